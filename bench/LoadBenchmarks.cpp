@@ -0,0 +1,78 @@
+#include "SyntheticCorpus.h"
+#include "VirtualMachine.h"
+#include "Inflater.h"
+#include "JarTransformer.h"
+#include "ClassHierarchy.h"
+
+#include <benchmark/benchmark.h>
+#include <cstdio>
+
+using std::string;
+using std::vector;
+
+namespace {
+	/**
+	 * Loads bench/C0 and, through its references, every other class in a synthetic jar, with a fresh
+	 * VirtualMachine each time so nothing is cached between iterations. Opening the jar is counted too, since
+	 * every real run has to do it. The first argument is the number of classes, and the second picks the
+	 * inflater backend, in the order Inflater::getBackends gives them.
+	 */
+	void getClassClosureBenchmark(benchmark::State& state) {
+		const unsigned int numClasses = state.range(0);
+		const vector<string> backends = Inflater::getBackends();
+		if(static_cast<size_t>(state.range(1)) >= backends.size()) {
+			state.SkipWithError("Inflater backend not compiled in");
+			return;
+		}
+		const string& backend = backends[state.range(1)];
+		vector<string> classpath(1, getCorpus(numClasses));
+		for(auto _ : state) {
+			VirtualMachine vm(classpath);
+			vm.setInflater(backend);
+			benchmark::DoNotOptimize(&vm.getClass("bench/C0"));
+		}
+		state.SetLabel(backend);
+		// Every class in the jar, plus java/lang/Object.
+		state.SetItemsProcessed(state.iterations() * (numClasses + 1));
+	}
+	BENCHMARK(getClassClosureBenchmark)->Name("VirtualMachine/getClass/closure")
+		->ArgsProduct({benchmark::CreateRange(16, 4096, 16), {0, 1}})->Unit(benchmark::kMillisecond);
+
+	/**
+	 * Strips the debug attributes out of every class in a synthetic jar, into a new jar. The argument is the
+	 * number of worker threads.
+	 */
+	void transformJarBenchmark(benchmark::State& state) {
+		const unsigned int numClasses = 1024;
+		const string& input = getCorpus(numClasses);
+		const string output = input + ".transformed";
+		VirtualMachine vm((vector<string>()));
+		JarTransformer transformer(vm, state.range(0));
+		transformer.addPass("strip-debug");
+		for(auto _ : state) {
+			transformer.run(input, output);
+		}
+		remove(output.c_str());
+		state.SetItemsProcessed(state.iterations() * transformer.numEntries());
+	}
+	BENCHMARK(transformJarBenchmark)->Name("JarTransformer/run")->RangeMultiplier(2)->Range(1, 8)
+		->Unit(benchmark::kMillisecond)->UseRealTime();
+
+	/**
+	 * Builds the hierarchy of every class in a synthetic jar, once they're all loaded. The argument is the
+	 * number of classes.
+	 */
+	void buildHierarchyBenchmark(benchmark::State& state) {
+		const unsigned int numClasses = state.range(0);
+		VirtualMachine vm(vector<string>(1, getCorpus(numClasses)));
+		vm.getClass("bench/C0");
+		uint32_t classes = 0;
+		for(auto _ : state) {
+			ClassHierarchy hierarchy(vm);
+			classes = hierarchy.numClasses();
+			benchmark::DoNotOptimize(classes);
+		}
+		state.SetItemsProcessed(state.iterations() * classes);
+	}
+	BENCHMARK(buildHierarchyBenchmark)->Name("ClassHierarchy/build")->Range(16, 4096)->Unit(benchmark::kMicrosecond);
+}
@@ -0,0 +1,308 @@
+#include "SyntheticCorpus.h"
+#include "CorpusGenerator.h"
+#include "ClassFile.h"
+#include "ConstantPool.h"
+#include "AttributePool.h"
+#include "ClassWriter.h"
+#include "ClassScanner.h"
+#include "Bytecode.h"
+#include "MemoryStreamBuf.h"
+#include "ModifiedUtf8.h"
+#include "Descriptor.h"
+#include "Util.h"
+
+#include <benchmark/benchmark.h>
+#include <istream>
+#include <memory>
+#include <sstream>
+
+using std::string;
+using std::vector;
+using std::istream;
+
+namespace {
+	/**
+	 * Generates a single class with the given constant pool size and number of methods, and no fields or
+	 * optional attributes, so the pool is mostly padding.
+	 */
+	string generateClass(unsigned int constantPoolSize, unsigned int methods) {
+		CorpusOptions options;
+		options.numClasses = 1;
+		options.constantPoolSize = constantPoolSize;
+		options.fields = 0;
+		options.methods = methods;
+		options.codeLength = 16;
+		options.lineNumbers = false;
+		options.sourceFile = false;
+		options.constantValues = false;
+		CorpusGenerator generator(options);
+		std::ostringstream out;
+		generator.generateClass(0, out);
+		return out.str();
+	}
+
+	/**
+	 * The bytes the integer readers chew through. Big enough that the loop dominates setting up the stream.
+	 */
+	const size_t READ_BUFFER_SIZE = 1 << 16;
+
+	void readShortUnsignedBenchmark(benchmark::State& state) {
+		string data(READ_BUFFER_SIZE, '\x5a');
+		for(auto _ : state) {
+			MemoryStreamBuf buffer(data.data(), data.size());
+			istream in(&buffer);
+			uint32_t sum = 0;
+			for(size_t i = 0; i < READ_BUFFER_SIZE / 2; i++) {
+				sum += readShortUnsigned(in);
+			}
+			benchmark::DoNotOptimize(sum);
+		}
+		state.SetBytesProcessed(state.iterations() * READ_BUFFER_SIZE);
+	}
+	BENCHMARK(readShortUnsignedBenchmark)->Name("Util/readShortUnsigned");
+
+	void readIntUnsignedBenchmark(benchmark::State& state) {
+		string data(READ_BUFFER_SIZE, '\x5a');
+		for(auto _ : state) {
+			MemoryStreamBuf buffer(data.data(), data.size());
+			istream in(&buffer);
+			uint32_t sum = 0;
+			for(size_t i = 0; i < READ_BUFFER_SIZE / 4; i++) {
+				sum += readIntUnsigned(in);
+			}
+			benchmark::DoNotOptimize(sum);
+		}
+		state.SetBytesProcessed(state.iterations() * READ_BUFFER_SIZE);
+	}
+	BENCHMARK(readIntUnsignedBenchmark)->Name("Util/readIntUnsigned");
+
+	/**
+	 * Builds just the constant pool of a class, by parsing the class from just past its magic and version
+	 * numbers. The argument is the size of the constant pool.
+	 */
+	void constantPoolConstructionBenchmark(benchmark::State& state) {
+		string data = generateClass(state.range(0), 1);
+		std::unique_ptr<ClassFile> owner(parseClass(data));
+		// Magic, then minor and major versions.
+		const size_t poolStart = 8;
+		uint64_t constants = 0;
+		for(auto _ : state) {
+			MemoryStreamBuf buffer(data.data() + poolStart, data.size() - poolStart);
+			istream in(&buffer);
+			ConstantPool pool(*owner, in);
+			constants += pool.getNumElements();
+			benchmark::DoNotOptimize(&pool);
+		}
+		state.SetItemsProcessed(constants);
+		state.SetBytesProcessed(state.iterations() * (data.size() - poolStart));
+	}
+	BENCHMARK(constantPoolConstructionBenchmark)->Name("ConstantPool/construct")->RangeMultiplier(8)->Range(64, 32768);
+
+	/**
+	 * Looks up every UTF-8 constant of a parsed class through ConstantPool::get, which is a dynamic_cast
+	 * on every call. The argument is the size of the constant pool.
+	 */
+	void constantPoolGetBenchmark(benchmark::State& state) {
+		std::unique_ptr<ClassFile> classFile(parseClass(generateClass(state.range(0), 1)));
+		const ConstantPool& pool = classFile->getConstantPool();
+		vector<uint16_t> indexes;
+		for(uint16_t i = 1; i <= pool.getNumElements(); i++) {
+			if(pool.isType<ConstantUtf8>(i)) {
+				indexes.push_back(i);
+			}
+		}
+		for(auto _ : state) {
+			size_t length = 0;
+			for(vector<uint16_t>::const_iterator i = indexes.begin(); i != indexes.end(); ++i) {
+				length += pool.get<ConstantUtf8>(*i).getStringValue().bytes();
+			}
+			benchmark::DoNotOptimize(length);
+		}
+		state.SetItemsProcessed(state.iterations() * indexes.size());
+	}
+	BENCHMARK(constantPoolGetBenchmark)->Name("ConstantPool/get")->RangeMultiplier(8)->Range(64, 32768);
+
+	/**
+	 * Decodes strings the length of a typical descriptor, all ASCII for 0, or with an accented letter every
+	 * sixteen characters for 1, which takes the scalar path around each one.
+	 */
+	void decodeModifiedUtf8Benchmark(benchmark::State& state) {
+		string data;
+		for(unsigned int i = 0; data.size() < READ_BUFFER_SIZE; i++) {
+			data += (state.range(0) && i % 16 == 15) ? "\xC3\xA9" : "x";
+		}
+		const size_t length = 48;
+		string out;
+		for(auto _ : state) {
+			for(size_t i = 0; i + length <= data.size(); i += length) {
+				benchmark::DoNotOptimize(decodeModifiedUtf8(data.data() + i, length, out));
+			}
+		}
+		state.SetBytesProcessed(state.iterations() * (data.size() / length) * length);
+	}
+	BENCHMARK(decodeModifiedUtf8Benchmark)->Name("ModifiedUtf8/decode")->Arg(0)->Arg(1);
+
+	/**
+	 * The number of methods in the classes the member benchmarks look through.
+	 */
+	const unsigned int MEMBER_COUNT = 256;
+
+	/**
+	 * Finds the Code attribute of every method by name, which compares the name of each attribute in turn.
+	 */
+	void getAttributeByNameBenchmark(benchmark::State& state) {
+		std::unique_ptr<ClassFile> classFile(parseClass(generateClass(0, MEMBER_COUNT)));
+		const ClassMemberPool& methods = classFile->getMethods();
+		const Glib::ustring name("Code");
+		for(auto _ : state) {
+			for(uint16_t i = 0; i < methods.numMembers(); i++) {
+				benchmark::DoNotOptimize(&methods[i].getAttributes().getAttribute(name));
+			}
+		}
+		state.SetItemsProcessed(state.iterations() * methods.numMembers());
+	}
+	BENCHMARK(getAttributeByNameBenchmark)->Name("AttributePool/getAttribute/name");
+
+	/**
+	 * Finds the Code attribute of every method by type, which is a dynamic_cast of each attribute in turn.
+	 */
+	void getAttributeByTypeBenchmark(benchmark::State& state) {
+		std::unique_ptr<ClassFile> classFile(parseClass(generateClass(0, MEMBER_COUNT)));
+		const ClassMemberPool& methods = classFile->getMethods();
+		for(auto _ : state) {
+			for(uint16_t i = 0; i < methods.numMembers(); i++) {
+				benchmark::DoNotOptimize(&methods[i].getAttributes().getAttribute<CodeAttribute>());
+			}
+		}
+		state.SetItemsProcessed(state.iterations() * methods.numMembers());
+	}
+	BENCHMARK(getAttributeByTypeBenchmark)->Name("AttributePool/getAttribute/type");
+
+	/**
+	 * Gets the name of every method, which goes through the constant pool each time.
+	 */
+	void getNameBenchmark(benchmark::State& state) {
+		std::unique_ptr<ClassFile> classFile(parseClass(generateClass(0, MEMBER_COUNT)));
+		const ClassMemberPool& methods = classFile->getMethods();
+		for(auto _ : state) {
+			for(uint16_t i = 0; i < methods.numMembers(); i++) {
+				benchmark::DoNotOptimize(&methods[i].getName());
+			}
+		}
+		state.SetItemsProcessed(state.iterations() * methods.numMembers());
+	}
+	BENCHMARK(getNameBenchmark)->Name("ClassMember/getName");
+
+	/**
+	 * Gets the number of argument slots of every method, which an invocation needs every time. The parsed
+	 * type is cached by the member after the first time.
+	 */
+	void getArgumentSlotsBenchmark(benchmark::State& state) {
+		std::unique_ptr<ClassFile> classFile(parseClass(generateClass(0, MEMBER_COUNT)));
+		const ClassMemberPool& methods = classFile->getMethods();
+		for(auto _ : state) {
+			unsigned int slots = 0;
+			for(uint16_t i = 0; i < methods.numMembers(); i++) {
+				slots += methods[i].getMethodType().getArgumentSlots();
+			}
+			benchmark::DoNotOptimize(slots);
+		}
+		state.SetItemsProcessed(state.iterations() * methods.numMembers());
+	}
+	BENCHMARK(getArgumentSlotsBenchmark)->Name("ClassMember/getMethodType");
+
+	/**
+	 * Resolves every method by its name and descriptor, through the pool's hash table.
+	 */
+	void findMemberBenchmark(benchmark::State& state) {
+		std::unique_ptr<ClassFile> classFile(parseClass(generateClass(0, MEMBER_COUNT)));
+		const ClassMemberPool& methods = classFile->getMethods();
+		vector<std::pair<string, string> > keys;
+		for(uint16_t i = 0; i < methods.numMembers(); i++) {
+			keys.push_back(std::make_pair(string(methods[i].getName()), string(methods[i].getDescriptor())));
+		}
+		for(auto _ : state) {
+			for(vector<std::pair<string, string> >::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+				benchmark::DoNotOptimize(methods.find(it->first, it->second));
+			}
+		}
+		state.SetItemsProcessed(state.iterations() * keys.size());
+	}
+	BENCHMARK(findMemberBenchmark)->Name("ClassMemberPool/find");
+
+	/**
+	 * Writes a parsed class back out. The first argument is the size of the constant pool, and the second is 1
+	 * if the writer is given the original bytes to copy the pool from, or 0 if it encodes every constant again.
+	 */
+	void writeClassBenchmark(benchmark::State& state) {
+		string data = generateClass(state.range(0), MEMBER_COUNT);
+		std::unique_ptr<ClassFile> classFile(parseClass(data));
+		ClassWriter writer(*classFile, state.range(1) ? data.data() : NULL, state.range(1) ? data.size() : 0);
+		string out(writer.getSize(), '\0');
+		for(auto _ : state) {
+			writer.write(&out[0]);
+			benchmark::DoNotOptimize(out.data());
+		}
+		state.SetBytesProcessed(state.iterations() * out.size());
+	}
+	BENCHMARK(writeClassBenchmark)->Name("ClassWriter/write")->ArgsProduct({{64, 4096, 32768}, {0, 1}});
+
+	/**
+	 * Parses a whole class into a ClassFile, as a baseline for scanning it.
+	 */
+	void parseClassBenchmark(benchmark::State& state) {
+		string data = generateClass(state.range(0), MEMBER_COUNT);
+		for(auto _ : state) {
+			std::unique_ptr<ClassFile> classFile(parseClass(data));
+			benchmark::DoNotOptimize(classFile.get());
+		}
+		state.SetBytesProcessed(state.iterations() * data.size());
+	}
+	BENCHMARK(parseClassBenchmark)->Name("ClassFile/parse")->RangeMultiplier(8)->Range(64, 32768);
+
+	/**
+	 * Counts the classes, fields and methods a class refers to, and the instructions that refer to them if
+	 * it's asked to visit instructions.
+	 */
+	class ReferenceCounter : public ClassVisitor {
+	public:
+		bool instructions;
+		uint32_t references;
+
+		ReferenceCounter(bool instructions) : instructions(instructions), references(0) {}
+
+		void visitClassConstant(uint16_t index, uint16_t nameIndex) {
+			references++;
+		}
+
+		void visitMemberReference(uint16_t index, uint8_t tag, uint16_t classIndex, uint16_t nameAndTypeIndex) {
+			references++;
+		}
+
+		bool visitCode(uint16_t maxStack, uint16_t maxLocals, const uint8_t* code, uint32_t codeLength) {
+			return instructions;
+		}
+
+		void visitInstruction(const Instruction& instruction, const uint8_t* code) {
+			if(instruction.opcode >= BY_getstatic && instruction.opcode <= BY_invokeinterface) {
+				references++;
+			}
+		}
+	};
+
+	/**
+	 * Scans a class for what it refers to, without building a ClassFile. The first argument is the size of the
+	 * constant pool, and the second is 1 if every instruction is visited too.
+	 */
+	void scanClassBenchmark(benchmark::State& state) {
+		string data = generateClass(state.range(0), MEMBER_COUNT);
+		ClassScanner scanner;
+		ReferenceCounter counter(state.range(1) != 0);
+		for(auto _ : state) {
+			scanner.scan(data.data(), data.size(), counter);
+		}
+		benchmark::DoNotOptimize(counter.references);
+		state.SetBytesProcessed(state.iterations() * data.size());
+	}
+	BENCHMARK(scanClassBenchmark)->Name("ClassScanner/scan")->ArgsProduct({{64, 4096, 32768}, {0, 1}});
+}
@@ -0,0 +1,73 @@
+#include "SyntheticCorpus.h"
+#include "CorpusGenerator.h"
+#include "ClassFile.h"
+#include "MemoryStreamBuf.h"
+#include "Util.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <stdexcept>
+#include <unistd.h>
+
+using std::string;
+using std::vector;
+using std::map;
+using std::istream;
+using std::runtime_error;
+
+namespace {
+	/**
+	 * The temporary directory holding the corpus jars, and the jars themselves, keyed by their size.
+	 */
+	string corpusDirectory;
+	map<unsigned int, string> corpora;
+
+	void deleteCorpora() {
+		for(map<unsigned int, string>::const_iterator i = corpora.begin(); i != corpora.end(); ++i) {
+			remove(i->second.c_str());
+		}
+		if(!corpusDirectory.empty()) {
+			rmdir(corpusDirectory.c_str());
+		}
+	}
+}
+
+/**
+ * Gets the path of a generated jar of numClasses classes named bench/C0, bench/C1, and so on, in a tree
+ * rooted at bench/C0, so loading it loads all of them. Jars are generated the first time they're asked for,
+ * and deleted when the program exits.
+ */
+const string& getCorpus(unsigned int numClasses) {
+	map<unsigned int, string>::const_iterator existing = corpora.find(numClasses);
+	if(existing != corpora.end()) {
+		return existing->second;
+	}
+	if(corpusDirectory.empty()) {
+		char directory[] = "/tmp/djava-bench-XXXXXX";
+		if(!mkdtemp(directory)) {
+			throw runtime_error("Could not create a directory for the benchmark corpus");
+		}
+		corpusDirectory = directory;
+		atexit(deleteCorpora);
+	}
+
+	CorpusOptions options;
+	options.numClasses = numClasses;
+	options.packageName = "bench";
+	CorpusGenerator generator(options);
+	string path = corpusDirectory + "/corpus-" + toString(numClasses) + ".jar";
+	generator.writeJar(path);
+	return corpora[numClasses] = path;
+}
+
+/**
+ * Parses a class out of memory, without initializing it. Parsing never touches the VirtualMachine, so every
+ * class belongs to one shared VirtualMachine with an empty classpath.
+ */
+ClassFile* parseClass(const string& data) {
+	static VirtualMachine vm((vector<string>()));
+	MemoryStreamBuf buffer(data.data(), data.size());
+	istream in(&buffer);
+	return new ClassFile(vm, in);
+}
@@ -0,0 +1,21 @@
+#ifndef SYNTHETIC_CORPUS_H
+#define SYNTHETIC_CORPUS_H
+
+#include <string>
+
+class ClassFile;
+
+/**
+ * Gets the path of a generated jar of numClasses classes named bench/C0, bench/C1, and so on, in a tree
+ * rooted at bench/C0, so loading it loads all of them. Jars are generated the first time they're asked for,
+ * and deleted when the program exits.
+ */
+const std::string& getCorpus(unsigned int numClasses);
+
+/**
+ * Parses a class out of memory, without initializing it. Parsing never touches the VirtualMachine, so every
+ * class belongs to one shared VirtualMachine with an empty classpath.
+ */
+ClassFile* parseClass(const std::string& data);
+
+#endif
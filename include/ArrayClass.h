@@ -0,0 +1,34 @@
+#ifndef ARRAY_CLASS_H
+#define ARRAY_CLASS_H
+
+#include <string>
+#include <stdint.h>
+#include "Descriptor.h"
+
+class ClassFile;
+
+/**
+ * The class of an array, like [I or [[Ljava/lang/String;. Array classes have no class file; the
+ * VirtualMachine makes one the first time it's asked for, and keeps it, keyed by its interned type, which
+ * stands for the element type and the number of dimensions together.
+ */
+class ArrayClass {
+private:
+	const FieldType& type;
+	ClassFile* elementClass;
+
+	ArrayClass(const ArrayClass& a) : type(a.type) {}
+	const ArrayClass& operator=(const ArrayClass&) { return *this; }
+public:
+	ArrayClass(const FieldType& type, ClassFile* elementClass);
+	virtual ~ArrayClass();
+
+	const FieldType& getType() const;
+	const std::string& getName() const;
+	uint8_t getDimensions() const;
+	FieldType::Kind getElementKind() const;
+	ClassFile* getElementClass() const;
+	const FieldType& getComponentType() const;
+};
+
+#endif
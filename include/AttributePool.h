@@ -36,6 +36,7 @@ public:
 	const ClassFile& getClassFile() const;
 	
 	uint16_t getNumAttributes() const;
+	const Attribute& operator[](uint16_t index) const;
 	
 	bool containsAttribute(const Glib::ustring& name) const;
 	const Attribute& getAttribute(const Glib::ustring& name) const;
@@ -44,12 +45,22 @@ public:
 	AttributeType& getAttribute() {
 		for(std::vector<Attribute*>::iterator it = attributes.begin(); it != attributes.end(); it++) {
 			if(dynamic_cast<AttributeType*>(*it)) {
-				return *it;
+				return *dynamic_cast<AttributeType*>(*it);
 			}
 		}
 		throw std::runtime_error("No such attribute type");
 	}
 	
+	template<typename AttributeType>
+	bool containsAttribute() const {
+		for(std::vector<Attribute*>::const_iterator it = attributes.begin(); it != attributes.end(); it++) {
+			if(dynamic_cast<const AttributeType*>(*it)) {
+				return true;
+			}
+		}
+		return false;
+	}
+	
 	template<typename AttributeType>
 	const AttributeType& getAttribute() const {
 		return const_cast<AttributePool*>(this)->getAttribute<AttributeType>();
@@ -115,4 +126,50 @@ public:
 	uint16_t getIndex() const;
 };
 
+/**
+ * One entry in the exception table of a Code attribute. The handler at handlerPc covers the instructions
+ * in [startPc, endPc), for exceptions of the class at catchType in the constant pool (or all exceptions,
+ * if catchType is 0).
+ */
+struct ExceptionHandler {
+	uint16_t startPc;
+	uint16_t endPc;
+	uint16_t handlerPc;
+	uint16_t catchType;
+};
+
+/**
+ * Class for the Code Attribute, which holds the bytecode of a method along with the sizes of its frame,
+ * its exception table, and attributes of its own (like the LineNumberTable). Every method that isn't native
+ * or abstract has exactly one of these.
+ * http://docs.oracle.com/javase/specs/jvms/se7/html/jvms-4.html#jvms-4.7.3
+ */
+class CodeAttribute : public Attribute {
+private:
+	uint16_t maxStack;
+	uint16_t maxLocals;
+	uint32_t codeLength;
+	std::vector<uint8_t> code;
+	std::vector<ExceptionHandler> exceptionTable;
+	AttributePool attributes;
+	
+	CodeAttribute(CodeAttribute& a);
+	virtual const CodeAttribute& operator=(CodeAttribute& c) { return *this; }
+	
+	std::vector<uint8_t> readCode(std::istream& input);
+	std::vector<ExceptionHandler> buildExceptionTable(std::istream& input);
+public:
+	const static Glib::ustring name;
+	
+	CodeAttribute(AttributePool& attributePool, uint16_t nameIndex, std::istream& input);
+	virtual ~CodeAttribute();
+	
+	uint16_t getMaxStack() const;
+	uint16_t getMaxLocals() const;
+	uint32_t getCodeLength() const;
+	const uint8_t* getCode() const;
+	const std::vector<ExceptionHandler>& getExceptionTable() const;
+	const AttributePool& getAttributes() const;
+};
+
 #endif
\ No newline at end of file
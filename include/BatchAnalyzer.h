@@ -0,0 +1,96 @@
+#ifndef BATCH_ANALYZER_H
+#define BATCH_ANALYZER_H
+
+#include <map>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <utility>
+#include <iostream>
+#include <stdint.h>
+
+#include "Inflater.h"
+
+class VirtualMachine;
+class ClassQueue;
+
+/**
+ * Statistics gathered from parsing a single class file. If the class couldn't be parsed, error holds the
+ * reason, and only jar, name and size are meaningful.
+ */
+struct ClassStatistics {
+	std::string jar;
+	std::string name;
+	uint32_t size;
+	uint16_t constantPoolSize;
+	uint16_t fieldCount;
+	uint16_t methodCount;
+	uint32_t codeSize;
+	std::map<std::string, uint32_t> attributes;
+	std::string error;
+};
+
+/**
+ * Parses every class in a set of jars, not just the ones reachable from some main class, and gathers
+ * statistics on each of them. Classes are only parsed, not initialized, so nothing gets loaded into the
+ * VirtualMachine.
+ *
+ * run() divides the entries between worker threads, each of which has its own libzip handle on every jar,
+ * since those can't be shared between threads. runStreaming() instead reads each jar sequentially on the
+ * calling thread, and queues the classes up for the workers.
+ */
+class BatchAnalyzer {
+public:
+	enum OutputFormat {
+		JSON,
+		CSV
+	};
+
+	BatchAnalyzer(VirtualMachine& vm, unsigned int numThreads = 0);
+	virtual ~BatchAnalyzer();
+
+	void setInflater(const std::string& backend);
+	void addJar(const std::string& path);
+	void run();
+	void runStreaming();
+
+	const std::vector<ClassStatistics>& getStatistics() const;
+	uint32_t numErrors() const;
+	uint64_t getTotalBytes() const;
+	double getElapsedSeconds() const;
+
+	void write(std::ostream& out, OutputFormat format) const;
+	void writeThroughput(std::ostream& out) const;
+
+private:
+	BatchAnalyzer(const BatchAnalyzer& b) : vm(b.vm) {}
+	const BatchAnalyzer& operator=(const BatchAnalyzer&) { return *this; }
+
+	/**
+	 * A class file inside one of the jars, by index into jars and into the jar's own entries.
+	 */
+	struct Entry {
+		uint32_t jar;
+		uint64_t index;
+	};
+
+	void listEntries();
+	void work();
+	void consume(ClassQueue& queue, std::vector<std::pair<uint32_t, ClassStatistics> >& results);
+	void analyze(const std::string& data, ClassStatistics& statistics);
+	void addInflaterStatistics(const Inflater& inflater);
+
+	VirtualMachine& vm;
+	unsigned int numThreads;
+	std::vector<std::string> jars;
+	std::vector<Entry> entries;
+	std::vector<ClassStatistics> statistics;
+	std::atomic<uint32_t> nextEntry;
+	std::string inflaterBackend;
+	InflaterStatistics inflaterStatistics;
+	std::mutex statisticsMutex;
+	double elapsedSeconds;
+};
+
+#endif
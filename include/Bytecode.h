@@ -0,0 +1,74 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <vector>
+#include <stdint.h>
+
+#include "Constants.h"
+
+class CodeAttribute;
+
+/**
+ * Static information about an opcode: its mnemonic, its length in bytes (0 for the variable-length
+ * tableswitch, lookupswitch and wide), and how many operand stack slots it pops and pushes. Longs and doubles
+ * take two slots. Instructions whose stack effect depends on a descriptor (field accesses, invocations,
+ * multianewarray) have -1 for both.
+ */
+struct OpcodeInfo {
+	const char* name;
+	uint8_t length;
+	int8_t pops;
+	int8_t pushes;
+};
+
+const OpcodeInfo& getOpcodeInfo(uint8_t opcode);
+
+/**
+ * A single decoded instruction: where it starts in the code, how long it is, and its opcode. For wide
+ * instructions, opcode is the modified instruction, not BY_wide.
+ */
+struct Instruction {
+	uint32_t pc;
+	uint16_t length;
+	uint8_t opcode;
+	bool wide;
+};
+
+void decodeInstruction(const uint8_t* code, uint32_t codeLength, uint32_t pc, Instruction& instruction);
+
+/**
+ * The decoded instruction stream of a Code attribute. Decoding is done once, up front; after that, the
+ * instructions can be walked in order or looked up by pc, and their operands read without re-decoding.
+ */
+class MethodCode {
+private:
+	const CodeAttribute& code;
+	std::vector<Instruction> instructions;
+	std::vector<uint32_t> pcIndex;
+
+	MethodCode(const MethodCode& m) : code(m.code) {}
+	const MethodCode& operator=(const MethodCode&) { return *this; }
+public:
+	static const uint32_t NO_INSTRUCTION = 0xFFFFFFFF;
+
+	MethodCode(const CodeAttribute& code);
+	virtual ~MethodCode();
+
+	const CodeAttribute& getCode() const;
+
+	uint32_t numInstructions() const;
+	const Instruction& operator[](uint32_t index) const;
+	uint32_t indexOf(uint32_t pc) const;
+
+	uint16_t getIndexOperand(const Instruction& instruction) const;
+	int32_t getConstantOperand(const Instruction& instruction) const;
+	uint32_t getBranchTarget(const Instruction& instruction) const;
+	uint32_t getSwitchTargets(const Instruction& instruction, std::vector<uint32_t>& targets) const;
+
+	static bool isBranch(uint8_t opcode);
+	static bool isSwitch(uint8_t opcode);
+	static bool isReturn(uint8_t opcode);
+	static bool endsBlock(uint8_t opcode);
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef CLASS_ARCHIVE_H
+#define CLASS_ARCHIVE_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A class data sharing archive: the already inflated bytes of a list of classes, with an index sorted by
+ * class name, in a single file that's mapped read-only. Every process that maps the same archive shares the
+ * same physical pages through the page cache, and loading a class out of it is a binary search and a parse
+ * straight out of the mapping, without touching a jar or inflating anything.
+ *
+ * Parsed ClassFiles are graphs of heap objects, full of pointers and vtables, so the archive keeps the class
+ * file bytes rather than the parsed form; they're position independent by nature. That makes it a cache of
+ * inflated classes: each process still parses every class it loads into its own heap.
+ *
+ * An archive also remembers the order its classes were given in, and optionally the name of a main class, so
+ * that a VirtualMachine can be snapshotted into one and restored from it in the order it loaded its classes.
+ *
+ * The layout is a header, the index, the load order, the names, then the classes, each starting on an 8 byte
+ * boundary. All integers are little-endian.
+ */
+class ClassArchive {
+private:
+	/**
+	 * An entry in the index, pointing at a name and at a class's bytes, relative to the start of the file.
+	 */
+	struct IndexEntry {
+		uint32_t nameOffset;
+		uint32_t nameLength;
+		uint64_t dataOffset;
+		uint32_t dataLength;
+		uint32_t crc;
+	};
+
+	std::string path;
+	const uint8_t* mapping;
+	size_t mappingSize;
+	uint32_t count;
+	const uint8_t* index;
+	const uint8_t* order;
+	std::string mainClass;
+
+	ClassArchive(const ClassArchive&) {}
+	const ClassArchive& operator=(const ClassArchive&) { return *this; }
+
+	IndexEntry getEntry(uint32_t i) const;
+public:
+	static const uint32_t VERSION = 2;
+
+	ClassArchive(const std::string& path);
+	virtual ~ClassArchive();
+
+	uint32_t size() const;
+	std::string getName(uint32_t i) const;
+	bool find(const std::string& name, const char*& data, size_t& size) const;
+	bool verify(std::string& error) const;
+	std::vector<std::string> getLoadOrder() const;
+	const std::string& getMainClass() const;
+
+	static void write(const std::string& path, const std::vector<std::pair<std::string, std::string> >& classes,
+		const std::string& mainClass = "");
+};
+
+#endif
@@ -10,6 +10,7 @@
 #include "ConstantPool.h"
 #include "AttributePool.h"
 #include "ClassMember.h"
+#include "Monitor.h"
 
 class Frame;
 
@@ -31,6 +32,15 @@ public:
 	uint16_t getMinorVersion() const;
 	uint16_t getMajorVersion() const;
 	
+	const Glib::ustring& getName() const;
+	std::vector<std::string> getReferencedClasses() const;
+	
+	uint16_t getThisClassIndex() const;
+	uint16_t getSuperClassIndex() const;
+	const std::vector<uint16_t>& getInterfaces() const;
+	std::string getSuperClassName() const;
+	std::vector<std::string> getInterfaceNames() const;
+	
 	ConstantPool& getConstantPool();
 	const ConstantPool& getConstantPool() const;
 	
@@ -46,6 +56,8 @@ public:
 	AttributePool& getAttributes();
 	const AttributePool& getAttributes() const;
 	
+	ObjectHeader& getHeader();
+	
 private:
 	//ClassFile(const ClassFile&) {}
 	//const ClassFile& operator=(const ClassFile&) { return *this; }
@@ -67,6 +79,7 @@ private:
 	ClassMemberPool fields;
 	ClassMemberPool methods;
 	AttributePool attributePool;
+	ObjectHeader header;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,86 @@
+#ifndef CLASS_HIERARCHY_H
+#define CLASS_HIERARCHY_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+class ClassFile;
+class VirtualMachine;
+
+/**
+ * The class hierarchy of a set of loaded classes: what each class extends and implements, and the other way
+ * around, what extends and implements it, for subtype checks like checkcast and instanceof and for tools that
+ * need every subclass, implementor or overrider of something.
+ *
+ * It's built once, as a snapshot, and never changes. Every class gets a dense id, and every list is a compact
+ * adjacency array indexed by id. The superclass tree is numbered in pre-order, so the subclasses of a class are
+ * the classes numbered within its interval, and checking whether one class extends another is two comparisons.
+ * Interfaces form a graph rather than a tree, so each class keeps the sorted ids of every interface it implements,
+ * directly or not, and each interface keeps every class that implements it.
+ *
+ * Classes that are named as a superclass or interface but weren't loaded are in the hierarchy too, without
+ * supertypes of their own. The classes it was built from must outlive it; reloading classes invalidates it.
+ */
+class ClassHierarchy {
+private:
+	std::vector<std::string> names;
+	std::unordered_map<std::string, uint32_t> ids;
+	std::vector<const ClassFile*> classFiles;
+	std::vector<bool> interfaces;
+	std::vector<uint32_t> superclasses;
+
+	// Each list is a start offset per class, plus one at the end, into one array of ids.
+	std::vector<uint32_t> subclassStarts;
+	std::vector<uint32_t> subclasses;
+	std::vector<uint32_t> directInterfaceStarts;
+	std::vector<uint32_t> directInterfaces;
+	std::vector<uint32_t> directImplementorStarts;
+	std::vector<uint32_t> directImplementors;
+	std::vector<uint32_t> interfaceStarts;
+	std::vector<uint32_t> allInterfaces;
+	std::vector<uint32_t> implementorStarts;
+	std::vector<uint32_t> implementors;
+
+	// The pre-order interval of each class in the superclass tree, and the classes in pre-order.
+	std::vector<uint32_t> preorder;
+	std::vector<uint32_t> intervalEnds;
+	std::vector<uint32_t> order;
+
+	ClassHierarchy(const ClassHierarchy&) {}
+	const ClassHierarchy& operator=(const ClassHierarchy&) { return *this; }
+
+	uint32_t addClass(const std::string& name);
+	void build(const std::vector<const ClassFile*>& classes);
+	void numberTree();
+	void findInterfaces(uint32_t id, std::vector<std::vector<uint32_t> >& closures, std::vector<uint8_t>& states) const;
+	std::vector<std::string> getNames(const std::vector<uint32_t>& starts, const std::vector<uint32_t>& lists, uint32_t id) const;
+public:
+	static const uint32_t NONE = 0xFFFFFFFF;
+
+	ClassHierarchy(VirtualMachine& vm);
+	ClassHierarchy(const std::vector<const ClassFile*>& classes);
+	virtual ~ClassHierarchy();
+
+	uint32_t numClasses() const;
+	uint32_t getId(const std::string& name) const;
+	const std::string& getName(uint32_t id) const;
+	const ClassFile* getClassFile(uint32_t id) const;
+	bool isInterface(uint32_t id) const;
+	uint32_t getSuperclass(uint32_t id) const;
+
+	bool isSubclassOf(uint32_t id, uint32_t superclass) const;
+	bool isSubtypeOf(uint32_t id, uint32_t type) const;
+	bool isSubclassOf(const std::string& name, const std::string& superclass) const;
+	bool isSubtypeOf(const std::string& name, const std::string& type) const;
+
+	std::vector<std::string> getDirectSubclasses(const std::string& name) const;
+	std::vector<std::string> getSubclasses(const std::string& name) const;
+	std::vector<std::string> getDirectImplementors(const std::string& name) const;
+	std::vector<std::string> getImplementors(const std::string& name) const;
+	std::vector<std::string> getOverriders(const std::string& className, const std::string& name,
+		const std::string& descriptor) const;
+};
+
+#endif
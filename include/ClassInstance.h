@@ -2,13 +2,14 @@
 #define CLASS_INSTANCE_H
 
 #include "ClassFile.h"
+#include "Monitor.h"
 #include <map>
 #include <string>
 #include <inttypes.h>
 
 class ClassFile;
 
-class ClassInstance {
+class ClassInstance : public ObjectHeader {
 public:
 	virtual ~ClassInstance() {}
 	
@@ -24,7 +25,7 @@ protected:
 	std::map<std::string,uint64_t> vars;
 };
 
-class JavaArray {
+class JavaArray : public ObjectHeader {
 public:
 	virtual ~JavaArray() {
 		delete[] storage;
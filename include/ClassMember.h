@@ -3,8 +3,12 @@
 
 #include "AttributePool.h"
 #include "ConstantPool.h"
+#include <atomic>
 #include <iostream>
 
+class FieldType;
+class MethodType;
+
 /**
  * This class wraps the access_flags attribute present in method and field structures in the class file. It has
  * convenience methods for checking all of the bits, so that the bitwise operations for checking visibility, access, et cetera
@@ -52,6 +56,8 @@ private:
 	uint16_t nameIndex;
 	uint16_t descriptorIndex;
 	AttributePool attributes;
+	mutable std::atomic<const FieldType*> fieldType;
+	mutable std::atomic<const MethodType*> methodType;
 	
 	ClassMember(ClassMember& cm) : cf(cm.cf), accessFlags(0), attributes(cm.cf, *((std::istream*)NULL)) {} //You really don't want to call this one.
 	virtual ClassMember& operator=(const ClassMember &cm) { return *this; }
@@ -66,23 +72,47 @@ public:
 	
 	const Glib::ustring& getName() const;
 	const Glib::ustring& getDescriptor() const;
+	const FieldType& getFieldType() const;
+	const MethodType& getMethodType() const;
 };
 
 /**
  * This represents all of either the fields or the methods in a class file. This class manages the fact that
  * a certain number have to be read, and moves that issue out of the ClassFile class.
+ * 
+ * Members are also indexed by name and descriptor in an open addressing hash table built as they're read, so
+ * resolving a field or method is a hash and usually a single comparison, instead of a scan through every member
+ * that looks up each one's name in the constant pool.
  */
 class ClassMemberPool {
 private:
+	/**
+	 * A slot in the hash table: the hash of a member's name and descriptor, its index plus one, or zero if the
+	 * slot is empty, and its name and descriptor as they are in the constant pool, so comparing them doesn't go
+	 * through the pool.
+	 */
+	struct Slot {
+		uint32_t hash;
+		uint16_t member;
+		const std::string* name;
+		const std::string* descriptor;
+	};
+	
 	ClassFile& cf;
 	std::vector<ClassMember*> members;
+	std::vector<Slot> table;
 	
+	void buildTable();
+	static uint32_t hash(const std::string& name, const std::string& descriptor);
 public:
 	ClassMemberPool(ClassFile& cf, std::istream& in);
 	virtual ~ClassMemberPool();
 	
 	uint16_t numMembers() const;
 	
+	ClassMember* find(const std::string& name, const std::string& descriptor);
+	const ClassMember* find(const std::string& name, const std::string& descriptor) const;
+	
 	ClassMember& operator[](uint16_t index);
 	const ClassMember& operator[](uint16_t index) const;
 };
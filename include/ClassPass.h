@@ -0,0 +1,31 @@
+#ifndef CLASS_PASS_H
+#define CLASS_PASS_H
+
+#include <string>
+#include <vector>
+#include "ClassWriter.h"
+
+/**
+ * A transformation applied to every class a JarTransformer rewrites. Passes see each attribute as the class is
+ * written, and decide whether it's kept.
+ *
+ * Passes are created by name, and are shared by every worker thread, so they can't keep any state of their own
+ * while they run.
+ */
+class ClassPass : public AttributeFilter {
+private:
+	ClassPass(const ClassPass&) {}
+	const ClassPass& operator=(const ClassPass&) { return *this; }
+protected:
+	ClassPass();
+public:
+	static ClassPass* create(const std::string& name);
+	static std::vector<std::string> getPasses();
+
+	virtual ~ClassPass();
+
+	virtual const char* getName() const = 0;
+	virtual bool keepAttribute(const Attribute& attribute) const;
+};
+
+#endif
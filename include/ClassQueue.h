@@ -0,0 +1,48 @@
+#ifndef CLASS_QUEUE_H
+#define CLASS_QUEUE_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+
+/**
+ * The bytes of a single class file read out of a jar, along with where it came from. sequence is the order
+ * the class was read in, so that results computed out of order can be put back in order.
+ */
+struct ClassBuffer {
+	uint32_t sequence;
+	std::string jar;
+	std::string name;
+	std::string data;
+};
+
+/**
+ * A bounded queue that hands class buffers from the thread reading jars to the threads parsing them. Buffers
+ * are swapped in and out of the queue's slots instead of copied, so the memory a consumer hands back with its
+ * next pop() ends up being reused by the producer, and nothing is allocated per class once the buffers have
+ * grown to fit.
+ */
+class ClassQueue {
+private:
+	std::vector<ClassBuffer> slots;
+	size_t head;
+	size_t count;
+	bool closed;
+	std::mutex queueMutex;
+	std::condition_variable notEmpty;
+	std::condition_variable notFull;
+
+	ClassQueue(const ClassQueue&) {}
+	const ClassQueue& operator=(const ClassQueue&) { return *this; }
+public:
+	ClassQueue(size_t capacity);
+	virtual ~ClassQueue();
+
+	void push(ClassBuffer& buffer);
+	bool pop(ClassBuffer& buffer);
+	void close();
+};
+
+#endif
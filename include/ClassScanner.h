@@ -0,0 +1,99 @@
+#ifndef CLASS_SCANNER_H
+#define CLASS_SCANNER_H
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+struct Instruction;
+class ClassScanner;
+
+/**
+ * Receives the parts of a class file from a ClassScanner, in the order they're in the file. Every callback does
+ * nothing by default, so a visitor only overrides the ones it wants.
+ *
+ * Nothing is copied: strings, attribute contents and bytecode are pointers into the bytes being scanned, and
+ * are only valid until the scan is over. Strings are in modified UTF-8, and aren't NUL terminated. Constants
+ * are visited first; everything after them refers to constants by index, which can be looked up through the
+ * scanner given to visitClass.
+ */
+class ClassVisitor {
+public:
+	/**
+	 * What an attribute belongs to.
+	 */
+	enum Owner {
+		CLASS,
+		FIELD,
+		METHOD,
+		CODE
+	};
+
+	virtual ~ClassVisitor();
+
+	virtual void visitUtf8(uint16_t index, const char* data, uint16_t length);
+	virtual void visitInteger(uint16_t index, int32_t value);
+	virtual void visitFloat(uint16_t index, float value);
+	virtual void visitLong(uint16_t index, int64_t value);
+	virtual void visitDouble(uint16_t index, double value);
+	virtual void visitClassConstant(uint16_t index, uint16_t nameIndex);
+	virtual void visitString(uint16_t index, uint16_t stringIndex);
+	virtual void visitMemberReference(uint16_t index, uint8_t tag, uint16_t classIndex, uint16_t nameAndTypeIndex);
+	virtual void visitNameAndType(uint16_t index, uint16_t nameIndex, uint16_t descriptorIndex);
+	virtual void visitMethodHandle(uint16_t index, uint8_t referenceKind, uint16_t referenceIndex);
+	virtual void visitMethodType(uint16_t index, uint16_t descriptorIndex);
+	virtual void visitInvokeDynamic(uint16_t index, uint16_t bootstrapMethodIndex, uint16_t nameAndTypeIndex);
+
+	virtual void visitClass(const ClassScanner& scanner, uint16_t accessFlags, uint16_t thisClass, uint16_t superClass);
+	virtual void visitInterface(uint16_t classIndex);
+	virtual void visitField(uint16_t accessFlags, uint16_t nameIndex, uint16_t descriptorIndex);
+	virtual void visitMethod(uint16_t accessFlags, uint16_t nameIndex, uint16_t descriptorIndex);
+	virtual void visitAttribute(Owner owner, uint16_t nameIndex, const uint8_t* info, uint32_t length);
+	virtual bool visitCode(uint16_t maxStack, uint16_t maxLocals, const uint8_t* code, uint32_t codeLength);
+	virtual void visitInstruction(const Instruction& instruction, const uint8_t* code);
+	virtual void visitExceptionHandler(uint16_t startPc, uint16_t endPc, uint16_t handlerPc, uint16_t catchType);
+	virtual void visitEnd();
+};
+
+/**
+ * Walks through the bytes of a class file and hands each part of it to a ClassVisitor as it's reached, without
+ * building a ClassFile, or allocating anything for each part. It's for analyses that only need to see what a
+ * class refers to, which would otherwise pay for the whole object graph of every class.
+ *
+ * The only thing kept is where each constant starts, so that they can be looked up by index, and that table is
+ * reused from one class to the next, so scanning a whole jar with one scanner allocates almost nothing.
+ */
+class ClassScanner {
+private:
+	const uint8_t* data;
+	size_t size;
+	size_t position;
+	std::vector<uint32_t> constants;
+	uint16_t codeNameIndex;
+
+	ClassScanner(const ClassScanner&) {}
+	const ClassScanner& operator=(const ClassScanner&) { return *this; }
+
+	void require(size_t count, const char* what) const;
+	uint8_t readByte();
+	uint16_t readShort();
+	uint32_t readInt();
+
+	void scanConstantPool(ClassVisitor& visitor);
+	void scanMembers(ClassVisitor& visitor, ClassVisitor::Owner owner);
+	void scanAttributes(ClassVisitor& visitor, ClassVisitor::Owner owner);
+	void scanCode(ClassVisitor& visitor, uint32_t length);
+public:
+	ClassScanner();
+	virtual ~ClassScanner();
+
+	void scan(const char* data, size_t size, ClassVisitor& visitor);
+
+	uint16_t getNumConstants() const;
+	uint8_t getTag(uint16_t index) const;
+	const uint8_t* getConstant(uint16_t index) const;
+	const char* getUtf8(uint16_t index, uint16_t& length) const;
+	const char* getClassName(uint16_t index, uint16_t& length) const;
+};
+
+#endif
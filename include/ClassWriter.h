@@ -0,0 +1,85 @@
+#ifndef CLASS_WRITER_H
+#define CLASS_WRITER_H
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+class ClassFile;
+class ConstantPool;
+class Constant;
+class ClassMemberPool;
+class AttributePool;
+class Attribute;
+
+/**
+ * Decides which attributes a ClassWriter leaves out of what it writes.
+ */
+class AttributeFilter {
+public:
+	virtual ~AttributeFilter() {}
+
+	virtual bool keepAttribute(const Attribute& attribute) const = 0;
+};
+
+/**
+ * Serializes a ClassFile back into the class file format. The size is worked out first, so the whole class
+ * is written into one buffer of exactly the right size, with no reallocation or copying afterwards.
+ *
+ * As much as possible is copied rather than rebuilt: the bytecode of Code attributes and the contents of
+ * attributes that aren't understood are copied as they were read, and if the bytes the class was parsed from
+ * are given, the constant pool is copied from them, since nothing in it has changed. Otherwise the pool is
+ * encoded again from the parsed constants, which gives the same bytes.
+ *
+ * Attributes can be left out with AttributeFilters, wherever they are, including inside Code attributes.
+ *
+ * The constant pool can also be compacted, once the filters are added, so that it only holds the constants that
+ * what's left of the class refers to. The constants that are kept stay in the same order, and every index is
+ * renumbered as it's written, including the ones in bytecode and in the attributes that are copied. That only
+ * works if where every index is can be found, so classes with attributes of a layout that isn't known keep all
+ * of their constants.
+ */
+class ClassWriter {
+private:
+	struct Output;
+	struct Marks;
+
+	const ClassFile& classFile;
+	const char* original;
+	size_t originalSize;
+	size_t originalConstantPoolSize;
+	std::vector<const AttributeFilter*> filters;
+	std::vector<uint16_t> constantMap;
+	uint16_t numConstants;
+
+	ClassWriter(const ClassWriter& w) : classFile(w.classFile) {}
+	const ClassWriter& operator=(const ClassWriter&) { return *this; }
+
+	void writeClass(Output& out) const;
+	void writeConstantPool(Output& out) const;
+	void writeConstant(Output& out, const Constant& constant) const;
+	void writeMembers(Output& out, const ClassMemberPool& members) const;
+	void writeAttributes(Output& out, const AttributePool& attributes) const;
+	void writeAttribute(Output& out, const Attribute& attribute) const;
+	void patchReferences(Output& out, size_t start, const std::vector<uint32_t>& offsets, const std::vector<uint32_t>& byteOffsets) const;
+
+	bool keepAttribute(const Attribute& attribute) const;
+	void markMembers(Marks& marks, const ClassMemberPool& members) const;
+	void markAttributes(Marks& marks, const AttributePool& attributes) const;
+	uint16_t mapConstant(uint16_t index) const;
+
+	size_t getOriginalConstantPoolSize() const;
+public:
+	ClassWriter(const ClassFile& classFile, const char* original = NULL, size_t originalSize = 0);
+	virtual ~ClassWriter();
+
+	void addFilter(const AttributeFilter* filter);
+	bool compactConstantPool();
+
+	size_t getSize() const;
+	void write(char* buffer) const;
+	std::string write() const;
+};
+
+#endif
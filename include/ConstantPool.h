@@ -5,6 +5,7 @@
  */
 
 #include <stdint.h>
+#include <atomic>
 #include <iostream>
 #include <vector>
 #include <glibmm/ustring.h>
@@ -12,6 +13,8 @@
 #include "Constants.h"
 
 class Constant;
+class FieldType;
+class MethodType;
 class ClassFile;
 class ConstantNameAndType;
 
@@ -97,6 +100,7 @@ public:
 class ConstantClassInfo : public Constant {
 private:
 	uint16_t classNameIndex;
+	mutable std::atomic<const FieldType*> type;
 	
 	ConstantClassInfo(ConstantClassInfo& c) : Constant(c.getConstantPool(), 0) {}
 	virtual const ConstantClassInfo& operator=(const ConstantClassInfo&) { return *this; }
@@ -107,6 +111,7 @@ public:
 	
 	virtual uint16_t getClassNameIndex() const;
 	virtual const Glib::ustring& getClassName() const;
+	virtual const FieldType& getClassType() const;
 	
 	virtual bool validate() const;
 };
@@ -257,6 +262,8 @@ class ConstantNameAndType : public Constant {
 private:
 	uint16_t nameIndex;
 	uint16_t descriptorIndex;
+	mutable std::atomic<const FieldType*> fieldType;
+	mutable std::atomic<const MethodType*> methodType;
 	
 	ConstantNameAndType(ConstantNameAndType& nt) : Constant(nt.getConstantPool(), 0) {}
 	virtual const ConstantNameAndType& operator=(const ConstantNameAndType&) { return *this; }
@@ -270,19 +277,22 @@ public:
 	
 	virtual const Glib::ustring& getName() const;
 	virtual const Glib::ustring& getTypeString() const;
+	virtual const FieldType& getFieldType() const;
+	virtual const MethodType& getMethodType() const;
 	
 	virtual bool validate() const;
 };
 
 /**
- * Represents an actual string in the file. These are stored in UTF-8 format in the class file,
- * so we use a Glib::ustring to represent them here.
+ * Represents an actual string in the file. These are stored in modified UTF-8 format in the class file,
+ * and converted to standard UTF-8 in a Glib::ustring here.
  * http://docs.oracle.com/javase/specs/jvms/se7/html/jvms-4.html#jvms-4.4.7
  */
 class ConstantUtf8 : public Constant {
 private:
 	uint16_t numBytes;
 	Glib::ustring stringValue;
+	bool valid;
 	
 	ConstantUtf8(ConstantUtf8& u) : Constant(u.getConstantPool(), 0) {}
 	virtual const ConstantUtf8& operator=(const ConstantUtf8&) { return *this; }
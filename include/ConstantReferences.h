@@ -0,0 +1,21 @@
+#ifndef CONSTANT_REFERENCES_H
+#define CONSTANT_REFERENCES_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+class CodeAttribute;
+
+/*
+ * Finds where constant pool indexes are kept in the parts of a class that are only held as bytes: bytecode, and
+ * attributes the parser doesn't understand. Each one found is given as an offset into those bytes, of a two byte
+ * index, except for ldc's, which is one byte. That's enough to renumber the constant pool and patch the bytes in
+ * place, without parsing them into anything.
+ * http://docs.oracle.com/javase/specs/jvms/se7/html/jvms-4.html#jvms-4.7
+ */
+
+bool findAttributeReferences(const std::string& name, const uint8_t* info, uint32_t length, std::vector<uint32_t>& offsets);
+void findCodeReferences(const CodeAttribute& code, std::vector<uint32_t>& offsets, std::vector<uint32_t>& byteOffsets);
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef CONTROL_FLOW_GRAPH_H
+#define CONTROL_FLOW_GRAPH_H
+
+#include <vector>
+#include <stdint.h>
+
+class MethodCode;
+
+/**
+ * A maximal straight-line run of instructions. Blocks are split at branch targets, after anything that
+ * transfers control, and at the boundaries of exception handler ranges, so a block is either entirely
+ * covered by a handler or not covered at all. Instructions are identified by their index in the MethodCode.
+ */
+struct BasicBlock {
+	uint32_t firstInstruction;
+	uint32_t lastInstruction;
+	uint32_t startPc;
+	uint32_t endPc;
+	bool isHandler;
+};
+
+/**
+ * A natural loop: the header, which dominates every block in the loop, and the blocks it contains
+ * (header included, in increasing order). Loops are sorted so that enclosing loops come before the loops
+ * they contain; parent is the index of the innermost enclosing loop, or NO_LOOP.
+ */
+struct Loop {
+	uint32_t header;
+	uint32_t parent;
+	uint32_t depth;
+	std::vector<uint32_t> blocks;
+	std::vector<uint32_t> backEdgeSources;
+};
+
+/**
+ * The control flow graph of a method, along with its dominator tree and natural loops. Block 0 is always
+ * the entry block. Edges to exception handlers are kept separately from normal edges, but both count for
+ * dominance. Everything is stored in flat arrays, since this gets built for every method that any analysis
+ * looks at.
+ *
+ * Dominators are computed with the Lengauer-Tarjan algorithm, and then numbered so that dominates() is
+ * a constant-time interval check.
+ */
+class ControlFlowGraph {
+private:
+	const MethodCode& code;
+	std::vector<BasicBlock> blocks;
+	std::vector<uint32_t> instructionBlocks;
+
+	std::vector<uint32_t> edgeStart;
+	std::vector<uint32_t> normalEdgeCount;
+	std::vector<uint32_t> edges;
+	std::vector<uint32_t> predecessorStart;
+	std::vector<uint32_t> predecessors;
+
+	std::vector<uint32_t> idom;
+	std::vector<uint32_t> reversePostorder;
+	std::vector<uint32_t> treeEnter;
+	std::vector<uint32_t> treeExit;
+	std::vector<Loop> loops;
+	std::vector<uint32_t> blockLoops;
+	bool reducible;
+
+	ControlFlowGraph(const ControlFlowGraph& c) : code(c.code) {}
+	const ControlFlowGraph& operator=(const ControlFlowGraph&) { return *this; }
+
+	void buildBlocks();
+	void buildEdges();
+	void computeDominators();
+	void numberDominatorTree();
+	void findLoops();
+public:
+	static const uint32_t NO_BLOCK = 0xFFFFFFFF;
+	static const uint32_t NO_LOOP = 0xFFFFFFFF;
+
+	ControlFlowGraph(const MethodCode& code);
+	virtual ~ControlFlowGraph();
+
+	const MethodCode& getCode() const;
+
+	uint32_t numBlocks() const;
+	const BasicBlock& operator[](uint32_t block) const;
+	uint32_t getBlockOf(uint32_t instruction) const;
+	uint32_t getBlockAt(uint32_t pc) const;
+
+	uint32_t numSuccessors(uint32_t block) const;
+	uint32_t numNormalSuccessors(uint32_t block) const;
+	uint32_t getSuccessor(uint32_t block, uint32_t index) const;
+	uint32_t numPredecessors(uint32_t block) const;
+	uint32_t getPredecessor(uint32_t block, uint32_t index) const;
+
+	bool isReachable(uint32_t block) const;
+	const std::vector<uint32_t>& getReversePostorder() const;
+	uint32_t getImmediateDominator(uint32_t block) const;
+	bool dominates(uint32_t dominator, uint32_t block) const;
+
+	bool isReducible() const;
+	const std::vector<Loop>& getLoops() const;
+	uint32_t getLoopOf(uint32_t block) const;
+	uint32_t getLoopDepth(uint32_t block) const;
+};
+
+#endif
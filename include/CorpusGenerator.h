@@ -0,0 +1,81 @@
+#ifndef CORPUS_GENERATOR_H
+#define CORPUS_GENERATOR_H
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <stdint.h>
+
+/**
+ * Everything that shapes a generated corpus. The defaults give small classes that look roughly like
+ * compiled Java: a few fields and methods, a line number table, a source file, and a tree of references.
+ */
+struct CorpusOptions {
+	/**
+	 * How the classes refer to each other. With TREE, class i refers to classes fanout * i + 1 through
+	 * fanout * i + fanout, and with CHAIN, to class i + 1, so loading class 0 loads the whole corpus either
+	 * way. With RANDOM, every class refers to fanout classes picked at random, cycles included.
+	 */
+	enum ReferenceGraph {
+		TREE,
+		CHAIN,
+		RANDOM
+	};
+
+	unsigned int numClasses;
+	std::string packageName;
+	uint64_t seed;
+
+	/** The size the constant pool is padded out to with strings and numbers, if it isn't that big already. */
+	unsigned int constantPoolSize;
+	unsigned int fields;
+	unsigned int methods;
+	/** The length of each method's code, in bytes, including the final return. */
+	unsigned int codeLength;
+
+	ReferenceGraph graph;
+	unsigned int fanout;
+
+	bool lineNumbers;
+	bool sourceFile;
+	bool constantValues;
+	bool exceptions;
+	/** The size of an attribute the decoder doesn't know, added to every class, or 0 for none. */
+	unsigned int customAttributeSize;
+
+	/** Whether to add the java/lang classes the corpus refers to, so it loads without the JRE. */
+	bool includeRuntime;
+
+	CorpusOptions();
+};
+
+/**
+ * Generates valid class files, and jars of them, from a CorpusOptions, so that benchmarks and tests don't need
+ * a JRE, and get the same input on every machine. Each class is generated from a random number generator seeded
+ * from the corpus seed and the class's index, using nothing but integer arithmetic, so a class comes out the same
+ * however many others are generated, in whatever order, on whatever platform.
+ */
+class CorpusGenerator {
+private:
+	CorpusOptions options;
+
+	CorpusGenerator(const CorpusGenerator&) {}
+	const CorpusGenerator& operator=(const CorpusGenerator&) { return *this; }
+
+	void generateRuntimeClass(const std::string& name, const std::string& superName, std::ostream& out) const;
+public:
+	CorpusGenerator(const CorpusOptions& options);
+	virtual ~CorpusGenerator();
+
+	const CorpusOptions& getOptions() const;
+
+	std::string getClassName(unsigned int index) const;
+	std::vector<unsigned int> getReferences(unsigned int index) const;
+	std::vector<std::string> getRuntimeClasses() const;
+
+	void generateClass(unsigned int index, std::ostream& out) const;
+
+	void writeJar(const std::string& path) const;
+};
+
+#endif
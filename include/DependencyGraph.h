@@ -0,0 +1,43 @@
+#ifndef DEPENDENCY_GRAPH_H
+#define DEPENDENCY_GRAPH_H
+
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * The graph of which classes refer to which, recorded by the VirtualMachine as it loads them. A class's edges
+ * are every class its constant pool names: its superclass, its interfaces, and the owners of the fields and
+ * methods it refers to. Edges are kept in both directions, so what a change to a class affects is as cheap to
+ * find as what a class needs.
+ *
+ * Classes that are referred to but haven't been loaded yet are nodes too, without edges of their own.
+ */
+class DependencyGraph {
+private:
+	std::map<std::string, std::set<std::string> > dependencies;
+	std::map<std::string, std::set<std::string> > dependents;
+
+	DependencyGraph(const DependencyGraph&) {}
+	const DependencyGraph& operator=(const DependencyGraph&) { return *this; }
+public:
+	DependencyGraph();
+	virtual ~DependencyGraph();
+
+	void addClass(const std::string& name, const std::vector<std::string>& references);
+	void removeClass(const std::string& name);
+
+	bool contains(const std::string& name) const;
+	std::vector<std::string> getClasses() const;
+	std::vector<std::string> getDependencies(const std::string& name) const;
+	std::vector<std::string> getDependents(const std::string& name) const;
+	std::set<std::string> getAffected(const std::vector<std::string>& changed) const;
+
+	void writeDot(std::ostream& out) const;
+	void writeBinary(std::ostream& out) const;
+};
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef DESCRIPTOR_H
+#define DESCRIPTOR_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * The type of a field, parameter or return value, parsed from a field descriptor like I, [[J or
+ * Ljava/lang/String;. V is accepted too, for methods that return nothing.
+ * http://docs.oracle.com/javase/specs/jvms/se7/html/jvms-4.html#jvms-4.3.2
+ *
+ * Types are interned: get returns the same object for the same descriptor for the life of the process, so
+ * they can be compared by address, and are never deleted. An array type is identified by its element type and
+ * number of dimensions, so it's the key for the array's class too.
+ *
+ * The registry is process-wide rather than per VirtualMachine, and sharded: descriptors hash to one of 64
+ * shards, each with its own lock, so parsing threads rarely contend. Since types are never freed, it grows with
+ * the number of distinct descriptors the process has seen, which for a batch or index run over many jars is
+ * about the number of distinct class names in them.
+ */
+class FieldType {
+public:
+	enum Kind {
+		BYTE = 'B',
+		CHAR = 'C',
+		DOUBLE = 'D',
+		FLOAT = 'F',
+		INT = 'I',
+		LONG = 'J',
+		SHORT = 'S',
+		BOOLEAN = 'Z',
+		VOID = 'V',
+		REFERENCE = 'L',
+		ARRAY = '['
+	};
+private:
+	std::string descriptor;
+	Kind kind;
+	Kind elementKind;
+	uint8_t dimensions;
+	uint8_t slots;
+	std::string className;
+	mutable std::atomic<const FieldType*> componentType;
+
+	FieldType(const std::string& descriptor);
+	FieldType(const FieldType&) {}
+	const FieldType& operator=(const FieldType&) { return *this; }
+public:
+	static const FieldType& get(const std::string& descriptor);
+	static const FieldType& forClassName(const std::string& name);
+	static std::string::size_type scan(const std::string& descriptor, std::string::size_type start);
+
+	const std::string& getDescriptor() const;
+	Kind getKind() const;
+	Kind getElementKind() const;
+	uint8_t getDimensions() const;
+	const std::string& getClassName() const;
+	const FieldType& getComponentType() const;
+
+	/**
+	 * Gets the number of local variable or operand stack slots a value of this type takes: two for long and
+	 * double, none for void, and one for everything else.
+	 */
+	uint8_t getSlots() const {
+		return slots;
+	}
+
+	/**
+	 * Whether values of this type are references, to objects or arrays.
+	 */
+	bool isReference() const {
+		return kind == REFERENCE || kind == ARRAY;
+	}
+};
+
+/**
+ * The parameter and return types of a method, parsed from a method descriptor like (IJLjava/lang/String;)V.
+ * http://docs.oracle.com/javase/specs/jvms/se7/html/jvms-4.html#jvms-4.3.3
+ *
+ * Method types are interned like FieldTypes, and everything about them is worked out when they're parsed, so
+ * setting up an invocation from one is a matter of reading fields.
+ */
+class MethodType {
+private:
+	std::string descriptor;
+	std::vector<const FieldType*> parameters;
+	const FieldType* returnType;
+	uint16_t argumentSlots;
+	std::vector<std::string> referencedClasses;
+
+	MethodType(const std::string& descriptor);
+	MethodType(const MethodType&) {}
+	const MethodType& operator=(const MethodType&) { return *this; }
+public:
+	static const MethodType& get(const std::string& descriptor);
+
+	const std::string& getDescriptor() const;
+
+	/**
+	 * Gets the number of declared parameters, not counting "this".
+	 */
+	uint16_t numParameters() const {
+		return parameters.size();
+	}
+
+	/**
+	 * Gets the type of a declared parameter.
+	 */
+	const FieldType& getParameter(uint16_t index) const {
+		return *parameters[index];
+	}
+
+	const FieldType& getReturnType() const;
+
+	/**
+	 * Gets the number of slots the declared parameters take, not counting "this", which is how many local
+	 * variables they fill, and how many operand stack slots an invocation pops for them.
+	 */
+	uint16_t getArgumentSlots() const {
+		return argumentSlots;
+	}
+
+	const std::vector<std::string>& getReferencedClasses() const;
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef ESCAPE_ANALYSIS_H
+#define ESCAPE_ANALYSIS_H
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+class ClassFile;
+class ClassMember;
+class VirtualMachine;
+
+/**
+ * Intraprocedural escape analysis over the decoded instruction stream of a single method. Every "new"
+ * instruction is an allocation site, and the analysis works out how far the objects created at each site
+ * can get:
+ *  - NO_ESCAPE: the object never leaves the method's frame, so it can be stack allocated, and if it is
+ *    also never aliased with anything else, its fields can be scalar replaced with locals. Passing an object
+ *    to a callee whose summary says it doesn't escape, like its own constructor usually, doesn't count.
+ *  - ARG_ESCAPE: the object is passed to a callee that doesn't let it outlive the call, but compares it by
+ *    reference, so it can still be stack allocated, but a real object has to exist.
+ *  - GLOBAL_ESCAPE: the object is returned, thrown, stored somewhere reachable from outside, or passed
+ *    to a callee we know nothing about. It has to go on the heap.
+ *
+ * The analysis also summarizes what the method does with its own parameters, in the same terms. Callers'
+ * analyses use these summaries for statically bound calls (invokespecial and invokestatic), most importantly
+ * for constructors, if they are given a VirtualMachine to load the callees from. Without one, every call other
+ * than java/lang/Object.<init> is assumed to let its arguments escape.
+ */
+class EscapeAnalysis {
+public:
+	enum EscapeState {
+		NO_ESCAPE = 0,
+		ARG_ESCAPE = 1,
+		GLOBAL_ESCAPE = 2
+	};
+
+	/**
+	 * The result for a single allocation site. fields holds the constant pool indices of the fields accessed
+	 * through objects from this site, which are the locals it needs if it is scalar replaced.
+	 */
+	struct AllocationSite {
+		uint32_t pc;
+		uint16_t classIndex;
+		EscapeState state;
+		bool scalarReplaceable;
+		std::vector<uint16_t> fields;
+	};
+
+	EscapeAnalysis(ClassFile& cf, const ClassMember& method, VirtualMachine* vm = NULL, unsigned int calleeDepth = 2);
+	virtual ~EscapeAnalysis();
+
+	const std::vector<AllocationSite>& getAllocationSites() const;
+	const AllocationSite* getAllocationSite(uint32_t pc) const;
+
+	uint16_t numParameters() const;
+	EscapeState getParameterState(uint16_t parameter) const;
+
+private:
+	EscapeAnalysis(const EscapeAnalysis&) {}
+	const EscapeAnalysis& operator=(const EscapeAnalysis&) { return *this; }
+
+	std::vector<AllocationSite> sites;
+	std::vector<EscapeState> parameterStates;
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef INFLATER_H
+#define INFLATER_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <stdint.h>
+#include <stddef.h>
+
+struct zip;
+
+/**
+ * Running totals of how much an Inflater has done, and how long it took. Only the time spent inflating is
+ * counted, not reading the compressed data.
+ */
+struct InflaterStatistics {
+	uint64_t entries;
+	uint64_t compressedBytes;
+	uint64_t inflatedBytes;
+	double seconds;
+
+	InflaterStatistics();
+	void add(const InflaterStatistics& other);
+};
+
+/**
+ * A pluggable DEFLATE decompression backend. Jar entries know their inflated size up front, so backends
+ * only have to inflate a whole buffer into an exactly sized output buffer, which lets the fast ones (like
+ * libdeflate, which uses SIMD for both inflating and checksums) skip all the bookkeeping streaming needs.
+ *
+ * Backends are created by name, and aren't thread safe; each thread that inflates needs its own.
+ */
+class Inflater {
+private:
+	std::string compressed;
+	InflaterStatistics statistics;
+
+	Inflater(const Inflater&) {}
+	const Inflater& operator=(const Inflater&) { return *this; }
+protected:
+	Inflater();
+
+	/**
+	 * Inflates a raw DEFLATE stream, which has to fill out exactly, and throws if it doesn't.
+	 */
+	virtual void inflateRaw(const uint8_t* in, size_t inSize, uint8_t* out, size_t outSize) = 0;
+public:
+	static Inflater* create(const std::string& backend = "");
+	static std::vector<std::string> getBackends();
+
+	virtual ~Inflater();
+
+	virtual const char* getName() const = 0;
+	virtual uint32_t checksum(const uint8_t* data, size_t size) const;
+
+	void inflate(const uint8_t* in, size_t inSize, uint8_t* out, size_t outSize);
+	void readEntry(struct zip* jar, uint64_t index, std::string& data);
+
+	const InflaterStatistics& getStatistics() const;
+	static void writeStatistics(std::ostream& out, const std::string& backend, const InflaterStatistics& statistics);
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef JAR_STREAM_H
+#define JAR_STREAM_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdint.h>
+
+#include <zlib.h>
+
+class Inflater;
+
+/**
+ * Reads the entries of a jar in the order they are stored, by walking the local file headers from the start
+ * of the file, instead of seeking around using the central directory like libzip does. The whole jar is read
+ * with one forward pass, which is much friendlier to spinning disks and network filesystems when every entry
+ * is wanted anyway.
+ *
+ * A single zlib stream and input buffer are reused for every entry, and entries are inflated into a buffer
+ * the caller owns, so a caller that reuses its buffers doesn't allocate anything per entry once it's warmed up.
+ * Entries whose sizes are only given in a trailing data descriptor are supported if they are deflated, since the
+ * end of the deflate stream marks the end of the data.
+ *
+ * If given an Inflater, entries whose sizes are known up front are inflated by it in one go, straight out of the
+ * input buffer, instead of through the zlib stream.
+ */
+class JarStream {
+private:
+	std::string path;
+	std::ifstream file;
+	std::vector<uint8_t> input;
+	size_t inputStart;
+	size_t inputEnd;
+	z_stream inflater;
+	Inflater* wholeBufferInflater;
+	bool entryPending;
+	bool finished;
+
+	std::string name;
+	uint16_t flags;
+	uint16_t method;
+	uint32_t crc;
+	uint32_t compressedSize;
+	uint32_t uncompressedSize;
+	std::string scratch;
+
+	JarStream(const JarStream&) {}
+	const JarStream& operator=(const JarStream&) { return *this; }
+
+	bool fill(size_t bytes);
+	uint16_t readShort();
+	uint32_t readInt();
+	void skipBytes(uint64_t bytes);
+	void inflateEntry(std::string& data);
+	void inflateWholeEntry(std::string& data);
+	void copyEntry(std::string& data);
+public:
+	static const size_t INPUT_BUFFER_SIZE = 1 << 18;
+
+	JarStream(const std::string& path);
+	virtual ~JarStream();
+
+	void setInflater(Inflater* inflater);
+
+	bool nextEntry();
+	const std::string& getName() const;
+	uint32_t getCompressedSize() const;
+	void readEntry(std::string& data);
+	void skipEntry();
+};
+
+#endif
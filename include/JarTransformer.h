@@ -0,0 +1,90 @@
+#ifndef JAR_TRANSFORMER_H
+#define JAR_TRANSFORMER_H
+
+#include <map>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <stdint.h>
+
+#include <zlib.h>
+
+class VirtualMachine;
+class ClassQueue;
+class ClassPass;
+class JarWriter;
+struct ClassBuffer;
+
+/**
+ * Rewrites every class in a jar through a set of ClassPasses, into a new jar. The calling thread reads the jar
+ * front to back with a JarStream and queues its entries up for the worker threads, which parse each class,
+ * write it back out with a ClassWriter, and deflate it. Entries are written to the new jar in the order they
+ * were in the old one, by whichever worker finishes the next one due, so only writing the jar is serialized.
+ *
+ * The constant pools of the classes can be compacted as well, so they only hold what the passes leave
+ * referenced.
+ *
+ * Entries that aren't classes are copied, and so are classes that can't be parsed or written, which are counted
+ * as errors.
+ */
+class JarTransformer {
+public:
+	JarTransformer(VirtualMachine& vm, unsigned int numThreads = 0);
+	virtual ~JarTransformer();
+
+	void addPass(const std::string& name);
+	void setInflater(const std::string& backend);
+	void setLevel(int level);
+	void setCompactConstantPool(bool compact);
+
+	void run(const std::string& input, const std::string& output);
+
+	uint32_t numEntries() const;
+	const std::vector<std::string>& getErrors() const;
+	void writeThroughput(std::ostream& out) const;
+
+private:
+	JarTransformer(const JarTransformer& t) : vm(t.vm) {}
+	const JarTransformer& operator=(const JarTransformer&) { return *this; }
+
+	/**
+	 * An entry that's been transformed and compressed, and is ready to be written.
+	 */
+	struct Result {
+		std::string name;
+		uint16_t method;
+		uint32_t crc;
+		uint32_t size;
+		std::string data;
+		std::string error;
+	};
+
+	void consume(ClassQueue& queue);
+	void transform(ClassBuffer& buffer, z_stream& deflater, std::string& scratch, Result& result);
+	void finish(uint32_t sequence, Result& result);
+	void write(Result& result);
+
+	VirtualMachine& vm;
+	unsigned int numThreads;
+	int level;
+	bool compact;
+	std::string inflaterBackend;
+	std::vector<ClassPass*> passes;
+
+	JarWriter* writer;
+	std::mutex outputMutex;
+	std::map<uint32_t, Result> pending;
+	uint32_t nextSequence;
+	std::string failure;
+
+	uint32_t entries;
+	uint32_t classes;
+	uint64_t bytesIn;
+	uint64_t bytesOut;
+	std::vector<std::string> errors;
+	double elapsedSeconds;
+};
+
+#endif
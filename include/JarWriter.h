@@ -0,0 +1,51 @@
+#ifndef JAR_WRITER_H
+#define JAR_WRITER_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdint.h>
+
+/**
+ * Writes a jar one entry at a time, front to back, from data that has already been compressed, so entries can
+ * be deflated on other threads and only written here. The central directory is written when the jar is closed.
+ *
+ * The jar is written to a temporary file next to it, which replaces it when it's closed, so a jar that's being
+ * read isn't left half written if writing fails. Every entry gets the same timestamp, so the same entries always
+ * give the same jar. Zip64 isn't supported, so a jar can't have more than 65535 entries, or be 4GB or bigger.
+ */
+class JarWriter {
+private:
+	/**
+	 * What the central directory needs to know about an entry that's been written.
+	 */
+	struct Entry {
+		std::string name;
+		uint16_t method;
+		uint32_t crc;
+		uint32_t compressedSize;
+		uint32_t uncompressedSize;
+		uint32_t offset;
+	};
+
+	std::string path;
+	std::string temporary;
+	std::ofstream file;
+	std::vector<Entry> entries;
+	uint64_t offset;
+	bool closed;
+
+	JarWriter(const JarWriter&) {}
+	const JarWriter& operator=(const JarWriter&) { return *this; }
+public:
+	static const uint16_t STORED = 0;
+	static const uint16_t DEFLATED = 8;
+
+	JarWriter(const std::string& path);
+	virtual ~JarWriter();
+
+	void addEntry(const std::string& name, uint16_t method, uint32_t crc, uint32_t uncompressedSize, const std::string& data);
+	void close();
+};
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef JAVA_THREAD_H
+#define JAVA_THREAD_H
+
+#include <functional>
+#include <thread>
+#include <stdexcept>
+#include <stdint.h>
+
+class ClassFile;
+class ClassMember;
+class ObjectHeader;
+class Profiler;
+class VirtualMachine;
+
+/**
+ * A single method activation on a JavaThread's stack. Frames don't own any memory: the frame itself, its
+ * local variables and its operand stack are all carved out of the owning thread's contiguous slot array,
+ * so pushing and popping a frame is just moving the thread's stack pointer.
+ * Every local variable and operand stack entry is a 64-bit slot, the same way ClassInstance stores its variables.
+ */
+class Frame {
+private:
+	ClassFile& classFile;
+	const ClassMember& method;
+	Frame* previous;
+	ObjectHeader* lockedObject;
+	uint64_t* locals;
+	uint64_t* operands;
+	uint16_t maxLocals;
+	uint16_t maxStack;
+	uint16_t stackDepth;
+	uint32_t pc;
+
+	Frame(const Frame& f) : classFile(f.classFile), method(f.method) {}
+	const Frame& operator=(const Frame&) { return *this; }
+
+	friend class JavaThread;
+public:
+	Frame(ClassFile& classFile, const ClassMember& method, Frame* previous, uint64_t* slots, uint16_t maxLocals, uint16_t maxStack);
+	virtual ~Frame();
+
+	ClassFile& getClassFile();
+	const ClassMember& getMethod() const;
+	Frame* getPrevious();
+	ObjectHeader* getLockedObject();
+
+	uint16_t getMaxLocals() const;
+	uint16_t getMaxStack() const;
+	uint16_t getStackDepth() const;
+
+	uint32_t getPc() const;
+	void setPc(uint32_t pc);
+
+	template<class T> T getLocal(uint16_t index) {
+		if(index >= maxLocals) {
+			throw std::runtime_error("Local variable index out of range.");
+		}
+		return reinterpret_cast<T&>(locals[index]);
+	}
+	template<class T> void setLocal(uint16_t index, T value) {
+		if(index >= maxLocals) {
+			throw std::runtime_error("Local variable index out of range.");
+		}
+		locals[index] = 0;
+		reinterpret_cast<T&>(locals[index]) = value;
+	}
+
+	template<class T> void push(T value) {
+		if(stackDepth >= maxStack) {
+			throw std::runtime_error("Operand stack overflow.");
+		}
+		operands[stackDepth] = 0;
+		reinterpret_cast<T&>(operands[stackDepth++]) = value;
+	}
+	template<class T> T pop() {
+		if(stackDepth == 0) {
+			throw std::runtime_error("Operand stack underflow.");
+		}
+		return reinterpret_cast<T&>(operands[--stackDepth]);
+	}
+};
+
+/**
+ * A Java thread. Each one maps onto its own OS thread, and has its own contiguous stack of slots that
+ * frames are allocated out of. The thread that constructs the VirtualMachine is attached as its main thread.
+ */
+class JavaThread {
+private:
+	VirtualMachine& vm;
+	uint32_t id;
+	uint64_t* stack;
+	uint64_t* stackLimit;
+	uint64_t* stackPointer;
+	Frame* currentFrame;
+	uint32_t depth;
+	Profiler* profiler;
+	std::thread osThread;
+
+	JavaThread(const JavaThread& t) : vm(t.vm) {}
+	const JavaThread& operator=(const JavaThread&) { return *this; }
+public:
+	static const uint32_t DEFAULT_STACK_SLOTS = 1 << 16;
+
+	JavaThread(VirtualMachine& vm, uint32_t id, uint32_t stackSlots = DEFAULT_STACK_SLOTS);
+	virtual ~JavaThread();
+
+	VirtualMachine& getVirtualMachine();
+	uint32_t getId() const;
+
+	Frame& pushFrame(ClassFile& cf, const ClassMember& method, uint16_t maxLocals, uint16_t maxStack, ObjectHeader* receiver = NULL);
+	void popFrame();
+
+	Frame* getCurrentFrame();
+	uint32_t getDepth() const;
+	Profiler* getProfiler();
+
+	void monitorEnter(ObjectHeader& object);
+	void monitorExit(ObjectHeader& object);
+
+	void attach();
+	void start(std::function<void(JavaThread&)> body);
+	void join();
+
+	static JavaThread* current();
+};
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef LOAD_STATISTICS_H
+#define LOAD_STATISTICS_H
+
+#include <atomic>
+#include <iostream>
+#include <istream>
+#include <stdint.h>
+
+#include "Trace.h"
+
+/**
+ * The phases of loading a class that are timed separately. Phases nest (initializing a class loads others,
+ * and member parsing includes their attributes), and each phase is only charged for the time, bytes and
+ * allocations it doesn't hand on to a nested one, so the phases add up to the total.
+ */
+enum LoadPhase {
+	PHASE_LOOKUP,
+	PHASE_INFLATE,
+	PHASE_CONSTANT_POOL,
+	PHASE_MEMBERS,
+	PHASE_ATTRIBUTES,
+	PHASE_VALIDATE,
+	PHASE_INITIALIZE,
+	NUM_LOAD_PHASES
+};
+
+/**
+ * Totals for a single phase.
+ */
+struct PhaseTotals {
+	uint64_t calls;
+	uint64_t nanoseconds;
+	uint64_t bytes;
+	uint64_t allocations;
+
+	PhaseTotals();
+	void add(const PhaseTotals& other);
+};
+
+/**
+ * Per-thread load time counters. Every thread counts into its own counters, which only it writes, so counting
+ * needs no locks or atomic read-modify-writes; the counters are summed when they're read, and a thread's
+ * counters are folded into the totals when it exits.
+ *
+ * Counting is off until enabled, and a disabled PhaseTimer costs a single relaxed load. Allocations are counted
+ * by replacing the global operator new, which always bumps a thread local counter.
+ */
+class LoadStatistics {
+private:
+	static std::atomic<bool> enabled;
+
+	LoadStatistics() {}
+public:
+	static void setEnabled(bool enabled);
+
+	/**
+	 * Whether phases are being timed.
+	 */
+	static bool isEnabled() {
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	static void record(LoadPhase phase, uint64_t nanoseconds, uint64_t bytes, uint64_t allocations);
+	static void collect(PhaseTotals totals[NUM_LOAD_PHASES]);
+	static void reset();
+
+	static uint64_t getAllocations();
+	static const char* getPhaseName(LoadPhase phase);
+	static void write(std::ostream& out);
+};
+
+/**
+ * Times a phase from construction to destruction, pausing while a phase nested inside it on the same thread
+ * runs. Bytes are either added explicitly, or measured as how far an input stream moves. While tracing, the
+ * phase is recorded as a span as well.
+ */
+class PhaseTimer {
+private:
+	LoadPhase phase;
+	bool active;
+	bool counting;
+	bool tracing;
+	PhaseTimer* parent;
+	std::istream* in;
+	int64_t startPosition;
+	uint64_t started;
+	uint64_t resumed;
+	uint64_t nanoseconds;
+	uint64_t bytes;
+	uint64_t childBytes;
+	uint64_t startAllocations;
+	uint64_t childAllocations;
+
+	PhaseTimer(const PhaseTimer&) {}
+	const PhaseTimer& operator=(const PhaseTimer&) { return *this; }
+
+	void start(std::istream* in);
+public:
+	/**
+	 * Starts timing a phase, if timing or tracing is enabled.
+	 */
+	PhaseTimer(LoadPhase phase) : phase(phase), active(false) {
+		if(LoadStatistics::isEnabled() || Trace::isEnabled()) {
+			start(NULL);
+		}
+	}
+
+	/**
+	 * Starts timing a phase that reads from a stream, if timing or tracing is enabled. The bytes the phase
+	 * reads are counted, if the stream can tell its position.
+	 */
+	PhaseTimer(LoadPhase phase, std::istream& in) : phase(phase), active(false) {
+		if(LoadStatistics::isEnabled() || Trace::isEnabled()) {
+			start(&in);
+		}
+	}
+
+	virtual ~PhaseTimer();
+
+	/**
+	 * Adds bytes processed by the phase.
+	 */
+	void addBytes(uint64_t count) {
+		if(active) {
+			bytes += count;
+		}
+	}
+};
+
+#endif
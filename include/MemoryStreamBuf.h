@@ -0,0 +1,24 @@
+#ifndef MEMORY_STREAM_BUF_H
+#define MEMORY_STREAM_BUF_H
+
+#include <streambuf>
+#include <stddef.h>
+
+/**
+ * A read-only stream buffer over memory that's owned elsewhere, so that a class file that's already been
+ * read into a buffer can be parsed through an std::istream without being copied into a stringstream first.
+ * The memory has to outlive the buffer.
+ */
+class MemoryStreamBuf : public std::streambuf {
+private:
+	MemoryStreamBuf(const MemoryStreamBuf&) {}
+	const MemoryStreamBuf& operator=(const MemoryStreamBuf&) { return *this; }
+protected:
+	pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode mode);
+	pos_type seekpos(pos_type position, std::ios_base::openmode mode);
+public:
+	MemoryStreamBuf(const char* data, size_t size);
+	virtual ~MemoryStreamBuf();
+};
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef MODIFIED_UTF8_H
+#define MODIFIED_UTF8_H
+
+#include <string>
+#include <stddef.h>
+
+/*
+ * Class files store strings in modified UTF-8: NUL is encoded in two bytes as 0xC0 0x80, so a raw zero byte never
+ * appears, and characters outside the Basic Multilingual Plane are encoded as a surrogate pair of three byte
+ * sequences instead of one four byte sequence. Nothing is ever longer than three bytes.
+ * http://docs.oracle.com/javase/specs/jvms/se7/html/jvms-4.html#jvms-4.4.7
+ *
+ * Most strings in a class file are plain ASCII, so these scan for it a vector at a time, with AVX2 or SSE2 when
+ * the CPU has them, and only fall back to decoding byte by byte around the characters that aren't.
+ */
+
+size_t countAscii(const char* data, size_t size);
+bool isValidModifiedUtf8(const char* data, size_t size);
+bool decodeModifiedUtf8(const char* data, size_t size, std::string& out);
+size_t encodeModifiedUtf8(const char* data, size_t size, char* out);
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+
+/**
+ * A heavyweight ("inflated") Java monitor, built out of a mutex and condition variables. Objects only get
+ * one of these once their thin lock has seen contention, or once someone calls wait() on them; until then
+ * the lock lives entirely in the object's lock word.
+ */
+class Monitor {
+private:
+	std::mutex monitorMutex;
+	std::condition_variable entryCondition;
+	std::condition_variable waitCondition;
+	uint32_t owner;
+	uint32_t recursions;
+
+	Monitor(const Monitor&) {}
+	const Monitor& operator=(const Monitor&) { return *this; }
+public:
+	Monitor(uint32_t owner, uint32_t recursions);
+	virtual ~Monitor();
+
+	void enter(uint32_t threadId);
+	void exit(uint32_t threadId);
+
+	void wait(uint32_t threadId);
+	void notify(uint32_t threadId);
+	void notifyAll(uint32_t threadId);
+
+	uint32_t getOwner();
+};
+
+/**
+ * The header shared by everything that can be synchronized on. It holds a single lock word, which is
+ * used as a thin lock: an unlocked object has a lock word of 0, and a locked one holds the owning thread's
+ * id and a recursion count, so uncontended monitorenter/monitorexit are a single compare-and-swap each.
+ * When a second thread contends for the lock, or the recursion count overflows, the lock word is swapped
+ * for a pointer to a Monitor (tagged with the low bit), and from then on the Monitor is used.
+ *
+ * Thin lock word layout: [owner thread id : rest][recursion count : 7][inflated : 1]
+ */
+class ObjectHeader {
+private:
+	std::atomic<uintptr_t> lockWord;
+
+	Monitor* inflate(uintptr_t word);
+	Monitor* inflateOwned(uint32_t threadId);
+
+	ObjectHeader(const ObjectHeader&) {}
+	const ObjectHeader& operator=(const ObjectHeader&) { return *this; }
+public:
+	ObjectHeader();
+	virtual ~ObjectHeader();
+
+	void monitorEnter(uint32_t threadId);
+	void monitorExit(uint32_t threadId);
+
+	void wait(uint32_t threadId);
+	void notify(uint32_t threadId);
+	void notifyAll(uint32_t threadId);
+
+	bool isInflated() const;
+	bool isLockedBy(uint32_t threadId) const;
+};
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <iostream>
+#include <signal.h>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+class ClassFile;
+class ClassMember;
+
+/**
+ * A node in a calling context tree: one method, reached through one particular chain of callers. Recursion
+ * makes a new node for every level, so times never count the same nanosecond twice. Methods are kept by name
+ * rather than by pointer, since reloading deletes the classes a profile has seen.
+ */
+struct ProfileNode {
+	std::string className;
+	std::string methodName;
+	ProfileNode* parent;
+	std::vector<ProfileNode*> children;
+
+	uint64_t invocations;
+	uint64_t bytecodes;
+	uint64_t inclusiveNanoseconds;
+	uint64_t exclusiveNanoseconds;
+	uint64_t samples;
+
+	ProfileNode(const std::string& className, const std::string& methodName, ProfileNode* parent);
+	~ProfileNode();
+
+	ProfileNode* getChild(const std::string& className, const std::string& methodName);
+	std::string getLabel() const;
+};
+
+/**
+ * An opt-in profiler for Java code, owned by a JavaThread, which calls enter and exit as it pushes and pops
+ * frames. The interpreter calls countOpcode for every instruction it executes.
+ *
+ * Both modes count invocations, bytecodes per method and an opcode histogram, which only touch memory the
+ * thread owns. COUNT also times every invocation, inclusive and exclusive of its callees, with two clock reads
+ * a call. SAMPLE skips the clock, and instead has SIGPROF interrupt the process every so often and charge a
+ * sample to whichever method is running, which is cheaper for code that makes lots of short calls. The signal
+ * handler only bumps a counter belonging to the interrupted OS thread, and the profiler running on that thread
+ * charges what's pending to its current method when it next enters or leaves one, so the handler never touches
+ * a profiler or thread that might be being destroyed.
+ *
+ * A thread's profile is handed over when it's destroyed, and the profiles of every thread are merged by call
+ * path when they're written.
+ */
+class Profiler {
+public:
+	enum Mode {
+		OFF,
+		COUNT,
+		SAMPLE
+	};
+private:
+	/**
+	 * A frame on the profiler's own stack, matching a Frame on the thread's.
+	 */
+	struct Activation {
+		ProfileNode* node;
+		uint64_t entered;
+		uint64_t calleeNanoseconds;
+	};
+
+	static std::atomic<int> mode;
+	static struct sigaction previousAction;
+
+	bool timed;
+	ProfileNode* root;
+	ProfileNode* current;
+	std::vector<Activation> activations;
+	uint64_t opcodes[256];
+
+	Profiler(const Profiler&) {}
+	const Profiler& operator=(const Profiler&) { return *this; }
+
+	void chargeSamples();
+public:
+	static void setMode(Mode mode, unsigned int sampleMicroseconds = 1000);
+	static Mode getMode();
+
+	Profiler();
+	virtual ~Profiler();
+
+	void enter(const ClassFile& classFile, const ClassMember& method);
+	void exit();
+
+	/**
+	 * Counts one executed instruction against the running method and the opcode histogram.
+	 */
+	void countOpcode(uint8_t opcode) {
+		opcodes[opcode]++;
+		current->bytecodes++;
+	}
+
+	static void writeCollapsed(std::ostream& out);
+	static void writeSummary(std::ostream& out);
+};
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef SEGMENTED_SYMBOL_INDEX_H
+#define SEGMENTED_SYMBOL_INDEX_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <stdint.h>
+
+#include "SymbolIndex.h"
+
+/**
+ * A symbol index over a set of jars that's kept up to date by scanning only what changed, for when rebuilding a
+ * whole SymbolIndex after every change would cost too much.
+ *
+ * It's kept as a log of segments, each an ordinary SymbolIndex, a list of the class entries of each jar, and a
+ * manifest. A jar's list has the CRC, size and time the central directory gives each entry, and the class it
+ * holds. The manifest lists the segments, and the jars with their size, modification time and list, and for every
+ * class name more than one entry has, where each of those entries is, in classpath order. An update reads and
+ * rewrites only the lists of the jars whose size or modification time changed, or that were added or removed, and
+ * scans the entries in them that changed into a new segment. Only the names those jars had or have can change
+ * which entry wins, so only they're looked up, in the segments and the manifest; the copies of those classes in
+ * older segments are marked dead with tombstones rather than rewritten. When the newest segments are as big as the
+ * one before them, they're merged into one, copying only the live classes, so every class is merged a logarithmic
+ * number of times, and an update costs about as much as the change it indexes, plus the size of the manifest.
+ *
+ * Queries search each segment in turn and skip dead classes. Like a SymbolIndex, the first class with a given
+ * name, in the order the jars were given, wins.
+ */
+class SegmentedSymbolIndex {
+private:
+	struct Entry {
+		std::string name;
+		uint32_t crc;
+		uint64_t size;
+		int64_t time;
+		std::string className;
+		bool changed;
+	};
+
+	struct Jar {
+		std::string path;
+		uint64_t size;
+		int64_t time;
+		uint32_t list;
+		bool listed;
+		std::vector<Entry> entries;
+	};
+
+	struct Segment {
+		uint32_t id;
+		SymbolIndex* index;
+		std::unordered_set<std::string> tombstones;
+	};
+
+	/**
+	 * One of the entries a class name is in.
+	 */
+	struct Location {
+		std::string jar;
+		std::string entry;
+	};
+
+	/**
+	 * An entry that might win for a class name, ordered by where it is on the classpath: the position of its jar,
+	 * and then of the entry in the jar.
+	 */
+	struct Candidate {
+		uint32_t jar;
+		uint32_t order;
+		bool changed;
+		Location location;
+
+		bool operator<(const Candidate& other) const;
+	};
+
+	typedef std::unordered_map<std::string, std::vector<Location> > Duplicates;
+
+	std::string path;
+	uint32_t nextSegment;
+	uint32_t nextList;
+	uint64_t jarsOffset;
+	std::vector<Segment> segments;
+	std::vector<std::string> errors;
+	uint32_t scanned;
+	uint32_t removed;
+	uint32_t merged;
+
+	SegmentedSymbolIndex(const SegmentedSymbolIndex&) {}
+	const SegmentedSymbolIndex& operator=(const SegmentedSymbolIndex&) { return *this; }
+
+	std::string getSegmentPath(uint32_t id) const;
+	std::string getListPath(uint32_t id) const;
+	uint32_t numLive(const Segment& segment) const;
+	void load();
+	void close();
+	void readJars(std::vector<Jar>& jars, Duplicates& duplicates) const;
+	void readEntries(Jar& jar) const;
+	void writeEntries(const Jar& jar) const;
+	void writeManifest(const std::vector<Segment>& segments, const std::vector<Jar>& jars, const Duplicates& duplicates) const;
+	Segment* findSegment(std::vector<Segment>& segments, uint32_t id) const;
+	uint32_t findLive(const std::string& name, ClassSymbol& symbol) const;
+	void listJar(const std::string& path, Jar* previous, Jar& jar) const;
+	void scanEntries(std::vector<Jar>& jars, SymbolIndexWriter& writer, std::unordered_set<std::string>& names);
+	void rescanEntries(const std::vector<Candidate>& candidates, SymbolIndexWriter& writer);
+public:
+	static const uint32_t VERSION = 2;
+
+	SegmentedSymbolIndex(const std::string& path);
+	virtual ~SegmentedSymbolIndex();
+
+	static bool isSegmented(const std::string& path);
+
+	void update(const std::vector<std::string>& jars);
+	uint32_t numScanned() const;
+	uint32_t numRemoved() const;
+	uint32_t numMerged() const;
+	const std::vector<std::string>& getErrors() const;
+
+	uint32_t numSegments() const;
+	uint32_t numClasses() const;
+
+	bool findClass(const std::string& name, ClassSymbol& symbol) const;
+	std::vector<MemberSymbol> findMembers(const std::string& name) const;
+	std::vector<ReferenceSymbol> findReferences(const std::string& className, const std::string& name = "",
+		const std::string& descriptor = "") const;
+};
+
+#endif
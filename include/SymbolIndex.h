@@ -0,0 +1,198 @@
+#ifndef SYMBOL_INDEX_H
+#define SYMBOL_INDEX_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ClassScanner.h"
+
+/**
+ * A class in a SymbolIndex: where it was found, and what it extends and implements. superName is empty for
+ * java/lang/Object.
+ */
+struct ClassSymbol {
+	std::string name;
+	std::string jar;
+	std::string entry;
+	std::string superName;
+	std::vector<std::string> interfaces;
+	uint16_t accessFlags;
+};
+
+/**
+ * A field or method declared by a class in a SymbolIndex.
+ */
+struct MemberSymbol {
+	std::string className;
+	std::string name;
+	std::string descriptor;
+	uint16_t accessFlags;
+	bool method;
+};
+
+/**
+ * A reference from a method to a class, field or method. For references to a class as a whole, name and
+ * descriptor are empty. For references that aren't made by the code of any one method, like a method handle in
+ * the constant pool, methodName and methodDescriptor are empty.
+ */
+struct ReferenceSymbol {
+	std::string targetClass;
+	std::string name;
+	std::string descriptor;
+	std::string className;
+	std::string methodName;
+	std::string methodDescriptor;
+};
+
+/**
+ * An index of the classes in a set of jars, the fields and methods they declare, and who refers to each class,
+ * field and method, kept in a single file that's mapped read-only, like a ClassArchive. Queries are binary
+ * searches straight out of the mapping, so nothing is parsed or built when the index is opened, other than
+ * checking that it's intact.
+ *
+ * Every string is kept once, in a table sorted by value, and everything else refers to strings by their
+ * position in it, so comparing two positions is the same as comparing the strings, and every other table is
+ * sorted by those positions. All integers are little-endian.
+ */
+class SymbolIndex {
+private:
+	friend class SymbolIndexWriter;
+
+	std::string path;
+	const uint8_t* mapping;
+	size_t mappingSize;
+	uint32_t stringCount;
+	uint32_t classCount;
+	uint32_t interfaceCount;
+	uint32_t memberCount;
+	uint32_t referenceCount;
+	uint32_t postingCount;
+	const uint8_t* strings;
+	const uint8_t* classes;
+	const uint8_t* interfaces;
+	const uint8_t* members;
+	const uint8_t* references;
+	const uint8_t* postings;
+
+	SymbolIndex(const SymbolIndex&) {}
+	const SymbolIndex& operator=(const SymbolIndex&) { return *this; }
+
+	const char* validate();
+	std::string getString(uint32_t id) const;
+	int compareString(uint32_t id, const std::string& value) const;
+	bool findString(const std::string& value, uint32_t& id) const;
+	void getClass(uint32_t i, ClassSymbol& symbol) const;
+public:
+	static const uint32_t VERSION = 1;
+	static const uint32_t NONE = 0xFFFFFFFF;
+
+	SymbolIndex(const std::string& path);
+	virtual ~SymbolIndex();
+
+	uint32_t numClasses() const;
+	uint32_t numMembers() const;
+	uint32_t numReferences() const;
+
+	bool findClass(const std::string& name, ClassSymbol& symbol) const;
+	std::vector<MemberSymbol> findMembers(const std::string& name) const;
+	std::vector<ReferenceSymbol> findReferences(const std::string& className, const std::string& name = "",
+		const std::string& descriptor = "") const;
+};
+
+/**
+ * Builds a SymbolIndex by scanning classes with a ClassScanner, which never builds a ClassFile. The classes,
+ * members and references are gathered in memory, by the ids their strings were first seen with, then sorted
+ * and renumbered when the index is written.
+ *
+ * Like the classpath, the first class with a given name wins; later ones are counted as duplicates and left
+ * out. Classes can also be copied out of another index, which is how segments of a SegmentedSymbolIndex are
+ * merged.
+ */
+class SymbolIndexWriter {
+private:
+	class Collector;
+	friend class Collector;
+
+	struct ClassRecord {
+		uint32_t name;
+		uint32_t jar;
+		uint32_t entry;
+		uint32_t superName;
+		uint32_t interfacesStart;
+		uint16_t interfaceCount;
+		uint16_t accessFlags;
+	};
+
+	struct MemberRecord {
+		uint32_t className;
+		uint32_t name;
+		uint32_t descriptor;
+		uint16_t accessFlags;
+		bool method;
+	};
+
+	struct MemberKey {
+		uint32_t name;
+		uint32_t className;
+		uint32_t descriptor;
+
+		bool operator<(const MemberKey& other) const;
+	};
+
+	struct ReferenceKey {
+		uint32_t className;
+		uint32_t name;
+		uint32_t descriptor;
+
+		bool operator<(const ReferenceKey& other) const;
+	};
+
+	struct Posting {
+		uint32_t reference;
+		uint32_t className;
+		uint32_t methodName;
+		uint32_t methodDescriptor;
+	};
+
+	std::unordered_map<std::string, uint32_t> stringIds;
+	std::vector<const std::string*> strings;
+	std::unordered_set<uint32_t> classNames;
+	std::vector<ClassRecord> classes;
+	std::vector<uint32_t> interfaces;
+	std::vector<MemberRecord> members;
+	std::map<ReferenceKey, uint32_t> referenceIds;
+	std::vector<ReferenceKey> references;
+	std::vector<Posting> postings;
+	std::vector<std::string> errors;
+	uint32_t duplicates;
+	ClassScanner scanner;
+
+	SymbolIndexWriter(const SymbolIndexWriter&) {}
+	const SymbolIndexWriter& operator=(const SymbolIndexWriter&) { return *this; }
+
+	uint32_t intern(const std::string& value);
+	uint32_t intern(const char* data, size_t length);
+	uint32_t intern(const SymbolIndex& index, uint32_t id, std::vector<uint32_t>& ids);
+	uint32_t getReference(uint32_t className, uint32_t name, uint32_t descriptor);
+public:
+	SymbolIndexWriter();
+	virtual ~SymbolIndexWriter();
+
+	void addJar(const std::string& path);
+	bool addClass(const std::string& jar, const std::string& entry, const char* data, size_t size);
+	bool addClass(const std::string& jar, const std::string& entry, const char* data, size_t size, std::string& name);
+	void addIndex(const SymbolIndex& index, const std::unordered_set<std::string>& excluded);
+
+	uint32_t numClasses() const;
+	uint32_t numDuplicates() const;
+	const std::vector<std::string>& getErrors() const;
+
+	void write(const std::string& path) const;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <stdint.h>
+
+/**
+ * Records a timeline of spans, and writes it in the Chrome trace event format, which chrome://tracing and
+ * Perfetto both open. Every thread records into its own buffer, and gets its own track, so loading on several
+ * threads shows up side by side, and spans on a thread nest by time, so a class's span contains the spans of
+ * everything its initialization loaded.
+ *
+ * Tracing is off until started, and a span costs a single relaxed load while it's off.
+ */
+class Trace {
+private:
+	static std::atomic<bool> enabled;
+
+	Trace() {}
+public:
+	static void start();
+	static void stop();
+
+	/**
+	 * Whether spans are being recorded.
+	 */
+	static bool isEnabled() {
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	static uint64_t now();
+	static void record(const char* category, const char* name, const std::string& detail, uint64_t start, uint64_t end);
+	static void write(std::ostream& out);
+};
+
+/**
+ * Records a span from construction to destruction on the calling thread, if tracing is enabled. The name
+ * has to outlive the trace, so it's meant to be a literal.
+ */
+class TraceSpan {
+private:
+	const char* category;
+	const char* name;
+	std::string detail;
+	uint64_t start;
+	bool active;
+
+	TraceSpan(const TraceSpan&) {}
+	const TraceSpan& operator=(const TraceSpan&) { return *this; }
+public:
+	/**
+	 * Starts a span, if tracing is enabled. The detail is shown with the span, like the name of the class
+	 * being loaded.
+	 */
+	TraceSpan(const char* category, const char* name, const std::string& detail = "") : category(category), name(name), start(0), active(false) {
+		if(Trace::isEnabled()) {
+			this->detail = detail;
+			start = Trace::now();
+			active = true;
+		}
+	}
+
+	virtual ~TraceSpan();
+};
+
+#endif
@@ -40,6 +40,25 @@ int64_t readLongSigned(std::istream& in);
 float readFloat(std::istream& in);
 double readDouble(std::istream& in);
 
+void writeByteUnsigned(std::ostream& out, uint8_t value);
+void writeShortUnsigned(std::ostream& out, uint16_t value);
+void writeIntUnsigned(std::ostream& out, uint32_t value);
+void writeLongUnsigned(std::ostream& out, uint64_t value);
+
+uint16_t readLittle16(const uint8_t* p);
+uint32_t readLittle32(const uint8_t* p);
+uint64_t readLittle64(const uint8_t* p);
+
+void writeLittle16(std::string& out, uint16_t value);
+void writeLittle32(std::string& out, uint32_t value);
+void writeLittle64(std::string& out, uint64_t value);
+
+bool isClassFile(const std::string& name);
+
+void writeJsonString(std::ostream& out, const std::string& s);
+
+std::string createTemporaryFile(const std::string& path);
+
 template<class T>
 uint32_t lowBits(const T& v) {
 	uint64_t val = reinterpret_cast<const uint64_t&>(v);
@@ -3,14 +3,22 @@
 
 #include <map>
 #include <string>
+#include <vector>
+#include <mutex>
 #include "ClassFile.h"
 #include "ClassInstance.h"
+#include "DependencyGraph.h"
 #include <inttypes.h>
 
 #include <zip.h>
 
 class ClassFile;
 class ClassInstance;
+class JavaThread;
+class Inflater;
+class ClassArchive;
+class ArrayClass;
+class FieldType;
 
 /**
  * This class represents the entire Virtual Machine, with all of its classes, and class instances.
@@ -18,23 +26,55 @@ class ClassInstance;
 class VirtualMachine {
 public:
 	VirtualMachine();
+	VirtualMachine(const std::vector<std::string>& classpath);
 	virtual ~VirtualMachine();
 	
 	virtual void setMainClass(std::string name);
 	virtual void runMain();
 	
 	virtual ClassFile& getClass(std::string name);
+	virtual ArrayClass& getArrayClass(const FieldType& type);
+	virtual std::string readClass(const std::string& name);
+	virtual std::vector<std::string> getLoadedClasses();
+	
+	virtual void setArchive(const std::string& path);
+	virtual void saveSnapshot(const std::string& path);
+	virtual void restoreSnapshot(const std::string& path);
+	
+	virtual const DependencyGraph& getDependencyGraph() const;
+	virtual std::vector<std::string> reloadClasses(const std::vector<std::string>& changed);
+	
+	virtual void setInflater(const std::string& backend);
+	virtual const Inflater& getInflater() const;
 	
 	virtual ClassInstance& getClassInstance(uint32_t index) { return *(instances[index]); }
 	virtual JavaArray& getJavaArray(uint32_t index) { return *(arrays[index]); }
+	
+	virtual JavaThread& createThread();
+	virtual JavaThread& getMainThread();
 private:
-	struct zip* rtZip;
-	struct zip* jceZip;
-	struct zip* jsseZip;
+	VirtualMachine(const VirtualMachine&) {}
+	const VirtualMachine& operator=(const VirtualMachine&) { return *this; }
+	
+	void openClasspath(const std::vector<std::string>& classpath);
+	void closeClasspath();
+	bool findClass(const std::string& name, const char*& data, size_t& size);
+	
+	std::vector<std::string> jars;
+	std::vector<struct zip*> classpath;
+	Inflater* inflater;
+	ClassArchive* archive;
+	std::string classData;
 	ClassFile* main;
 	std::map<std::string,ClassFile*> classes;
+	std::vector<std::string> loadOrder;
+	std::map<const FieldType*,ArrayClass*> arrayClasses;
+	DependencyGraph graph;
 	std::map<uint32_t,ClassInstance*> instances;
 	std::map<uint32_t,JavaArray*> arrays;
+	std::recursive_mutex classMutex;
+	std::mutex threadMutex;
+	std::vector<JavaThread*> threads;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "ArrayClass.h"
+#include <stdexcept>
+
+using std::string;
+using std::runtime_error;
+
+/**
+ * Constructor for ArrayClass. Takes in the array type, and the class of its elements, which has to be NULL
+ * for arrays of primitives.
+ */
+ArrayClass::ArrayClass(const FieldType& type, ClassFile* elementClass) : type(type), elementClass(elementClass) {
+	if(type.getKind() != FieldType::ARRAY) {
+		throw runtime_error(type.getDescriptor() + " is not an array type");
+	}
+}
+
+/**
+ * Destructor for ArrayClass. The element class belongs to the VirtualMachine, so there is nothing to delete.
+ */
+ArrayClass::~ArrayClass() {
+
+}
+
+/**
+ * Gets the type of this array.
+ */
+const FieldType& ArrayClass::getType() const {
+	return type;
+}
+
+/**
+ * Gets the name of this class, which for arrays is the descriptor, like [[I.
+ */
+const string& ArrayClass::getName() const {
+	return type.getDescriptor();
+}
+
+/**
+ * Gets the number of dimensions.
+ */
+uint8_t ArrayClass::getDimensions() const {
+	return type.getDimensions();
+}
+
+/**
+ * Gets the type of the elements, all the way down: REFERENCE for arrays of classes, or the primitive.
+ */
+FieldType::Kind ArrayClass::getElementKind() const {
+	return type.getElementKind();
+}
+
+/**
+ * Gets the class of the elements, all the way down, or NULL for arrays of primitives.
+ */
+ClassFile* ArrayClass::getElementClass() const {
+	return elementClass;
+}
+
+/**
+ * Gets the type of what the array holds directly, which is another array type if it has more than one dimension.
+ */
+const FieldType& ArrayClass::getComponentType() const {
+	return type.getComponentType();
+}
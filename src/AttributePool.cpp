@@ -1,5 +1,6 @@
 #include "AttributePool.h"
 #include "ClassFile.h"
+#include "LoadStatistics.h"
 #include "Util.h"
 
 #include <set>
@@ -12,13 +13,14 @@ using std::endl;
 using std::set;
 using std::runtime_error;
 using std::string;
+using std::vector;
 
 /**
  * Constructs an AttributePool using the ClassFile that it's a part of, out of a stream.
  */
 AttributePool::AttributePool(ClassFile& classFile, istream& input) try : 
 	classFile(classFile), constantPool(classFile.getConstantPool()), attributes(readShortUnsigned(input), NULL) {
-	
+	PhaseTimer timer(PHASE_ATTRIBUTES, input);
 	uint16_t i;
 	try {
 		for(i = 0; i < attributes.size(); i++) {
@@ -53,6 +55,8 @@ Attribute* AttributePool::buildAttribute(istream& input) {
 	//TODO: if i take out the string(...) part, i get valgrind errors all over the place. I don't know if this is glib or me.
 	if(string(name) == string(ConstantValueAttribute::name)) {
 		return new ConstantValueAttribute(*this, nameIndex, input);
+	} else if(string(name) == string(CodeAttribute::name)) {
+		return new CodeAttribute(*this, nameIndex, input);
 	} else {
 		return new UnknownAttribute(*this, nameIndex, input);
 	}
@@ -79,6 +83,16 @@ uint16_t AttributePool::getNumAttributes() const {
 	return attributes.size();
 }
 
+/**
+ * Returns the attribute at the given index, in the order they appear in the file.
+ */
+const Attribute& AttributePool::operator[](uint16_t index) const {
+	if(index >= attributes.size() || attributes[index] == NULL) {
+		throw runtime_error("No attribute present at index " + toString(index));
+	}
+	return *(attributes[index]);
+}
+
 /**
  * Returns whether there is an attribute with the given name in the Attribute Pool.
  */
@@ -210,4 +224,94 @@ uint16_t ConstantValueAttribute::getIndex() const {
 	return index;
 }
 
+const ustring CodeAttribute::name = "Code";
 
+/**
+ * Constructs a Code attribute, using the attribute pool, the name index, and an input stream.
+ */
+CodeAttribute::CodeAttribute(AttributePool& attributePool, uint16_t nameIndex, istream& input) :
+	Attribute(attributePool, nameIndex, readIntUnsigned(input)),
+	maxStack(readShortUnsigned(input)),
+	maxLocals(readShortUnsigned(input)),
+	codeLength(readIntUnsigned(input)),
+	code(readCode(input)),
+	exceptionTable(buildExceptionTable(input)),
+	attributes(attributePool.getClassFile(), input) {
+	
+}
+
+/**
+ * Destructor for the CodeAttribute. The bytecode is held in a vector, so nothing is deleted here.
+ */
+CodeAttribute::~CodeAttribute() {
+
+}
+
+/**
+ * Called in the constructor to read the bytecode, once its length is known. Throws if the length is more than
+ * the 65535 bytes a method can have, or more than the attribute holds.
+ */
+vector<uint8_t> CodeAttribute::readCode(istream& input) {
+	if(codeLength > 0xFFFF || getLength() < 8 || codeLength > getLength() - 8) {
+		throw runtime_error("Code length " + toString(codeLength) + " doesn't fit in its attribute");
+	}
+	vector<uint8_t> ret(codeLength);
+	input.read((char*)ret.data(), codeLength);
+	return ret;
+}
+
+/**
+ * Called in the constructor to read the exception table, which comes right after the bytecode.
+ */
+vector<ExceptionHandler> CodeAttribute::buildExceptionTable(istream& input) {
+	vector<ExceptionHandler> ret(readShortUnsigned(input));
+	for(uint16_t i = 0; i < ret.size(); i++) {
+		ret[i].startPc = readShortUnsigned(input);
+		ret[i].endPc = readShortUnsigned(input);
+		ret[i].handlerPc = readShortUnsigned(input);
+		ret[i].catchType = readShortUnsigned(input);
+	}
+	return ret;
+}
+
+/**
+ * Gets the maximum depth of the operand stack while executing this code.
+ */
+uint16_t CodeAttribute::getMaxStack() const {
+	return maxStack;
+}
+
+/**
+ * Gets the number of local variable slots used by this code, including the ones holding the parameters.
+ */
+uint16_t CodeAttribute::getMaxLocals() const {
+	return maxLocals;
+}
+
+/**
+ * Gets the length of the bytecode, in bytes.
+ */
+uint32_t CodeAttribute::getCodeLength() const {
+	return codeLength;
+}
+
+/**
+ * Gets the bytecode itself.
+ */
+const uint8_t* CodeAttribute::getCode() const {
+	return code.data();
+}
+
+/**
+ * Gets the table of exception handlers for this code.
+ */
+const vector<ExceptionHandler>& CodeAttribute::getExceptionTable() const {
+	return exceptionTable;
+}
+
+/**
+ * Gets the attributes of this code, such as its LineNumberTable and LocalVariableTable.
+ */
+const AttributePool& CodeAttribute::getAttributes() const {
+	return attributes;
+}
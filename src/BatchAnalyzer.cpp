@@ -0,0 +1,437 @@
+#include "BatchAnalyzer.h"
+#include "ClassFile.h"
+#include "JarStream.h"
+#include "ClassQueue.h"
+#include "Inflater.h"
+#include "MemoryStreamBuf.h"
+#include "Trace.h"
+#include "Util.h"
+
+#include <zip.h>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <stdexcept>
+
+using std::string;
+using std::vector;
+using std::map;
+using std::pair;
+using std::make_pair;
+using std::ostream;
+using std::endl;
+using std::runtime_error;
+
+namespace {
+	/**
+	 * Adds every attribute in a pool to the histogram, including the ones nested inside Code attributes, and
+	 * adds up the length of the bytecode.
+	 */
+	void countAttributes(const AttributePool& pool, map<string, uint32_t>& histogram, uint32_t& codeSize) {
+		for(uint16_t i = 0; i < pool.getNumAttributes(); i++) {
+			const Attribute& attribute = pool[i];
+			histogram[string(attribute.getName())]++;
+			const CodeAttribute* code = dynamic_cast<const CodeAttribute*>(&attribute);
+			if(code) {
+				codeSize += code->getCodeLength();
+				countAttributes(code->getAttributes(), histogram, codeSize);
+			}
+		}
+	}
+
+	void countMemberAttributes(const ClassMemberPool& members, map<string, uint32_t>& histogram, uint32_t& codeSize) {
+		for(uint16_t i = 0; i < members.numMembers(); i++) {
+			countAttributes(members[i].getAttributes(), histogram, codeSize);
+		}
+	}
+
+	/**
+	 * Makes the statistics for a class that hasn't been parsed yet, named after its jar entry.
+	 */
+	ClassStatistics emptyStatistics(const string& jar, const string& entryName) {
+		ClassStatistics classStatistics;
+		classStatistics.jar = jar;
+		classStatistics.name = isClassFile(entryName) ? entryName.substr(0, entryName.size() - 6) : entryName;
+		classStatistics.size = 0;
+		classStatistics.constantPoolSize = 0;
+		classStatistics.fieldCount = 0;
+		classStatistics.methodCount = 0;
+		classStatistics.codeSize = 0;
+		return classStatistics;
+	}
+
+	/**
+	 * Writes a string as a CSV field, quoting it if it contains anything that would confuse a reader.
+	 */
+	void writeCsvField(ostream& out, const string& s) {
+		if(s.find_first_of(",\"\r\n") == string::npos) {
+			out << s;
+			return;
+		}
+		out << '"';
+		for(string::const_iterator it = s.begin(); it != s.end(); it++) {
+			if(*it == '"') {
+				out << '"';
+			}
+			out << *it;
+		}
+		out << '"';
+	}
+}
+
+/**
+ * Constructor for BatchAnalyzer. The VirtualMachine is only used to construct the ClassFiles; classes are
+ * never loaded into it. If numThreads is 0, one thread is used per core.
+ */
+BatchAnalyzer::BatchAnalyzer(VirtualMachine& vm, unsigned int numThreads) :
+	vm(vm), numThreads(numThreads), nextEntry(0), elapsedSeconds(0) {
+	if(this->numThreads == 0) {
+		this->numThreads = std::thread::hardware_concurrency();
+	}
+	if(this->numThreads == 0) {
+		this->numThreads = 1;
+	}
+}
+
+/**
+ * Destructor for BatchAnalyzer. Jars are only held open while running, so there's nothing to clean up.
+ */
+BatchAnalyzer::~BatchAnalyzer() {
+
+}
+
+/**
+ * Chooses the inflater backend by name. By default, the fastest one available is used.
+ */
+void BatchAnalyzer::setInflater(const string& backend) {
+	delete Inflater::create(backend); // Make sure it exists before any threads need one.
+	inflaterBackend = backend;
+}
+
+/**
+ * Adds a jar to the set that will be analyzed. Every class file in it is parsed; nothing else is.
+ */
+void BatchAnalyzer::addJar(const string& path) {
+	jars.push_back(path);
+}
+
+/**
+ * Lists the class files in every jar through their central directories, for run() to divide up.
+ */
+void BatchAnalyzer::listEntries() {
+	entries.clear();
+	statistics.clear();
+	for(uint32_t j = 0; j < jars.size(); j++) {
+		int error = 0;
+		struct zip* jar = zip_open(jars[j].c_str(), 0, &error);
+		if(!jar) {
+			throw runtime_error("Could not open " + jars[j] + ": libzip error " + toString(error));
+		}
+		zip_int64_t count = zip_get_num_entries(jar, 0);
+		for(zip_int64_t i = 0; i < count; i++) {
+			const char* name = zip_get_name(jar, i, 0);
+			if(!name || !isClassFile(name)) {
+				continue;
+			}
+			Entry entry;
+			entry.jar = j;
+			entry.index = i;
+			entries.push_back(entry);
+			statistics.push_back(emptyStatistics(jars[j], name));
+		}
+		zip_close(jar);
+	}
+}
+
+/**
+ * Parses every class in the jars, spread across the worker threads. Entries are found through each jar's
+ * central directory, and read through libzip. The calling thread works too.
+ */
+void BatchAnalyzer::run() {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	listEntries();
+	inflaterStatistics = InflaterStatistics();
+	nextEntry = 0;
+	vector<std::thread> workers;
+	for(unsigned int i = 1; i < numThreads && i < entries.size(); i++) {
+		workers.push_back(std::thread(&BatchAnalyzer::work, this));
+	}
+	work();
+	for(vector<std::thread>::iterator it = workers.begin(); it != workers.end(); it++) {
+		it->join();
+	}
+	elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Parses every class in the jars like run(), except that the calling thread reads each jar front to back
+ * with a JarStream and hands the classes to the worker threads through a ClassQueue. Every jar is read with
+ * one sequential pass, instead of a seek per entry.
+ */
+void BatchAnalyzer::runStreaming() {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	entries.clear();
+	statistics.clear();
+	inflaterStatistics = InflaterStatistics();
+	ClassQueue queue(numThreads * 4);
+	vector<vector<pair<uint32_t, ClassStatistics> > > results(numThreads + 1);
+	vector<std::thread> workers;
+	for(unsigned int i = 0; i < numThreads; i++) {
+		workers.push_back(std::thread(&BatchAnalyzer::consume, this, std::ref(queue), std::ref(results[i])));
+	}
+
+	// Entries that can't be read never make it to the queue, so the reader records them itself.
+	vector<pair<uint32_t, ClassStatistics> >& readErrors = results[numThreads];
+	uint32_t sequence = 0;
+	ClassBuffer buffer;
+	Inflater* inflater = NULL;
+	try {
+		inflater = Inflater::create(inflaterBackend);
+		for(vector<string>::iterator jar = jars.begin(); jar != jars.end(); jar++) {
+			JarStream stream(*jar);
+			stream.setInflater(inflater);
+			while(true) {
+				// Skipping an entry that can't be read can leave nowhere to go on from, which loses the rest of
+				// that jar but not the others.
+				try {
+					if(!stream.nextEntry()) {
+						break;
+					}
+				} catch(const std::exception& e) {
+					readErrors.push_back(make_pair(sequence++, emptyStatistics(*jar, stream.getName())));
+					readErrors.back().second.error = e.what();
+					break;
+				}
+				if(!isClassFile(stream.getName())) {
+					continue;
+				}
+				buffer.sequence = sequence++;
+				buffer.jar = *jar;
+				buffer.name = stream.getName();
+				try {
+					stream.readEntry(buffer.data);
+				} catch(const std::exception& e) {
+					readErrors.push_back(make_pair(buffer.sequence, emptyStatistics(*jar, buffer.name)));
+					readErrors.back().second.error = e.what();
+					continue;
+				}
+				queue.push(buffer);
+			}
+		}
+	} catch(...) {
+		queue.close();
+		for(vector<std::thread>::iterator it = workers.begin(); it != workers.end(); it++) {
+			it->join();
+		}
+		delete inflater;
+		throw;
+	}
+	addInflaterStatistics(*inflater);
+	delete inflater;
+	queue.close();
+	for(vector<std::thread>::iterator it = workers.begin(); it != workers.end(); it++) {
+		it->join();
+	}
+
+	statistics.resize(sequence);
+	for(uint32_t i = 0; i < results.size(); i++) {
+		for(uint32_t r = 0; r < results[i].size(); r++) {
+			std::swap(statistics[results[i][r].first], results[i][r].second);
+		}
+	}
+	elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * The body of a worker thread in streaming mode. Parses classes off the queue until it's closed and empty,
+ * keeping the results, tagged with the order they were read in, to itself.
+ */
+void BatchAnalyzer::consume(ClassQueue& queue, vector<pair<uint32_t, ClassStatistics> >& results) {
+	ClassBuffer buffer;
+	while(queue.pop(buffer)) {
+		results.push_back(make_pair(buffer.sequence, emptyStatistics(buffer.jar, buffer.name)));
+		ClassStatistics& classStatistics = results.back().second;
+		classStatistics.size = buffer.data.size();
+		analyze(buffer.data, classStatistics);
+	}
+}
+
+/**
+ * The body of a worker thread. Takes entries off the shared counter until there are none left, and fills in
+ * their statistics. Each entry's statistics are only ever touched by the thread that took it. Each worker
+ * has its own inflater, since they aren't thread safe.
+ */
+void BatchAnalyzer::work() {
+	Inflater* inflater = Inflater::create(inflaterBackend);
+	vector<struct zip*> handles(jars.size(), NULL);
+	string data;
+	for(uint32_t i = nextEntry++; i < entries.size(); i = nextEntry++) {
+		const Entry& entry = entries[i];
+		ClassStatistics& classStatistics = statistics[i];
+		try {
+			if(!handles[entry.jar]) {
+				int error = 0;
+				handles[entry.jar] = zip_open(jars[entry.jar].c_str(), 0, &error);
+				if(!handles[entry.jar]) {
+					throw runtime_error("Could not open " + jars[entry.jar] + ": libzip error " + toString(error));
+				}
+			}
+			inflater->readEntry(handles[entry.jar], entry.index, data);
+		} catch(const std::exception& e) {
+			classStatistics.error = e.what();
+			continue;
+		}
+		classStatistics.size = data.size();
+		analyze(data, classStatistics);
+	}
+	for(vector<struct zip*>::iterator it = handles.begin(); it != handles.end(); it++) {
+		if(*it) {
+			zip_close(*it);
+		}
+	}
+	addInflaterStatistics(*inflater);
+	delete inflater;
+}
+
+/**
+ * Adds a worker's inflater statistics to the totals.
+ */
+void BatchAnalyzer::addInflaterStatistics(const Inflater& inflater) {
+	std::lock_guard<std::mutex> lock(statisticsMutex);
+	inflaterStatistics.add(inflater.getStatistics());
+}
+
+/**
+ * Parses a single class file, and fills in its statistics. If it can't be parsed, the reason goes in the
+ * statistics instead of being thrown.
+ */
+void BatchAnalyzer::analyze(const string& data, ClassStatistics& classStatistics) {
+	TraceSpan span("parse", "class", classStatistics.name);
+	try {
+		MemoryStreamBuf buffer(data.data(), data.size());
+		std::istream in(&buffer);
+		ClassFile cf(vm, in);
+		classStatistics.constantPoolSize = cf.getConstantPool().getNumElements();
+		classStatistics.fieldCount = cf.getFields().numMembers();
+		classStatistics.methodCount = cf.getMethods().numMembers();
+		countAttributes(cf.getAttributes(), classStatistics.attributes, classStatistics.codeSize);
+		countMemberAttributes(cf.getFields(), classStatistics.attributes, classStatistics.codeSize);
+		countMemberAttributes(cf.getMethods(), classStatistics.attributes, classStatistics.codeSize);
+	} catch(const std::exception& e) {
+		classStatistics.error = e.what();
+	} catch(const char* str) {
+		classStatistics.error = str;
+	} catch(const string& s) {
+		classStatistics.error = s;
+	}
+}
+
+/**
+ * Gets the statistics for every class, in the order the jars were added, and then the order of the jars'
+ * entries.
+ */
+const vector<ClassStatistics>& BatchAnalyzer::getStatistics() const {
+	return statistics;
+}
+
+/**
+ * Gets the number of classes that couldn't be read or parsed.
+ */
+uint32_t BatchAnalyzer::numErrors() const {
+	uint32_t errors = 0;
+	for(vector<ClassStatistics>::const_iterator it = statistics.begin(); it != statistics.end(); it++) {
+		if(!it->error.empty()) {
+			errors++;
+		}
+	}
+	return errors;
+}
+
+/**
+ * Gets the total uncompressed size of every class that was read.
+ */
+uint64_t BatchAnalyzer::getTotalBytes() const {
+	uint64_t bytes = 0;
+	for(vector<ClassStatistics>::const_iterator it = statistics.begin(); it != statistics.end(); it++) {
+		bytes += it->size;
+	}
+	return bytes;
+}
+
+/**
+ * Gets how long the last call to run() took, in seconds.
+ */
+double BatchAnalyzer::getElapsedSeconds() const {
+	return elapsedSeconds;
+}
+
+/**
+ * Writes the statistics for every class, as either a JSON array of objects or CSV with a header row. In
+ * CSV, the attribute histogram is a single field of name=count pairs separated by semicolons.
+ */
+void BatchAnalyzer::write(ostream& out, OutputFormat format) const {
+	if(format == CSV) {
+		out << "jar,class,bytes,constant_pool,fields,methods,code_size,attributes,error" << endl;
+	} else {
+		out << "[";
+	}
+	for(vector<ClassStatistics>::const_iterator it = statistics.begin(); it != statistics.end(); it++) {
+		if(format == CSV) {
+			string attributes;
+			for(map<string, uint32_t>::const_iterator a = it->attributes.begin(); a != it->attributes.end(); a++) {
+				if(!attributes.empty()) {
+					attributes += ";";
+				}
+				attributes += a->first + "=" + toString(a->second);
+			}
+			writeCsvField(out, it->jar);
+			out << ",";
+			writeCsvField(out, it->name);
+			out << "," << it->size << "," << it->constantPoolSize << "," << it->fieldCount << "," << it->methodCount;
+			out << "," << it->codeSize << ",";
+			writeCsvField(out, attributes);
+			out << ",";
+			writeCsvField(out, it->error);
+			out << "\n";
+		} else {
+			out << (it == statistics.begin() ? "\n" : ",\n") << "  {\"jar\": ";
+			writeJsonString(out, it->jar);
+			out << ", \"class\": ";
+			writeJsonString(out, it->name);
+			out << ", \"bytes\": " << it->size;
+			if(!it->error.empty()) {
+				out << ", \"error\": ";
+				writeJsonString(out, it->error);
+				out << "}";
+				continue;
+			}
+			out << ", \"constantPool\": " << it->constantPoolSize << ", \"fields\": " << it->fieldCount;
+			out << ", \"methods\": " << it->methodCount << ", \"codeSize\": " << it->codeSize << ", \"attributes\": {";
+			for(map<string, uint32_t>::const_iterator a = it->attributes.begin(); a != it->attributes.end(); a++) {
+				if(a != it->attributes.begin()) {
+					out << ", ";
+				}
+				writeJsonString(out, a->first);
+				out << ": " << a->second;
+			}
+			out << "}}";
+		}
+	}
+	if(format == JSON) {
+		out << "\n]" << endl;
+	}
+	out.flush();
+}
+
+/**
+ * Writes a summary of how fast the last run went, in classes and megabytes per second, and how fast the
+ * inflater backend went on its own.
+ */
+void BatchAnalyzer::writeThroughput(ostream& out) const {
+	double megabytes = getTotalBytes() / (1024.0 * 1024.0);
+	double seconds = elapsedSeconds > 0 ? elapsedSeconds : 1e-9;
+	out << "Parsed " << statistics.size() << " classes (" << numErrors() << " errors, " << megabytes << " MB) in ";
+	out << elapsedSeconds << " s with " << numThreads << " threads: " << (statistics.size() / seconds) << " classes/s, ";
+	out << (megabytes / seconds) << " MB/s" << endl;
+	Inflater::writeStatistics(out, inflaterBackend.empty() ? Inflater::getBackends()[0] : inflaterBackend, inflaterStatistics);
+}
@@ -0,0 +1,479 @@
+#include "Bytecode.h"
+#include "AttributePool.h"
+#include "Util.h"
+
+#include <stdexcept>
+
+using std::vector;
+using std::runtime_error;
+
+namespace {
+	/**
+	 * Opcode information, indexed by opcode, for every opcode from BY_nop through BY_jsr_w.
+	 */
+	const OpcodeInfo OPCODES[] = {
+	{"nop", 1, 0, 0},
+	{"aconst_null", 1, 0, 1},
+	{"iconst_m1", 1, 0, 1},
+	{"iconst_0", 1, 0, 1},
+	{"iconst_1", 1, 0, 1},
+	{"iconst_2", 1, 0, 1},
+	{"iconst_3", 1, 0, 1},
+	{"iconst_4", 1, 0, 1},
+	{"iconst_5", 1, 0, 1},
+	{"lconst_0", 1, 0, 2},
+	{"lconst_1", 1, 0, 2},
+	{"fconst_0", 1, 0, 1},
+	{"fconst_1", 1, 0, 1},
+	{"fconst_2", 1, 0, 1},
+	{"dconst_0", 1, 0, 2},
+	{"dconst_1", 1, 0, 2},
+	{"bipush", 2, 0, 1},
+	{"sipush", 3, 0, 1},
+	{"ldc", 2, 0, 1},
+	{"ldc_w", 3, 0, 1},
+	{"ldc2_w", 3, 0, 2},
+	{"iload", 2, 0, 1},
+	{"lload", 2, 0, 2},
+	{"fload", 2, 0, 1},
+	{"dload", 2, 0, 2},
+	{"aload", 2, 0, 1},
+	{"iload_0", 1, 0, 1},
+	{"iload_1", 1, 0, 1},
+	{"iload_2", 1, 0, 1},
+	{"iload_3", 1, 0, 1},
+	{"lload_0", 1, 0, 2},
+	{"lload_1", 1, 0, 2},
+	{"lload_2", 1, 0, 2},
+	{"lload_3", 1, 0, 2},
+	{"fload_0", 1, 0, 1},
+	{"fload_1", 1, 0, 1},
+	{"fload_2", 1, 0, 1},
+	{"fload_3", 1, 0, 1},
+	{"dload_0", 1, 0, 2},
+	{"dload_1", 1, 0, 2},
+	{"dload_2", 1, 0, 2},
+	{"dload_3", 1, 0, 2},
+	{"aload_0", 1, 0, 1},
+	{"aload_1", 1, 0, 1},
+	{"aload_2", 1, 0, 1},
+	{"aload_3", 1, 0, 1},
+	{"iaload", 1, 2, 1},
+	{"laload", 1, 2, 2},
+	{"faload", 1, 2, 1},
+	{"daload", 1, 2, 2},
+	{"aaload", 1, 2, 1},
+	{"baload", 1, 2, 1},
+	{"caload", 1, 2, 1},
+	{"saload", 1, 2, 1},
+	{"istore", 2, 1, 0},
+	{"lstore", 2, 2, 0},
+	{"fstore", 2, 1, 0},
+	{"dstore", 2, 2, 0},
+	{"astore", 2, 1, 0},
+	{"istore_0", 1, 1, 0},
+	{"istore_1", 1, 1, 0},
+	{"istore_2", 1, 1, 0},
+	{"istore_3", 1, 1, 0},
+	{"lstore_0", 1, 2, 0},
+	{"lstore_1", 1, 2, 0},
+	{"lstore_2", 1, 2, 0},
+	{"lstore_3", 1, 2, 0},
+	{"fstore_0", 1, 1, 0},
+	{"fstore_1", 1, 1, 0},
+	{"fstore_2", 1, 1, 0},
+	{"fstore_3", 1, 1, 0},
+	{"dstore_0", 1, 2, 0},
+	{"dstore_1", 1, 2, 0},
+	{"dstore_2", 1, 2, 0},
+	{"dstore_3", 1, 2, 0},
+	{"astore_0", 1, 1, 0},
+	{"astore_1", 1, 1, 0},
+	{"astore_2", 1, 1, 0},
+	{"astore_3", 1, 1, 0},
+	{"iastore", 1, 3, 0},
+	{"lastore", 1, 4, 0},
+	{"fastore", 1, 3, 0},
+	{"dastore", 1, 4, 0},
+	{"aastore", 1, 3, 0},
+	{"bastore", 1, 3, 0},
+	{"castore", 1, 3, 0},
+	{"sastore", 1, 3, 0},
+	{"pop", 1, 1, 0},
+	{"pop2", 1, 2, 0},
+	{"dup", 1, 1, 2},
+	{"dup_x1", 1, 2, 3},
+	{"dup_x2", 1, 3, 4},
+	{"dup2", 1, 2, 4},
+	{"dup2_x1", 1, 3, 5},
+	{"dup2_x2", 1, 4, 6},
+	{"swap", 1, 2, 2},
+	{"iadd", 1, 2, 1},
+	{"ladd", 1, 4, 2},
+	{"fadd", 1, 2, 1},
+	{"dadd", 1, 4, 2},
+	{"isub", 1, 2, 1},
+	{"lsub", 1, 4, 2},
+	{"fsub", 1, 2, 1},
+	{"dsub", 1, 4, 2},
+	{"imul", 1, 2, 1},
+	{"lmul", 1, 4, 2},
+	{"fmul", 1, 2, 1},
+	{"dmul", 1, 4, 2},
+	{"idiv", 1, 2, 1},
+	{"ldiv", 1, 4, 2},
+	{"fdiv", 1, 2, 1},
+	{"ddiv", 1, 4, 2},
+	{"irem", 1, 2, 1},
+	{"lrem", 1, 4, 2},
+	{"frem", 1, 2, 1},
+	{"drem", 1, 4, 2},
+	{"ineg", 1, 1, 1},
+	{"lneg", 1, 2, 2},
+	{"fneg", 1, 1, 1},
+	{"dneg", 1, 2, 2},
+	{"ishl", 1, 2, 1},
+	{"lshl", 1, 3, 2},
+	{"ishr", 1, 2, 1},
+	{"lshr", 1, 3, 2},
+	{"iushr", 1, 2, 1},
+	{"lushr", 1, 3, 2},
+	{"iand", 1, 2, 1},
+	{"land", 1, 4, 2},
+	{"ior", 1, 2, 1},
+	{"lor", 1, 4, 2},
+	{"ixor", 1, 2, 1},
+	{"lxor", 1, 4, 2},
+	{"iinc", 3, 0, 0},
+	{"i2l", 1, 1, 2},
+	{"i2f", 1, 1, 1},
+	{"i2d", 1, 1, 2},
+	{"l2i", 1, 2, 1},
+	{"l2f", 1, 2, 1},
+	{"l2d", 1, 2, 2},
+	{"f2i", 1, 1, 1},
+	{"f2l", 1, 1, 2},
+	{"f2d", 1, 1, 2},
+	{"d2i", 1, 2, 1},
+	{"d2l", 1, 2, 2},
+	{"d2f", 1, 2, 1},
+	{"i2b", 1, 1, 1},
+	{"i2c", 1, 1, 1},
+	{"i2s", 1, 1, 1},
+	{"lcmp", 1, 4, 1},
+	{"fcmpl", 1, 2, 1},
+	{"fcmpg", 1, 2, 1},
+	{"dcmpl", 1, 4, 1},
+	{"dcmpg", 1, 4, 1},
+	{"ifeq", 3, 1, 0},
+	{"ifne", 3, 1, 0},
+	{"iflt", 3, 1, 0},
+	{"ifgt", 3, 1, 0},
+	{"ifge", 3, 1, 0},
+	{"ifle", 3, 1, 0},
+	{"if_icmpeq", 3, 2, 0},
+	{"if_icmpne", 3, 2, 0},
+	{"if_icmplt", 3, 2, 0},
+	{"if_icmpge", 3, 2, 0},
+	{"if_icmpgt", 3, 2, 0},
+	{"if_icmple", 3, 2, 0},
+	{"if_acmpeq", 3, 2, 0},
+	{"if_acmpne", 3, 2, 0},
+	{"goto", 3, 0, 0},
+	{"jsr", 3, 0, 1},
+	{"ret", 2, 0, 0},
+	{"tableswitch", 0, 1, 0},
+	{"lookupswitch", 0, 1, 0},
+	{"ireturn", 1, 1, 0},
+	{"lreturn", 1, 2, 0},
+	{"freturn", 1, 1, 0},
+	{"dreturn", 1, 2, 0},
+	{"areturn", 1, 1, 0},
+	{"return", 1, 0, 0},
+	{"getstatic", 3, -1, -1},
+	{"putstatic", 3, -1, -1},
+	{"getfield", 3, -1, -1},
+	{"putfield", 3, -1, -1},
+	{"invokevirtual", 3, -1, -1},
+	{"invokespecial", 3, -1, -1},
+	{"invokestatic", 3, -1, -1},
+	{"invokeinterface", 5, -1, -1},
+	{"invokedynamic", 5, -1, -1},
+	{"new", 3, 0, 1},
+	{"newarray", 2, 1, 1},
+	{"anewarray", 3, 1, 1},
+	{"arraylength", 1, 1, 1},
+	{"athrow", 1, 1, 0},
+	{"checkcast", 3, 1, 1},
+	{"instanceof", 3, 1, 1},
+	{"monitorenter", 1, 1, 0},
+	{"monitorexit", 1, 1, 0},
+	{"wide", 0, 0, 0},
+	{"multianewarray", 4, -1, -1},
+	{"ifnull", 3, 1, 0},
+	{"ifnonnull", 3, 1, 0},
+	{"goto_w", 5, 0, 0},
+	{"jsr_w", 5, 0, 1}
+	};
+	
+	const OpcodeInfo UNKNOWN_OPCODE = {NULL, 0, 0, 0};
+	
+	uint16_t readU2(const uint8_t* code) {
+		return (((uint16_t)code[0]) << 8) | code[1];
+	}
+	
+	int32_t readS4(const uint8_t* code) {
+		return (int32_t)((((uint32_t)code[0]) << 24) | (((uint32_t)code[1]) << 16) | (((uint32_t)code[2]) << 8) | code[3]);
+	}
+	
+	/**
+	 * Switch instructions are padded so that their operands start on a multiple of 4 bytes from the start of the code.
+	 */
+	uint32_t switchOperands(uint32_t pc) {
+		return (pc + 4) & ~3u;
+	}
+}
+
+const uint32_t MethodCode::NO_INSTRUCTION;
+
+/**
+ * Gets the static information about an opcode. Opcodes that aren't defined have a NULL name.
+ */
+const OpcodeInfo& getOpcodeInfo(uint8_t opcode) {
+	if(opcode > BY_jsr_w) {
+		return UNKNOWN_OPCODE;
+	}
+	return OPCODES[opcode];
+}
+
+/**
+ * Decodes the instruction starting at a pc. Throws if it's an undefined opcode or runs off of the end of the code.
+ * Switch sizes come from the code itself, so they're checked against what's left of it before they're multiplied
+ * out, and in 64 bits, so a malformed switch can't wrap around into a length that looks valid.
+ */
+void decodeInstruction(const uint8_t* bytes, uint32_t codeLength, uint32_t pc, Instruction& instruction) {
+	instruction.pc = pc;
+	instruction.opcode = bytes[pc];
+	instruction.wide = false;
+	uint64_t length;
+	const OpcodeInfo& info = getOpcodeInfo(instruction.opcode);
+	if(info.name == NULL) {
+		throw runtime_error("Unknown opcode 0x" + toHexString((int)instruction.opcode) + " at pc " + toString(pc) + ".");
+	}
+	if(instruction.opcode == BY_wide) {
+		if(pc + 1 >= codeLength) {
+			throw runtime_error("Truncated wide instruction at pc " + toString(pc) + ".");
+		}
+		instruction.opcode = bytes[pc + 1];
+		instruction.wide = true;
+		length = (instruction.opcode == BY_iinc) ? 6 : 4;
+	} else if(instruction.opcode == BY_tableswitch) {
+		uint64_t operands = switchOperands(pc);
+		if(operands + 12 > codeLength) {
+			throw runtime_error("Truncated tableswitch at pc " + toString(pc) + ".");
+		}
+		int32_t low = readS4(bytes + operands + 4);
+		int32_t high = readS4(bytes + operands + 8);
+		if(high < low) {
+			throw runtime_error("Invalid tableswitch bounds at pc " + toString(pc) + ".");
+		}
+		uint64_t cases = (uint64_t)((int64_t)high - low) + 1;
+		if(cases > (codeLength - operands - 12) / 4) {
+			throw runtime_error("Tableswitch at pc " + toString(pc) + " runs off the end of the code.");
+		}
+		length = operands + 12 + 4 * cases - pc;
+	} else if(instruction.opcode == BY_lookupswitch) {
+		uint64_t operands = switchOperands(pc);
+		if(operands + 8 > codeLength) {
+			throw runtime_error("Truncated lookupswitch at pc " + toString(pc) + ".");
+		}
+		int32_t pairs = readS4(bytes + operands + 4);
+		if(pairs < 0) {
+			throw runtime_error("Invalid lookupswitch pair count at pc " + toString(pc) + ".");
+		}
+		if((uint64_t)pairs > (codeLength - operands - 8) / 8) {
+			throw runtime_error("Lookupswitch at pc " + toString(pc) + " runs off the end of the code.");
+		}
+		length = operands + 8 + 8 * (uint64_t)pairs - pc;
+	} else {
+		length = info.length;
+	}
+	if(pc + length > codeLength || length > 0xFFFF) {
+		throw runtime_error("Instruction at pc " + toString(pc) + " runs off the end of the code.");
+	}
+	instruction.length = length;
+}
+
+/**
+ * Decodes all of the instructions in a Code attribute. Throws if the code contains an undefined opcode or
+ * an instruction that runs off of the end of the code.
+ */
+MethodCode::MethodCode(const CodeAttribute& code) : code(code), pcIndex(code.getCodeLength(), NO_INSTRUCTION) {
+	const uint8_t* bytes = code.getCode();
+	uint32_t codeLength = code.getCodeLength();
+	instructions.reserve(codeLength / 2);
+	uint32_t pc = 0;
+	while(pc < codeLength) {
+		Instruction instruction;
+		decodeInstruction(bytes, codeLength, pc, instruction);
+		pcIndex[pc] = instructions.size();
+		instructions.push_back(instruction);
+		pc += instruction.length;
+	}
+}
+
+/**
+ * Destructor for MethodCode. The code itself belongs to the CodeAttribute, so nothing is deleted.
+ */
+MethodCode::~MethodCode() {
+	
+}
+
+/**
+ * Gets the Code attribute this was decoded from.
+ */
+const CodeAttribute& MethodCode::getCode() const {
+	return code;
+}
+
+/**
+ * Gets the number of instructions in the code.
+ */
+uint32_t MethodCode::numInstructions() const {
+	return instructions.size();
+}
+
+/**
+ * Gets a specific instruction, by its position in the instruction stream (not its pc).
+ */
+const Instruction& MethodCode::operator[](uint32_t index) const {
+	if(index >= instructions.size()) {
+		throw runtime_error("Instruction index out of range: " + toString(index) + " >= " + toString(instructions.size()));
+	}
+	return instructions[index];
+}
+
+/**
+ * Gets the position in the instruction stream of the instruction that starts at pc, or NO_INSTRUCTION
+ * if no instruction starts there.
+ */
+uint32_t MethodCode::indexOf(uint32_t pc) const {
+	if(pc >= pcIndex.size()) {
+		return NO_INSTRUCTION;
+	}
+	return pcIndex[pc];
+}
+
+/**
+ * Gets the index operand of an instruction: a constant pool index for ldc, field accesses, invocations and
+ * the type instructions, or a local variable index for loads, stores, iinc and ret.
+ */
+uint16_t MethodCode::getIndexOperand(const Instruction& instruction) const {
+	const uint8_t* bytes = code.getCode() + instruction.pc;
+	if(instruction.wide) {
+		return readU2(bytes + 2);
+	}
+	switch(instruction.opcode) {
+		case BY_ldc:
+		case BY_iload:
+		case BY_lload:
+		case BY_fload:
+		case BY_dload:
+		case BY_aload:
+		case BY_istore:
+		case BY_lstore:
+		case BY_fstore:
+		case BY_dstore:
+		case BY_astore:
+		case BY_iinc:
+		case BY_ret:
+			return bytes[1];
+		default:
+			return readU2(bytes + 1);
+	}
+}
+
+/**
+ * Gets the signed constant operand of bipush, sipush and iinc, the array type of newarray, or the
+ * dimension count of multianewarray.
+ */
+int32_t MethodCode::getConstantOperand(const Instruction& instruction) const {
+	const uint8_t* bytes = code.getCode() + instruction.pc;
+	switch(instruction.opcode) {
+		case BY_bipush:
+			return (int8_t)bytes[1];
+		case BY_sipush:
+			return (int16_t)readU2(bytes + 1);
+		case BY_iinc:
+			return instruction.wide ? (int16_t)readU2(bytes + 4) : (int8_t)bytes[2];
+		case BY_newarray:
+			return bytes[1];
+		case BY_multinewarray:
+			return bytes[3];
+		default:
+			throw runtime_error("Instruction at pc " + toString(instruction.pc) + " has no constant operand.");
+	}
+}
+
+/**
+ * Gets the pc a branch instruction (the ifs, goto, jsr, and their wide forms) jumps to.
+ */
+uint32_t MethodCode::getBranchTarget(const Instruction& instruction) const {
+	const uint8_t* bytes = code.getCode() + instruction.pc;
+	if(instruction.opcode == BY_goto_w || instruction.opcode == BY_jsr_w) {
+		return instruction.pc + readS4(bytes + 1);
+	}
+	return instruction.pc + (int16_t)readU2(bytes + 1);
+}
+
+/**
+ * Fills targets with every pc a tableswitch or lookupswitch can jump to, not counting the default, and
+ * returns the default target.
+ */
+uint32_t MethodCode::getSwitchTargets(const Instruction& instruction, vector<uint32_t>& targets) const {
+	const uint8_t* operands = code.getCode() + switchOperands(instruction.pc);
+	targets.clear();
+	if(instruction.opcode == BY_tableswitch) {
+		int32_t low = readS4(operands + 4);
+		int32_t high = readS4(operands + 8);
+		for(uint32_t i = 0; i <= (uint32_t)(high - low); i++) {
+			targets.push_back(instruction.pc + readS4(operands + 12 + 4 * i));
+		}
+	} else {
+		int32_t pairs = readS4(operands + 4);
+		for(int32_t i = 0; i < pairs; i++) {
+			targets.push_back(instruction.pc + readS4(operands + 12 + 8 * i));
+		}
+	}
+	return instruction.pc + readS4(operands);
+}
+
+/**
+ * Returns whether the opcode is a conditional or unconditional jump to a single target, including jsr.
+ */
+bool MethodCode::isBranch(uint8_t opcode) {
+	return (opcode >= BY_ifeq && opcode <= BY_jsr) || opcode == BY_ifnull || opcode == BY_ifnonnull ||
+		opcode == BY_goto_w || opcode == BY_jsr_w;
+}
+
+/**
+ * Returns whether the opcode is tableswitch or lookupswitch.
+ */
+bool MethodCode::isSwitch(uint8_t opcode) {
+	return opcode == BY_tableswitch || opcode == BY_lookupswitch;
+}
+
+/**
+ * Returns whether the opcode returns from the method.
+ */
+bool MethodCode::isReturn(uint8_t opcode) {
+	return opcode >= BY_ireturn && opcode <= BY_return;
+}
+
+/**
+ * Returns whether control never falls through from the opcode to the next instruction.
+ */
+bool MethodCode::endsBlock(uint8_t opcode) {
+	return isReturn(opcode) || isSwitch(opcode) || opcode == BY_goto || opcode == BY_goto_w ||
+		opcode == BY_athrow || opcode == BY_ret;
+}
@@ -0,0 +1,303 @@
+#include "ClassArchive.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <zlib.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using std::string;
+using std::vector;
+using std::pair;
+using std::ofstream;
+using std::runtime_error;
+
+namespace {
+	const char MAGIC[8] = { 'D', 'J', 'A', 'V', 'A', 'C', 'D', 'S' };
+
+	/*
+	 * Header {
+	 * 		u1 magic[8];
+	 * 		u4 version;
+	 * 		u4 count;
+	 * 		u8 size;
+	 * 		u4 main_offset;
+	 * 		u4 main_length;
+	 * }
+	 * IndexEntry {
+	 * 		u4 name_offset;
+	 * 		u4 name_length;
+	 * 		u8 data_offset;
+	 * 		u4 data_length;
+	 * 		u4 crc;
+	 * }
+	 * Archive {
+	 * 		Header header;
+	 * 		IndexEntry index[count];
+	 * 		u4 load_order[count];
+	 * 		u1 names[];
+	 * 		u1 classes[];
+	 * }
+	 */
+	const size_t HEADER_SIZE = 32;
+	const size_t ENTRY_SIZE = 24;
+	const size_t ALIGNMENT = 8;
+
+	void align(string& out) {
+		out.append((ALIGNMENT - out.size() % ALIGNMENT) % ALIGNMENT, '\0');
+	}
+
+	/**
+	 * Orders the positions of classes by their names.
+	 */
+	struct ByName {
+		const vector<pair<string, string> >& classes;
+
+		ByName(const vector<pair<string, string> >& classes) : classes(classes) {}
+
+		bool operator()(uint32_t a, uint32_t b) const {
+			return classes[a].first < classes[b].first;
+		}
+	};
+}
+
+/**
+ * Maps an archive, and checks that its header and index are sane, so that lookups never read outside
+ * the mapping. Throws if the archive can't be used.
+ */
+ClassArchive::ClassArchive(const string& path) : path(path), mapping(NULL), mappingSize(0), count(0), index(NULL), order(NULL) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0) {
+		throw runtime_error("Could not open class archive " + path);
+	}
+	struct stat info;
+	if(fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(HEADER_SIZE)) {
+		close(fd);
+		throw runtime_error(path + " is not a class archive");
+	}
+	mappingSize = info.st_size;
+	void* memory = mmap(NULL, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(memory == MAP_FAILED) {
+		throw runtime_error("Could not map class archive " + path);
+	}
+	mapping = static_cast<const uint8_t*>(memory);
+
+	const char* problem = NULL;
+	if(memcmp(mapping, MAGIC, sizeof(MAGIC)) != 0) {
+		problem = " is not a class archive";
+	} else if(readLittle32(mapping + 8) != VERSION) {
+		problem = " was written by a different version";
+	} else if(readLittle64(mapping + 16) != mappingSize) {
+		problem = " is truncated";
+	} else {
+		count = readLittle32(mapping + 12);
+		index = mapping + HEADER_SIZE;
+		order = index + static_cast<size_t>(count) * ENTRY_SIZE;
+		uint32_t mainOffset = readLittle32(mapping + 24);
+		uint32_t mainLength = readLittle32(mapping + 28);
+		if(static_cast<uint64_t>(count) * (ENTRY_SIZE + 4) > mappingSize - HEADER_SIZE
+			|| static_cast<uint64_t>(mainOffset) + mainLength > mappingSize) {
+			problem = " has a corrupt index";
+		} else {
+			mainClass.assign(reinterpret_cast<const char*>(mapping + mainOffset), mainLength);
+		}
+		for(uint32_t i = 0; !problem && i < count; i++) {
+			IndexEntry entry = getEntry(i);
+			if(static_cast<uint64_t>(entry.nameOffset) + entry.nameLength > mappingSize || entry.dataOffset > mappingSize
+				|| entry.dataLength > mappingSize - entry.dataOffset) {
+				problem = " has a corrupt index";
+			}
+			if(readLittle32(order + static_cast<size_t>(i) * 4) >= count) {
+				problem = " has a corrupt load order";
+			}
+		}
+	}
+	if(problem) {
+		munmap(const_cast<uint8_t*>(mapping), mappingSize);
+		throw runtime_error(path + problem);
+	}
+}
+
+/**
+ * Destructor for ClassArchive. Unmaps the archive; classes parsed out of it have their own copies of
+ * everything.
+ */
+ClassArchive::~ClassArchive() {
+	munmap(const_cast<uint8_t*>(mapping), mappingSize);
+}
+
+/**
+ * Decodes an entry of the index.
+ */
+ClassArchive::IndexEntry ClassArchive::getEntry(uint32_t i) const {
+	const uint8_t* p = index + static_cast<size_t>(i) * ENTRY_SIZE;
+	IndexEntry entry;
+	entry.nameOffset = readLittle32(p);
+	entry.nameLength = readLittle32(p + 4);
+	entry.dataOffset = readLittle64(p + 8);
+	entry.dataLength = readLittle32(p + 16);
+	entry.crc = readLittle32(p + 20);
+	return entry;
+}
+
+/**
+ * Gets the number of classes in the archive.
+ */
+uint32_t ClassArchive::size() const {
+	return count;
+}
+
+/**
+ * Gets the name of the i'th class, in sorted order.
+ */
+string ClassArchive::getName(uint32_t i) const {
+	IndexEntry entry = getEntry(i);
+	return string(reinterpret_cast<const char*>(mapping + entry.nameOffset), entry.nameLength);
+}
+
+/**
+ * Looks up a class by its internal name with a binary search over the index. If it's there, points data at
+ * its bytes in the mapping, which stay valid as long as the archive does.
+ */
+bool ClassArchive::find(const string& name, const char*& data, size_t& size) const {
+	uint32_t low = 0;
+	uint32_t high = count;
+	while(low < high) {
+		uint32_t middle = low + (high - low) / 2;
+		IndexEntry entry = getEntry(middle);
+		size_t common = std::min<size_t>(entry.nameLength, name.size());
+		int comparison = memcmp(mapping + entry.nameOffset, name.data(), common);
+		if(comparison == 0) {
+			comparison = entry.nameLength < name.size() ? -1 : (entry.nameLength > name.size() ? 1 : 0);
+		}
+		if(comparison == 0) {
+			data = reinterpret_cast<const char*>(mapping + entry.dataOffset);
+			size = entry.dataLength;
+			return true;
+		} else if(comparison < 0) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	return false;
+}
+
+/**
+ * Checks every class against the CRC it was archived with. Loading doesn't, since it would touch every page
+ * of the archive up front; this is for checking an archive after it's been copied around.
+ */
+bool ClassArchive::verify(string& error) const {
+	for(uint32_t i = 0; i < count; i++) {
+		IndexEntry entry = getEntry(i);
+		if(crc32(crc32(0, Z_NULL, 0), mapping + entry.dataOffset, entry.dataLength) != entry.crc) {
+			error = path + ": " + getName(i) + " fails its CRC check";
+			return false;
+		}
+		if(i > 0 && !(getName(i - 1) < getName(i))) {
+			error = path + ": the index isn't sorted at " + getName(i);
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Gets the names of the classes in the order they were given when the archive was written.
+ */
+vector<string> ClassArchive::getLoadOrder() const {
+	vector<string> names;
+	names.reserve(count);
+	for(uint32_t i = 0; i < count; i++) {
+		names.push_back(getName(readLittle32(order + static_cast<size_t>(i) * 4)));
+	}
+	return names;
+}
+
+/**
+ * Gets the name of the main class the archive was written with, or an empty string if there isn't one.
+ */
+const string& ClassArchive::getMainClass() const {
+	return mainClass;
+}
+
+/**
+ * Writes an archive of the given classes, keyed by internal name, remembering the order they're given in and
+ * the main class. The archive is written next to its final path, then renamed over it, so processes that already
+ * have the old one mapped keep a consistent view, and new ones never see a partial archive.
+ */
+void ClassArchive::write(const string& path, const vector<pair<string, string> >& classes, const string& mainClass) {
+	vector<uint32_t> sorted(classes.size());
+	for(uint32_t i = 0; i < sorted.size(); i++) {
+		sorted[i] = i;
+	}
+	std::sort(sorted.begin(), sorted.end(), ByName(classes));
+	vector<uint32_t> positions(classes.size());
+	for(uint32_t i = 0; i < sorted.size(); i++) {
+		positions[sorted[i]] = i;
+		if(i > 0 && classes[sorted[i - 1]].first == classes[sorted[i]].first) {
+			throw runtime_error("Class " + classes[sorted[i]].first + " is in the archive twice");
+		}
+	}
+
+	string names;
+	for(vector<uint32_t>::iterator it = sorted.begin(); it != sorted.end(); it++) {
+		names += classes[*it].first;
+	}
+	size_t namesStart = HEADER_SIZE + (ENTRY_SIZE + 4) * classes.size();
+	size_t mainOffset = namesStart + names.size();
+	names += mainClass;
+	size_t dataStart = namesStart + names.size();
+	dataStart += (ALIGNMENT - dataStart % ALIGNMENT) % ALIGNMENT;
+
+	string header(MAGIC, sizeof(MAGIC));
+	string index;
+	string data;
+	size_t nameOffset = namesStart;
+	for(vector<uint32_t>::iterator it = sorted.begin(); it != sorted.end(); it++) {
+		const pair<string, string>& entry = classes[*it];
+		if(entry.second.size() > 0xffffffffU || dataStart + data.size() > 0xffffffffffffULL) {
+			throw runtime_error("Class " + entry.first + " is too big to archive");
+		}
+		writeLittle32(index, nameOffset);
+		writeLittle32(index, entry.first.size());
+		writeLittle64(index, dataStart + data.size());
+		writeLittle32(index, entry.second.size());
+		writeLittle32(index, crc32(crc32(0, Z_NULL, 0), reinterpret_cast<const Bytef*>(entry.second.data()), entry.second.size()));
+		nameOffset += entry.first.size();
+		data += entry.second;
+		align(data);
+	}
+	for(vector<uint32_t>::iterator it = positions.begin(); it != positions.end(); it++) {
+		writeLittle32(index, *it);
+	}
+	writeLittle32(header, VERSION);
+	writeLittle32(header, classes.size());
+	writeLittle64(header, dataStart + data.size());
+	writeLittle32(header, mainOffset);
+	writeLittle32(header, mainClass.size());
+
+	string temporary = createTemporaryFile(path);
+	{
+		ofstream out(temporary.c_str(), std::ios::binary | std::ios::trunc);
+		out << header << index << names;
+		out << string(dataStart - namesStart - names.size(), '\0');
+		out << data;
+		out.close();
+		if(!out) {
+			remove(temporary.c_str());
+			throw runtime_error("Could not write class archive " + temporary);
+		}
+	}
+	if(rename(temporary.c_str(), path.c_str()) != 0) {
+		remove(temporary.c_str());
+		throw runtime_error("Could not move class archive " + temporary + " to " + path);
+	}
+}
@@ -1,7 +1,10 @@
 #include "ClassFile.h"
 #include "Constants.h"
+#include "Descriptor.h"
+#include "LoadStatistics.h"
 #include "Util.h"
 #include <iostream>
+#include <set>
 #include <stdexcept>
 
 using std::istream;
@@ -56,18 +59,16 @@ ClassFile::ClassFile(VirtualMachine& vm,istream& file) try :
 	if(magic != 0xCAFEBABE) {
 		throw "not a class file!";
 	}
-	if(!constantPool.validate()) {
+	bool valid;
+	{
+		PhaseTimer timer(PHASE_VALIDATE);
+		valid = constantPool.validate();
+	}
+	if(!valid) {
 		throw runtime_error("Constant Pool did not validate.");
 	}
 	
-	
-	//find <init> and <clinit>
-	for(u2 i = 0;i < methods.numMembers(); i++) {
-		//TODO: valgrind complains when this isn't string(...)
-		if(string(methods[i].getName()) == "<clinit>") {
-			clinit = &(methods[i]);
-		}
-	}
+	clinit = methods.find("<clinit>", "()V");
 } catch(...) {
 	throw;
 }
@@ -99,22 +100,16 @@ vector<uint16_t> ClassFile::buildInterfaces(istream& in) {
  * TODO: Make this run the <cl_init> method.
  */
 void ClassFile::initialize() {
-	for(u2 i=1;i<constantPool.getNumElements();i++) {
-		Constant& c = constantPool[i];
-		if(&c != NULL && constantPool.isType<ConstantClassInfo>(i)) {
-			ustring name = constantPool.get<ConstantClassInfo>(i).getClassName();
-			if(name[0] == '[') {
-				while(name[0] == '[') {
-					name = name.substr(1);
-				}
-				// If we found a [, it means that there is an extra L before the class name.
-				name = name.substr(1); 
-				// There is also a semicolon after the class name in this case.
-				name = name.substr(0, name.size() - 1);
-			}
-			//TODO: when i leave this as name != "", i get valgrind errors all over the place. I don't know if this is glib or if it's me.
-			if(string(name) != "") {
-				vm.getClass(name);
+	PhaseTimer timer(PHASE_INITIALIZE);
+	vector<string> references = getReferencedClasses();
+	for(vector<string>::iterator it = references.begin(); it != references.end(); it++) {
+		vm.getClass(*it);
+	}
+	for(u2 i=1;i<=constantPool.getNumElements();i++) {
+		if(constantPool.isType<ConstantClassInfo>(i)) {
+			const FieldType& type = constantPool.get<ConstantClassInfo>(i).getClassType();
+			if(type.getKind() == FieldType::ARRAY) {
+				vm.getArrayClass(type);
 			}
 		}
 	}
@@ -123,6 +118,74 @@ void ClassFile::initialize() {
 	}
 }
 
+/**
+ * Gets the name of every class this one refers to, once each, in the order the constant pool first names
+ * them: its superclass and interfaces, the owners of the fields and methods it refers to, and any other
+ * class it names. Arrays are reduced to the class of their elements, and arrays of primitives are left out.
+ */
+vector<string> ClassFile::getReferencedClasses() const {
+	vector<string> references;
+	std::set<string> seen;
+	for(u2 i=1;i<=constantPool.getNumElements();i++) {
+		const ConstantClassInfo* info = NULL;
+		if(constantPool.isType<ConstantClassInfo>(i)) {
+			info = &constantPool.get<ConstantClassInfo>(i);
+		} else if(constantPool.isType<ConstantMemberReference>(i)) {
+			info = &constantPool.get<ConstantMemberReference>(i).getClass();
+		} else {
+			continue;
+		}
+		const string& name = info->getClassType().getClassName();
+		if(name != "" && seen.insert(name).second) {
+			references.push_back(name);
+		}
+	}
+	return references;
+}
+
+/**
+ * Gets the index of the ConstantClassInfo naming this class.
+ */
+uint16_t ClassFile::getThisClassIndex() const {
+	return this_class;
+}
+
+/**
+ * Gets the index of the ConstantClassInfo naming the superclass, which is 0 for java/lang/Object.
+ */
+uint16_t ClassFile::getSuperClassIndex() const {
+	return super_class;
+}
+
+/**
+ * Gets the indexes of the ConstantClassInfos naming the interfaces this class implements directly.
+ */
+const vector<uint16_t>& ClassFile::getInterfaces() const {
+	return interfaces;
+}
+
+/**
+ * Gets the internal name of the superclass, or an empty string for java/lang/Object, which has none.
+ */
+string ClassFile::getSuperClassName() const {
+	if(super_class == 0) {
+		return string();
+	}
+	return constantPool.get<ConstantClassInfo>(super_class).getClassName();
+}
+
+/**
+ * Gets the internal names of the interfaces this class implements directly, in the order it declares them.
+ */
+vector<string> ClassFile::getInterfaceNames() const {
+	vector<string> names;
+	names.reserve(interfaces.size());
+	for(vector<uint16_t>::const_iterator it = interfaces.begin(); it != interfaces.end(); it++) {
+		names.push_back(constantPool.get<ConstantClassInfo>(*it).getClassName());
+	}
+	return names;
+}
+
 /**
  * Gets the magic constant associated with this class file. If it's not 0xCAFEBABE, something has gone wrong.
  */
@@ -130,6 +193,13 @@ uint32_t ClassFile::getMagic() const {
 	return magic;
 }
 
+/**
+ * Gets the internal name of this class, like java/lang/Object.
+ */
+const ustring& ClassFile::getName() const {
+	return constantPool.get<ConstantClassInfo>(this_class).getClassName();
+}
+
 /**
  * Returns the minor version of the java class file. Depends on the compiler that generated it.
  */
@@ -183,7 +253,7 @@ ClassMemberPool& ClassFile::getFields() {
  * Returns the const pool of fields in this class file.
  */
 const ClassMemberPool& ClassFile::getFields() const {
-	return methods;
+	return fields;
 }
 
 /**
@@ -214,3 +284,11 @@ const AttributePool& ClassFile::getAttributes() const {
 	return attributePool;
 }
 
+
+
+/**
+ * Returns the header holding this class's monitor, which is what static synchronized methods lock.
+ */
+ObjectHeader& ClassFile::getHeader() {
+	return header;
+}
\ No newline at end of file
@@ -0,0 +1,408 @@
+#include "ClassHierarchy.h"
+#include "ClassFile.h"
+#include "VirtualMachine.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using std::string;
+using std::vector;
+using std::pair;
+using std::runtime_error;
+
+const uint32_t ClassHierarchy::NONE;
+
+namespace {
+	enum VisitState {
+		UNVISITED,
+		VISITING,
+		VISITED
+	};
+
+	/**
+	 * Turns a list of edges into an adjacency array: a start offset for each of count nodes, plus one at the end,
+	 * and the targets of each node's edges, in the order they were given.
+	 */
+	void buildAdjacency(const vector<pair<uint32_t, uint32_t> >& edges, uint32_t count, vector<uint32_t>& starts, vector<uint32_t>& targets) {
+		starts.assign(count + 1, 0);
+		for(vector<pair<uint32_t, uint32_t> >::const_iterator it = edges.begin(); it != edges.end(); it++) {
+			starts[it->first + 1]++;
+		}
+		for(uint32_t i = 0; i < count; i++) {
+			starts[i + 1] += starts[i];
+		}
+		targets.resize(edges.size());
+		vector<uint32_t> next(starts.begin(), starts.end() - 1);
+		for(vector<pair<uint32_t, uint32_t> >::const_iterator it = edges.begin(); it != edges.end(); it++) {
+			targets[next[it->first]++] = it->second;
+		}
+	}
+
+	/**
+	 * Gets the package part of an internal class name, which is empty for the default package.
+	 */
+	string getPackage(const string& name) {
+		size_t slash = name.rfind('/');
+		return slash == string::npos ? string() : name.substr(0, slash);
+	}
+}
+
+/**
+ * Builds the hierarchy of every class a virtual machine has loaded so far.
+ */
+ClassHierarchy::ClassHierarchy(VirtualMachine& vm) {
+	vector<string> loaded = vm.getLoadedClasses();
+	vector<const ClassFile*> classes;
+	classes.reserve(loaded.size());
+	for(vector<string>::iterator it = loaded.begin(); it != loaded.end(); it++) {
+		classes.push_back(&vm.getClass(*it));
+	}
+	build(classes);
+}
+
+/**
+ * Builds the hierarchy of a list of classes, which don't have to belong to a virtual machine that loaded them.
+ * If two classes have the same name, the first one is used.
+ */
+ClassHierarchy::ClassHierarchy(const vector<const ClassFile*>& classes) {
+	build(classes);
+}
+
+/**
+ * Destructor for ClassHierarchy. The class files belong to whoever it was built from.
+ */
+ClassHierarchy::~ClassHierarchy() {
+
+}
+
+/**
+ * Gets the id of a class, giving it the next one if it hasn't got one yet.
+ */
+uint32_t ClassHierarchy::addClass(const string& name) {
+	std::pair<std::unordered_map<string, uint32_t>::iterator, bool> inserted = ids.insert(std::make_pair(name, names.size()));
+	if(inserted.second) {
+		names.push_back(name);
+		classFiles.push_back(NULL);
+		interfaces.push_back(false);
+		superclasses.push_back(NONE);
+	}
+	return inserted.first->second;
+}
+
+/**
+ * Gives every class and every class they name as a supertype an id, then builds the adjacency arrays, numbers
+ * the superclass tree, and finds every interface of every class. Throws if a class is its own supertype.
+ */
+void ClassHierarchy::build(const vector<const ClassFile*>& classes) {
+	vector<uint32_t> loaded;
+	loaded.reserve(classes.size());
+	for(vector<const ClassFile*>::const_iterator it = classes.begin(); it != classes.end(); it++) {
+		uint32_t id = addClass((*it)->getName());
+		if(!classFiles[id]) {
+			classFiles[id] = *it;
+			interfaces[id] = (*it)->getAccessFlags().isInterface();
+			loaded.push_back(id);
+		}
+	}
+
+	// Everything named as an interface is one, even if it wasn't loaded.
+	vector<pair<uint32_t, uint32_t> > interfaceEdges;
+	for(vector<uint32_t>::iterator it = loaded.begin(); it != loaded.end(); it++) {
+		string superName = classFiles[*it]->getSuperClassName();
+		if(!superName.empty()) {
+			uint32_t superclass = addClass(superName);
+			superclasses[*it] = superclass;
+		}
+		vector<string> interfaceNames = classFiles[*it]->getInterfaceNames();
+		for(vector<string>::iterator name = interfaceNames.begin(); name != interfaceNames.end(); name++) {
+			uint32_t interface = addClass(*name);
+			interfaces[interface] = true;
+			interfaceEdges.push_back(std::make_pair(*it, interface));
+		}
+	}
+
+	uint32_t count = names.size();
+	vector<pair<uint32_t, uint32_t> > edges;
+	for(uint32_t i = 0; i < count; i++) {
+		if(superclasses[i] != NONE) {
+			edges.push_back(std::make_pair(superclasses[i], i));
+		}
+	}
+	buildAdjacency(edges, count, subclassStarts, subclasses);
+	buildAdjacency(interfaceEdges, count, directInterfaceStarts, directInterfaces);
+	for(vector<pair<uint32_t, uint32_t> >::iterator it = interfaceEdges.begin(); it != interfaceEdges.end(); it++) {
+		std::swap(it->first, it->second);
+	}
+	buildAdjacency(interfaceEdges, count, directImplementorStarts, directImplementors);
+
+	numberTree();
+
+	// Superclasses come before their subclasses in pre-order, so only chains of superinterfaces recurse.
+	vector<vector<uint32_t> > closures(count);
+	vector<uint8_t> states(count, UNVISITED);
+	for(vector<uint32_t>::iterator it = order.begin(); it != order.end(); it++) {
+		findInterfaces(*it, closures, states);
+	}
+	edges.clear();
+	for(vector<uint32_t>::iterator it = order.begin(); it != order.end(); it++) {
+		for(vector<uint32_t>::iterator interface = closures[*it].begin(); interface != closures[*it].end(); interface++) {
+			edges.push_back(std::make_pair(*it, *interface));
+		}
+	}
+	buildAdjacency(edges, count, interfaceStarts, allInterfaces);
+	for(vector<pair<uint32_t, uint32_t> >::iterator it = edges.begin(); it != edges.end(); it++) {
+		std::swap(it->first, it->second);
+	}
+	buildAdjacency(edges, count, implementorStarts, implementors);
+}
+
+/**
+ * Numbers the superclass tree in pre-order, without recursing, so the subclasses of a class are the ones
+ * numbered after it and before the end of its interval. A class that's never reached from a root is part of a
+ * cycle.
+ */
+void ClassHierarchy::numberTree() {
+	uint32_t count = names.size();
+	preorder.assign(count, NONE);
+	intervalEnds.assign(count, NONE);
+	order.clear();
+	order.reserve(count);
+	vector<pair<uint32_t, uint32_t> > stack;
+	for(uint32_t root = 0; root < count; root++) {
+		if(superclasses[root] != NONE) {
+			continue;
+		}
+		preorder[root] = order.size();
+		order.push_back(root);
+		stack.push_back(std::make_pair(root, subclassStarts[root]));
+		while(!stack.empty()) {
+			pair<uint32_t, uint32_t>& top = stack.back();
+			if(top.second == subclassStarts[top.first + 1]) {
+				intervalEnds[top.first] = order.size();
+				stack.pop_back();
+				continue;
+			}
+			uint32_t child = subclasses[top.second++];
+			preorder[child] = order.size();
+			order.push_back(child);
+			stack.push_back(std::make_pair(child, subclassStarts[child]));
+		}
+	}
+	for(uint32_t i = 0; i < count; i++) {
+		if(preorder[i] == NONE) {
+			throw runtime_error("The superclasses of " + names[i] + " are circular");
+		}
+	}
+}
+
+/**
+ * Finds every interface a class implements, directly or not: those of its superclass, the ones it names, and
+ * theirs, as a sorted list of ids.
+ */
+void ClassHierarchy::findInterfaces(uint32_t id, vector<vector<uint32_t> >& closures, vector<uint8_t>& states) const {
+	if(states[id] == VISITED) {
+		return;
+	} else if(states[id] == VISITING) {
+		throw runtime_error("The superinterfaces of " + names[id] + " are circular");
+	}
+	states[id] = VISITING;
+	vector<uint32_t> closure;
+	if(superclasses[id] != NONE) {
+		findInterfaces(superclasses[id], closures, states);
+		closure = closures[superclasses[id]];
+	}
+	for(uint32_t i = directInterfaceStarts[id]; i < directInterfaceStarts[id + 1]; i++) {
+		uint32_t interface = directInterfaces[i];
+		findInterfaces(interface, closures, states);
+		closure.push_back(interface);
+		closure.insert(closure.end(), closures[interface].begin(), closures[interface].end());
+	}
+	std::sort(closure.begin(), closure.end());
+	closure.erase(std::unique(closure.begin(), closure.end()), closure.end());
+	closures[id].swap(closure);
+	states[id] = VISITED;
+}
+
+/**
+ * Gets the names of the classes in one class's part of an adjacency array.
+ */
+vector<string> ClassHierarchy::getNames(const vector<uint32_t>& starts, const vector<uint32_t>& lists, uint32_t id) const {
+	vector<string> result;
+	if(id != NONE) {
+		for(uint32_t i = starts[id]; i < starts[id + 1]; i++) {
+			result.push_back(names[lists[i]]);
+		}
+	}
+	return result;
+}
+
+/**
+ * Gets the number of classes in the hierarchy, including those that are only named as supertypes.
+ */
+uint32_t ClassHierarchy::numClasses() const {
+	return names.size();
+}
+
+/**
+ * Gets the id of a class, or NONE if it isn't in the hierarchy.
+ */
+uint32_t ClassHierarchy::getId(const string& name) const {
+	std::unordered_map<string, uint32_t>::const_iterator it = ids.find(name);
+	return it == ids.end() ? NONE : it->second;
+}
+
+/**
+ * Gets the name of a class by its id.
+ */
+const string& ClassHierarchy::getName(uint32_t id) const {
+	return names[id];
+}
+
+/**
+ * Gets the class file of a class by its id, or NULL if it's only named as a supertype.
+ */
+const ClassFile* ClassHierarchy::getClassFile(uint32_t id) const {
+	return classFiles[id];
+}
+
+/**
+ * Returns whether a class is an interface, or was named as one.
+ */
+bool ClassHierarchy::isInterface(uint32_t id) const {
+	return interfaces[id];
+}
+
+/**
+ * Gets the id of a class's superclass, or NONE for java/lang/Object and classes that weren't loaded.
+ */
+uint32_t ClassHierarchy::getSuperclass(uint32_t id) const {
+	return superclasses[id];
+}
+
+/**
+ * Returns whether a class is another one or extends it, directly or not, by checking that it's numbered within
+ * the other's interval.
+ */
+bool ClassHierarchy::isSubclassOf(uint32_t id, uint32_t superclass) const {
+	return preorder[superclass] <= preorder[id] && preorder[id] < intervalEnds[superclass];
+}
+
+/**
+ * Returns whether a class can be assigned to a type, as checkcast and instanceof decide for classes: the type is
+ * the class, or a class it extends, or an interface it implements, directly or not.
+ */
+bool ClassHierarchy::isSubtypeOf(uint32_t id, uint32_t type) const {
+	if(!interfaces[type]) {
+		return isSubclassOf(id, type);
+	}
+	return id == type || std::binary_search(allInterfaces.begin() + interfaceStarts[id], allInterfaces.begin() + interfaceStarts[id + 1], type);
+}
+
+/**
+ * Returns whether a class is another one or extends it, by name. Classes that aren't in the hierarchy are
+ * neither.
+ */
+bool ClassHierarchy::isSubclassOf(const string& name, const string& superclass) const {
+	uint32_t id = getId(name);
+	uint32_t superclassId = getId(superclass);
+	return id != NONE && superclassId != NONE && isSubclassOf(id, superclassId);
+}
+
+/**
+ * Returns whether a class can be assigned to a type, by name.
+ */
+bool ClassHierarchy::isSubtypeOf(const string& name, const string& type) const {
+	uint32_t id = getId(name);
+	uint32_t typeId = getId(type);
+	return id != NONE && typeId != NONE && isSubtypeOf(id, typeId);
+}
+
+/**
+ * Gets the classes that extend a class directly, in the order they were loaded. For java/lang/Object, that
+ * includes every interface.
+ */
+vector<string> ClassHierarchy::getDirectSubclasses(const string& name) const {
+	return getNames(subclassStarts, subclasses, getId(name));
+}
+
+/**
+ * Gets every class that extends a class, directly or not, in pre-order. They're the classes in its interval,
+ * so nothing is searched.
+ */
+vector<string> ClassHierarchy::getSubclasses(const string& name) const {
+	vector<string> result;
+	uint32_t id = getId(name);
+	if(id != NONE) {
+		for(uint32_t i = preorder[id] + 1; i < intervalEnds[id]; i++) {
+			result.push_back(names[order[i]]);
+		}
+	}
+	return result;
+}
+
+/**
+ * Gets the classes that name an interface as one of theirs, and the interfaces that extend it directly.
+ */
+vector<string> ClassHierarchy::getDirectImplementors(const string& name) const {
+	return getNames(directImplementorStarts, directImplementors, getId(name));
+}
+
+/**
+ * Gets every class that implements an interface, directly or not, including through its superclass, and every
+ * interface that extends it, in pre-order.
+ */
+vector<string> ClassHierarchy::getImplementors(const string& name) const {
+	return getNames(implementorStarts, implementors, getId(name));
+}
+
+/**
+ * Gets the classes that override a method: the subtypes of its class that declare an instance method with the
+ * same name and descriptor. Constructors, static methods and private methods can't be overridden. A package
+ * private method can only be overridden from the same package, or by overriding a method that overrides it, in a
+ * class in between, that the overrider can see (JVMS 5.4.5). Classes that weren't loaded are left out.
+ */
+vector<string> ClassHierarchy::getOverriders(const string& className, const string& name, const string& descriptor) const {
+	vector<string> result;
+	uint32_t id = getId(className);
+	if(id == NONE || !classFiles[id]) {
+		return result;
+	}
+	const ClassMember* method = classFiles[id]->getMethods().find(name, descriptor);
+	if(!method || method->getAccessFlags().isStatic() || method->getAccessFlags().isPrivate() || name[0] == '<') {
+		return result;
+	}
+	bool packagePrivate = !interfaces[id] && !method->getAccessFlags().isPublic() && !method->getAccessFlags().isProtected();
+	string package = getPackage(className);
+
+	vector<uint32_t> candidates;
+	if(interfaces[id]) {
+		candidates.assign(implementors.begin() + implementorStarts[id], implementors.begin() + implementorStarts[id + 1]);
+	} else {
+		candidates.assign(order.begin() + preorder[id] + 1, order.begin() + intervalEnds[id]);
+	}
+	// The subclasses are in pre-order, so whether a class overrides the method is known before its subclasses
+	// look for a superclass they override it through.
+	vector<bool> overriding(names.size(), false);
+	for(vector<uint32_t>::iterator it = candidates.begin(); it != candidates.end(); it++) {
+		if(!classFiles[*it]) {
+			continue;
+		}
+		const ClassMember* overrider = classFiles[*it]->getMethods().find(name, descriptor);
+		if(!overrider || overrider->getAccessFlags().isStatic() || overrider->getAccessFlags().isPrivate()) {
+			continue;
+		}
+		string overriderPackage = getPackage(names[*it]);
+		bool overrides = !packagePrivate || overriderPackage == package;
+		for(uint32_t superclass = superclasses[*it]; !overrides && superclass != id; superclass = superclasses[superclass]) {
+			if(overriding[superclass]) {
+				const AccessFlags& flags = classFiles[superclass]->getMethods().find(name, descriptor)->getAccessFlags();
+				overrides = flags.isPublic() || flags.isProtected() || getPackage(names[superclass]) == overriderPackage;
+			}
+		}
+		if(overrides) {
+			overriding[*it] = true;
+			result.push_back(names[*it]);
+		}
+	}
+	return result;
+}
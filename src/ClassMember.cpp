@@ -1,10 +1,13 @@
 #include "ClassMember.h"
+#include "LoadStatistics.h"
 
 #include <stdexcept>
 #include "ClassFile.h"
 #include "Util.h"
+#include "Descriptor.h"
 
 using std::istream;
+using std::string;
 using std::runtime_error;
 using Glib::ustring;
 
@@ -185,7 +188,9 @@ ClassMember::ClassMember(ClassFile& cf,std::istream& in) try :
 	accessFlags(in),
 	nameIndex(readShortUnsigned(in)),
 	descriptorIndex(readShortUnsigned(in)),
-	attributes(cf, in) {
+	attributes(cf, in),
+	fieldType(NULL),
+	methodType(NULL) {
 	
 } catch(...) {
 	throw;
@@ -241,20 +246,46 @@ const ustring& ClassMember::getDescriptor() const {
 	return cf.getConstantPool().get<const ConstantUtf8&>(descriptorIndex).getStringValue();
 }
 
+/**
+ * Gets the parsed type of this field. It's looked up once, and remembered.
+ */
+const FieldType& ClassMember::getFieldType() const {
+	const FieldType* type = fieldType.load(std::memory_order_acquire);
+	if(!type) {
+		type = &FieldType::get(getDescriptor());
+		fieldType.store(type, std::memory_order_release);
+	}
+	return *type;
+}
+
+/**
+ * Gets the parsed type of this method. It's looked up once, and remembered.
+ */
+const MethodType& ClassMember::getMethodType() const {
+	const MethodType* type = methodType.load(std::memory_order_acquire);
+	if(!type) {
+		type = &MethodType::get(getDescriptor());
+		methodType.store(type, std::memory_order_release);
+	}
+	return *type;
+}
+
 /**
  * Constructor for the ClassMemberPool that takes in the associated ClassFile, and an input stream to
  * read the data from. It finds out from the input stream how many members there are, and reads them
  * all in.
  */
 ClassMemberPool::ClassMemberPool(ClassFile& cf, istream& in) try : cf(cf), members(readShortUnsigned(in)) {
+	PhaseTimer timer(PHASE_MEMBERS, in);
 	uint16_t i;
 	try {
 		for(i = 0; i < members.size(); i++) {
 			members[i] = new ClassMember(cf, in);
 		}
+		buildTable();
 	} catch(...) {
 		for(uint16_t j = 0; j < i; j++) {
-			delete members[i];
+			delete members[j];
 		}
 		throw;
 	}
@@ -298,6 +329,70 @@ const ClassMember& ClassMemberPool::operator[](uint16_t index) const {
 	return *(members[index]);
 }
 
+/**
+ * Hashes a name and descriptor together with FNV-1a. The descriptor can't start with the separator, so no two
+ * pairs hash the same bytes.
+ */
+uint32_t ClassMemberPool::hash(const string& name, const string& descriptor) {
+	uint32_t h = 2166136261U;
+	for(string::const_iterator it = name.begin(); it != name.end(); it++) {
+		h = (h ^ static_cast<uint8_t>(*it)) * 16777619U;
+	}
+	h = (h ^ 0) * 16777619U;
+	for(string::const_iterator it = descriptor.begin(); it != descriptor.end(); it++) {
+		h = (h ^ static_cast<uint8_t>(*it)) * 16777619U;
+	}
+	return h;
+}
 
+/**
+ * Builds the hash table, with a power of two number of slots at most half full, probed linearly. If two members
+ * have the same name and descriptor, which a valid class file never has, the first one is found.
+ */
+void ClassMemberPool::buildTable() {
+	size_t size = 4;
+	while(size < 2 * members.size()) {
+		size *= 2;
+	}
+	Slot empty = { 0, 0, NULL, NULL };
+	table.assign(size, empty);
+	for(uint16_t i = 0; i < members.size(); i++) {
+		const string& name = members[i]->getName().raw();
+		const string& descriptor = members[i]->getDescriptor().raw();
+		uint32_t h = hash(name, descriptor);
+		size_t slot = h & (size - 1);
+		while(table[slot].member != 0) {
+			if(table[slot].hash == h && *table[slot].name == name && *table[slot].descriptor == descriptor) {
+				break;
+			}
+			slot = (slot + 1) & (size - 1);
+		}
+		if(table[slot].member == 0) {
+			table[slot].hash = h;
+			table[slot].member = i + 1;
+			table[slot].name = &name;
+			table[slot].descriptor = &descriptor;
+		}
+	}
+}
 
+/**
+ * Finds the member with a name and descriptor, like <init> and ()V, or returns NULL if there isn't one.
+ */
+ClassMember* ClassMemberPool::find(const string& name, const string& descriptor) {
+	return const_cast<ClassMember*>(static_cast<const ClassMemberPool*>(this)->find(name, descriptor));
+}
 
+/**
+ * Finds the const member with a name and descriptor, or returns NULL if there isn't one.
+ */
+const ClassMember* ClassMemberPool::find(const string& name, const string& descriptor) const {
+	uint32_t h = hash(name, descriptor);
+	size_t mask = table.size() - 1;
+	for(size_t slot = h & mask; table[slot].member != 0; slot = (slot + 1) & mask) {
+		if(table[slot].hash == h && *table[slot].name == name && *table[slot].descriptor == descriptor) {
+			return members[table[slot].member - 1];
+		}
+	}
+	return NULL;
+}
@@ -0,0 +1,69 @@
+#include "ClassPass.h"
+#include "AttributePool.h"
+#include <stdexcept>
+
+using std::string;
+using std::vector;
+using std::runtime_error;
+
+namespace {
+	/**
+	 * Leaves out what's only there for debuggers and stack traces: line numbers, local variable names and
+	 * types, and the source file. None of it changes what the class does.
+	 */
+	class StripDebugPass : public ClassPass {
+	public:
+		const char* getName() const;
+		bool keepAttribute(const Attribute& attribute) const;
+	};
+
+	const char* StripDebugPass::getName() const {
+		return "strip-debug";
+	}
+
+	bool StripDebugPass::keepAttribute(const Attribute& attribute) const {
+		const string& name = attribute.getName().raw();
+		return name != "LineNumberTable" && name != "LocalVariableTable" && name != "LocalVariableTypeTable"
+			&& name != "SourceFile" && name != "SourceDebugExtension";
+	}
+}
+
+/**
+ * Creates the pass with the given name.
+ */
+ClassPass* ClassPass::create(const string& name) {
+	if(name == "strip-debug") {
+		return new StripDebugPass();
+	}
+	throw runtime_error("Unknown pass: " + name);
+}
+
+/**
+ * Gets the names of every pass.
+ */
+vector<string> ClassPass::getPasses() {
+	vector<string> passes;
+	passes.push_back("strip-debug");
+	return passes;
+}
+
+/**
+ * Constructor for ClassPass.
+ */
+ClassPass::ClassPass() {
+
+}
+
+/**
+ * Destructor for ClassPass.
+ */
+ClassPass::~ClassPass() {
+
+}
+
+/**
+ * Keeps every attribute, unless a pass says otherwise.
+ */
+bool ClassPass::keepAttribute(const Attribute& attribute) const {
+	return true;
+}
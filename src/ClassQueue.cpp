@@ -0,0 +1,76 @@
+#include "ClassQueue.h"
+
+#include <stdexcept>
+
+using std::mutex;
+using std::unique_lock;
+using std::runtime_error;
+
+/**
+ * Constructor for ClassQueue. At most capacity buffers can be waiting at once; after that, push() blocks.
+ */
+ClassQueue::ClassQueue(size_t capacity) : slots(capacity > 0 ? capacity : 1), head(0), count(0), closed(false) {
+
+}
+
+/**
+ * Destructor for ClassQueue.
+ */
+ClassQueue::~ClassQueue() {
+
+}
+
+/**
+ * Adds a buffer to the queue, waiting for room if it's full. The buffer's contents are swapped into the
+ * queue, and it gets back some previously consumed buffer's memory in exchange.
+ */
+void ClassQueue::push(ClassBuffer& buffer) {
+	unique_lock<mutex> lock(queueMutex);
+	while(count == slots.size() && !closed) {
+		notFull.wait(lock);
+	}
+	if(closed) {
+		throw runtime_error("Pushing onto a closed ClassQueue");
+	}
+	ClassBuffer& slot = slots[(head + count) % slots.size()];
+	slot.sequence = buffer.sequence;
+	slot.jar.swap(buffer.jar);
+	slot.name.swap(buffer.name);
+	slot.data.swap(buffer.data);
+	count++;
+	notEmpty.notify_one();
+}
+
+/**
+ * Takes the oldest buffer off the queue, waiting for one if it's empty. The old contents of buffer are
+ * swapped into the queue for the producer to reuse. Returns false once the queue has been closed and
+ * everything in it has been taken.
+ */
+bool ClassQueue::pop(ClassBuffer& buffer) {
+	unique_lock<mutex> lock(queueMutex);
+	while(count == 0 && !closed) {
+		notEmpty.wait(lock);
+	}
+	if(count == 0) {
+		return false;
+	}
+	ClassBuffer& slot = slots[head];
+	buffer.sequence = slot.sequence;
+	buffer.jar.swap(slot.jar);
+	buffer.name.swap(slot.name);
+	buffer.data.swap(slot.data);
+	head = (head + 1) % slots.size();
+	count--;
+	notFull.notify_one();
+	return true;
+}
+
+/**
+ * Marks the end of the input. Consumers drain what's left, and then pop() returns false.
+ */
+void ClassQueue::close() {
+	unique_lock<mutex> lock(queueMutex);
+	closed = true;
+	notEmpty.notify_all();
+	notFull.notify_all();
+}
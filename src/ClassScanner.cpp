@@ -0,0 +1,458 @@
+#include "ClassScanner.h"
+#include "Bytecode.h"
+#include "Constants.h"
+#include "Util.h"
+
+#include <cstring>
+#include <stdexcept>
+
+using std::string;
+using std::runtime_error;
+
+/**
+ * Destructor for ClassVisitor.
+ */
+ClassVisitor::~ClassVisitor() {
+
+}
+
+/**
+ * Visits a CONSTANT_Utf8_info, with its bytes as they are in the class file.
+ */
+void ClassVisitor::visitUtf8(uint16_t index, const char* data, uint16_t length) {
+
+}
+
+/**
+ * Visits a CONSTANT_Integer_info.
+ */
+void ClassVisitor::visitInteger(uint16_t index, int32_t value) {
+
+}
+
+/**
+ * Visits a CONSTANT_Float_info.
+ */
+void ClassVisitor::visitFloat(uint16_t index, float value) {
+
+}
+
+/**
+ * Visits a CONSTANT_Long_info.
+ */
+void ClassVisitor::visitLong(uint16_t index, int64_t value) {
+
+}
+
+/**
+ * Visits a CONSTANT_Double_info.
+ */
+void ClassVisitor::visitDouble(uint16_t index, double value) {
+
+}
+
+/**
+ * Visits a CONSTANT_Class_info.
+ */
+void ClassVisitor::visitClassConstant(uint16_t index, uint16_t nameIndex) {
+
+}
+
+/**
+ * Visits a CONSTANT_String_info.
+ */
+void ClassVisitor::visitString(uint16_t index, uint16_t stringIndex) {
+
+}
+
+/**
+ * Visits a CONSTANT_Fieldref_info, CONSTANT_Methodref_info or CONSTANT_InterfaceMethodref_info, which the tag
+ * tells apart.
+ */
+void ClassVisitor::visitMemberReference(uint16_t index, uint8_t tag, uint16_t classIndex, uint16_t nameAndTypeIndex) {
+
+}
+
+/**
+ * Visits a CONSTANT_NameAndType_info.
+ */
+void ClassVisitor::visitNameAndType(uint16_t index, uint16_t nameIndex, uint16_t descriptorIndex) {
+
+}
+
+/**
+ * Visits a CONSTANT_MethodHandle_info.
+ */
+void ClassVisitor::visitMethodHandle(uint16_t index, uint8_t referenceKind, uint16_t referenceIndex) {
+
+}
+
+/**
+ * Visits a CONSTANT_MethodType_info.
+ */
+void ClassVisitor::visitMethodType(uint16_t index, uint16_t descriptorIndex) {
+
+}
+
+/**
+ * Visits a CONSTANT_InvokeDynamic_info.
+ */
+void ClassVisitor::visitInvokeDynamic(uint16_t index, uint16_t bootstrapMethodIndex, uint16_t nameAndTypeIndex) {
+
+}
+
+/**
+ * Visits the class itself, once every constant has been. superClass is 0 for java/lang/Object.
+ */
+void ClassVisitor::visitClass(const ClassScanner& scanner, uint16_t accessFlags, uint16_t thisClass, uint16_t superClass) {
+
+}
+
+/**
+ * Visits an interface the class implements.
+ */
+void ClassVisitor::visitInterface(uint16_t classIndex) {
+
+}
+
+/**
+ * Visits a field. Its attributes are visited next.
+ */
+void ClassVisitor::visitField(uint16_t accessFlags, uint16_t nameIndex, uint16_t descriptorIndex) {
+
+}
+
+/**
+ * Visits a method. Its attributes are visited next.
+ */
+void ClassVisitor::visitMethod(uint16_t accessFlags, uint16_t nameIndex, uint16_t descriptorIndex) {
+
+}
+
+/**
+ * Visits any attribute, including Code attributes, which are then visited again with visitCode.
+ */
+void ClassVisitor::visitAttribute(Owner owner, uint16_t nameIndex, const uint8_t* info, uint32_t length) {
+
+}
+
+/**
+ * Visits the code of a method. Returns whether to visit each of its instructions, which is the most expensive part
+ * of a scan, so it's false by default. The exception handlers and attributes of the code are visited either way.
+ */
+bool ClassVisitor::visitCode(uint16_t maxStack, uint16_t maxLocals, const uint8_t* code, uint32_t codeLength) {
+	return false;
+}
+
+/**
+ * Visits an instruction, given the code it's in, which its operands can be read from.
+ */
+void ClassVisitor::visitInstruction(const Instruction& instruction, const uint8_t* code) {
+
+}
+
+/**
+ * Visits an entry in the exception table of the code. catchType is 0 for handlers that catch everything.
+ */
+void ClassVisitor::visitExceptionHandler(uint16_t startPc, uint16_t endPc, uint16_t handlerPc, uint16_t catchType) {
+
+}
+
+/**
+ * Visits the end of the class.
+ */
+void ClassVisitor::visitEnd() {
+
+}
+
+/**
+ * Constructor for ClassScanner.
+ */
+ClassScanner::ClassScanner() : data(NULL), size(0), position(0), codeNameIndex(0) {
+
+}
+
+/**
+ * Destructor for ClassScanner.
+ */
+ClassScanner::~ClassScanner() {
+
+}
+
+/**
+ * Scans a class file, calling the visitor with each part of it. Throws if the bytes aren't a class file, or end
+ * too soon, which may be after some of it has been visited already.
+ */
+void ClassScanner::scan(const char* data, size_t size, ClassVisitor& visitor) {
+	this->data = reinterpret_cast<const uint8_t*>(data);
+	this->size = size;
+	position = 0;
+	codeNameIndex = 0;
+	constants.clear();
+
+	if(readInt() != 0xCAFEBABE) {
+		throw runtime_error("Not a class file: the magic number is wrong");
+	}
+	require(4, "version");
+	position += 4;
+	scanConstantPool(visitor);
+
+	uint16_t accessFlags = readShort();
+	uint16_t thisClass = readShort();
+	uint16_t superClass = readShort();
+	visitor.visitClass(*this, accessFlags, thisClass, superClass);
+	uint16_t interfaces = readShort();
+	for(uint16_t i = 0; i < interfaces; i++) {
+		visitor.visitInterface(readShort());
+	}
+	scanMembers(visitor, ClassVisitor::FIELD);
+	scanMembers(visitor, ClassVisitor::METHOD);
+	scanAttributes(visitor, ClassVisitor::CLASS);
+	visitor.visitEnd();
+}
+
+/**
+ * Throws if there aren't at least count bytes left to read.
+ */
+void ClassScanner::require(size_t count, const char* what) const {
+	if(size - position < count) {
+		throw runtime_error(string(what) + " runs past the end of the class file");
+	}
+}
+
+/**
+ * Reads a byte.
+ */
+uint8_t ClassScanner::readByte() {
+	require(1, "Class file");
+	return data[position++];
+}
+
+/**
+ * Reads a big-endian two byte number.
+ */
+uint16_t ClassScanner::readShort() {
+	require(2, "Class file");
+	uint16_t value = (static_cast<uint16_t>(data[position]) << 8) | data[position + 1];
+	position += 2;
+	return value;
+}
+
+/**
+ * Reads a big-endian four byte number.
+ */
+uint32_t ClassScanner::readInt() {
+	require(4, "Class file");
+	uint32_t value = (static_cast<uint32_t>(data[position]) << 24) | (static_cast<uint32_t>(data[position + 1]) << 16)
+		| (static_cast<uint32_t>(data[position + 2]) << 8) | data[position + 3];
+	position += 4;
+	return value;
+}
+
+/**
+ * Visits every constant, noting where each one starts. The Utf8 constant holding "Code" is noted too, so Code
+ * attributes can be told apart by index.
+ */
+void ClassScanner::scanConstantPool(ClassVisitor& visitor) {
+	uint16_t count = readShort();
+	constants.resize(count > 0 ? count : 1, 0);
+	for(uint16_t i = 1; i < count; i++) {
+		constants[i] = position;
+		uint8_t tag = readByte();
+		switch(tag) {
+			case CONSTANT_Utf8: {
+				uint16_t length = readShort();
+				require(length, "Utf8 constant");
+				const char* bytes = reinterpret_cast<const char*>(data + position);
+				if(length == 4 && std::memcmp(bytes, "Code", 4) == 0) {
+					codeNameIndex = i;
+				}
+				visitor.visitUtf8(i, bytes, length);
+				position += length;
+				break;
+			}
+			case CONSTANT_Integer:
+				visitor.visitInteger(i, static_cast<int32_t>(readInt()));
+				break;
+			case CONSTANT_Float: {
+				uint32_t bits = readInt();
+				float value;
+				std::memcpy(&value, &bits, sizeof(value));
+				visitor.visitFloat(i, value);
+				break;
+			}
+			case CONSTANT_Long:
+			case CONSTANT_Double: {
+				uint64_t bits = static_cast<uint64_t>(readInt()) << 32;
+				bits |= readInt();
+				if(tag == CONSTANT_Long) {
+					visitor.visitLong(i, static_cast<int64_t>(bits));
+				} else {
+					double value;
+					std::memcpy(&value, &bits, sizeof(value));
+					visitor.visitDouble(i, value);
+				}
+				// These take two indexes, and the second one has nothing in it.
+				i++;
+				break;
+			}
+			case CONSTANT_Class:
+				visitor.visitClassConstant(i, readShort());
+				break;
+			case CONSTANT_String:
+				visitor.visitString(i, readShort());
+				break;
+			case CONSTANT_Fieldref:
+			case CONSTANT_Methodref:
+			case CONSTANT_InterfaceMethodref: {
+				uint16_t classIndex = readShort();
+				visitor.visitMemberReference(i, tag, classIndex, readShort());
+				break;
+			}
+			case CONSTANT_NameAndType: {
+				uint16_t nameIndex = readShort();
+				visitor.visitNameAndType(i, nameIndex, readShort());
+				break;
+			}
+			case CONSTANT_MethodHandle: {
+				uint8_t kind = readByte();
+				visitor.visitMethodHandle(i, kind, readShort());
+				break;
+			}
+			case CONSTANT_MethodType:
+				visitor.visitMethodType(i, readShort());
+				break;
+			case CONSTANT_InvokeDynamic: {
+				uint16_t bootstrapMethodIndex = readShort();
+				visitor.visitInvokeDynamic(i, bootstrapMethodIndex, readShort());
+				break;
+			}
+			default:
+				throw runtime_error("Constant type not known: " + toString<int>(tag));
+		}
+	}
+}
+
+/**
+ * Visits the fields or the methods, and their attributes.
+ */
+void ClassScanner::scanMembers(ClassVisitor& visitor, ClassVisitor::Owner owner) {
+	uint16_t count = readShort();
+	for(uint16_t i = 0; i < count; i++) {
+		uint16_t accessFlags = readShort();
+		uint16_t nameIndex = readShort();
+		uint16_t descriptorIndex = readShort();
+		if(owner == ClassVisitor::FIELD) {
+			visitor.visitField(accessFlags, nameIndex, descriptorIndex);
+		} else {
+			visitor.visitMethod(accessFlags, nameIndex, descriptorIndex);
+		}
+		scanAttributes(visitor, owner);
+	}
+}
+
+/**
+ * Visits a count of attributes, and then each one. The Code attributes of methods are scanned into as well.
+ */
+void ClassScanner::scanAttributes(ClassVisitor& visitor, ClassVisitor::Owner owner) {
+	uint16_t count = readShort();
+	for(uint16_t i = 0; i < count; i++) {
+		uint16_t nameIndex = readShort();
+		uint32_t length = readInt();
+		require(length, "Attribute");
+		const uint8_t* info = data + position;
+		visitor.visitAttribute(owner, nameIndex, info, length);
+		if(owner == ClassVisitor::METHOD && nameIndex == codeNameIndex && codeNameIndex != 0) {
+			scanCode(visitor, length);
+		} else {
+			position += length;
+		}
+	}
+}
+
+/**
+ * Visits the contents of a Code attribute: the code, its instructions if the visitor wants them, the exception
+ * table and the attributes. Throws if they don't add up to the attribute's length.
+ */
+void ClassScanner::scanCode(ClassVisitor& visitor, uint32_t length) {
+	size_t start = position;
+	uint16_t maxStack = readShort();
+	uint16_t maxLocals = readShort();
+	uint32_t codeLength = readInt();
+	if(codeLength > 0xFFFF || length < 8 || codeLength > length - 8) {
+		throw runtime_error("Code length " + toString(codeLength) + " doesn't fit in its attribute");
+	}
+	require(codeLength, "Code");
+	const uint8_t* code = data + position;
+	position += codeLength;
+	if(visitor.visitCode(maxStack, maxLocals, code, codeLength)) {
+		Instruction instruction;
+		for(uint32_t pc = 0; pc < codeLength; pc += instruction.length) {
+			decodeInstruction(code, codeLength, pc, instruction);
+			visitor.visitInstruction(instruction, code);
+		}
+	}
+	uint16_t handlers = readShort();
+	for(uint16_t i = 0; i < handlers; i++) {
+		uint16_t startPc = readShort();
+		uint16_t endPc = readShort();
+		uint16_t handlerPc = readShort();
+		visitor.visitExceptionHandler(startPc, endPc, handlerPc, readShort());
+	}
+	scanAttributes(visitor, ClassVisitor::CODE);
+	if(position - start != length) {
+		throw runtime_error("Code attribute is " + toString(length) + " bytes, but its contents are " + toString(position - start));
+	}
+}
+
+/**
+ * Gets the number of constant pool indexes in the class being scanned, including the unused index 0, like the
+ * count in the class file.
+ */
+uint16_t ClassScanner::getNumConstants() const {
+	return constants.size();
+}
+
+/**
+ * Gets the tag of a constant, or 0 if there isn't a constant at that index.
+ */
+uint8_t ClassScanner::getTag(uint16_t index) const {
+	if(index >= constants.size() || constants[index] == 0) {
+		return 0;
+	}
+	return data[constants[index]];
+}
+
+/**
+ * Gets a constant's bytes in the class file, starting with its tag. Throws if there isn't a constant at that index.
+ */
+const uint8_t* ClassScanner::getConstant(uint16_t index) const {
+	if(getTag(index) == 0) {
+		throw runtime_error("Constant " + toString(index) + " is out of range [1, " + toString(constants.size()) + "].");
+	}
+	return data + constants[index];
+}
+
+/**
+ * Gets the bytes of a Utf8 constant, and its length. Throws if the constant isn't a Utf8 constant.
+ */
+const char* ClassScanner::getUtf8(uint16_t index, uint16_t& length) const {
+	const uint8_t* constant = getConstant(index);
+	if(constant[0] != CONSTANT_Utf8) {
+		throw runtime_error("Constant " + toString(index) + " is not a Utf8 constant");
+	}
+	length = (static_cast<uint16_t>(constant[1]) << 8) | constant[2];
+	return reinterpret_cast<const char*>(constant + 3);
+}
+
+/**
+ * Gets the name of the class a Class constant refers to, and its length. Throws if the constant isn't a Class
+ * constant.
+ */
+const char* ClassScanner::getClassName(uint16_t index, uint16_t& length) const {
+	const uint8_t* constant = getConstant(index);
+	if(constant[0] != CONSTANT_Class) {
+		throw runtime_error("Constant " + toString(index) + " is not a Class constant");
+	}
+	return getUtf8((static_cast<uint16_t>(constant[1]) << 8) | constant[2], length);
+}
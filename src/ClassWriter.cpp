@@ -0,0 +1,602 @@
+#include "ClassWriter.h"
+#include "ClassFile.h"
+#include "Constants.h"
+#include "ConstantReferences.h"
+#include "ModifiedUtf8.h"
+#include "Util.h"
+#include <cstring>
+#include <stdexcept>
+
+using std::string;
+using std::vector;
+using std::runtime_error;
+
+namespace {
+	/**
+	 * Reads a big-endian two byte index.
+	 */
+	uint16_t readIndex(const uint8_t* bytes) {
+		return (static_cast<uint16_t>(bytes[0]) << 8) | bytes[1];
+	}
+}
+
+/**
+ * Where the class is written. With a NULL base nothing is written, and only the size is counted, so the same
+ * code that writes a class also measures it.
+ */
+struct ClassWriter::Output {
+	char* base;
+	size_t size;
+
+	Output(char* base) : base(base), size(0) {}
+
+	void putByte(uint8_t value) {
+		if(base) {
+			base[size] = static_cast<char>(value);
+		}
+		size += 1;
+	}
+
+	void putShort(uint16_t value) {
+		if(base) {
+			base[size] = static_cast<char>(value >> 8);
+			base[size + 1] = static_cast<char>(value);
+		}
+		size += 2;
+	}
+
+	void putInt(uint32_t value) {
+		if(base) {
+			patchInt(size, value);
+		}
+		size += 4;
+	}
+
+	void putBytes(const void* data, size_t length) {
+		if(base) {
+			std::memcpy(base + size, data, length);
+		}
+		size += length;
+	}
+
+	void patchInt(size_t position, uint32_t value) {
+		if(base) {
+			base[position] = static_cast<char>(value >> 24);
+			base[position + 1] = static_cast<char>(value >> 16);
+			base[position + 2] = static_cast<char>(value >> 8);
+			base[position + 3] = static_cast<char>(value);
+		}
+	}
+};
+
+/**
+ * The constants that are referred to, while the constant pool is being compacted. Constants are marked once,
+ * and queued up so that the constants they refer to in turn can be marked after.
+ */
+struct ClassWriter::Marks {
+	vector<bool> slots;
+	vector<bool> used;
+	vector<uint16_t> pending;
+
+	Marks(const ConstantPool& pool) : slots(pool.getNumElements() + 1), used(pool.getNumElements() + 1) {
+		for(uint16_t i = 1; i <= pool.getNumElements(); i++) {
+			slots[i] = true;
+			if(pool[i].getType() == CONSTANT_Long || pool[i].getType() == CONSTANT_Double) {
+				i++;
+			}
+		}
+	}
+
+	/**
+	 * Marks a constant, which has to be there. Index 0 is where there's no constant, so it's left alone.
+	 */
+	void mark(uint16_t index) {
+		if(index == 0) {
+			return;
+		}
+		if(index >= slots.size() || !slots[index]) {
+			throw runtime_error("Constant pool index out of range: " + toString(index));
+		}
+		if(!used[index]) {
+			used[index] = true;
+			pending.push_back(index);
+		}
+	}
+
+	/**
+	 * Marks the constants at offsets into some bytes, found by findCodeReferences or findAttributeReferences.
+	 */
+	void mark(const uint8_t* bytes, const vector<uint32_t>& offsets, const vector<uint32_t>& byteOffsets) {
+		for(vector<uint32_t>::const_iterator it = offsets.begin(); it != offsets.end(); it++) {
+			mark(readIndex(bytes + *it));
+		}
+		for(vector<uint32_t>::const_iterator it = byteOffsets.begin(); it != byteOffsets.end(); it++) {
+			mark(bytes[*it]);
+		}
+	}
+};
+
+/**
+ * Constructor for ClassWriter. Takes in the class to write, and optionally the bytes it was parsed from, which
+ * have to stay valid as long as the writer is used.
+ */
+ClassWriter::ClassWriter(const ClassFile& classFile, const char* original, size_t originalSize) :
+	classFile(classFile),
+	original(original),
+	originalSize(originalSize),
+	originalConstantPoolSize(0),
+	numConstants(0) {
+
+	originalConstantPoolSize = getOriginalConstantPoolSize();
+}
+
+/**
+ * Destructor for ClassWriter. The class and its bytes belong to the caller, so there is nothing to delete.
+ */
+ClassWriter::~ClassWriter() {
+
+}
+
+/**
+ * Adds a filter that every attribute has to be kept by to be written. The filter isn't owned by the writer. Since
+ * the constants that are kept depend on the attributes that are, this undoes any compaction of the constant pool.
+ */
+void ClassWriter::addFilter(const AttributeFilter* filter) {
+	filters.push_back(filter);
+	constantMap.clear();
+}
+
+/**
+ * Leaves the constants nothing written refers to out of the constant pool, and renumbers the rest. Returns
+ * false, and keeps every constant, if the class has an attribute whose layout isn't known, or refers to
+ * constants that aren't there.
+ */
+bool ClassWriter::compactConstantPool() {
+	constantMap.clear();
+	const ConstantPool& pool = classFile.getConstantPool();
+	Marks marks(pool);
+	try {
+		marks.mark(classFile.getThisClassIndex());
+		marks.mark(classFile.getSuperClassIndex());
+		const vector<uint16_t>& interfaces = classFile.getInterfaces();
+		for(vector<uint16_t>::const_iterator it = interfaces.begin(); it != interfaces.end(); it++) {
+			marks.mark(*it);
+		}
+		markMembers(marks, classFile.getFields());
+		markMembers(marks, classFile.getMethods());
+		markAttributes(marks, classFile.getAttributes());
+
+		while(!marks.pending.empty()) {
+			const Constant& constant = pool[marks.pending.back()];
+			marks.pending.pop_back();
+			switch(constant.getType()) {
+				case CONSTANT_Class:
+					marks.mark(static_cast<const ConstantClassInfo&>(constant).getClassNameIndex());
+					break;
+				case CONSTANT_Fieldref:
+				case CONSTANT_Methodref:
+				case CONSTANT_InterfaceMethodref: {
+					const ConstantMemberReference& reference = static_cast<const ConstantMemberReference&>(constant);
+					marks.mark(reference.getClassIndex());
+					marks.mark(reference.getNameAndTypeIndex());
+					break;
+				}
+				case CONSTANT_String:
+					marks.mark(static_cast<const ConstantString&>(constant).getStringIndex());
+					break;
+				case CONSTANT_NameAndType: {
+					const ConstantNameAndType& nameAndType = static_cast<const ConstantNameAndType&>(constant);
+					marks.mark(nameAndType.getNameIndex());
+					marks.mark(nameAndType.getDescriptorIndex());
+					break;
+				}
+				case CONSTANT_MethodHandle:
+					marks.mark(static_cast<const ConstantMethodHandle&>(constant).getReferenceIndex());
+					break;
+				case CONSTANT_MethodType:
+					marks.mark(static_cast<const ConstantMethodType&>(constant).getDescriptorIndex());
+					break;
+				case CONSTANT_InvokeDynamic:
+					// The bootstrap method index is into the BootstrapMethods attribute, not the constant pool.
+					marks.mark(static_cast<const ConstantInvokeDynamic&>(constant).getNameAndTypeIndex());
+					break;
+			}
+		}
+	} catch(const std::exception&) {
+		return false;
+	}
+
+	// Kept constants stay in order, so every index only gets smaller, and ldc's one byte indexes still fit.
+	vector<uint16_t> map(marks.slots.size(), 0);
+	uint16_t next = 1;
+	for(uint16_t i = 1; i < marks.slots.size(); i++) {
+		if(marks.used[i]) {
+			map[i] = next;
+			bool wide = pool[i].getType() == CONSTANT_Long || pool[i].getType() == CONSTANT_Double;
+			next += wide ? 2 : 1;
+		}
+	}
+	if(next - 1 != pool.getNumElements()) {
+		constantMap.swap(map);
+		numConstants = next - 1;
+	}
+	return true;
+}
+
+/**
+ * Gets the number of bytes the class takes when it's written.
+ */
+size_t ClassWriter::getSize() const {
+	Output out(NULL);
+	writeClass(out);
+	return out.size;
+}
+
+/**
+ * Writes the class into a buffer, which has to have room for getSize bytes.
+ */
+void ClassWriter::write(char* buffer) const {
+	Output out(buffer);
+	writeClass(out);
+}
+
+/**
+ * Writes the class into a string of exactly the right size.
+ */
+string ClassWriter::write() const {
+	string bytes(getSize(), '\0');
+	if(!bytes.empty()) {
+		write(&bytes[0]);
+	}
+	return bytes;
+}
+
+/**
+ * Writes the whole class, in the same order ClassFile reads it.
+ */
+void ClassWriter::writeClass(Output& out) const {
+	out.putInt(classFile.getMagic());
+	out.putShort(classFile.getMinorVersion());
+	out.putShort(classFile.getMajorVersion());
+	writeConstantPool(out);
+	out.putShort(classFile.getAccessFlags().getValue());
+	out.putShort(mapConstant(classFile.getThisClassIndex()));
+	out.putShort(mapConstant(classFile.getSuperClassIndex()));
+	const vector<uint16_t>& interfaces = classFile.getInterfaces();
+	out.putShort(interfaces.size());
+	for(vector<uint16_t>::const_iterator it = interfaces.begin(); it != interfaces.end(); it++) {
+		out.putShort(mapConstant(*it));
+	}
+	writeMembers(out, classFile.getFields());
+	writeMembers(out, classFile.getMethods());
+	writeAttributes(out, classFile.getAttributes());
+}
+
+/**
+ * Writes the constant pool count and the constants. They're copied from the original bytes when there are
+ * some and the pool hasn't been compacted, and encoded one at a time otherwise.
+ */
+void ClassWriter::writeConstantPool(Output& out) const {
+	const ConstantPool& pool = classFile.getConstantPool();
+	out.putShort((constantMap.empty() ? pool.getNumElements() : numConstants) + 1);
+	if(originalConstantPoolSize && constantMap.empty()) {
+		// Past the magic, the version numbers and the count.
+		out.putBytes(original + 10, originalConstantPoolSize);
+		return;
+	}
+	for(uint16_t i = 1; i <= pool.getNumElements(); i++) {
+		const Constant& constant = pool[i];
+		if(constantMap.empty() || constantMap[i]) {
+			writeConstant(out, constant);
+		}
+		if(constant.getType() == CONSTANT_Long || constant.getType() == CONSTANT_Double) {
+			// These take two indexes, and the second one has nothing in it.
+			i++;
+		}
+	}
+}
+
+/**
+ * Writes a single cp_info structure.
+ */
+void ClassWriter::writeConstant(Output& out, const Constant& constant) const {
+	out.putByte(constant.getType());
+	switch(constant.getType()) {
+		case CONSTANT_Class:
+			out.putShort(mapConstant(static_cast<const ConstantClassInfo&>(constant).getClassNameIndex()));
+			break;
+		case CONSTANT_Fieldref:
+		case CONSTANT_Methodref:
+		case CONSTANT_InterfaceMethodref: {
+			const ConstantMemberReference& reference = static_cast<const ConstantMemberReference&>(constant);
+			out.putShort(mapConstant(reference.getClassIndex()));
+			out.putShort(mapConstant(reference.getNameAndTypeIndex()));
+			break;
+		}
+		case CONSTANT_String:
+			out.putShort(mapConstant(static_cast<const ConstantString&>(constant).getStringIndex()));
+			break;
+		case CONSTANT_Integer:
+			out.putInt(static_cast<const ConstantInteger&>(constant).getIntValue());
+			break;
+		case CONSTANT_Float: {
+			float value = static_cast<const ConstantFloat&>(constant).getFloatValue();
+			uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			out.putInt(bits);
+			break;
+		}
+		case CONSTANT_Long: {
+			const ConstantLong& value = static_cast<const ConstantLong&>(constant);
+			out.putInt(value.getHighBits());
+			out.putInt(value.getLowBits());
+			break;
+		}
+		case CONSTANT_Double: {
+			const ConstantDouble& value = static_cast<const ConstantDouble&>(constant);
+			out.putInt(value.getHighBits());
+			out.putInt(value.getLowBits());
+			break;
+		}
+		case CONSTANT_NameAndType: {
+			const ConstantNameAndType& nameAndType = static_cast<const ConstantNameAndType&>(constant);
+			out.putShort(mapConstant(nameAndType.getNameIndex()));
+			out.putShort(mapConstant(nameAndType.getDescriptorIndex()));
+			break;
+		}
+		case CONSTANT_Utf8: {
+			const string& value = static_cast<const ConstantUtf8&>(constant).getStringValue().raw();
+			size_t length = encodeModifiedUtf8(value.data(), value.size(), NULL);
+			if(length > 0xFFFF) {
+				throw runtime_error("Utf8 constant is too long to write: " + toString(length) + " bytes");
+			}
+			out.putShort(length);
+			if(out.base) {
+				encodeModifiedUtf8(value.data(), value.size(), out.base + out.size);
+			}
+			out.size += length;
+			break;
+		}
+		case CONSTANT_MethodHandle: {
+			const ConstantMethodHandle& handle = static_cast<const ConstantMethodHandle&>(constant);
+			out.putByte(handle.getReferenceKind());
+			out.putShort(mapConstant(handle.getReferenceIndex()));
+			break;
+		}
+		case CONSTANT_MethodType:
+			out.putShort(mapConstant(static_cast<const ConstantMethodType&>(constant).getDescriptorIndex()));
+			break;
+		case CONSTANT_InvokeDynamic: {
+			const ConstantInvokeDynamic& invoke = static_cast<const ConstantInvokeDynamic&>(constant);
+			out.putShort(invoke.getBootstrapMethodAttributeIndex());
+			out.putShort(mapConstant(invoke.getNameAndTypeIndex()));
+			break;
+		}
+		default:
+			throw runtime_error("Constant type not known: " + toString<int>(constant.getType()));
+	}
+}
+
+/**
+ * Writes the count of fields or methods, and then each one.
+ */
+void ClassWriter::writeMembers(Output& out, const ClassMemberPool& members) const {
+	out.putShort(members.numMembers());
+	for(uint16_t i = 0; i < members.numMembers(); i++) {
+		const ClassMember& member = members[i];
+		out.putShort(member.getAccessFlags().getValue());
+		out.putShort(mapConstant(member.getNameIndex()));
+		out.putShort(mapConstant(member.getDescriptorIndex()));
+		writeAttributes(out, member.getAttributes());
+	}
+}
+
+/**
+ * Writes the count of attributes, and then each one the filters keep. The count is filled in afterwards.
+ */
+void ClassWriter::writeAttributes(Output& out, const AttributePool& attributes) const {
+	size_t countPosition = out.size;
+	out.putShort(0);
+	uint16_t count = 0;
+	for(uint16_t i = 0; i < attributes.getNumAttributes(); i++) {
+		const Attribute& attribute = attributes[i];
+		if(keepAttribute(attribute)) {
+			writeAttribute(out, attribute);
+			count++;
+		}
+	}
+	if(out.base) {
+		out.base[countPosition] = static_cast<char>(count >> 8);
+		out.base[countPosition + 1] = static_cast<char>(count);
+	}
+}
+
+/**
+ * Writes a single attribute. Attributes that weren't understood are copied as they were read; the length of a
+ * Code attribute is filled in once its contents have been written, since its own attributes are written again.
+ * If the constant pool has been compacted, the indexes in what's copied are renumbered afterwards.
+ */
+void ClassWriter::writeAttribute(Output& out, const Attribute& attribute) const {
+	out.putShort(mapConstant(attribute.getNameIndex()));
+	if(const CodeAttribute* code = dynamic_cast<const CodeAttribute*>(&attribute)) {
+		size_t lengthPosition = out.size;
+		out.putInt(0);
+		out.putShort(code->getMaxStack());
+		out.putShort(code->getMaxLocals());
+		out.putInt(code->getCodeLength());
+		size_t codePosition = out.size;
+		out.putBytes(code->getCode(), code->getCodeLength());
+		if(out.base && !constantMap.empty()) {
+			vector<uint32_t> offsets;
+			vector<uint32_t> byteOffsets;
+			findCodeReferences(*code, offsets, byteOffsets);
+			patchReferences(out, codePosition, offsets, byteOffsets);
+		}
+		const vector<ExceptionHandler>& handlers = code->getExceptionTable();
+		out.putShort(handlers.size());
+		for(vector<ExceptionHandler>::const_iterator it = handlers.begin(); it != handlers.end(); it++) {
+			out.putShort(it->startPc);
+			out.putShort(it->endPc);
+			out.putShort(it->handlerPc);
+			out.putShort(mapConstant(it->catchType));
+		}
+		writeAttributes(out, code->getAttributes());
+		out.patchInt(lengthPosition, out.size - lengthPosition - 4);
+	} else if(const ConstantValueAttribute* value = dynamic_cast<const ConstantValueAttribute*>(&attribute)) {
+		out.putInt(2);
+		out.putShort(mapConstant(value->getIndex()));
+	} else if(const UnknownAttribute* unknown = dynamic_cast<const UnknownAttribute*>(&attribute)) {
+		out.putInt(unknown->getLength());
+		size_t infoPosition = out.size;
+		out.putBytes(unknown->getInfo(), unknown->getLength());
+		if(out.base && !constantMap.empty()) {
+			vector<uint32_t> offsets;
+			if(!findAttributeReferences(attribute.getName().raw(), unknown->getInfo(), unknown->getLength(), offsets)) {
+				throw runtime_error("Can't renumber the constants in the " + string(attribute.getName()) + " attribute");
+			}
+			patchReferences(out, infoPosition, offsets, vector<uint32_t>());
+		}
+	} else {
+		throw runtime_error("Don't know how to write the " + string(attribute.getName()) + " attribute");
+	}
+}
+
+/**
+ * Renumbers the constant pool indexes at offsets from a position in what's been written, two byte ones and then
+ * one byte ones.
+ */
+void ClassWriter::patchReferences(Output& out, size_t start, const vector<uint32_t>& offsets, const vector<uint32_t>& byteOffsets) const {
+	uint8_t* bytes = reinterpret_cast<uint8_t*>(out.base + start);
+	for(vector<uint32_t>::const_iterator it = offsets.begin(); it != offsets.end(); it++) {
+		uint16_t index = mapConstant(readIndex(bytes + *it));
+		bytes[*it] = static_cast<uint8_t>(index >> 8);
+		bytes[*it + 1] = static_cast<uint8_t>(index);
+	}
+	for(vector<uint32_t>::const_iterator it = byteOffsets.begin(); it != byteOffsets.end(); it++) {
+		bytes[*it] = static_cast<uint8_t>(mapConstant(bytes[*it]));
+	}
+}
+
+/**
+ * Returns whether every filter keeps an attribute.
+ */
+bool ClassWriter::keepAttribute(const Attribute& attribute) const {
+	for(vector<const AttributeFilter*>::const_iterator it = filters.begin(); it != filters.end(); it++) {
+		if(!(*it)->keepAttribute(attribute)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Marks the constants the fields or methods refer to, and the ones their attributes do.
+ */
+void ClassWriter::markMembers(Marks& marks, const ClassMemberPool& members) const {
+	for(uint16_t i = 0; i < members.numMembers(); i++) {
+		const ClassMember& member = members[i];
+		marks.mark(member.getNameIndex());
+		marks.mark(member.getDescriptorIndex());
+		markAttributes(marks, member.getAttributes());
+	}
+}
+
+/**
+ * Marks the constants the attributes that are kept refer to, including their names. Throws if there's one
+ * whose layout isn't known, since what it refers to can't be found.
+ */
+void ClassWriter::markAttributes(Marks& marks, const AttributePool& attributes) const {
+	for(uint16_t i = 0; i < attributes.getNumAttributes(); i++) {
+		const Attribute& attribute = attributes[i];
+		if(!keepAttribute(attribute)) {
+			continue;
+		}
+		marks.mark(attribute.getNameIndex());
+		if(const CodeAttribute* code = dynamic_cast<const CodeAttribute*>(&attribute)) {
+			vector<uint32_t> offsets;
+			vector<uint32_t> byteOffsets;
+			findCodeReferences(*code, offsets, byteOffsets);
+			marks.mark(code->getCode(), offsets, byteOffsets);
+			const vector<ExceptionHandler>& handlers = code->getExceptionTable();
+			for(vector<ExceptionHandler>::const_iterator it = handlers.begin(); it != handlers.end(); it++) {
+				marks.mark(it->catchType);
+			}
+			markAttributes(marks, code->getAttributes());
+		} else if(const ConstantValueAttribute* value = dynamic_cast<const ConstantValueAttribute*>(&attribute)) {
+			marks.mark(value->getIndex());
+		} else if(const UnknownAttribute* unknown = dynamic_cast<const UnknownAttribute*>(&attribute)) {
+			vector<uint32_t> offsets;
+			if(!findAttributeReferences(attribute.getName().raw(), unknown->getInfo(), unknown->getLength(), offsets)) {
+				throw runtime_error("Layout of the " + string(attribute.getName()) + " attribute isn't known");
+			}
+			marks.mark(unknown->getInfo(), offsets, vector<uint32_t>());
+		} else {
+			throw runtime_error("Don't know how to write the " + string(attribute.getName()) + " attribute");
+		}
+	}
+}
+
+/**
+ * Gets the index a constant is written at, which is where it was read from unless the pool has been compacted.
+ */
+uint16_t ClassWriter::mapConstant(uint16_t index) const {
+	if(constantMap.empty() || index == 0) {
+		return index;
+	}
+	if(index >= constantMap.size() || !constantMap[index]) {
+		throw runtime_error("Constant " + toString(index) + " was left out of the compacted constant pool");
+	}
+	return constantMap[index];
+}
+
+/**
+ * Works out how many bytes the constants took in the original bytes, from how big each one is, or returns 0 if
+ * there are no original bytes, or they don't hold this class's constant pool.
+ */
+size_t ClassWriter::getOriginalConstantPoolSize() const {
+	const ConstantPool& pool = classFile.getConstantPool();
+	if(!original || originalSize < 10) {
+		return 0;
+	}
+	uint16_t count = (static_cast<uint8_t>(original[8]) << 8) | static_cast<uint8_t>(original[9]);
+	if(count != pool.getNumElements() + 1) {
+		return 0;
+	}
+	size_t size = 0;
+	for(uint16_t i = 1; i <= pool.getNumElements(); i++) {
+		const Constant& constant = pool[i];
+		switch(constant.getType()) {
+			case CONSTANT_Class:
+			case CONSTANT_String:
+			case CONSTANT_MethodType:
+				size += 3;
+				break;
+			case CONSTANT_MethodHandle:
+				size += 4;
+				break;
+			case CONSTANT_Fieldref:
+			case CONSTANT_Methodref:
+			case CONSTANT_InterfaceMethodref:
+			case CONSTANT_Integer:
+			case CONSTANT_Float:
+			case CONSTANT_NameAndType:
+			case CONSTANT_InvokeDynamic:
+				size += 5;
+				break;
+			case CONSTANT_Long:
+			case CONSTANT_Double:
+				size += 9;
+				i++;
+				break;
+			case CONSTANT_Utf8:
+				size += 3 + static_cast<const ConstantUtf8&>(constant).getNumBytes();
+				break;
+			default:
+				return 0;
+		}
+	}
+	if(10 + size > originalSize) {
+		return 0;
+	}
+	return size;
+}
@@ -1,10 +1,14 @@
 #include "ConstantPool.h"
+#include "LoadStatistics.h"
 #include <stdlib.h>
 #include <stdexcept>
 #include "Util.h"
+#include "ModifiedUtf8.h"
+#include "Descriptor.h"
 
 using std::istream;
 using std::vector;
+using std::string;
 using Glib::ustring;
 
 /** 
@@ -22,6 +26,7 @@ ConstantPool::ConstantPool(ClassFile& cf, uint16_t numElements) try : cf(cf), co
  * that the input stream begins at the beginning of the constant pool size, which is "constant_pool_count".
  */
 ConstantPool::ConstantPool(ClassFile& cf, istream& in) try : cf(cf), constants(readShortUnsigned(in) - 1, NULL) {
+	PhaseTimer timer(PHASE_CONSTANT_POOL, in);
 	uint16_t i;
 	try {
 		for(i = 0; i < constants.size(); i++) {
@@ -177,7 +182,8 @@ uint8_t Constant::getType() const {
  */
 ConstantClassInfo::ConstantClassInfo(ConstantPool& pool, uint16_t classNameIndex) :
 	Constant(pool, CONSTANT_Class), 
-	classNameIndex(classNameIndex) {
+	classNameIndex(classNameIndex),
+	type(NULL) {
 	
 }
 
@@ -185,7 +191,8 @@ ConstantClassInfo::ConstantClassInfo(ConstantPool& pool, uint16_t classNameIndex
  * Constructor for the ConstantClassInfo that takes in an input stream to read from.
  */
 ConstantClassInfo::ConstantClassInfo(ConstantPool& pool, istream& in) :
-	Constant(pool, CONSTANT_Class) {
+	Constant(pool, CONSTANT_Class),
+	type(NULL) {
 	
 	classNameIndex = readShortUnsigned(in);
 }
@@ -212,6 +219,19 @@ const ustring& ConstantClassInfo::getClassName() const {
 	return getConstantPool().get<ConstantUtf8>(classNameIndex).getStringValue();
 }
 
+/**
+ * Gets the type the class name stands for: a reference to the class, or an array type for array classes, whose
+ * names are descriptors. It's resolved once, and remembered, so the name is never taken apart again.
+ */
+const FieldType& ConstantClassInfo::getClassType() const {
+	const FieldType* resolved = type.load(std::memory_order_acquire);
+	if(!resolved) {
+		resolved = &FieldType::forClassName(getClassName());
+		type.store(resolved, std::memory_order_release);
+	}
+	return *resolved;
+}
+
 /**
  * Returns whether the ConstantClassInfo is valid, based on whether the classNameIndex is a ConstantUtf8.
  */
@@ -528,7 +548,9 @@ bool ConstantDouble::validate() const {
 ConstantNameAndType::ConstantNameAndType(ConstantPool& cp, uint16_t nameIndex, uint16_t descriptorIndex) :
 	Constant(cp, CONSTANT_NameAndType),
 	nameIndex(nameIndex),
-	descriptorIndex(descriptorIndex) {
+	descriptorIndex(descriptorIndex),
+	fieldType(NULL),
+	methodType(NULL) {
 	
 }
 
@@ -536,7 +558,9 @@ ConstantNameAndType::ConstantNameAndType(ConstantPool& cp, uint16_t nameIndex, u
  * Constructor for the ConstantNameAndType information in the class file. Takes in a stream to read the data from.
  */
 ConstantNameAndType::ConstantNameAndType(ConstantPool& cp, istream& in) :
-	Constant(cp, CONSTANT_NameAndType) {
+	Constant(cp, CONSTANT_NameAndType),
+	fieldType(NULL),
+	methodType(NULL) {
 	
 	nameIndex = readShortUnsigned(in);
 	descriptorIndex = readShortUnsigned(in);
@@ -577,6 +601,30 @@ const ustring& ConstantNameAndType::getTypeString() const {
 	return getConstantPool().get<ConstantUtf8>(descriptorIndex).getStringValue();
 }
 
+/**
+ * Gets the parsed type of the field this refers to. It's looked up once, and remembered.
+ */
+const FieldType& ConstantNameAndType::getFieldType() const {
+	const FieldType* type = fieldType.load(std::memory_order_acquire);
+	if(!type) {
+		type = &FieldType::get(getTypeString());
+		fieldType.store(type, std::memory_order_release);
+	}
+	return *type;
+}
+
+/**
+ * Gets the parsed type of the method this refers to. It's looked up once, and remembered.
+ */
+const MethodType& ConstantNameAndType::getMethodType() const {
+	const MethodType* type = methodType.load(std::memory_order_acquire);
+	if(!type) {
+		type = &MethodType::get(getTypeString());
+		methodType.store(type, std::memory_order_release);
+	}
+	return *type;
+}
+
 /**
  * Returns whether the ConstantNameAndType is valid. It is valid if both the name and type are indexes of
  * ConstantUtf8s.
@@ -592,27 +640,35 @@ bool ConstantNameAndType::validate() const {
 ConstantUtf8::ConstantUtf8(ConstantPool& pool, uint16_t numBytes, const ustring& stringValue) :
 	Constant(pool, CONSTANT_Utf8),
 	numBytes(numBytes),
-	stringValue(stringValue) {
+	stringValue(stringValue),
+	valid(true) {
 	
 }
 
 /**
- * Constructor for the ConstantUtf8 object. Takes in a binary stream to read the data from.
+ * Constructor for the ConstantUtf8 object. Takes in a binary stream to read the data from. Strings that
+ * are all ASCII are stored as they are; anything else is checked and converted from modified UTF-8, and
+ * remembered as invalid for validate if it isn't legal.
  */
 ConstantUtf8::ConstantUtf8(ConstantPool& pool, istream& in) :
 	Constant(pool, CONSTANT_Utf8) {
 	
 	numBytes = readShortUnsigned(in);
-	char* data = new char[numBytes+1];
-	try {
-		in.read(data, numBytes);
-		data[numBytes] = '\0';
-		stringValue = ustring(data);
-	} catch(...) {
-		delete[] data;
-		throw;
+	// Both buffers are reused from one constant to the next, so the string itself is all that's allocated.
+	static thread_local string bytes;
+	static thread_local string decoded;
+	bytes.resize(numBytes);
+	in.read(&bytes[0], numBytes);
+	if(in.gcount() != numBytes) {
+		throw std::runtime_error("Utf8 constant runs past the end of the class file");
+	}
+	if(countAscii(bytes.data(), numBytes) == numBytes) {
+		valid = true;
+		stringValue.assign(bytes.begin(), bytes.end());
+	} else {
+		valid = decodeModifiedUtf8(bytes.data(), numBytes, decoded);
+		stringValue.assign(decoded.begin(), decoded.end());
 	}
-	delete[] data;
 }
 
 /**
@@ -630,18 +686,17 @@ uint16_t ConstantUtf8::getNumBytes() const {
 }
 
 /**
- * Returns the string represented, in UTF-8 format.
+ * Returns the string represented, in standard UTF-8 format, so NUL is a zero byte.
  */
 const ustring& ConstantUtf8::getStringValue() const {
 	return stringValue;
 }
 
 /**
- * Returns whether the ConstantUtf8 is valid. ConstantUtf8s are, for now, always valid.
- * TODO: Check if the string is in valid utf8 or something?
+ * Returns whether the ConstantUtf8 was legal modified UTF-8.
  */
 bool ConstantUtf8::validate() const {
-	return true;
+	return valid;
 }
 
 /**
@@ -0,0 +1,335 @@
+#include "ConstantReferences.h"
+#include "AttributePool.h"
+#include "Bytecode.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+	/**
+	 * How deeply annotations can nest inside each other before an attribute is taken to be malformed.
+	 */
+	const unsigned int MAX_ANNOTATION_DEPTH = 64;
+
+	/**
+	 * Walks through the bytes of an attribute, noting the offset of every constant pool index passed over. Every
+	 * method returns false if the attribute ends too soon.
+	 */
+	class Scanner {
+	private:
+		const uint8_t* info;
+		uint32_t length;
+		uint32_t position;
+		vector<uint32_t>& offsets;
+	public:
+		Scanner(const uint8_t* info, uint32_t length, vector<uint32_t>& offsets) :
+			info(info), length(length), position(0), offsets(offsets) {}
+
+		bool atEnd() const {
+			return position == length;
+		}
+
+		bool skip(uint32_t count) {
+			if(length - position < count) {
+				return false;
+			}
+			position += count;
+			return true;
+		}
+
+		bool readByte(uint8_t& value) {
+			if(length - position < 1) {
+				return false;
+			}
+			value = info[position++];
+			return true;
+		}
+
+		bool readShort(uint16_t& value) {
+			if(length - position < 2) {
+				return false;
+			}
+			value = (static_cast<uint16_t>(info[position]) << 8) | info[position + 1];
+			position += 2;
+			return true;
+		}
+
+		bool reference() {
+			offsets.push_back(position);
+			return skip(2);
+		}
+
+		/**
+		 * Passes over a count followed by that many indexes, each followed by some bytes that aren't indexes.
+		 */
+		bool references(uint32_t count, uint32_t padding) {
+			for(uint32_t i = 0; i < count; i++) {
+				if(!reference() || !skip(padding)) {
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+
+	bool scanAnnotation(Scanner& scanner, unsigned int depth);
+
+	/**
+	 * Passes over an element_value of an annotation.
+	 */
+	bool scanElementValue(Scanner& scanner, unsigned int depth) {
+		uint8_t tag;
+		if(!scanner.readByte(tag)) {
+			return false;
+		}
+		switch(tag) {
+			case 'B':
+			case 'C':
+			case 'D':
+			case 'F':
+			case 'I':
+			case 'J':
+			case 'S':
+			case 'Z':
+			case 's':
+			case 'c':
+				return scanner.reference();
+			case 'e':
+				return scanner.reference() && scanner.reference();
+			case '@':
+				return scanAnnotation(scanner, depth + 1);
+			case '[': {
+				uint16_t count;
+				if(!scanner.readShort(count)) {
+					return false;
+				}
+				for(uint16_t i = 0; i < count; i++) {
+					if(!scanElementValue(scanner, depth)) {
+						return false;
+					}
+				}
+				return true;
+			}
+			default:
+				return false;
+		}
+	}
+
+	/**
+	 * Passes over an annotation: its type, and the name and value of each of its elements.
+	 */
+	bool scanAnnotation(Scanner& scanner, unsigned int depth) {
+		uint16_t count;
+		if(depth > MAX_ANNOTATION_DEPTH || !scanner.reference() || !scanner.readShort(count)) {
+			return false;
+		}
+		for(uint16_t i = 0; i < count; i++) {
+			if(!scanner.reference() || !scanElementValue(scanner, depth)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Passes over a count of annotations, and the annotations.
+	 */
+	bool scanAnnotations(Scanner& scanner) {
+		uint16_t count;
+		if(!scanner.readShort(count)) {
+			return false;
+		}
+		for(uint16_t i = 0; i < count; i++) {
+			if(!scanAnnotation(scanner, 0)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Passes over a count of verification_type_infos in a stack map frame, and the types. Only the Object type
+	 * refers to a constant; Uninitialized is followed by the pc of a new instruction.
+	 */
+	bool scanVerificationTypes(Scanner& scanner, uint16_t count) {
+		for(uint16_t i = 0; i < count; i++) {
+			uint8_t tag;
+			if(!scanner.readByte(tag)) {
+				return false;
+			}
+			if(tag == 7) {
+				if(!scanner.reference()) {
+					return false;
+				}
+			} else if(tag == 8) {
+				if(!scanner.skip(2)) {
+					return false;
+				}
+			} else if(tag > 8) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Passes over the frames of a StackMapTable.
+	 */
+	bool scanStackMapTable(Scanner& scanner) {
+		uint16_t count;
+		if(!scanner.readShort(count)) {
+			return false;
+		}
+		for(uint16_t i = 0; i < count; i++) {
+			uint8_t type;
+			if(!scanner.readByte(type)) {
+				return false;
+			}
+			bool valid;
+			if(type < 64) {
+				valid = true;
+			} else if(type < 128) {
+				valid = scanVerificationTypes(scanner, 1);
+			} else if(type < 247) {
+				valid = false;
+			} else if(type == 247) {
+				valid = scanner.skip(2) && scanVerificationTypes(scanner, 1);
+			} else if(type < 252) {
+				valid = scanner.skip(2);
+			} else if(type < 255) {
+				valid = scanner.skip(2) && scanVerificationTypes(scanner, type - 251);
+			} else {
+				uint16_t locals;
+				uint16_t stack;
+				valid = scanner.skip(2) && scanner.readShort(locals) && scanVerificationTypes(scanner, locals)
+					&& scanner.readShort(stack) && scanVerificationTypes(scanner, stack);
+			}
+			if(!valid) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Passes over a whole attribute, if it's one whose layout is known.
+	 */
+	bool scanAttribute(Scanner& scanner, const string& name) {
+		uint16_t count;
+		if(name == "SourceFile" || name == "Signature" || name == "NestHost" || name == "ModuleMainClass") {
+			return scanner.reference();
+		} else if(name == "Deprecated" || name == "Synthetic") {
+			return true;
+		} else if(name == "LineNumberTable") {
+			return scanner.readShort(count) && scanner.skip(4 * static_cast<uint32_t>(count));
+		} else if(name == "Exceptions" || name == "NestMembers" || name == "PermittedSubclasses" || name == "ModulePackages") {
+			return scanner.readShort(count) && scanner.references(count, 0);
+		} else if(name == "InnerClasses") {
+			// The inner class, the outer class and the simple name, and then the flags.
+			if(!scanner.readShort(count)) {
+				return false;
+			}
+			for(uint16_t i = 0; i < count; i++) {
+				if(!scanner.reference() || !scanner.reference() || !scanner.reference() || !scanner.skip(2)) {
+					return false;
+				}
+			}
+			return true;
+		} else if(name == "EnclosingMethod") {
+			return scanner.reference() && scanner.reference();
+		} else if(name == "LocalVariableTable" || name == "LocalVariableTypeTable") {
+			// The pc and length the variable is live for, its name and descriptor or signature, and its slot.
+			if(!scanner.readShort(count)) {
+				return false;
+			}
+			for(uint16_t i = 0; i < count; i++) {
+				if(!scanner.skip(4) || !scanner.reference() || !scanner.reference() || !scanner.skip(2)) {
+					return false;
+				}
+			}
+			return true;
+		} else if(name == "MethodParameters") {
+			uint8_t parameters;
+			return scanner.readByte(parameters) && scanner.references(parameters, 2);
+		} else if(name == "BootstrapMethods") {
+			// A method handle, and its static arguments.
+			if(!scanner.readShort(count)) {
+				return false;
+			}
+			for(uint16_t i = 0; i < count; i++) {
+				uint16_t arguments;
+				if(!scanner.reference() || !scanner.readShort(arguments) || !scanner.references(arguments, 0)) {
+					return false;
+				}
+			}
+			return true;
+		} else if(name == "StackMapTable") {
+			return scanStackMapTable(scanner);
+		} else if(name == "RuntimeVisibleAnnotations" || name == "RuntimeInvisibleAnnotations") {
+			return scanAnnotations(scanner);
+		} else if(name == "RuntimeVisibleParameterAnnotations" || name == "RuntimeInvisibleParameterAnnotations") {
+			uint8_t parameters;
+			if(!scanner.readByte(parameters)) {
+				return false;
+			}
+			for(uint8_t i = 0; i < parameters; i++) {
+				if(!scanAnnotations(scanner)) {
+					return false;
+				}
+			}
+			return true;
+		} else if(name == "AnnotationDefault") {
+			return scanElementValue(scanner, 0);
+		}
+		return false;
+	}
+}
+
+/**
+ * Finds the constant pool indexes in an attribute the parser keeps as bytes, given its name. Returns false if
+ * the attribute isn't one whose layout is known, or its bytes don't match it, in which case the offsets found
+ * so far are meaningless.
+ */
+bool findAttributeReferences(const string& name, const uint8_t* info, uint32_t length, vector<uint32_t>& offsets) {
+	if(name == "SourceDebugExtension") {
+		// Just a string, which isn't in the constant pool.
+		return true;
+	}
+	Scanner scanner(info, length, offsets);
+	return scanAttribute(scanner, name) && scanner.atEnd();
+}
+
+/**
+ * Finds the constant pool indexes in the bytecode of a Code attribute: the two byte ones of ldc_w, ldc2_w, field
+ * accesses, invocations and the type instructions, and the one byte ones of ldc. Throws if the code can't be
+ * decoded.
+ */
+void findCodeReferences(const CodeAttribute& code, vector<uint32_t>& offsets, vector<uint32_t>& byteOffsets) {
+	MethodCode methodCode(code);
+	for(uint32_t i = 0; i < methodCode.numInstructions(); i++) {
+		const Instruction& instruction = methodCode[i];
+		switch(instruction.opcode) {
+			case BY_ldc:
+				byteOffsets.push_back(instruction.pc + 1);
+				break;
+			case BY_ldc_w:
+			case BY_ldc2_w:
+			case BY_getstatic:
+			case BY_putstatic:
+			case BY_getfield:
+			case BY_putfield:
+			case BY_invokevirtual:
+			case BY_invokespecial:
+			case BY_invokestatic:
+			case BY_invokeinterface:
+			case BY_invokedynamic:
+			case BY_new:
+			case BY_anewarray:
+			case BY_checkcast:
+			case BY_instanceof:
+			case BY_multinewarray:
+				offsets.push_back(instruction.pc + 1);
+				break;
+		}
+	}
+}
@@ -0,0 +1,573 @@
+#include "ControlFlowGraph.h"
+#include "Bytecode.h"
+#include "AttributePool.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using std::vector;
+using std::runtime_error;
+
+const uint32_t ControlFlowGraph::NO_BLOCK;
+const uint32_t ControlFlowGraph::NO_LOOP;
+
+namespace {
+	/**
+	 * Looks up the instruction index for a pc that control can be transferred to, throwing if it isn't the
+	 * start of an instruction. A pc equal to the code length is allowed, since handler ranges can end there.
+	 */
+	uint32_t targetIndex(const MethodCode& code, uint32_t pc) {
+		if(pc == code.getCode().getCodeLength()) {
+			return code.numInstructions();
+		}
+		uint32_t index = code.indexOf(pc);
+		if(index == MethodCode::NO_INSTRUCTION) {
+			throw runtime_error("Control is transferred to pc " + toString(pc) + ", which is not the start of an instruction.");
+		}
+		return index;
+	}
+
+	bool sortLoopsOutermostFirst(const Loop& a, const Loop& b) {
+		return a.blocks.size() > b.blocks.size();
+	}
+}
+
+/**
+ * Builds the control flow graph of some decoded code, along with its dominator tree and loops.
+ */
+ControlFlowGraph::ControlFlowGraph(const MethodCode& code) : code(code), reducible(true) {
+	buildBlocks();
+	buildEdges();
+	computeDominators();
+	numberDominatorTree();
+	findLoops();
+}
+
+/**
+ * Destructor for ControlFlowGraph. Nothing is allocated, so nothing is deleted.
+ */
+ControlFlowGraph::~ControlFlowGraph() {
+
+}
+
+/**
+ * Splits the instructions up into basic blocks, by finding every instruction that starts one.
+ */
+void ControlFlowGraph::buildBlocks() {
+	uint32_t count = code.numInstructions();
+	vector<bool> leaders(count + 1, false);
+	vector<bool> handlers(count + 1, false);
+	vector<uint32_t> targets;
+	if(count > 0) {
+		leaders[0] = true;
+	}
+	for(uint32_t i = 0; i < count; i++) {
+		const Instruction& instruction = code[i];
+		if(MethodCode::isBranch(instruction.opcode)) {
+			leaders[targetIndex(code, code.getBranchTarget(instruction))] = true;
+			leaders[i + 1] = true;
+		} else if(MethodCode::isSwitch(instruction.opcode)) {
+			leaders[targetIndex(code, code.getSwitchTargets(instruction, targets))] = true;
+			for(uint32_t t = 0; t < targets.size(); t++) {
+				leaders[targetIndex(code, targets[t])] = true;
+			}
+			leaders[i + 1] = true;
+		} else if(MethodCode::endsBlock(instruction.opcode)) {
+			leaders[i + 1] = true;
+		}
+	}
+	const vector<ExceptionHandler>& exceptionTable = code.getCode().getExceptionTable();
+	for(uint32_t h = 0; h < exceptionTable.size(); h++) {
+		leaders[targetIndex(code, exceptionTable[h].startPc)] = true;
+		leaders[targetIndex(code, exceptionTable[h].endPc)] = true;
+		uint32_t handler = targetIndex(code, exceptionTable[h].handlerPc);
+		leaders[handler] = true;
+		handlers[handler] = true;
+	}
+
+	instructionBlocks.assign(count, NO_BLOCK);
+	for(uint32_t i = 0; i < count; i++) {
+		if(leaders[i]) {
+			BasicBlock block;
+			block.firstInstruction = i;
+			block.startPc = code[i].pc;
+			block.isHandler = handlers[i];
+			blocks.push_back(block);
+		}
+		BasicBlock& block = blocks.back();
+		block.lastInstruction = i;
+		block.endPc = code[i].pc + code[i].length;
+		instructionBlocks[i] = blocks.size() - 1;
+	}
+}
+
+/**
+ * Finds the normal and exceptional successors of every block, and stores them, and the predecessors, in
+ * flat arrays indexed by block.
+ */
+void ControlFlowGraph::buildEdges() {
+	const vector<ExceptionHandler>& exceptionTable = code.getCode().getExceptionTable();
+	vector<uint32_t> subroutineReturns;
+	for(uint32_t b = 0; b < blocks.size(); b++) {
+		uint8_t opcode = code[blocks[b].lastInstruction].opcode;
+		if((opcode == BY_jsr || opcode == BY_jsr_w) && b + 1 < blocks.size()) {
+			subroutineReturns.push_back(b + 1);
+		}
+	}
+
+	vector<uint32_t> targets;
+	edgeStart.reserve(blocks.size() + 1);
+	normalEdgeCount.reserve(blocks.size());
+	edges.reserve(blocks.size() * 2);
+	for(uint32_t b = 0; b < blocks.size(); b++) {
+		const Instruction& last = code[blocks[b].lastInstruction];
+		uint32_t first = edges.size();
+		edgeStart.push_back(first);
+		if(MethodCode::isBranch(last.opcode)) {
+			edges.push_back(getBlockAt(code.getBranchTarget(last)));
+		} else if(MethodCode::isSwitch(last.opcode)) {
+			edges.push_back(getBlockAt(code.getSwitchTargets(last, targets)));
+			for(uint32_t t = 0; t < targets.size(); t++) {
+				edges.push_back(getBlockAt(targets[t]));
+			}
+		} else if(last.opcode == BY_ret) {
+			// Without tracking return addresses, a ret could go back to after any jsr.
+			edges.insert(edges.end(), subroutineReturns.begin(), subroutineReturns.end());
+		}
+		if(!MethodCode::endsBlock(last.opcode)) {
+			if(b + 1 >= blocks.size()) {
+				throw runtime_error("Control falls off the end of the code after pc " + toString(last.pc) + ".");
+			}
+			edges.push_back(b + 1);
+		}
+		std::sort(edges.begin() + first, edges.end());
+		edges.erase(std::unique(edges.begin() + first, edges.end()), edges.end());
+		normalEdgeCount.push_back(edges.size() - first);
+
+		uint32_t exceptionalFirst = edges.size();
+		for(uint32_t h = 0; h < exceptionTable.size(); h++) {
+			if(blocks[b].startPc >= exceptionTable[h].startPc && blocks[b].startPc < exceptionTable[h].endPc) {
+				edges.push_back(getBlockAt(exceptionTable[h].handlerPc));
+			}
+		}
+		std::sort(edges.begin() + exceptionalFirst, edges.end());
+		edges.erase(std::unique(edges.begin() + exceptionalFirst, edges.end()), edges.end());
+	}
+	edgeStart.push_back(edges.size());
+
+	predecessorStart.assign(blocks.size() + 1, 0);
+	for(uint32_t e = 0; e < edges.size(); e++) {
+		predecessorStart[edges[e] + 1]++;
+	}
+	for(uint32_t b = 0; b < blocks.size(); b++) {
+		predecessorStart[b + 1] += predecessorStart[b];
+	}
+	predecessors.resize(edges.size());
+	vector<uint32_t> filled(predecessorStart.begin(), predecessorStart.end() - 1);
+	for(uint32_t b = 0; b < blocks.size(); b++) {
+		for(uint32_t e = edgeStart[b]; e < edgeStart[b + 1]; e++) {
+			predecessors[filled[edges[e]]++] = b;
+		}
+	}
+}
+
+/**
+ * Computes immediate dominators with the Lengauer-Tarjan algorithm, using path compression. Also records the
+ * depth-first order of the blocks, which loop finding and reverse postorder both need.
+ */
+void ControlFlowGraph::computeDominators() {
+	uint32_t n = blocks.size();
+	idom.assign(n, NO_BLOCK);
+	if(n == 0) {
+		return;
+	}
+	const uint32_t UNVISITED = 0xFFFFFFFF;
+	vector<uint32_t> dfnum(n, UNVISITED);
+	vector<uint32_t> vertex;
+	vector<uint32_t> parent(n, NO_BLOCK);
+	vector<uint32_t> postorder;
+	vertex.reserve(n);
+	postorder.reserve(n);
+
+	// Iterative depth first search, so that huge methods can't overflow the native stack.
+	vector<uint32_t> stack;
+	vector<uint32_t> nextEdge(n, 0);
+	stack.push_back(0);
+	dfnum[0] = 0;
+	vertex.push_back(0);
+	while(!stack.empty()) {
+		uint32_t b = stack.back();
+		if(nextEdge[b] < numSuccessors(b)) {
+			uint32_t s = getSuccessor(b, nextEdge[b]++);
+			if(dfnum[s] == UNVISITED) {
+				dfnum[s] = vertex.size();
+				vertex.push_back(s);
+				parent[s] = b;
+				stack.push_back(s);
+			}
+		} else {
+			postorder.push_back(b);
+			stack.pop_back();
+		}
+	}
+	reversePostorder.assign(postorder.rbegin(), postorder.rend());
+
+	// semi holds depth first numbers; everything else holds block numbers.
+	vector<uint32_t> semi(n, UNVISITED);
+	vector<uint32_t> ancestor(n, NO_BLOCK);
+	vector<uint32_t> best(n);
+	vector<uint32_t> samedom(n, NO_BLOCK);
+	vector<uint32_t> bucketHead(n, NO_BLOCK);
+	vector<uint32_t> bucketNext(n, NO_BLOCK);
+	vector<uint32_t> path;
+	for(uint32_t b = 0; b < n; b++) {
+		best[b] = b;
+		if(dfnum[b] != UNVISITED) {
+			semi[b] = dfnum[b];
+		}
+	}
+
+	for(uint32_t i = vertex.size() - 1; i > 0; i--) {
+		uint32_t b = vertex[i];
+		uint32_t p = parent[b];
+		uint32_t s = dfnum[p];
+		for(uint32_t e = predecessorStart[b]; e < predecessorStart[b + 1]; e++) {
+			uint32_t v = predecessors[e];
+			if(dfnum[v] == UNVISITED) {
+				continue;
+			}
+			uint32_t candidate;
+			if(dfnum[v] <= dfnum[b]) {
+				candidate = dfnum[v];
+			} else {
+				// Find the ancestor of v with the lowest semidominator, compressing the path as we go.
+				path.clear();
+				uint32_t x = v;
+				while(ancestor[x] != NO_BLOCK && ancestor[ancestor[x]] != NO_BLOCK) {
+					path.push_back(x);
+					x = ancestor[x];
+				}
+				for(uint32_t k = path.size(); k > 0; k--) {
+					uint32_t y = path[k - 1];
+					uint32_t a = ancestor[y];
+					if(semi[best[a]] < semi[best[y]]) {
+						best[y] = best[a];
+					}
+					ancestor[y] = ancestor[a];
+				}
+				candidate = semi[best[v]];
+			}
+			if(candidate < s) {
+				s = candidate;
+			}
+		}
+		semi[b] = s;
+		uint32_t sb = vertex[s];
+		bucketNext[b] = bucketHead[sb];
+		bucketHead[sb] = b;
+		ancestor[b] = p;
+
+		for(uint32_t v = bucketHead[p]; v != NO_BLOCK; v = bucketNext[v]) {
+			path.clear();
+			uint32_t x = v;
+			while(ancestor[x] != NO_BLOCK && ancestor[ancestor[x]] != NO_BLOCK) {
+				path.push_back(x);
+				x = ancestor[x];
+			}
+			for(uint32_t k = path.size(); k > 0; k--) {
+				uint32_t y = path[k - 1];
+				uint32_t a = ancestor[y];
+				if(semi[best[a]] < semi[best[y]]) {
+					best[y] = best[a];
+				}
+				ancestor[y] = ancestor[a];
+			}
+			uint32_t y = best[v];
+			if(semi[y] == semi[v]) {
+				idom[v] = p;
+			} else {
+				samedom[v] = y;
+			}
+		}
+		bucketHead[p] = NO_BLOCK;
+	}
+	for(uint32_t i = 1; i < vertex.size(); i++) {
+		uint32_t b = vertex[i];
+		if(samedom[b] != NO_BLOCK) {
+			idom[b] = idom[samedom[b]];
+		}
+	}
+}
+
+/**
+ * Numbers the dominator tree in depth first order, so that a block dominates another exactly when the
+ * other's interval is inside its own.
+ */
+void ControlFlowGraph::numberDominatorTree() {
+	uint32_t n = blocks.size();
+	treeEnter.assign(n, 0);
+	treeExit.assign(n, 0);
+	if(n == 0) {
+		return;
+	}
+	vector<uint32_t> childStart(n + 1, 0);
+	for(uint32_t b = 1; b < n; b++) {
+		if(idom[b] != NO_BLOCK) {
+			childStart[idom[b] + 1]++;
+		}
+	}
+	for(uint32_t b = 0; b < n; b++) {
+		childStart[b + 1] += childStart[b];
+	}
+	vector<uint32_t> children(childStart[n]);
+	vector<uint32_t> filled(childStart.begin(), childStart.end() - 1);
+	for(uint32_t b = 1; b < n; b++) {
+		if(idom[b] != NO_BLOCK) {
+			children[filled[idom[b]]++] = b;
+		}
+	}
+
+	uint32_t counter = 1;
+	vector<uint32_t> stack;
+	vector<uint32_t> nextChild(childStart.begin(), childStart.end() - 1);
+	stack.push_back(0);
+	treeEnter[0] = counter++;
+	while(!stack.empty()) {
+		uint32_t b = stack.back();
+		if(nextChild[b] < childStart[b + 1]) {
+			uint32_t c = children[nextChild[b]++];
+			treeEnter[c] = counter++;
+			stack.push_back(c);
+		} else {
+			treeExit[b] = counter++;
+			stack.pop_back();
+		}
+	}
+}
+
+/**
+ * Finds the natural loops. Every edge to a block that dominates its source is a back edge, and the loop it
+ * forms is everything that can reach the source without going through the header. Back edges to the same
+ * header form a single loop. If some cycle is entered other than through a dominating header, the graph
+ * is irreducible, and that cycle isn't reported as a loop.
+ */
+void ControlFlowGraph::findLoops() {
+	uint32_t n = blocks.size();
+	blockLoops.assign(n, NO_LOOP);
+	vector<uint32_t> headerLoops(n, NO_LOOP);
+	vector<bool> inLoop(n, false);
+	vector<uint32_t> worklist;
+
+	// Retreating edges go to a block that's still on the depth first search stack. The reverse postorder
+	// numbers those as coming no later than the edge's source.
+	vector<uint32_t> order(n, 0xFFFFFFFF);
+	for(uint32_t i = 0; i < reversePostorder.size(); i++) {
+		order[reversePostorder[i]] = i;
+	}
+
+	for(uint32_t i = 0; i < reversePostorder.size(); i++) {
+		uint32_t source = reversePostorder[i];
+		for(uint32_t e = edgeStart[source]; e < edgeStart[source + 1]; e++) {
+			uint32_t header = edges[e];
+			if(order[header] > order[source]) {
+				continue;
+			}
+			if(!dominates(header, source)) {
+				reducible = false;
+				continue;
+			}
+			if(headerLoops[header] == NO_LOOP) {
+				headerLoops[header] = loops.size();
+				loops.push_back(Loop());
+				loops.back().header = header;
+				loops.back().parent = NO_LOOP;
+				loops.back().depth = 1;
+			}
+			loops[headerLoops[header]].backEdgeSources.push_back(source);
+		}
+	}
+
+	for(uint32_t l = 0; l < loops.size(); l++) {
+		Loop& loop = loops[l];
+		inLoop[loop.header] = true;
+		loop.blocks.push_back(loop.header);
+		worklist.clear();
+		for(uint32_t s = 0; s < loop.backEdgeSources.size(); s++) {
+			if(!inLoop[loop.backEdgeSources[s]]) {
+				inLoop[loop.backEdgeSources[s]] = true;
+				loop.blocks.push_back(loop.backEdgeSources[s]);
+				worklist.push_back(loop.backEdgeSources[s]);
+			}
+		}
+		while(!worklist.empty()) {
+			uint32_t b = worklist.back();
+			worklist.pop_back();
+			for(uint32_t e = predecessorStart[b]; e < predecessorStart[b + 1]; e++) {
+				uint32_t p = predecessors[e];
+				if(!inLoop[p] && isReachable(p)) {
+					inLoop[p] = true;
+					loop.blocks.push_back(p);
+					worklist.push_back(p);
+				}
+			}
+		}
+		for(uint32_t b = 0; b < loop.blocks.size(); b++) {
+			inLoop[loop.blocks[b]] = false;
+		}
+		std::sort(loop.blocks.begin(), loop.blocks.end());
+	}
+
+	// A loop that contains another is always strictly bigger, so sorting by size puts parents first.
+	std::stable_sort(loops.begin(), loops.end(), sortLoopsOutermostFirst);
+	for(uint32_t l = 0; l < loops.size(); l++) {
+		Loop& loop = loops[l];
+		loop.parent = blockLoops[loop.header];
+		loop.depth = (loop.parent == NO_LOOP) ? 1 : loops[loop.parent].depth + 1;
+		for(uint32_t b = 0; b < loop.blocks.size(); b++) {
+			blockLoops[loop.blocks[b]] = l;
+		}
+	}
+}
+
+/**
+ * Gets the decoded code this graph was built from.
+ */
+const MethodCode& ControlFlowGraph::getCode() const {
+	return code;
+}
+
+/**
+ * Gets the number of basic blocks.
+ */
+uint32_t ControlFlowGraph::numBlocks() const {
+	return blocks.size();
+}
+
+/**
+ * Gets a specific basic block.
+ */
+const BasicBlock& ControlFlowGraph::operator[](uint32_t block) const {
+	if(block >= blocks.size()) {
+		throw runtime_error("Block index out of range: " + toString(block) + " >= " + toString(blocks.size()));
+	}
+	return blocks[block];
+}
+
+/**
+ * Gets the block containing the instruction with the given index in the MethodCode.
+ */
+uint32_t ControlFlowGraph::getBlockOf(uint32_t instruction) const {
+	if(instruction >= instructionBlocks.size()) {
+		throw runtime_error("Instruction index out of range: " + toString(instruction) + " >= " + toString(instructionBlocks.size()));
+	}
+	return instructionBlocks[instruction];
+}
+
+/**
+ * Gets the block containing the instruction that starts at the given pc.
+ */
+uint32_t ControlFlowGraph::getBlockAt(uint32_t pc) const {
+	uint32_t index = code.indexOf(pc);
+	if(index == MethodCode::NO_INSTRUCTION) {
+		throw runtime_error("No instruction starts at pc " + toString(pc) + ".");
+	}
+	return instructionBlocks[index];
+}
+
+/**
+ * Gets the number of successors of a block, counting exception handlers.
+ */
+uint32_t ControlFlowGraph::numSuccessors(uint32_t block) const {
+	return edgeStart[block + 1] - edgeStart[block];
+}
+
+/**
+ * Gets the number of successors of a block that aren't exception handlers. These come first.
+ */
+uint32_t ControlFlowGraph::numNormalSuccessors(uint32_t block) const {
+	return normalEdgeCount[block];
+}
+
+/**
+ * Gets a successor of a block. Indices below numNormalSuccessors() are normal control flow, and the rest
+ * are exception handlers covering the block.
+ */
+uint32_t ControlFlowGraph::getSuccessor(uint32_t block, uint32_t index) const {
+	return edges[edgeStart[block] + index];
+}
+
+/**
+ * Gets the number of predecessors of a block, counting blocks it handles exceptions for.
+ */
+uint32_t ControlFlowGraph::numPredecessors(uint32_t block) const {
+	return predecessorStart[block + 1] - predecessorStart[block];
+}
+
+/**
+ * Gets a predecessor of a block.
+ */
+uint32_t ControlFlowGraph::getPredecessor(uint32_t block, uint32_t index) const {
+	return predecessors[predecessorStart[block] + index];
+}
+
+/**
+ * Returns whether control can reach a block from the entry of the method.
+ */
+bool ControlFlowGraph::isReachable(uint32_t block) const {
+	return block == 0 || idom[block] != NO_BLOCK;
+}
+
+/**
+ * Gets the reachable blocks in reverse postorder, which visits every block before its successors, except
+ * along back edges. This is the order forward dataflow analyses converge fastest in.
+ */
+const vector<uint32_t>& ControlFlowGraph::getReversePostorder() const {
+	return reversePostorder;
+}
+
+/**
+ * Gets the immediate dominator of a block, or NO_BLOCK for the entry block and unreachable blocks.
+ */
+uint32_t ControlFlowGraph::getImmediateDominator(uint32_t block) const {
+	return idom[block];
+}
+
+/**
+ * Returns whether every path from the entry to block goes through dominator. Every block dominates itself.
+ */
+bool ControlFlowGraph::dominates(uint32_t dominator, uint32_t block) const {
+	if(!isReachable(dominator) || !isReachable(block)) {
+		return false;
+	}
+	return treeEnter[dominator] <= treeEnter[block] && treeExit[block] <= treeExit[dominator];
+}
+
+/**
+ * Returns whether every cycle in the graph is a natural loop. Java compilers only ever generate reducible
+ * graphs, but hand-written or obfuscated bytecode may not be.
+ */
+bool ControlFlowGraph::isReducible() const {
+	return reducible;
+}
+
+/**
+ * Gets the natural loops, outermost loops first.
+ */
+const vector<Loop>& ControlFlowGraph::getLoops() const {
+	return loops;
+}
+
+/**
+ * Gets the innermost loop containing a block, or NO_LOOP.
+ */
+uint32_t ControlFlowGraph::getLoopOf(uint32_t block) const {
+	return blockLoops[block];
+}
+
+/**
+ * Gets how many loops a block is nested inside of.
+ */
+uint32_t ControlFlowGraph::getLoopDepth(uint32_t block) const {
+	return blockLoops[block] == NO_LOOP ? 0 : loops[blockLoops[block]].depth;
+}
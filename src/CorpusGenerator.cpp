@@ -0,0 +1,491 @@
+#include "CorpusGenerator.h"
+#include "Constants.h"
+#include "Util.h"
+
+#include <zip.h>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+using std::string;
+using std::vector;
+using std::map;
+using std::ostream;
+using std::ostringstream;
+using std::runtime_error;
+
+namespace {
+	const char* const OBJECT_CLASS = "java/lang/Object";
+	const char* const EXCEPTION_CLASS = "java/lang/Exception";
+
+	/**
+	 * SplitMix64, which is tiny, fast, and fully specified, unlike the distributions in <random>, whose
+	 * output differs between standard libraries. Each class gets its own generator for each purpose, so
+	 * what one class draws never shifts another.
+	 */
+	class Random {
+	private:
+		uint64_t state;
+	public:
+		Random(uint64_t seed, uint64_t index, uint64_t stream) : state(seed ^ (index * 0x9e3779b97f4a7c15ULL) ^ (stream << 56)) {}
+
+		uint64_t next() {
+			uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+			return z ^ (z >> 31);
+		}
+
+		/**
+		 * Gets a number from 0 up to but not including bound. The modulo bias is irrelevant here.
+		 */
+		uint32_t below(uint32_t bound) {
+			return bound == 0 ? 0 : next() % bound;
+		}
+	};
+
+	const uint64_t REFERENCE_STREAM = 0;
+	const uint64_t CONTENT_STREAM = 1;
+
+	/**
+	 * Builds a constant pool, handing out indexes as constants are added. Named constants are shared, like
+	 * a compiler would, but the padding constants aren't.
+	 */
+	class ConstantPoolBuilder {
+	private:
+		const string& className;
+		ostringstream pool;
+		uint32_t count;
+		map<string, uint16_t> utf8s;
+		map<string, uint16_t> classes;
+
+		uint16_t next(uint32_t slots) {
+			if(count + slots > 0xffff) {
+				throw runtime_error("The constant pool of " + className + " has more than 65535 entries");
+			}
+			uint16_t index = count;
+			count += slots;
+			return index;
+		}
+	public:
+		ConstantPoolBuilder(const string& className) : className(className), count(1) {}
+
+		uint32_t size() const {
+			return count;
+		}
+
+		uint16_t addUtf8(const string& value) {
+			uint16_t index = next(1);
+			writeByteUnsigned(pool, CONSTANT_Utf8);
+			writeShortUnsigned(pool, value.size());
+			pool << value;
+			return index;
+		}
+
+		uint16_t utf8(const string& value) {
+			map<string, uint16_t>::iterator existing = utf8s.find(value);
+			if(existing != utf8s.end()) {
+				return existing->second;
+			}
+			return utf8s[value] = addUtf8(value);
+		}
+
+		uint16_t classInfo(const string& name) {
+			map<string, uint16_t>::iterator existing = classes.find(name);
+			if(existing != classes.end()) {
+				return existing->second;
+			}
+			uint16_t nameIndex = utf8(name);
+			uint16_t index = next(1);
+			writeByteUnsigned(pool, CONSTANT_Class);
+			writeShortUnsigned(pool, nameIndex);
+			return classes[name] = index;
+		}
+
+		uint16_t integer(int32_t value) {
+			uint16_t index = next(1);
+			writeByteUnsigned(pool, CONSTANT_Integer);
+			writeIntUnsigned(pool, value);
+			return index;
+		}
+
+		uint16_t longConstant(int64_t value) {
+			uint16_t index = next(2);
+			writeByteUnsigned(pool, CONSTANT_Long);
+			writeLongUnsigned(pool, value);
+			return index;
+		}
+
+		uint16_t stringConstant(const string& value) {
+			uint16_t valueIndex = addUtf8(value);
+			uint16_t index = next(1);
+			writeByteUnsigned(pool, CONSTANT_String);
+			writeShortUnsigned(pool, valueIndex);
+			return index;
+		}
+
+		uint16_t memberReference(uint8_t type, const string& owner, const string& name, const string& descriptor) {
+			uint16_t ownerIndex = classInfo(owner);
+			uint16_t nameIndex = utf8(name);
+			uint16_t descriptorIndex = utf8(descriptor);
+			uint16_t nameAndType = next(1);
+			writeByteUnsigned(pool, CONSTANT_NameAndType);
+			writeShortUnsigned(pool, nameIndex);
+			writeShortUnsigned(pool, descriptorIndex);
+			uint16_t index = next(1);
+			writeByteUnsigned(pool, type);
+			writeShortUnsigned(pool, ownerIndex);
+			writeShortUnsigned(pool, nameAndType);
+			return index;
+		}
+
+		/**
+		 * Writes the constant pool count and the constants.
+		 */
+		void write(ostream& out) const {
+			writeShortUnsigned(out, count);
+			out << pool.str();
+		}
+	};
+
+	/**
+	 * Writes the header of a class, up to and including its constant pool.
+	 */
+	void writeHeader(ostream& out, const ConstantPoolBuilder& pool) {
+		writeIntUnsigned(out, 0xcafebabe);
+		writeShortUnsigned(out, 0);
+		writeShortUnsigned(out, 50);
+		pool.write(out);
+	}
+
+	/**
+	 * Makes up an identifier-like string for padding the constant pool.
+	 */
+	string randomString(Random& random) {
+		static const char letters[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_$0123456789";
+		string value(4 + random.below(28), 'a');
+		for(string::iterator it = value.begin(); it != value.end(); it++) {
+			*it = letters[random.below(sizeof(letters) - 1)];
+		}
+		return value;
+	}
+}
+
+/**
+ * Constructor for CorpusOptions, with the defaults.
+ */
+CorpusOptions::CorpusOptions() :
+	numClasses(100),
+	packageName("gen"),
+	seed(1),
+	constantPoolSize(0),
+	fields(4),
+	methods(8),
+	codeLength(32),
+	graph(TREE),
+	fanout(2),
+	lineNumbers(true),
+	sourceFile(true),
+	constantValues(true),
+	exceptions(false),
+	customAttributeSize(0),
+	includeRuntime(true) {
+
+}
+
+/**
+ * Constructor for CorpusGenerator.
+ */
+CorpusGenerator::CorpusGenerator(const CorpusOptions& options) : options(options) {
+	if(this->options.codeLength == 0) {
+		this->options.codeLength = 1;
+	}
+	if(this->options.codeLength > 65535) {
+		throw runtime_error("Methods can't have more than 65535 bytes of code");
+	}
+}
+
+/**
+ * Destructor for CorpusGenerator.
+ */
+CorpusGenerator::~CorpusGenerator() {
+
+}
+
+/**
+ * Gets the options the corpus is generated from.
+ */
+const CorpusOptions& CorpusGenerator::getOptions() const {
+	return options;
+}
+
+/**
+ * Gets the internal name of the class with the given index, like gen/C12.
+ */
+string CorpusGenerator::getClassName(unsigned int index) const {
+	string prefix = options.packageName.empty() ? "" : options.packageName + "/";
+	return prefix + "C" + toString(index);
+}
+
+/**
+ * Gets the indexes of the classes the given class refers to, following the reference graph.
+ */
+vector<unsigned int> CorpusGenerator::getReferences(unsigned int index) const {
+	vector<unsigned int> references;
+	if(options.graph == CorpusOptions::TREE) {
+		for(unsigned int i = 1; i <= options.fanout; i++) {
+			uint64_t child = static_cast<uint64_t>(options.fanout) * index + i;
+			if(child < options.numClasses) {
+				references.push_back(child);
+			}
+		}
+	} else if(options.graph == CorpusOptions::CHAIN) {
+		if(index + 1 < options.numClasses) {
+			references.push_back(index + 1);
+		}
+	} else {
+		Random random(options.seed, index, REFERENCE_STREAM);
+		for(unsigned int i = 0; i < options.fanout; i++) {
+			references.push_back(random.below(options.numClasses));
+		}
+	}
+	return references;
+}
+
+/**
+ * Gets the names of the stand-ins for the JRE classes that generated classes refer to, which are added to
+ * jars when includeRuntime is set. They're empty classes, with nothing but a name and a superclass.
+ */
+vector<string> CorpusGenerator::getRuntimeClasses() const {
+	vector<string> classes;
+	if(options.includeRuntime) {
+		classes.push_back(OBJECT_CLASS);
+		if(options.exceptions) {
+			classes.push_back(EXCEPTION_CLASS);
+		}
+	}
+	return classes;
+}
+
+/**
+ * Writes an empty class with the given superclass, or none if it's empty.
+ */
+void CorpusGenerator::generateRuntimeClass(const string& name, const string& superName, ostream& out) const {
+	ConstantPoolBuilder pool(name);
+	uint16_t thisClass = pool.classInfo(name);
+	uint16_t superClass = superName.empty() ? 0 : pool.classInfo(superName);
+	writeHeader(out, pool);
+	writeShortUnsigned(out, ACC_PUBLIC | ACC_SUPER);
+	writeShortUnsigned(out, thisClass);
+	writeShortUnsigned(out, superClass);
+	writeShortUnsigned(out, 0); // Interfaces
+	writeShortUnsigned(out, 0); // Fields
+	writeShortUnsigned(out, 0); // Methods
+	writeShortUnsigned(out, 0); // Attributes
+}
+
+/**
+ * Writes the class with the given index. Every method is static and void, and its code stores and loads
+ * a local, reads the class's own fields, and calls the first method of each class it refers to, padded
+ * out with nops to the code length and ending in a return.
+ */
+void CorpusGenerator::generateClass(unsigned int index, ostream& out) const {
+	const string name = getClassName(index);
+	const string simpleName = name.substr(name.rfind('/') + 1);
+	Random random(options.seed, index, CONTENT_STREAM);
+	ConstantPoolBuilder pool(name);
+
+	uint16_t thisClass = pool.classInfo(name);
+	uint16_t superClass = pool.classInfo(OBJECT_CLASS);
+	vector<uint16_t> calls;
+	vector<unsigned int> references = getReferences(index);
+	for(vector<unsigned int>::iterator it = references.begin(); it != references.end(); it++) {
+		if(options.methods > 0) {
+			calls.push_back(pool.memberReference(CONSTANT_Methodref, getClassName(*it), "method0", "()V"));
+		} else {
+			pool.classInfo(getClassName(*it));
+		}
+	}
+	vector<uint16_t> fieldReferences;
+	for(unsigned int i = 0; i < options.fields; i++) {
+		fieldReferences.push_back(pool.memberReference(CONSTANT_Fieldref, name, "field" + toString(i), "I"));
+	}
+	uint16_t exceptionClass = options.exceptions ? pool.classInfo(EXCEPTION_CLASS) : 0;
+
+	uint16_t codeName = pool.utf8("Code");
+	uint16_t methodDescriptor = pool.utf8("()V");
+	uint16_t fieldDescriptor = pool.utf8("I");
+	uint16_t lineNumbersName = options.lineNumbers ? pool.utf8("LineNumberTable") : 0;
+	uint16_t constantValueName = options.constantValues ? pool.utf8("ConstantValue") : 0;
+	uint16_t exceptionsName = options.exceptions ? pool.utf8("Exceptions") : 0;
+	uint16_t sourceFileName = options.sourceFile ? pool.utf8("SourceFile") : 0;
+	uint16_t sourceFile = options.sourceFile ? pool.utf8(simpleName + ".java") : 0;
+	uint16_t customName = options.customAttributeSize > 0 ? pool.utf8("Padding") : 0;
+	vector<uint16_t> fieldValues;
+	for(unsigned int i = 0; i < options.fields && options.constantValues; i++) {
+		fieldValues.push_back(pool.integer(random.next()));
+	}
+	vector<uint16_t> methodNames;
+	for(unsigned int i = 0; i < options.methods; i++) {
+		methodNames.push_back(pool.utf8("method" + toString(i)));
+	}
+
+	while(pool.size() < options.constantPoolSize) {
+		uint32_t kind = random.below(4);
+		if(kind == 0) {
+			pool.integer(random.next());
+		} else if(kind == 1 && pool.size() + 2 <= options.constantPoolSize) {
+			pool.longConstant(random.next());
+		} else if(kind == 2 && pool.size() + 2 <= options.constantPoolSize) {
+			pool.stringConstant(randomString(random));
+		} else {
+			pool.addUtf8(randomString(random));
+		}
+	}
+
+	writeHeader(out, pool);
+	writeShortUnsigned(out, ACC_PUBLIC | ACC_SUPER);
+	writeShortUnsigned(out, thisClass);
+	writeShortUnsigned(out, superClass);
+	writeShortUnsigned(out, 0);
+
+	writeShortUnsigned(out, options.fields);
+	for(unsigned int i = 0; i < options.fields; i++) {
+		writeShortUnsigned(out, ACC_PUBLIC | ACC_STATIC | (options.constantValues ? ACC_FINAL : 0));
+		writeShortUnsigned(out, pool.utf8("field" + toString(i)));
+		writeShortUnsigned(out, fieldDescriptor);
+		if(options.constantValues) {
+			writeShortUnsigned(out, 1);
+			writeShortUnsigned(out, constantValueName);
+			writeIntUnsigned(out, 2);
+			writeShortUnsigned(out, fieldValues[i]);
+		} else {
+			writeShortUnsigned(out, 0);
+		}
+	}
+
+	writeShortUnsigned(out, options.methods);
+	for(unsigned int i = 0; i < options.methods; i++) {
+		// Builds the code a statement at a time, keeping the stack balanced after each one.
+		string code;
+		vector<uint16_t> lineStarts;
+		bool stored = false;
+		while(code.size() + 1 < options.codeLength) {
+			size_t left = options.codeLength - 1 - code.size();
+			uint32_t kind = random.below(4);
+			lineStarts.push_back(code.size());
+			if(kind == 0 && !calls.empty() && left >= 3) {
+				uint16_t call = calls[random.below(calls.size())];
+				code += static_cast<char>(BY_invokestatic);
+				code += static_cast<char>(call >> 8);
+				code += static_cast<char>(call);
+			} else if(kind == 1 && !fieldReferences.empty() && left >= 4) {
+				uint16_t field = fieldReferences[random.below(fieldReferences.size())];
+				code += static_cast<char>(BY_getstatic);
+				code += static_cast<char>(field >> 8);
+				code += static_cast<char>(field);
+				code += static_cast<char>(BY_pop);
+			} else if(kind == 2 && stored && left >= 2) {
+				code += static_cast<char>(BY_iload_0);
+				code += static_cast<char>(BY_pop);
+			} else if(left >= 3) {
+				code += static_cast<char>(BY_bipush);
+				code += static_cast<char>(random.below(256));
+				code += static_cast<char>(BY_istore_0);
+				stored = true;
+			} else {
+				code.append(left, static_cast<char>(BY_nop));
+			}
+		}
+		lineStarts.push_back(code.size());
+		code += static_cast<char>(BY_return);
+
+		uint32_t lineNumbersLength = 2 + 4 * lineStarts.size();
+		uint32_t codeLength = 12 + code.size() + (options.lineNumbers ? 6 + lineNumbersLength : 0);
+		writeShortUnsigned(out, ACC_PUBLIC | ACC_STATIC);
+		writeShortUnsigned(out, methodNames[i]);
+		writeShortUnsigned(out, methodDescriptor);
+		writeShortUnsigned(out, options.exceptions ? 2 : 1);
+		writeShortUnsigned(out, codeName);
+		writeIntUnsigned(out, codeLength);
+		writeShortUnsigned(out, 1); // Stack
+		writeShortUnsigned(out, 1); // Locals
+		writeIntUnsigned(out, code.size());
+		out << code;
+		writeShortUnsigned(out, 0); // Exception table
+		if(options.lineNumbers) {
+			writeShortUnsigned(out, 1);
+			writeShortUnsigned(out, lineNumbersName);
+			writeIntUnsigned(out, lineNumbersLength);
+			writeShortUnsigned(out, lineStarts.size());
+			for(size_t line = 0; line < lineStarts.size(); line++) {
+				writeShortUnsigned(out, lineStarts[line]);
+				writeShortUnsigned(out, line + 1);
+			}
+		} else {
+			writeShortUnsigned(out, 0);
+		}
+		if(options.exceptions) {
+			writeShortUnsigned(out, exceptionsName);
+			writeIntUnsigned(out, 4);
+			writeShortUnsigned(out, 1);
+			writeShortUnsigned(out, exceptionClass);
+		}
+	}
+
+	writeShortUnsigned(out, (options.sourceFile ? 1 : 0) + (options.customAttributeSize > 0 ? 1 : 0));
+	if(options.sourceFile) {
+		writeShortUnsigned(out, sourceFileName);
+		writeIntUnsigned(out, 2);
+		writeShortUnsigned(out, sourceFile);
+	}
+	if(options.customAttributeSize > 0) {
+		writeShortUnsigned(out, customName);
+		writeIntUnsigned(out, options.customAttributeSize);
+		for(unsigned int i = 0; i < options.customAttributeSize; i++) {
+			writeByteUnsigned(out, random.below(256));
+		}
+	}
+}
+
+/**
+ * Writes the whole corpus to a jar, along with the runtime stand-ins if they're wanted.
+ */
+void CorpusGenerator::writeJar(const string& path) const {
+	vector<string> names = getRuntimeClasses();
+	// libzip only reads the buffers when the jar is closed, so every class is kept until then.
+	vector<string> classes;
+	for(vector<string>::iterator it = names.begin(); it != names.end(); it++) {
+		ostringstream out;
+		generateRuntimeClass(*it, *it == OBJECT_CLASS ? "" : OBJECT_CLASS, out);
+		classes.push_back(out.str());
+	}
+	for(unsigned int i = 0; i < options.numClasses; i++) {
+		ostringstream out;
+		generateClass(i, out);
+		names.push_back(getClassName(i));
+		classes.push_back(out.str());
+	}
+
+	int error = 0;
+	struct zip* jar = zip_open(path.c_str(), ZIP_CREATE | ZIP_TRUNCATE, &error);
+	if(!jar) {
+		throw runtime_error("Could not create " + path + ": libzip error " + toString(error));
+	}
+	for(size_t i = 0; i < classes.size(); i++) {
+		struct zip_source* source = zip_source_buffer(jar, classes[i].data(), classes[i].size(), 0);
+		if(!source || zip_file_add(jar, (names[i] + ".class").c_str(), source, ZIP_FL_OVERWRITE) < 0) {
+			string message = zip_strerror(jar);
+			if(source) {
+				zip_source_free(source);
+			}
+			zip_discard(jar);
+			throw runtime_error("Could not add " + names[i] + " to " + path + ": " + message);
+		}
+	}
+	if(zip_close(jar) != 0) {
+		string message = zip_strerror(jar);
+		zip_discard(jar);
+		throw runtime_error("Could not write " + path + ": " + message);
+	}
+}
@@ -0,0 +1,198 @@
+#include "DependencyGraph.h"
+#include "Util.h"
+
+using std::string;
+using std::vector;
+using std::map;
+using std::set;
+using std::ostream;
+using std::endl;
+
+namespace {
+	typedef map<string, set<string> > Edges;
+
+	/**
+	 * Gets the classes at the other end of a class's edges, or nothing if it has none.
+	 */
+	vector<string> getEdges(const Edges& edges, const string& name) {
+		Edges::const_iterator it = edges.find(name);
+		if(it == edges.end()) {
+			return vector<string>();
+		}
+		return vector<string>(it->second.begin(), it->second.end());
+	}
+
+	/**
+	 * Writes a DOT ID as a quoted string. Quotes have to be escaped, and so do backslashes, which Graphviz would
+	 * otherwise read as escapes when it uses the ID as a label.
+	 */
+	void writeDotId(ostream& out, const string& id) {
+		out << '"';
+		for(string::const_iterator it = id.begin(); it != id.end(); it++) {
+			if(*it == '"' || *it == '\\') {
+				out << '\\';
+			}
+			out << *it;
+		}
+		out << '"';
+	}
+}
+
+/*
+ * DependencyGraph {
+ * 		u4 magic;			// "DJDG"
+ * 		u2 version;
+ * 		u4 classes_count;
+ * 		Class classes[classes_count];
+ * }
+ * Class {
+ * 		u2 name_length;
+ * 		u1 name[name_length];
+ * 		u4 dependencies_count;
+ * 		u4 dependencies[dependencies_count];	// indexes into classes
+ * }
+ */
+
+/**
+ * Constructor for DependencyGraph. It starts out empty.
+ */
+DependencyGraph::DependencyGraph() {
+
+}
+
+/**
+ * Destructor for DependencyGraph.
+ */
+DependencyGraph::~DependencyGraph() {
+
+}
+
+/**
+ * Records the classes a class refers to, replacing whatever it was recorded with before. A class that refers
+ * to itself doesn't get an edge to itself.
+ */
+void DependencyGraph::addClass(const string& name, const vector<string>& references) {
+	removeClass(name);
+	set<string>& edges = dependencies[name];
+	dependents[name];
+	for(vector<string>::const_iterator it = references.begin(); it != references.end(); it++) {
+		if(*it != name) {
+			edges.insert(*it);
+			dependents[*it].insert(name);
+			dependencies[*it];
+		}
+	}
+}
+
+/**
+ * Forgets the edges a class was recorded with. Classes that refer to it keep their edges to it, so it stays in
+ * the graph as long as anything does.
+ */
+void DependencyGraph::removeClass(const string& name) {
+	Edges::iterator it = dependencies.find(name);
+	if(it == dependencies.end()) {
+		return;
+	}
+	for(set<string>::iterator dependency = it->second.begin(); dependency != it->second.end(); dependency++) {
+		dependents[*dependency].erase(name);
+	}
+	it->second.clear();
+}
+
+/**
+ * Whether a class has been recorded, or is referred to by one that has.
+ */
+bool DependencyGraph::contains(const string& name) const {
+	return dependencies.count(name) > 0;
+}
+
+/**
+ * Gets the name of every class in the graph, in sorted order.
+ */
+vector<string> DependencyGraph::getClasses() const {
+	vector<string> names;
+	for(Edges::const_iterator it = dependencies.begin(); it != dependencies.end(); it++) {
+		names.push_back(it->first);
+	}
+	return names;
+}
+
+/**
+ * Gets the classes a class refers to directly, in sorted order.
+ */
+vector<string> DependencyGraph::getDependencies(const string& name) const {
+	return getEdges(dependencies, name);
+}
+
+/**
+ * Gets the classes that refer to a class directly, in sorted order.
+ */
+vector<string> DependencyGraph::getDependents(const string& name) const {
+	return getEdges(dependents, name);
+}
+
+/**
+ * Gets every class a change to the given ones affects: the changed classes themselves, and every class that
+ * refers to one of them, directly or not.
+ */
+set<string> DependencyGraph::getAffected(const vector<string>& changed) const {
+	set<string> affected(changed.begin(), changed.end());
+	vector<string> pending(changed.begin(), changed.end());
+	while(!pending.empty()) {
+		string name = pending.back();
+		pending.pop_back();
+		Edges::const_iterator it = dependents.find(name);
+		if(it == dependents.end()) {
+			continue;
+		}
+		for(set<string>::const_iterator dependent = it->second.begin(); dependent != it->second.end(); dependent++) {
+			if(affected.insert(*dependent).second) {
+				pending.push_back(*dependent);
+			}
+		}
+	}
+	return affected;
+}
+
+/**
+ * Writes the graph in Graphviz's DOT language, with an edge from every class to each class it refers to.
+ */
+void DependencyGraph::writeDot(ostream& out) const {
+	out << "digraph classes {" << endl;
+	for(Edges::const_iterator it = dependencies.begin(); it != dependencies.end(); it++) {
+		out << '\t';
+		writeDotId(out, it->first);
+		out << ';' << endl;
+		for(set<string>::const_iterator dependency = it->second.begin(); dependency != it->second.end(); dependency++) {
+			out << '\t';
+			writeDotId(out, it->first);
+			out << " -> ";
+			writeDotId(out, *dependency);
+			out << ';' << endl;
+		}
+	}
+	out << '}' << endl;
+}
+
+/**
+ * Writes the graph as compact adjacency lists, big-endian like a class file: every class's name, then the
+ * indexes of the classes it refers to. Classes are in sorted order, so the same graph is always written the same.
+ */
+void DependencyGraph::writeBinary(ostream& out) const {
+	map<string, uint32_t> indexes;
+	for(Edges::const_iterator it = dependencies.begin(); it != dependencies.end(); it++) {
+		uint32_t index = indexes.size();
+		indexes[it->first] = index;
+	}
+	out.write("DJDG", 4);
+	writeShortUnsigned(out, 1);
+	writeIntUnsigned(out, dependencies.size());
+	for(Edges::const_iterator it = dependencies.begin(); it != dependencies.end(); it++) {
+		writeShortUnsigned(out, it->first.size());
+		out.write(it->first.data(), it->first.size());
+		writeIntUnsigned(out, it->second.size());
+		for(set<string>::const_iterator dependency = it->second.begin(); dependency != it->second.end(); dependency++) {
+			writeIntUnsigned(out, indexes[*dependency]);
+		}
+	}
+}
@@ -0,0 +1,263 @@
+#include "Descriptor.h"
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+using std::string;
+using std::vector;
+using std::unordered_map;
+using std::mutex;
+using std::lock_guard;
+using std::runtime_error;
+
+namespace {
+	/**
+	 * Every type parsed so far, keyed by descriptor, split into shards by the descriptor's hash so that threads
+	 * parsing different classes rarely wait on the same lock. The registries are never destroyed, so types stay
+	 * valid while classes are torn down during exit.
+	 */
+	template<class T>
+	struct Registry {
+		static const size_t SHARDS = 64;
+
+		struct alignas(64) Shard {
+			mutex lock;
+			unordered_map<string, const T*> types;
+		};
+
+		Shard shards[SHARDS];
+
+		Shard& getShard(const string& descriptor) {
+			return shards[std::hash<string>()(descriptor) % SHARDS];
+		}
+	};
+}
+
+/**
+ * Parses a field descriptor, which has to be the whole string.
+ */
+FieldType::FieldType(const string& descriptor) : descriptor(descriptor), dimensions(0), componentType(NULL) {
+	if(descriptor.empty() || scan(descriptor, 0) != descriptor.size()) {
+		throw runtime_error("Malformed field descriptor " + descriptor);
+	}
+	string::size_type start = descriptor.find_first_not_of('[');
+	if(start > 255) {
+		throw runtime_error("Too many array dimensions in " + descriptor);
+	}
+	dimensions = start;
+	elementKind = static_cast<Kind>(descriptor[start]);
+	kind = dimensions > 0 ? ARRAY : elementKind;
+	if(elementKind == REFERENCE) {
+		className = descriptor.substr(start + 1, descriptor.size() - start - 2);
+	}
+	slots = (kind == LONG || kind == DOUBLE) ? 2 : (kind == VOID ? 0 : 1);
+}
+
+/**
+ * Gets the interned type for a field descriptor, or V. Throws if it's malformed.
+ */
+const FieldType& FieldType::get(const string& descriptor) {
+	static Registry<FieldType>* registry = new Registry<FieldType>();
+	Registry<FieldType>::Shard& shard = registry->getShard(descriptor);
+	lock_guard<mutex> guard(shard.lock);
+	const FieldType*& type = shard.types[descriptor];
+	if(!type) {
+		try {
+			type = new FieldType(descriptor);
+		} catch(...) {
+			shard.types.erase(descriptor);
+			throw;
+		}
+	}
+	return *type;
+}
+
+/**
+ * Gets the interned type for the name in a CONSTANT_Class_info, which is a descriptor for arrays, like [I or
+ * [Ljava/lang/String;, and an internal name, like java/lang/String, for everything else. Class types are also
+ * registered under their bare name, so only the first lookup of a name builds its descriptor.
+ */
+const FieldType& FieldType::forClassName(const string& name) {
+	if(!name.empty() && name[0] == ARRAY) {
+		return get(name);
+	}
+	static Registry<FieldType>* registry = new Registry<FieldType>();
+	Registry<FieldType>::Shard& shard = registry->getShard(name);
+	{
+		lock_guard<mutex> guard(shard.lock);
+		unordered_map<string, const FieldType*>::iterator it = shard.types.find(name);
+		if(it != shard.types.end()) {
+			return *(it->second);
+		}
+	}
+	const FieldType& type = get("L" + name + ";");
+	lock_guard<mutex> guard(shard.lock);
+	shard.types[name] = &type;
+	return type;
+}
+
+/**
+ * Finds where the field type starting at a position in a descriptor ends. Throws if there isn't a legal one
+ * there. Arrays of void aren't legal.
+ */
+string::size_type FieldType::scan(const string& descriptor, string::size_type start) {
+	string::size_type i = start;
+	while(i < descriptor.size() && descriptor[i] == '[') {
+		i++;
+	}
+	if(i >= descriptor.size()) {
+		throw runtime_error("Malformed descriptor " + descriptor);
+	}
+	switch(descriptor[i]) {
+		case BYTE:
+		case CHAR:
+		case DOUBLE:
+		case FLOAT:
+		case INT:
+		case LONG:
+		case SHORT:
+		case BOOLEAN:
+			return i + 1;
+		case VOID:
+			if(i != start) {
+				throw runtime_error("Malformed descriptor " + descriptor);
+			}
+			return i + 1;
+		case REFERENCE: {
+			string::size_type end = descriptor.find(';', i);
+			if(end == string::npos || end == i + 1) {
+				throw runtime_error("Malformed descriptor " + descriptor);
+			}
+			return end + 1;
+		}
+		default:
+			throw runtime_error("Malformed descriptor " + descriptor);
+	}
+}
+
+/**
+ * Gets the descriptor this type was parsed from.
+ */
+const string& FieldType::getDescriptor() const {
+	return descriptor;
+}
+
+/**
+ * Gets what sort of type this is. Arrays are ARRAY, whatever they hold.
+ */
+FieldType::Kind FieldType::getKind() const {
+	return kind;
+}
+
+/**
+ * Gets the type of the elements of an array, all the way down, or the kind itself if this isn't an array.
+ */
+FieldType::Kind FieldType::getElementKind() const {
+	return elementKind;
+}
+
+/**
+ * Gets the number of array dimensions, which is zero if this isn't an array.
+ */
+uint8_t FieldType::getDimensions() const {
+	return dimensions;
+}
+
+/**
+ * Gets the internal name of the class this type refers to, which is the element class for arrays, or an empty
+ * string if it doesn't refer to a class.
+ */
+const string& FieldType::getClassName() const {
+	return className;
+}
+
+/**
+ * Gets the type of the elements of an array one dimension down, like [I for [[I. Throws if this isn't an array.
+ */
+const FieldType& FieldType::getComponentType() const {
+	const FieldType* type = componentType.load(std::memory_order_acquire);
+	if(!type) {
+		if(kind != ARRAY) {
+			throw runtime_error(descriptor + " is not an array type");
+		}
+		type = &get(descriptor.substr(1));
+		componentType.store(type, std::memory_order_release);
+	}
+	return *type;
+}
+
+/**
+ * Parses a method descriptor.
+ */
+MethodType::MethodType(const string& descriptor) : descriptor(descriptor), returnType(NULL), argumentSlots(0) {
+	if(descriptor.empty() || descriptor[0] != '(') {
+		throw runtime_error("Malformed method descriptor " + descriptor);
+	}
+	string::size_type i = 1;
+	while(i < descriptor.size() && descriptor[i] != ')') {
+		if(descriptor[i] == FieldType::VOID) {
+			throw runtime_error("Malformed method descriptor " + descriptor);
+		}
+		string::size_type end = FieldType::scan(descriptor, i);
+		parameters.push_back(&FieldType::get(descriptor.substr(i, end - i)));
+		argumentSlots += parameters.back()->getSlots();
+		i = end;
+	}
+	if(i >= descriptor.size() || FieldType::scan(descriptor, i + 1) != descriptor.size()) {
+		throw runtime_error("Malformed method descriptor " + descriptor);
+	}
+	returnType = &FieldType::get(descriptor.substr(i + 1));
+
+	vector<const FieldType*> types(parameters);
+	types.push_back(returnType);
+	for(vector<const FieldType*>::iterator it = types.begin(); it != types.end(); it++) {
+		const string& name = (*it)->getClassName();
+		if(!name.empty() && std::find(referencedClasses.begin(), referencedClasses.end(), name) == referencedClasses.end()) {
+			referencedClasses.push_back(name);
+		}
+	}
+}
+
+/**
+ * Gets the interned type for a method descriptor. Throws if it's malformed.
+ */
+const MethodType& MethodType::get(const string& descriptor) {
+	static Registry<MethodType>* registry = new Registry<MethodType>();
+	Registry<MethodType>::Shard& shard = registry->getShard(descriptor);
+	lock_guard<mutex> guard(shard.lock);
+	const MethodType*& type = shard.types[descriptor];
+	if(!type) {
+		try {
+			type = new MethodType(descriptor);
+		} catch(...) {
+			shard.types.erase(descriptor);
+			throw;
+		}
+	}
+	return *type;
+}
+
+/**
+ * Gets the descriptor this type was parsed from.
+ */
+const string& MethodType::getDescriptor() const {
+	return descriptor;
+}
+
+/**
+ * Gets the return type, which is VOID for methods that don't return anything.
+ */
+const FieldType& MethodType::getReturnType() const {
+	return *returnType;
+}
+
+/**
+ * Gets the internal names of the classes the parameters and return type refer to, once each, in the order
+ * they appear.
+ */
+const vector<string>& MethodType::getReferencedClasses() const {
+	return referencedClasses;
+}
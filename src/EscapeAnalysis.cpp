@@ -0,0 +1,744 @@
+#include "EscapeAnalysis.h"
+#include "Bytecode.h"
+#include "ControlFlowGraph.h"
+#include "ClassFile.h"
+#include "Descriptor.h"
+#include "Util.h"
+
+#include <map>
+#include <set>
+#include <algorithm>
+#include <stdexcept>
+
+using std::vector;
+using std::map;
+using std::set;
+using std::pair;
+using std::make_pair;
+using std::string;
+using std::runtime_error;
+
+namespace {
+	/**
+	 * Abstract values held in locals and operand stack slots. Non-negative values are abstract objects: the
+	 * method's reference parameters, followed by its allocation sites.
+	 */
+	const int32_t UNTRACKED = -1;
+	const int32_t NULL_VALUE = -2;
+
+	/**
+	 * An abstract object. Objects that can end up in the same slot are merged with union-find, and the
+	 * flags of a merged set are the combination of its members' flags.
+	 */
+	struct AbstractObject {
+		int32_t parent;
+		EscapeAnalysis::EscapeState state;
+		bool external;
+		bool ambiguous;
+		bool compared;
+		bool stored;
+		set<uint16_t> fields;
+	};
+
+	struct FrameState {
+		bool reached;
+		vector<int32_t> locals;
+		vector<int32_t> stack;
+	};
+
+	/**
+	 * Does the actual work for EscapeAnalysis: a worklist dataflow analysis over the basic blocks, which is
+	 * rerun until the set of merged objects and values stored in fields stop changing.
+	 */
+	class Analyzer {
+	private:
+		ClassFile& cf;
+		const ClassMember& method;
+		const CodeAttribute& code;
+		MethodCode instructions;
+		ControlFlowGraph graph;
+		VirtualMachine* vm;
+		unsigned int calleeDepth;
+
+		vector<AbstractObject> objects;
+		vector<int32_t> parameterObjects;
+		map<uint32_t, int32_t> siteObjects;
+		vector<FrameState> states;
+		vector<pair<int32_t, int32_t> > storeEdges;
+		map<pair<int32_t, uint16_t>, int32_t> fieldValues;
+		map<uint16_t, vector<EscapeAnalysis::EscapeState> > calleeSummaries;
+		bool changed;
+
+		int32_t find(int32_t object);
+		int32_t canonical(int32_t value);
+		int32_t newObject(EscapeAnalysis::EscapeState state);
+		int32_t merge(int32_t target, int32_t incoming);
+		bool mergeInto(FrameState& target, const FrameState& incoming);
+		void escape(int32_t value, EscapeAnalysis::EscapeState state);
+
+		int32_t pop(FrameState& state);
+		void pop(FrameState& state, uint16_t slots);
+		void push(FrameState& state, int32_t value, uint16_t slots = 1);
+		void setLocal(FrameState& state, uint16_t index, int32_t value, uint16_t slots = 1);
+
+		bool isTrivialConstructor(uint16_t methodIndex, uint8_t opcode);
+		const vector<EscapeAnalysis::EscapeState>& getCalleeSummary(uint16_t methodIndex, uint8_t opcode);
+		void transfer(const Instruction& instruction, FrameState& state);
+		void run();
+	public:
+		Analyzer(ClassFile& cf, const ClassMember& method, const CodeAttribute& code, VirtualMachine* vm, unsigned int calleeDepth);
+
+		void analyze(vector<EscapeAnalysis::AllocationSite>& sites, vector<EscapeAnalysis::EscapeState>& parameterStates);
+	};
+
+	Analyzer::Analyzer(ClassFile& cf, const ClassMember& method, const CodeAttribute& code, VirtualMachine* vm, unsigned int calleeDepth) :
+		cf(cf), method(method), code(code), instructions(code), graph(instructions), vm(vm), calleeDepth(calleeDepth), changed(false) {
+
+	}
+
+	int32_t Analyzer::find(int32_t object) {
+		while(objects[object].parent != object) {
+			objects[object].parent = objects[objects[object].parent].parent;
+			object = objects[object].parent;
+		}
+		return object;
+	}
+
+	int32_t Analyzer::canonical(int32_t value) {
+		return value < 0 ? value : find(value);
+	}
+
+	int32_t Analyzer::newObject(EscapeAnalysis::EscapeState state) {
+		AbstractObject object;
+		object.parent = objects.size();
+		object.state = state;
+		object.external = false;
+		object.ambiguous = false;
+		object.compared = false;
+		object.stored = false;
+		objects.push_back(object);
+		return object.parent;
+	}
+
+	/**
+	 * Merges an incoming value into the value already in a slot, and returns the merged value. Two different
+	 * objects meeting in one slot get unioned; an object meeting an untracked reference becomes ambiguous.
+	 */
+	int32_t Analyzer::merge(int32_t target, int32_t incoming) {
+		target = canonical(target);
+		incoming = canonical(incoming);
+		if(target == incoming || incoming == NULL_VALUE) {
+			return target;
+		} else if(target == NULL_VALUE) {
+			return incoming;
+		} else if(target == UNTRACKED) {
+			objects[incoming].ambiguous = true;
+			return incoming;
+		} else if(incoming == UNTRACKED) {
+			objects[target].ambiguous = true;
+			return target;
+		}
+		objects[incoming].parent = target;
+		changed = true;
+		return target;
+	}
+
+	/**
+	 * Merges an incoming frame state into the state at the start of an instruction. Returns whether the
+	 * target state changed, meaning the instruction needs to be looked at again.
+	 */
+	bool Analyzer::mergeInto(FrameState& target, const FrameState& incoming) {
+		if(!target.reached) {
+			target.reached = true;
+			target.locals = incoming.locals;
+			target.stack = incoming.stack;
+			return true;
+		}
+		if(target.stack.size() != incoming.stack.size()) {
+			throw runtime_error("Operand stack heights differ where control flow merges.");
+		}
+		bool ret = false;
+		for(uint16_t i = 0; i < target.locals.size(); i++) {
+			int32_t old = canonical(target.locals[i]);
+			target.locals[i] = merge(old, incoming.locals[i]);
+			ret = ret || (target.locals[i] != old);
+		}
+		for(uint16_t i = 0; i < target.stack.size(); i++) {
+			int32_t old = canonical(target.stack[i]);
+			target.stack[i] = merge(old, incoming.stack[i]);
+			ret = ret || (target.stack[i] != old);
+		}
+		return ret;
+	}
+
+	/**
+	 * Records that a value escapes at least as far as the given state.
+	 */
+	void Analyzer::escape(int32_t value, EscapeAnalysis::EscapeState state) {
+		if(value >= 0) {
+			AbstractObject& object = objects[find(value)];
+			object.state = std::max(object.state, state);
+		}
+	}
+
+	int32_t Analyzer::pop(FrameState& state) {
+		if(state.stack.empty()) {
+			throw runtime_error("Operand stack underflow during escape analysis.");
+		}
+		int32_t ret = state.stack.back();
+		state.stack.pop_back();
+		return ret;
+	}
+
+	void Analyzer::pop(FrameState& state, uint16_t slots) {
+		for(uint16_t i = 0; i < slots; i++) {
+			pop(state);
+		}
+	}
+
+	void Analyzer::push(FrameState& state, int32_t value, uint16_t slots) {
+		for(uint16_t i = 0; i < slots; i++) {
+			state.stack.push_back(value);
+		}
+	}
+
+	void Analyzer::setLocal(FrameState& state, uint16_t index, int32_t value, uint16_t slots) {
+		if(index + slots > state.locals.size()) {
+			throw runtime_error("Local variable index out of range during escape analysis.");
+		}
+		for(uint16_t i = 0; i < slots; i++) {
+			state.locals[index + i] = value;
+		}
+	}
+
+	/**
+	 * Returns whether an invocation is of java/lang/Object.<init>, which does nothing, so passing an object
+	 * to it doesn't count as a use.
+	 */
+	bool Analyzer::isTrivialConstructor(uint16_t methodIndex, uint8_t opcode) {
+		if(opcode != BY_invokespecial) {
+			return false;
+		}
+		const ConstantMemberReference& ref = cf.getConstantPool().get<ConstantMemberReference>(methodIndex);
+		return string(ref.getNameAndType().getName()) == "<init>" && string(ref.getClass().getClassName()) == "java/lang/Object";
+	}
+
+	/**
+	 * Gets what a statically bound callee does with its parameters. An empty summary means nothing is known,
+	 * and every argument has to be assumed to escape.
+	 */
+	const vector<EscapeAnalysis::EscapeState>& Analyzer::getCalleeSummary(uint16_t methodIndex, uint8_t opcode) {
+		map<uint16_t, vector<EscapeAnalysis::EscapeState> >::iterator it = calleeSummaries.find(methodIndex);
+		if(it != calleeSummaries.end()) {
+			return it->second;
+		}
+		vector<EscapeAnalysis::EscapeState>& summary = calleeSummaries[methodIndex];
+		if(opcode != BY_invokespecial && opcode != BY_invokestatic) {
+			return summary;
+		}
+		const ConstantMemberReference& ref = cf.getConstantPool().get<ConstantMemberReference>(methodIndex);
+		string className = ref.getClass().getClassName();
+		string name = ref.getNameAndType().getName();
+		string descriptor = ref.getNameAndType().getTypeString();
+		if(isTrivialConstructor(methodIndex, opcode)) {
+			summary.push_back(EscapeAnalysis::NO_ESCAPE);
+			return summary;
+		}
+		if(vm == NULL || calleeDepth == 0) {
+			return summary;
+		}
+		if(className.empty() || className[0] == '[') {
+			return summary;
+		}
+		try {
+			ClassFile& callee = vm->getClass(className);
+			ClassMember* m = callee.getMethods().find(name, descriptor);
+			if(m != NULL && m->getAttributes().containsAttribute<CodeAttribute>()) {
+				EscapeAnalysis calleeAnalysis(callee, *m, vm, calleeDepth - 1);
+				for(uint16_t p = 0; p < calleeAnalysis.numParameters(); p++) {
+					summary.push_back(calleeAnalysis.getParameterState(p));
+				}
+			}
+		} catch(...) {
+			// Loading a callee can throw more than std::exceptions, like the strings thrown for constant types
+			// the pool doesn't know, and any failure just means nothing is known about it.
+			summary.clear();
+		}
+		return summary;
+	}
+
+	/**
+	 * Applies the effect of a single instruction to the abstract frame state.
+	 */
+	void Analyzer::transfer(const Instruction& instruction, FrameState& state) {
+		const ConstantPool& pool = cf.getConstantPool();
+		uint8_t opcode = instruction.opcode;
+		switch(opcode) {
+			case BY_aconst_null:
+				push(state, NULL_VALUE);
+				break;
+			case BY_aload:
+				push(state, state.locals.at(instructions.getIndexOperand(instruction)));
+				break;
+			case BY_aload_0:
+			case BY_aload_1:
+			case BY_aload_2:
+			case BY_aload_3:
+				push(state, state.locals.at(opcode - BY_aload_0));
+				break;
+			case BY_astore:
+				setLocal(state, instructions.getIndexOperand(instruction), pop(state));
+				break;
+			case BY_astore_0:
+			case BY_astore_1:
+			case BY_astore_2:
+			case BY_astore_3:
+				setLocal(state, opcode - BY_astore_0, pop(state));
+				break;
+			case BY_istore:
+			case BY_fstore:
+				pop(state, 1);
+				setLocal(state, instructions.getIndexOperand(instruction), UNTRACKED);
+				break;
+			case BY_lstore:
+			case BY_dstore:
+				pop(state, 2);
+				setLocal(state, instructions.getIndexOperand(instruction), UNTRACKED, 2);
+				break;
+			case BY_istore_0:
+			case BY_istore_1:
+			case BY_istore_2:
+			case BY_istore_3:
+				pop(state, 1);
+				setLocal(state, opcode - BY_istore_0, UNTRACKED);
+				break;
+			case BY_fstore_0:
+			case BY_fstore_1:
+			case BY_fstore_2:
+			case BY_fstore_3:
+				pop(state, 1);
+				setLocal(state, opcode - BY_fstore_0, UNTRACKED);
+				break;
+			case BY_lstore_0:
+			case BY_lstore_1:
+			case BY_lstore_2:
+			case BY_lstore_3:
+				pop(state, 2);
+				setLocal(state, opcode - BY_lstore_0, UNTRACKED, 2);
+				break;
+			case BY_dstore_0:
+			case BY_dstore_1:
+			case BY_dstore_2:
+			case BY_dstore_3:
+				pop(state, 2);
+				setLocal(state, opcode - BY_dstore_0, UNTRACKED, 2);
+				break;
+			case BY_aastore: {
+				int32_t value = pop(state);
+				pop(state, 2);
+				escape(value, EscapeAnalysis::GLOBAL_ESCAPE);
+				break;
+			}
+			case BY_dup: {
+				int32_t a = pop(state);
+				push(state, a);
+				push(state, a);
+				break;
+			}
+			case BY_dup_x1: {
+				int32_t a = pop(state), b = pop(state);
+				push(state, a);
+				push(state, b);
+				push(state, a);
+				break;
+			}
+			case BY_dup_x2: {
+				int32_t a = pop(state), b = pop(state), c = pop(state);
+				push(state, a);
+				push(state, c);
+				push(state, b);
+				push(state, a);
+				break;
+			}
+			case BY_dup2: {
+				int32_t a = pop(state), b = pop(state);
+				push(state, b);
+				push(state, a);
+				push(state, b);
+				push(state, a);
+				break;
+			}
+			case BY_dup2_x1: {
+				int32_t a = pop(state), b = pop(state), c = pop(state);
+				push(state, b);
+				push(state, a);
+				push(state, c);
+				push(state, b);
+				push(state, a);
+				break;
+			}
+			case BY_dup2_x2: {
+				int32_t a = pop(state), b = pop(state), c = pop(state), d = pop(state);
+				push(state, b);
+				push(state, a);
+				push(state, d);
+				push(state, c);
+				push(state, b);
+				push(state, a);
+				break;
+			}
+			case BY_swap: {
+				int32_t a = pop(state), b = pop(state);
+				push(state, a);
+				push(state, b);
+				break;
+			}
+			case BY_areturn:
+			case BY_athrow:
+				escape(pop(state), EscapeAnalysis::GLOBAL_ESCAPE);
+				state.stack.clear();
+				break;
+			case BY_getstatic: {
+				const ConstantMemberReference& ref = pool.get<ConstantMemberReference>(instructions.getIndexOperand(instruction));
+				push(state, UNTRACKED, ref.getNameAndType().getFieldType().getSlots());
+				break;
+			}
+			case BY_putstatic: {
+				const ConstantMemberReference& ref = pool.get<ConstantMemberReference>(instructions.getIndexOperand(instruction));
+				uint16_t slots = ref.getNameAndType().getFieldType().getSlots();
+				if(slots == 1) {
+					escape(pop(state), EscapeAnalysis::GLOBAL_ESCAPE);
+				} else {
+					pop(state, slots);
+				}
+				break;
+			}
+			case BY_getfield: {
+				uint16_t fieldIndex = instructions.getIndexOperand(instruction);
+				const ConstantMemberReference& ref = pool.get<ConstantMemberReference>(fieldIndex);
+				const FieldType& type = ref.getNameAndType().getFieldType();
+				int32_t object = canonical(pop(state));
+				int32_t value = UNTRACKED;
+				if(object >= 0) {
+					objects[object].fields.insert(fieldIndex);
+					if(type.isReference()) {
+						value = NULL_VALUE;
+						for(map<pair<int32_t, uint16_t>, int32_t>::iterator it = fieldValues.begin(); it != fieldValues.end(); it++) {
+							if(it->first.second == fieldIndex && find(it->first.first) == object) {
+								value = merge(value, it->second);
+							}
+						}
+						// The field may also still hold whatever it held before this method stored anything.
+						value = merge(value, UNTRACKED);
+					}
+				}
+				push(state, value, type.getSlots());
+				break;
+			}
+			case BY_putfield: {
+				uint16_t fieldIndex = instructions.getIndexOperand(instruction);
+				const ConstantMemberReference& ref = pool.get<ConstantMemberReference>(fieldIndex);
+				uint16_t slots = ref.getNameAndType().getFieldType().getSlots();
+				int32_t value = canonical(pop(state));
+				pop(state, slots - 1);
+				int32_t object = canonical(pop(state));
+				if(object >= 0) {
+					objects[object].fields.insert(fieldIndex);
+				}
+				if(value >= 0) {
+					objects[value].stored = true;
+					if(object >= 0) {
+						pair<int32_t, uint16_t> key = make_pair(object, fieldIndex);
+						map<pair<int32_t, uint16_t>, int32_t>::iterator it = fieldValues.find(key);
+						if(it == fieldValues.end()) {
+							fieldValues[key] = value;
+							storeEdges.push_back(make_pair(object, value));
+							changed = true;
+						} else {
+							it->second = merge(it->second, value);
+						}
+					} else {
+						escape(value, EscapeAnalysis::GLOBAL_ESCAPE);
+					}
+				}
+				break;
+			}
+			case BY_invokevirtual:
+			case BY_invokespecial:
+			case BY_invokestatic:
+			case BY_invokeinterface:
+			case BY_invokedynamic: {
+				uint16_t methodIndex = instructions.getIndexOperand(instruction);
+				const MethodType* type;
+				if(opcode == BY_invokedynamic) {
+					type = &pool.get<ConstantInvokeDynamic>(methodIndex).getNameAndType().getMethodType();
+				} else {
+					type = &pool.get<ConstantMemberReference>(methodIndex).getNameAndType().getMethodType();
+				}
+				bool hasReceiver = (opcode != BY_invokestatic && opcode != BY_invokedynamic);
+				vector<int32_t> arguments(type->numParameters() + (hasReceiver ? 1 : 0), UNTRACKED);
+				for(uint16_t i = arguments.size(); i > 0; i--) {
+					if(hasReceiver && i == 1) {
+						arguments[i - 1] = pop(state);
+						continue;
+					}
+					const FieldType& parameter = type->getParameter(i - 1 - (hasReceiver ? 1 : 0));
+					if(parameter.isReference()) {
+						arguments[i - 1] = pop(state);
+					} else {
+						pop(state, parameter.getSlots());
+					}
+				}
+				const vector<EscapeAnalysis::EscapeState>* summary = NULL;
+				if(opcode != BY_invokedynamic) {
+					summary = &getCalleeSummary(methodIndex, opcode);
+				}
+				for(uint16_t i = 0; i < arguments.size(); i++) {
+					if(summary == NULL || i >= summary->size()) {
+						escape(arguments[i], EscapeAnalysis::GLOBAL_ESCAPE);
+					} else {
+						escape(arguments[i], (*summary)[i]);
+					}
+				}
+				if(type->getReturnType().getKind() != FieldType::VOID) {
+					push(state, UNTRACKED, type->getReturnType().getSlots());
+				}
+				break;
+			}
+			case BY_new: {
+				push(state, siteObjects[instruction.pc]);
+				break;
+			}
+			case BY_checkcast:
+				break;
+			case BY_if_acmpeq:
+			case BY_if_acmpne: {
+				int32_t a = canonical(pop(state)), b = canonical(pop(state));
+				if(a >= 0) {
+					objects[a].compared = true;
+				}
+				if(b >= 0) {
+					objects[b].compared = true;
+				}
+				break;
+			}
+			case BY_multinewarray:
+				pop(state, instructions.getConstantOperand(instruction));
+				push(state, UNTRACKED);
+				break;
+			default: {
+				const OpcodeInfo& info = getOpcodeInfo(opcode);
+				pop(state, info.pops);
+				push(state, UNTRACKED, info.pushes);
+				break;
+			}
+		}
+	}
+
+	/**
+	 * Runs the worklist over every reachable block, starting from whatever states are already known. Blocks
+	 * are taken in reverse postorder, so that most of them are only visited once per run.
+	 */
+	void Analyzer::run() {
+		const vector<uint32_t>& order = graph.getReversePostorder();
+		vector<uint32_t> position(graph.numBlocks(), 0);
+		set<uint32_t> worklist;
+		for(uint32_t i = 0; i < order.size(); i++) {
+			position[order[i]] = i;
+			if(states[order[i]].reached) {
+				worklist.insert(i);
+			}
+		}
+		while(!worklist.empty()) {
+			uint32_t block = order[*worklist.begin()];
+			worklist.erase(worklist.begin());
+			const BasicBlock& basicBlock = graph[block];
+			uint32_t numSuccessors = graph.numSuccessors(block);
+			uint32_t numNormalSuccessors = graph.numNormalSuccessors(block);
+			FrameState state = states[block];
+			for(uint32_t index = basicBlock.firstInstruction; index <= basicBlock.lastInstruction; index++) {
+				// An exception can be thrown either before or after the instruction's effect on the locals.
+				FrameState thrown;
+				thrown.reached = true;
+				thrown.locals = state.locals;
+				thrown.stack.assign(1, UNTRACKED);
+				transfer(instructions[index], state);
+				for(uint32_t s = numNormalSuccessors; s < numSuccessors; s++) {
+					uint32_t handler = graph.getSuccessor(block, s);
+					bool handlerChanged = mergeInto(states[handler], thrown);
+					FrameState after = thrown;
+					after.locals = state.locals;
+					handlerChanged = mergeInto(states[handler], after) || handlerChanged;
+					if(handlerChanged) {
+						worklist.insert(position[handler]);
+					}
+				}
+			}
+			for(uint32_t s = 0; s < numNormalSuccessors; s++) {
+				uint32_t next = graph.getSuccessor(block, s);
+				if(mergeInto(states[next], state)) {
+					worklist.insert(position[next]);
+				}
+			}
+		}
+	}
+
+	/**
+	 * Runs the analysis to a fixed point, and fills in the results.
+	 */
+	void Analyzer::analyze(vector<EscapeAnalysis::AllocationSite>& sites, vector<EscapeAnalysis::EscapeState>& parameterStates) {
+		const MethodType& type = method.getMethodType();
+		bool isStatic = method.getAccessFlags().isStatic();
+		FrameState entry;
+		entry.reached = true;
+		entry.locals.assign(code.getMaxLocals(), UNTRACKED);
+		uint16_t local = 0;
+		for(int32_t i = isStatic ? 0 : -1; i < type.numParameters(); i++) {
+			// The receiver, if there is one, comes first, and is a reference.
+			if(i < 0 || type.getParameter(i).isReference()) {
+				parameterObjects.push_back(newObject(EscapeAnalysis::NO_ESCAPE));
+				objects[parameterObjects.back()].external = true;
+				setLocal(entry, local, parameterObjects.back());
+			} else {
+				parameterObjects.push_back(UNTRACKED);
+			}
+			local += i < 0 ? 1 : type.getParameter(i).getSlots();
+		}
+
+		bool hasSubroutines = false;
+		for(uint32_t i = 0; i < instructions.numInstructions(); i++) {
+			uint8_t opcode = instructions[i].opcode;
+			if(opcode == BY_new) {
+				siteObjects[instructions[i].pc] = newObject(EscapeAnalysis::NO_ESCAPE);
+			} else if(opcode == BY_jsr || opcode == BY_jsr_w || opcode == BY_ret) {
+				hasSubroutines = true;
+			}
+		}
+
+		if(!hasSubroutines && instructions.numInstructions() > 0) {
+			FrameState unreached;
+			unreached.reached = false;
+			states.assign(graph.numBlocks(), unreached);
+			states[0] = entry;
+			do {
+				changed = false;
+				run();
+			} while(changed);
+		} else {
+			// Subroutines (jsr/ret) aren't worth modeling; old code that uses them just gets nothing optimized.
+			for(uint32_t i = 0; i < objects.size(); i++) {
+				objects[i].state = EscapeAnalysis::GLOBAL_ESCAPE;
+			}
+		}
+
+		vector<uint32_t> setSizes(objects.size(), 0);
+		vector<AbstractObject*> roots(objects.size(), NULL);
+		for(uint32_t i = 0; i < objects.size(); i++) {
+			int32_t root = find(i);
+			setSizes[root]++;
+			roots[i] = &objects[root];
+			if(root != (int32_t)i) {
+				objects[root].state = std::max(objects[root].state, objects[i].state);
+				objects[root].external = objects[root].external || objects[i].external;
+				objects[root].ambiguous = objects[root].ambiguous || objects[i].ambiguous;
+				objects[root].compared = objects[root].compared || objects[i].compared;
+				objects[root].stored = objects[root].stored || objects[i].stored;
+				objects[root].fields.insert(objects[i].fields.begin(), objects[i].fields.end());
+			}
+		}
+
+		// Objects stored in fields of other objects escape at least as far as those objects do. Objects that
+		// the caller might be able to see (parameters, and anything merged with an untracked reference) count
+		// as escaping globally here, even though the method doesn't make them escape any further itself.
+		bool propagated = true;
+		while(propagated) {
+			propagated = false;
+			for(uint32_t i = 0; i < storeEdges.size(); i++) {
+				AbstractObject& container = *(roots[storeEdges[i].first]);
+				AbstractObject& value = *(roots[storeEdges[i].second]);
+				EscapeAnalysis::EscapeState containerState = (container.external || container.ambiguous) ?
+					EscapeAnalysis::GLOBAL_ESCAPE : container.state;
+				if(value.state < containerState) {
+					value.state = containerState;
+					propagated = true;
+				}
+			}
+		}
+
+		// A parameter the method compares by reference needs a real object behind it, even if it doesn't escape.
+		for(uint16_t i = 0; i < parameterObjects.size(); i++) {
+			if(parameterObjects[i] >= 0) {
+				const AbstractObject& root = *(roots[parameterObjects[i]]);
+				parameterStates.push_back(root.compared ? std::max(root.state, EscapeAnalysis::ARG_ESCAPE) : root.state);
+			} else {
+				parameterStates.push_back(EscapeAnalysis::NO_ESCAPE);
+			}
+		}
+
+		for(map<uint32_t, int32_t>::iterator it = siteObjects.begin(); it != siteObjects.end(); it++) {
+			const AbstractObject& root = *(roots[it->second]);
+			EscapeAnalysis::AllocationSite site;
+			site.pc = it->first;
+			site.classIndex = instructions.getIndexOperand(instructions[instructions.indexOf(it->first)]);
+			site.state = root.state;
+			site.scalarReplaceable = root.state == EscapeAnalysis::NO_ESCAPE && setSizes[find(it->second)] == 1 &&
+				!root.ambiguous && !root.compared && !root.stored && !hasSubroutines;
+			site.fields.assign(root.fields.begin(), root.fields.end());
+			sites.push_back(site);
+		}
+	}
+}
+
+/**
+ * Runs escape analysis on a method, which must have a Code attribute. If vm is given, the summaries of
+ * statically bound callees are computed by analyzing them too, following calls at most calleeDepth deep.
+ */
+EscapeAnalysis::EscapeAnalysis(ClassFile& cf, const ClassMember& method, VirtualMachine* vm, unsigned int calleeDepth) {
+	const CodeAttribute& code = method.getAttributes().getAttribute<CodeAttribute>();
+	Analyzer analyzer(cf, method, code, vm, calleeDepth);
+	analyzer.analyze(sites, parameterStates);
+}
+
+/**
+ * Destructor for EscapeAnalysis. Nothing is allocated, so nothing is deleted.
+ */
+EscapeAnalysis::~EscapeAnalysis() {
+
+}
+
+/**
+ * Gets the results for every allocation site in the method, in order of pc.
+ */
+const std::vector<EscapeAnalysis::AllocationSite>& EscapeAnalysis::getAllocationSites() const {
+	return sites;
+}
+
+/**
+ * Gets the result for the allocation site at the given pc, or NULL if there is no "new" instruction there.
+ */
+const EscapeAnalysis::AllocationSite* EscapeAnalysis::getAllocationSite(uint32_t pc) const {
+	for(uint32_t i = 0; i < sites.size(); i++) {
+		if(sites[i].pc == pc) {
+			return &sites[i];
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Gets the number of parameters of the method, counting "this" for instance methods.
+ */
+uint16_t EscapeAnalysis::numParameters() const {
+	return parameterStates.size();
+}
+
+/**
+ * Gets how far the method lets a parameter escape. Parameter 0 is "this" for instance methods. Primitive
+ * parameters never escape.
+ */
+EscapeAnalysis::EscapeState EscapeAnalysis::getParameterState(uint16_t parameter) const {
+	if(parameter >= parameterStates.size()) {
+		throw runtime_error("Parameter index out of range: " + toString(parameter) + " >= " + toString(parameterStates.size()));
+	}
+	return parameterStates[parameter];
+}
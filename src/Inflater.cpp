@@ -0,0 +1,258 @@
+#include "Inflater.h"
+#include "LoadStatistics.h"
+#include "Util.h"
+
+#include <zip.h>
+#include <zlib.h>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef HAVE_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
+using std::string;
+using std::vector;
+using std::ostream;
+using std::endl;
+using std::runtime_error;
+
+namespace {
+	/**
+	 * Inflates with zlib. A single z_stream is reset and reused for every buffer.
+	 */
+	class ZlibInflater : public Inflater {
+	private:
+		z_stream stream;
+	protected:
+		void inflateRaw(const uint8_t* in, size_t inSize, uint8_t* out, size_t outSize);
+	public:
+		ZlibInflater();
+		virtual ~ZlibInflater();
+		const char* getName() const;
+	};
+
+	ZlibInflater::ZlibInflater() {
+		memset(&stream, 0, sizeof(stream));
+		// Negative window bits mean a raw deflate stream, without the zlib header, which is what zips hold.
+		if(inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+			throw runtime_error("Could not initialize zlib: " + string(stream.msg ? stream.msg : "unknown error"));
+		}
+	}
+
+	ZlibInflater::~ZlibInflater() {
+		inflateEnd(&stream);
+	}
+
+	const char* ZlibInflater::getName() const {
+		return "zlib";
+	}
+
+	void ZlibInflater::inflateRaw(const uint8_t* in, size_t inSize, uint8_t* out, size_t outSize) {
+		inflateReset(&stream);
+		stream.next_in = const_cast<Bytef*>(in);
+		stream.avail_in = inSize;
+		stream.next_out = out;
+		stream.avail_out = outSize;
+		int result = ::inflate(&stream, Z_FINISH);
+		if(result != Z_STREAM_END) {
+			throw runtime_error("zlib could not inflate entry: " + string(stream.msg ? stream.msg : "output size doesn't match"));
+		} else if(stream.avail_out != 0) {
+			throw runtime_error("Entry inflated to " + toString(outSize - stream.avail_out) + " bytes instead of " + toString(outSize));
+		}
+	}
+
+#ifdef HAVE_LIBDEFLATE
+	/**
+	 * Inflates with libdeflate, which only does whole buffers, but does them much faster than zlib, and has a
+	 * SIMD CRC-32 as well.
+	 */
+	class LibdeflateInflater : public Inflater {
+	private:
+		struct libdeflate_decompressor* decompressor;
+	protected:
+		void inflateRaw(const uint8_t* in, size_t inSize, uint8_t* out, size_t outSize);
+	public:
+		LibdeflateInflater();
+		virtual ~LibdeflateInflater();
+		const char* getName() const;
+		uint32_t checksum(const uint8_t* data, size_t size) const;
+	};
+
+	LibdeflateInflater::LibdeflateInflater() : decompressor(libdeflate_alloc_decompressor()) {
+		if(!decompressor) {
+			throw runtime_error("Could not allocate a libdeflate decompressor");
+		}
+	}
+
+	LibdeflateInflater::~LibdeflateInflater() {
+		libdeflate_free_decompressor(decompressor);
+	}
+
+	const char* LibdeflateInflater::getName() const {
+		return "libdeflate";
+	}
+
+	void LibdeflateInflater::inflateRaw(const uint8_t* in, size_t inSize, uint8_t* out, size_t outSize) {
+		// Without somewhere to put the actual size, libdeflate fails unless the output is filled exactly.
+		enum libdeflate_result result = libdeflate_deflate_decompress(decompressor, in, inSize, out, outSize, NULL);
+		if(result != LIBDEFLATE_SUCCESS) {
+			throw runtime_error("libdeflate could not inflate entry: error " + toString(result));
+		}
+	}
+
+	uint32_t LibdeflateInflater::checksum(const uint8_t* data, size_t size) const {
+		return libdeflate_crc32(0, data, size);
+	}
+#endif
+
+	/**
+	 * Reads exactly size bytes from a file in a zip, or throws.
+	 */
+	void readFully(struct zip_file* file, uint8_t* data, uint64_t size) {
+		uint64_t read = 0;
+		zip_int64_t bytes = 0;
+		while(read < size && (bytes = zip_fread(file, data + read, size - read)) > 0) {
+			read += bytes;
+		}
+		zip_fclose(file);
+		if(read != size) {
+			throw runtime_error("Entry is truncated: read " + toString(read) + " of " + toString(size) + " bytes");
+		}
+	}
+}
+
+/**
+ * Constructor for InflaterStatistics. Everything starts at zero.
+ */
+InflaterStatistics::InflaterStatistics() : entries(0), compressedBytes(0), inflatedBytes(0), seconds(0) {
+
+}
+
+/**
+ * Adds another set of statistics to this one, for combining the statistics of inflaters on different threads.
+ */
+void InflaterStatistics::add(const InflaterStatistics& other) {
+	entries += other.entries;
+	compressedBytes += other.compressedBytes;
+	inflatedBytes += other.inflatedBytes;
+	seconds += other.seconds;
+}
+
+/**
+ * Creates an inflater using the named backend. An empty name picks the fastest one available.
+ */
+Inflater* Inflater::create(const string& backend) {
+	if(backend == "zlib") {
+		return new ZlibInflater();
+	}
+#ifdef HAVE_LIBDEFLATE
+	if(backend == "libdeflate" || backend.empty()) {
+		return new LibdeflateInflater();
+	}
+#else
+	if(backend.empty()) {
+		return new ZlibInflater();
+	}
+#endif
+	throw runtime_error("Unknown inflater backend: " + backend);
+}
+
+/**
+ * Gets the names of the backends that were compiled in, fastest first.
+ */
+vector<string> Inflater::getBackends() {
+	vector<string> backends;
+#ifdef HAVE_LIBDEFLATE
+	backends.push_back("libdeflate");
+#endif
+	backends.push_back("zlib");
+	return backends;
+}
+
+/**
+ * Constructor for Inflater.
+ */
+Inflater::Inflater() {
+
+}
+
+/**
+ * Destructor for Inflater.
+ */
+Inflater::~Inflater() {
+
+}
+
+/**
+ * Computes the CRC-32 that zip files use to check entries.
+ */
+uint32_t Inflater::checksum(const uint8_t* data, size_t size) const {
+	return crc32(crc32(0, Z_NULL, 0), data, size);
+}
+
+/**
+ * Inflates a raw DEFLATE stream into a buffer of exactly its inflated size, and counts it in the statistics.
+ */
+void Inflater::inflate(const uint8_t* in, size_t inSize, uint8_t* out, size_t outSize) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	inflateRaw(in, inSize, out, outSize);
+	statistics.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	statistics.entries++;
+	statistics.compressedBytes += inSize;
+	statistics.inflatedBytes += outSize;
+}
+
+/**
+ * Reads an entry of a jar into data, which ends up exactly the entry's size. Deflated entries are read
+ * from libzip still compressed, and inflated in one go by this backend. Anything else is left to libzip.
+ * The entry's CRC is checked either way.
+ */
+void Inflater::readEntry(struct zip* jar, uint64_t index, string& data) {
+	PhaseTimer timer(PHASE_INFLATE);
+	struct zip_stat stat;
+	zip_stat_init(&stat);
+	const zip_uint64_t needed = ZIP_STAT_SIZE | ZIP_STAT_COMP_SIZE | ZIP_STAT_COMP_METHOD;
+	if(zip_stat_index(jar, index, 0, &stat) != 0 || (stat.valid & needed) != needed) {
+		throw runtime_error(zip_strerror(jar));
+	}
+	data.resize(stat.size);
+	uint8_t* out = reinterpret_cast<uint8_t*>(&data[0]);
+	if(stat.comp_method == ZIP_CM_DEFLATE) {
+		struct zip_file* file = zip_fopen_index(jar, index, ZIP_FL_COMPRESSED);
+		if(!file) {
+			throw runtime_error(zip_strerror(jar));
+		}
+		compressed.resize(stat.comp_size);
+		readFully(file, reinterpret_cast<uint8_t*>(&compressed[0]), stat.comp_size);
+		inflate(reinterpret_cast<const uint8_t*>(compressed.data()), compressed.size(), out, data.size());
+	} else {
+		struct zip_file* file = zip_fopen_index(jar, index, 0);
+		if(!file) {
+			throw runtime_error(zip_strerror(jar));
+		}
+		readFully(file, out, stat.size);
+	}
+	if((stat.valid & ZIP_STAT_CRC) && checksum(out, data.size()) != stat.crc) {
+		throw runtime_error(string(stat.name ? stat.name : "Entry") + " fails its CRC check");
+	}
+	timer.addBytes(data.size());
+}
+
+/**
+ * Gets the totals for everything this inflater has inflated.
+ */
+const InflaterStatistics& Inflater::getStatistics() const {
+	return statistics;
+}
+
+/**
+ * Writes a one line summary of a backend's throughput, measured on the inflated size.
+ */
+void Inflater::writeStatistics(ostream& out, const string& backend, const InflaterStatistics& statistics) {
+	double megabytes = statistics.inflatedBytes / (1024.0 * 1024.0);
+	double seconds = statistics.seconds > 0 ? statistics.seconds : 1e-9;
+	out << "Inflated " << statistics.entries << " entries with " << backend << " (" << (statistics.compressedBytes / (1024.0 * 1024.0));
+	out << " MB to " << megabytes << " MB) in " << statistics.seconds << " s: " << (megabytes / seconds) << " MB/s" << endl;
+}
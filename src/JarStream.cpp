@@ -0,0 +1,338 @@
+#include "JarStream.h"
+#include "Inflater.h"
+#include "LoadStatistics.h"
+#include "Util.h"
+
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+using std::string;
+using std::runtime_error;
+
+namespace {
+	const uint32_t LOCAL_FILE_HEADER = 0x04034b50;
+	const uint32_t DATA_DESCRIPTOR = 0x08074b50;
+	const uint32_t CENTRAL_DIRECTORY_HEADER = 0x02014b50;
+	const uint32_t END_OF_CENTRAL_DIRECTORY = 0x06054b50;
+	const uint16_t FLAG_ENCRYPTED = 1 << 0;
+	const uint16_t FLAG_DATA_DESCRIPTOR = 1 << 3;
+	const uint16_t METHOD_STORED = 0;
+	const uint16_t METHOD_DEFLATED = 8;
+}
+
+/**
+ * Opens a jar for streaming. Nothing is read until the first call to nextEntry().
+ */
+JarStream::JarStream(const string& path) :
+	path(path), file(path.c_str(), std::ios::in | std::ios::binary), input(INPUT_BUFFER_SIZE), inputStart(0), inputEnd(0),
+	wholeBufferInflater(NULL), entryPending(false), finished(false), flags(0), method(0), crc(0), compressedSize(0), uncompressedSize(0) {
+	if(!file) {
+		throw runtime_error("Could not open " + path);
+	}
+	memset(&inflater, 0, sizeof(inflater));
+	// Negative window bits mean a raw deflate stream, without the zlib header, which is what zips hold.
+	if(inflateInit2(&inflater, -MAX_WBITS) != Z_OK) {
+		throw runtime_error("Could not initialize zlib: " + string(inflater.msg ? inflater.msg : "unknown error"));
+	}
+}
+
+/**
+ * Destructor for JarStream. Releases the zlib state; the file closes itself.
+ */
+JarStream::~JarStream() {
+	inflateEnd(&inflater);
+}
+
+/**
+ * Sets the inflater to use for entries whose sizes are known up front, or NULL to inflate everything through
+ * zlib. The inflater isn't owned by the stream.
+ */
+void JarStream::setInflater(Inflater* inflater) {
+	wholeBufferInflater = inflater;
+}
+
+/**
+ * Makes sure at least the given number of bytes are in the input buffer, reading more of the file if needed.
+ * Returns false if the file ends first.
+ */
+bool JarStream::fill(size_t bytes) {
+	if(inputEnd - inputStart >= bytes) {
+		return true;
+	}
+	memmove(&input[0], &input[inputStart], inputEnd - inputStart);
+	inputEnd -= inputStart;
+	inputStart = 0;
+	while(inputEnd < bytes && file) {
+		file.read(reinterpret_cast<char*>(&input[inputEnd]), input.size() - inputEnd);
+		if(file.gcount() == 0) {
+			break;
+		}
+		inputEnd += file.gcount();
+	}
+	return inputEnd >= bytes;
+}
+
+/**
+ * Reads a little-endian short out of the input buffer. The caller has to have filled it first.
+ */
+uint16_t JarStream::readShort() {
+	uint16_t value = input[inputStart] | (input[inputStart + 1] << 8);
+	inputStart += 2;
+	return value;
+}
+
+/**
+ * Reads a little-endian int out of the input buffer. The caller has to have filled it first.
+ */
+uint32_t JarStream::readInt() {
+	uint32_t value = input[inputStart] | (input[inputStart + 1] << 8) | (input[inputStart + 2] << 16) | ((uint32_t)input[inputStart + 3] << 24);
+	inputStart += 4;
+	return value;
+}
+
+/**
+ * Moves forward through the file without looking at what's skipped.
+ */
+void JarStream::skipBytes(uint64_t bytes) {
+	while(bytes > 0) {
+		if(inputStart == inputEnd && !fill(1)) {
+			throw runtime_error(path + " is truncated");
+		}
+		size_t skipped = std::min<uint64_t>(bytes, inputEnd - inputStart);
+		inputStart += skipped;
+		bytes -= skipped;
+	}
+}
+
+/**
+ * Moves to the next entry, skipping the current one if it hasn't been read. Returns false once the entries
+ * run out, which is when the central directory starts.
+ */
+bool JarStream::nextEntry() {
+	if(entryPending) {
+		skipEntry();
+	}
+	if(finished) {
+		return false;
+	}
+	if(!fill(4)) {
+		finished = true;
+		return false;
+	}
+	uint32_t signature = readInt();
+	if(signature == CENTRAL_DIRECTORY_HEADER || signature == END_OF_CENTRAL_DIRECTORY) {
+		finished = true;
+		return false;
+	} else if(signature != LOCAL_FILE_HEADER) {
+		finished = true;
+		throw runtime_error(path + " has unexpected data after " + name);
+	}
+	if(!fill(26)) {
+		throw runtime_error(path + " is truncated");
+	}
+	readShort(); // Version needed to extract
+	flags = readShort();
+	method = readShort();
+	readInt(); // Modification time and date
+	crc = readInt();
+	compressedSize = readInt();
+	uncompressedSize = readInt();
+	uint16_t nameLength = readShort();
+	uint16_t extraLength = readShort();
+	if(!fill(nameLength)) {
+		throw runtime_error(path + " is truncated");
+	}
+	name.assign(reinterpret_cast<const char*>(&input[inputStart]), nameLength);
+	inputStart += nameLength;
+	skipBytes(extraLength);
+	if(compressedSize == 0xFFFFFFFF || uncompressedSize == 0xFFFFFFFF) {
+		throw runtime_error(path + ": " + name + " is a zip64 entry, which can't be streamed");
+	}
+	entryPending = true;
+	return true;
+}
+
+/**
+ * Gets the name of the current entry.
+ */
+const string& JarStream::getName() const {
+	return name;
+}
+
+/**
+ * Gets the compressed size of the current entry, as given in its local header. This is 0 for entries whose
+ * sizes come after their data.
+ */
+uint32_t JarStream::getCompressedSize() const {
+	return compressedSize;
+}
+
+/**
+ * Reads the current entry, inflating it if needed, into data, replacing whatever was there. The entry's
+ * CRC is checked. An entry that can't be read is skipped, unless its sizes come after its data, in which
+ * case nothing says where it ends and the stream finishes.
+ */
+void JarStream::readEntry(string& data) {
+	if(!entryPending) {
+		throw runtime_error("No entry to read from " + path);
+	}
+	if((flags & FLAG_ENCRYPTED) || (method != METHOD_DEFLATED && method != METHOD_STORED)) {
+		entryPending = false;
+		if(flags & FLAG_DATA_DESCRIPTOR) {
+			finished = true;
+		} else {
+			skipBytes(compressedSize);
+		}
+		throw runtime_error(path + ": " + name + ((flags & FLAG_ENCRYPTED) ? string(" is encrypted") :
+			" uses unsupported compression method " + toString(method)));
+	}
+	entryPending = false;
+	PhaseTimer timer(PHASE_INFLATE);
+	if(method == METHOD_DEFLATED && wholeBufferInflater && !(flags & FLAG_DATA_DESCRIPTOR)) {
+		inflateWholeEntry(data);
+	} else if(method == METHOD_DEFLATED) {
+		inflateEntry(data);
+	} else {
+		copyEntry(data);
+	}
+	if(flags & FLAG_DATA_DESCRIPTOR) {
+		// The descriptor's signature is optional, so a CRC that happens to equal it is ambiguous. The
+		// signature is far more likely.
+		if(!fill(12)) {
+			throw runtime_error(path + " is truncated");
+		}
+		uint32_t first = readInt();
+		if(first == DATA_DESCRIPTOR) {
+			if(!fill(12)) {
+				throw runtime_error(path + " is truncated");
+			}
+			first = readInt();
+		}
+		crc = first;
+		compressedSize = readInt();
+		uncompressedSize = readInt();
+	}
+	if(data.size() != uncompressedSize) {
+		throw runtime_error(path + ": " + name + " should be " + toString(uncompressedSize) + " bytes, but is " + toString(data.size()));
+	}
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+	uint32_t actual = wholeBufferInflater ? wholeBufferInflater->checksum(bytes, data.size()) : crc32(crc32(0, Z_NULL, 0), bytes, data.size());
+	if(actual != crc) {
+		throw runtime_error(path + ": " + name + " fails its CRC check");
+	}
+	timer.addBytes(data.size());
+}
+
+/**
+ * Skips the current entry. Deflated entries without their sizes up front still have to be inflated to
+ * find where they end.
+ */
+void JarStream::skipEntry() {
+	if(!entryPending) {
+		return;
+	}
+	if(flags & FLAG_DATA_DESCRIPTOR) {
+		readEntry(scratch);
+	} else {
+		entryPending = false;
+		skipBytes(compressedSize);
+	}
+}
+
+/**
+ * Inflates a deflated entry. If its size is known up front, data is sized exactly once; otherwise it grows
+ * until the deflate stream ends.
+ */
+void JarStream::inflateEntry(string& data) {
+	bool knownSize = !(flags & FLAG_DATA_DESCRIPTOR);
+	// One spare byte, so that an entry bigger than its header claims is caught instead of truncated.
+	data.resize(knownSize ? uncompressedSize + 1 : std::max<size_t>(data.capacity(), 1 << 12));
+	inflateReset(&inflater);
+	size_t produced = 0;
+	uint64_t consumed = 0;
+	int result = Z_OK;
+	while(result != Z_STREAM_END) {
+		if(inputStart == inputEnd && !fill(1)) {
+			throw runtime_error(path + " is truncated");
+		}
+		if(produced == data.size()) {
+			if(knownSize) {
+				skipBytes(compressedSize - consumed);
+				throw runtime_error(path + ": " + name + " inflates to more than " + toString(uncompressedSize) + " bytes");
+			}
+			data.resize(data.size() * 2);
+		}
+		size_t available = inputEnd - inputStart;
+		if(knownSize) {
+			available = std::min<uint64_t>(available, compressedSize - consumed);
+			if(available == 0) {
+				throw runtime_error(path + ": " + name + " ends before its deflate stream does");
+			}
+		}
+		inflater.next_in = &input[inputStart];
+		inflater.avail_in = available;
+		inflater.next_out = reinterpret_cast<Bytef*>(&data[produced]);
+		inflater.avail_out = data.size() - produced;
+		result = inflate(&inflater, Z_NO_FLUSH);
+		inputStart += available - inflater.avail_in;
+		consumed += available - inflater.avail_in;
+		produced = data.size() - inflater.avail_out;
+		if(result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+			// With the size known, the rest of the jar can still be read past the bad entry.
+			if(knownSize) {
+				skipBytes(compressedSize - consumed);
+			} else {
+				finished = true;
+			}
+			throw runtime_error(path + ": " + name + " is corrupt: " + string(inflater.msg ? inflater.msg : "unknown error"));
+		}
+	}
+	data.resize(produced);
+	if(knownSize && consumed < compressedSize) {
+		skipBytes(compressedSize - consumed);
+	}
+}
+
+/**
+ * Inflates a deflated entry of known size with the whole-buffer inflater. The compressed data is inflated
+ * in place in the input buffer, which grows if the entry doesn't fit.
+ */
+void JarStream::inflateWholeEntry(string& data) {
+	if(compressedSize > input.size()) {
+		input.resize(compressedSize);
+	}
+	if(!fill(compressedSize)) {
+		throw runtime_error(path + " is truncated");
+	}
+	const uint8_t* compressed = &input[inputStart];
+	// Move past the entry first, so that the rest of the jar can still be read if it's corrupt.
+	inputStart += compressedSize;
+	data.resize(uncompressedSize);
+	try {
+		wholeBufferInflater->inflate(compressed, compressedSize, reinterpret_cast<uint8_t*>(&data[0]), uncompressedSize);
+	} catch(const std::exception& e) {
+		throw runtime_error(path + ": " + name + " is corrupt: " + e.what());
+	}
+}
+
+/**
+ * Copies a stored entry. These have to have their sizes up front, since nothing else marks where they end.
+ */
+void JarStream::copyEntry(string& data) {
+	if(flags & FLAG_DATA_DESCRIPTOR) {
+		finished = true;
+		throw runtime_error(path + ": " + name + " is stored without its size, so it can't be streamed");
+	}
+	data.resize(compressedSize);
+	size_t copied = 0;
+	while(copied < compressedSize) {
+		if(inputStart == inputEnd && !fill(1)) {
+			throw runtime_error(path + " is truncated");
+		}
+		size_t bytes = std::min<size_t>(compressedSize - copied, inputEnd - inputStart);
+		memcpy(&data[copied], &input[inputStart], bytes);
+		inputStart += bytes;
+		copied += bytes;
+	}
+}
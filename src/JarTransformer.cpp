@@ -0,0 +1,299 @@
+#include "JarTransformer.h"
+#include "ClassFile.h"
+#include "ClassPass.h"
+#include "ClassWriter.h"
+#include "ClassQueue.h"
+#include "JarStream.h"
+#include "JarWriter.h"
+#include "Inflater.h"
+#include "MemoryStreamBuf.h"
+#include "Trace.h"
+#include "Util.h"
+
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <cstring>
+#include <stdexcept>
+
+using std::string;
+using std::vector;
+using std::map;
+using std::ostream;
+using std::endl;
+using std::runtime_error;
+
+/**
+ * Constructor for JarTransformer. The VirtualMachine is only used to construct the ClassFiles; classes are
+ * never loaded into it. If numThreads is 0, one thread is used per core.
+ */
+JarTransformer::JarTransformer(VirtualMachine& vm, unsigned int numThreads) :
+	vm(vm), numThreads(numThreads), level(Z_DEFAULT_COMPRESSION), compact(false), writer(NULL), nextSequence(0), entries(0), classes(0),
+	bytesIn(0), bytesOut(0), elapsedSeconds(0) {
+	if(this->numThreads == 0) {
+		this->numThreads = std::thread::hardware_concurrency();
+	}
+	if(this->numThreads == 0) {
+		this->numThreads = 1;
+	}
+}
+
+/**
+ * Destructor for JarTransformer. Deletes the passes.
+ */
+JarTransformer::~JarTransformer() {
+	for(vector<ClassPass*>::iterator it = passes.begin(); it != passes.end(); it++) {
+		delete *it;
+	}
+}
+
+/**
+ * Adds a pass, by name, to run on every class. Passes run in the order they're added.
+ */
+void JarTransformer::addPass(const string& name) {
+	passes.push_back(ClassPass::create(name));
+}
+
+/**
+ * Chooses the inflater backend by name. By default, the fastest one available is used.
+ */
+void JarTransformer::setInflater(const string& backend) {
+	delete Inflater::create(backend); // Make sure it exists before the jar is opened.
+	inflaterBackend = backend;
+}
+
+/**
+ * Sets the zlib compression level for the new jar, from 0, which stores every entry, to 9.
+ */
+void JarTransformer::setLevel(int level) {
+	if(level < 0 || level > 9) {
+		throw runtime_error("Compression level has to be between 0 and 9, not " + toString(level));
+	}
+	this->level = level;
+}
+
+/**
+ * Sets whether the constant pool of each class is compacted after the passes, leaving out the constants nothing
+ * refers to any more. Classes with attributes whose layout isn't known keep their whole pool.
+ */
+void JarTransformer::setCompactConstantPool(bool compact) {
+	this->compact = compact;
+}
+
+/**
+ * Transforms every entry of the input jar into the output jar. Throws if either jar can't be read or
+ * written; classes that can't be transformed only count as errors.
+ */
+void JarTransformer::run(const string& input, const string& output) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	pending.clear();
+	nextSequence = 0;
+	failure.clear();
+	entries = 0;
+	classes = 0;
+	bytesIn = 0;
+	bytesOut = 0;
+	errors.clear();
+
+	JarWriter jar(output);
+	writer = &jar;
+	ClassQueue queue(numThreads * 4);
+	vector<std::thread> workers;
+	for(unsigned int i = 0; i < numThreads; i++) {
+		workers.push_back(std::thread(&JarTransformer::consume, this, std::ref(queue)));
+	}
+
+	uint32_t sequence = 0;
+	ClassBuffer buffer;
+	Inflater* inflater = NULL;
+	try {
+		inflater = Inflater::create(inflaterBackend);
+		JarStream stream(input);
+		stream.setInflater(inflater);
+		while(stream.nextEntry()) {
+			{
+				// Once an entry fails nothing more is written, so there's no point reading the rest.
+				std::lock_guard<std::mutex> lock(outputMutex);
+				if(!failure.empty()) {
+					break;
+				}
+			}
+			buffer.sequence = sequence++;
+			buffer.jar = input;
+			buffer.name = stream.getName();
+			stream.readEntry(buffer.data);
+			bytesIn += buffer.data.size();
+			queue.push(buffer);
+		}
+	} catch(...) {
+		queue.close();
+		for(vector<std::thread>::iterator it = workers.begin(); it != workers.end(); it++) {
+			it->join();
+		}
+		delete inflater;
+		writer = NULL;
+		throw;
+	}
+	delete inflater;
+	queue.close();
+	for(vector<std::thread>::iterator it = workers.begin(); it != workers.end(); it++) {
+		it->join();
+	}
+	writer = NULL;
+	if(!failure.empty()) {
+		throw runtime_error(failure);
+	}
+	jar.close();
+	elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * The body of a worker thread. Transforms entries off the queue until it's closed and empty. Each worker has
+ * its own deflate stream and buffers, which are reused from one entry to the next.
+ */
+void JarTransformer::consume(ClassQueue& queue) {
+	z_stream deflater;
+	memset(&deflater, 0, sizeof(deflater));
+	// Negative window bits mean a raw deflate stream, without the zlib header, which is what zips hold.
+	bool initialized = deflateInit2(&deflater, level == 0 ? 1 : level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+	ClassBuffer buffer;
+	string scratch;
+	Result result;
+	while(queue.pop(buffer)) {
+		try {
+			if(!initialized) {
+				throw runtime_error("Could not initialize zlib: " + string(deflater.msg ? deflater.msg : "unknown error"));
+			}
+			transform(buffer, deflater, scratch, result);
+			finish(buffer.sequence, result);
+		} catch(const std::exception& e) {
+			std::lock_guard<std::mutex> lock(outputMutex);
+			if(failure.empty()) {
+				failure = e.what();
+			}
+		}
+	}
+	if(initialized) {
+		deflateEnd(&deflater);
+	}
+}
+
+/**
+ * Rewrites a class through the passes, if the entry is one, and compresses the entry. A class that can't be
+ * parsed or written is kept as it was, with the reason in the result.
+ */
+void JarTransformer::transform(ClassBuffer& buffer, z_stream& deflater, string& scratch, Result& result) {
+	result.name = buffer.name;
+	result.error.clear();
+	const string* data = &buffer.data;
+	if(isClassFile(buffer.name)) {
+		TraceSpan span("transform", "class", buffer.name);
+		try {
+			MemoryStreamBuf streamBuffer(buffer.data.data(), buffer.data.size());
+			std::istream in(&streamBuffer);
+			ClassFile classFile(vm, in);
+			ClassWriter classWriter(classFile, buffer.data.data(), buffer.data.size());
+			for(vector<ClassPass*>::iterator it = passes.begin(); it != passes.end(); it++) {
+				classWriter.addFilter(*it);
+			}
+			if(compact) {
+				classWriter.compactConstantPool();
+			}
+			scratch.resize(classWriter.getSize());
+			if(!scratch.empty()) {
+				classWriter.write(&scratch[0]);
+			}
+			data = &scratch;
+		} catch(const std::exception& e) {
+			result.error = e.what();
+		} catch(...) {
+			result.error = "Not a class file";
+		}
+	}
+
+	result.size = data->size();
+	result.crc = crc32(crc32(0, Z_NULL, 0), reinterpret_cast<const Bytef*>(data->data()), data->size());
+	result.method = JarWriter::STORED;
+	if(level != 0 && !data->empty()) {
+		deflateReset(&deflater);
+		result.data.resize(deflateBound(&deflater, data->size()));
+		deflater.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data->data()));
+		deflater.avail_in = data->size();
+		deflater.next_out = reinterpret_cast<Bytef*>(&result.data[0]);
+		deflater.avail_out = result.data.size();
+		if(::deflate(&deflater, Z_FINISH) != Z_STREAM_END) {
+			throw runtime_error("zlib could not deflate " + buffer.name + ": " + string(deflater.msg ? deflater.msg : "unknown error"));
+		}
+		result.data.resize(deflater.total_out);
+		// Entries that don't get any smaller are stored, like jar tools do.
+		if(result.data.size() < data->size()) {
+			result.method = JarWriter::DEFLATED;
+		}
+	}
+	if(result.method == JarWriter::STORED) {
+		result.data.assign(*data);
+	}
+}
+
+/**
+ * Hands a finished entry over to be written. If it's the next one due, it's written along with any that were
+ * waiting on it; otherwise it waits for the ones before it. The result's buffers are swapped out, not copied.
+ */
+void JarTransformer::finish(uint32_t sequence, Result& result) {
+	std::lock_guard<std::mutex> lock(outputMutex);
+	if(!failure.empty()) {
+		// Nothing more is written once writing has failed.
+		return;
+	}
+	if(sequence != nextSequence) {
+		std::swap(pending[sequence], result);
+		return;
+	}
+	write(result);
+	nextSequence++;
+	for(map<uint32_t, Result>::iterator it = pending.begin(); it != pending.end() && it->first == nextSequence; it = pending.begin()) {
+		write(it->second);
+		std::swap(it->second, result);
+		pending.erase(it);
+		nextSequence++;
+	}
+}
+
+/**
+ * Writes an entry to the new jar, and counts it. The output lock has to be held.
+ */
+void JarTransformer::write(Result& result) {
+	writer->addEntry(result.name, result.method, result.crc, result.size, result.data);
+	entries++;
+	bytesOut += result.data.size();
+	if(!result.error.empty()) {
+		errors.push_back(result.name + ": " + result.error);
+	} else if(isClassFile(result.name)) {
+		classes++;
+	}
+}
+
+/**
+ * Gets the number of entries the last run wrote, classes or not.
+ */
+uint32_t JarTransformer::numEntries() const {
+	return entries;
+}
+
+/**
+ * Gets the classes that were copied instead of transformed, and why, in the order they're in the jar.
+ */
+const vector<string>& JarTransformer::getErrors() const {
+	return errors;
+}
+
+/**
+ * Writes how many entries and classes were transformed, and how fast, to a stream. The speed is of the
+ * inflated entries read, and the size is of the jar written, before its central directory.
+ */
+void JarTransformer::writeThroughput(ostream& out) const {
+	double megabytes = bytesIn / (1024.0 * 1024.0);
+	out << "Transformed " << classes << " classes in " << entries << " entries (" << errors.size() << " errors) in "
+		<< elapsedSeconds << "s: " << (elapsedSeconds > 0 ? megabytes / elapsedSeconds : 0) << " MB/s, "
+		<< bytesOut << " bytes written" << endl;
+}
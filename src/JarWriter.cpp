@@ -0,0 +1,146 @@
+#include "JarWriter.h"
+#include "Util.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+using std::string;
+using std::vector;
+using std::runtime_error;
+
+namespace {
+	const uint32_t LOCAL_FILE_HEADER = 0x04034b50;
+	const uint32_t CENTRAL_DIRECTORY_HEADER = 0x02014b50;
+	const uint32_t END_OF_CENTRAL_DIRECTORY = 0x06054b50;
+	const uint16_t VERSION = 20;
+	const uint16_t FLAG_UTF8 = 1 << 11;
+	// Midnight on the first of January 1980, the earliest time a zip can hold.
+	const uint16_t DOS_TIME = 0;
+	const uint16_t DOS_DATE = (1 << 5) | 1;
+
+	/**
+	 * Gets the general purpose flags for an entry, which only say whether its name is UTF-8.
+	 */
+	uint16_t getFlags(const string& name) {
+		for(string::const_iterator it = name.begin(); it != name.end(); it++) {
+			if(static_cast<unsigned char>(*it) >= 0x80) {
+				return FLAG_UTF8;
+			}
+		}
+		return 0;
+	}
+}
+
+/**
+ * Creates a jar. Nothing replaces what's at the path until it's closed.
+ */
+JarWriter::JarWriter(const string& path) :
+	path(path), temporary(createTemporaryFile(path)), file(temporary.c_str(), std::ios::out | std::ios::binary | std::ios::trunc), offset(0),
+	closed(false) {
+	if(!file) {
+		throw runtime_error("Could not open " + temporary + " for writing");
+	}
+}
+
+/**
+ * Destructor for JarWriter. A jar that was never closed is thrown away.
+ */
+JarWriter::~JarWriter() {
+	if(!closed) {
+		file.close();
+		remove(temporary.c_str());
+	}
+}
+
+/**
+ * Writes an entry, whose data is already compressed with the given method. The CRC and size are of the
+ * uncompressed data.
+ */
+void JarWriter::addEntry(const string& name, uint16_t method, uint32_t crc, uint32_t uncompressedSize, const string& data) {
+	if(closed) {
+		throw runtime_error("Jar " + path + " is already closed");
+	}
+	if(entries.size() + 1 > 0xFFFF || name.size() > 0xFFFF || data.size() > 0xFFFFFFFFU
+		|| offset + 30 + name.size() + data.size() > 0xFFFFFFFFU) {
+		throw runtime_error("Jar " + path + " would need Zip64, which isn't supported");
+	}
+	Entry entry;
+	entry.name = name;
+	entry.method = method;
+	entry.crc = crc;
+	entry.compressedSize = data.size();
+	entry.uncompressedSize = uncompressedSize;
+	entry.offset = offset;
+
+	string header;
+	writeLittle32(header, LOCAL_FILE_HEADER);
+	writeLittle16(header, VERSION);
+	writeLittle16(header, getFlags(name));
+	writeLittle16(header, method);
+	writeLittle16(header, DOS_TIME);
+	writeLittle16(header, DOS_DATE);
+	writeLittle32(header, crc);
+	writeLittle32(header, entry.compressedSize);
+	writeLittle32(header, uncompressedSize);
+	writeLittle16(header, name.size());
+	writeLittle16(header, 0);
+	header += name;
+	file.write(header.data(), header.size());
+	file.write(data.data(), data.size());
+	if(!file) {
+		throw runtime_error("Could not write " + name + " to " + temporary);
+	}
+	offset += header.size() + data.size();
+	entries.push_back(entry);
+}
+
+/**
+ * Writes the central directory, and moves the jar into place.
+ */
+void JarWriter::close() {
+	if(closed) {
+		return;
+	}
+	string directory;
+	for(vector<Entry>::const_iterator it = entries.begin(); it != entries.end(); it++) {
+		writeLittle32(directory, CENTRAL_DIRECTORY_HEADER);
+		writeLittle16(directory, VERSION);
+		writeLittle16(directory, VERSION);
+		writeLittle16(directory, getFlags(it->name));
+		writeLittle16(directory, it->method);
+		writeLittle16(directory, DOS_TIME);
+		writeLittle16(directory, DOS_DATE);
+		writeLittle32(directory, it->crc);
+		writeLittle32(directory, it->compressedSize);
+		writeLittle32(directory, it->uncompressedSize);
+		writeLittle16(directory, it->name.size());
+		writeLittle16(directory, 0);
+		writeLittle16(directory, 0);
+		writeLittle16(directory, 0);
+		writeLittle16(directory, 0);
+		writeLittle32(directory, 0);
+		writeLittle32(directory, it->offset);
+		directory += it->name;
+	}
+	if(offset + directory.size() > 0xFFFFFFFFU) {
+		throw runtime_error("Jar " + path + " would need Zip64, which isn't supported");
+	}
+	uint32_t directorySize = directory.size();
+	writeLittle32(directory, END_OF_CENTRAL_DIRECTORY);
+	writeLittle16(directory, 0);
+	writeLittle16(directory, 0);
+	writeLittle16(directory, entries.size());
+	writeLittle16(directory, entries.size());
+	writeLittle32(directory, directorySize);
+	writeLittle32(directory, offset);
+	writeLittle16(directory, 0);
+	file.write(directory.data(), directory.size());
+	file.close();
+	if(!file) {
+		throw runtime_error("Could not write " + temporary);
+	}
+	if(rename(temporary.c_str(), path.c_str()) != 0) {
+		throw runtime_error("Could not move " + temporary + " to " + path);
+	}
+	closed = true;
+}
@@ -0,0 +1,284 @@
+#include "JavaThread.h"
+#include "ClassFile.h"
+#include "Monitor.h"
+#include "Profiler.h"
+#include "Util.h"
+
+#include <new>
+#include <stdexcept>
+
+using std::runtime_error;
+using std::function;
+using std::thread;
+
+namespace {
+	/**
+	 * The number of 64-bit slots a Frame object takes up at the bottom of its stack allocation.
+	 */
+	const uint32_t FRAME_SLOTS = (sizeof(Frame) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+	thread_local JavaThread* currentThread = NULL;
+}
+
+/**
+ * Constructs a Frame. The slots pointer points at the memory for the local variables, which the operand
+ * stack immediately follows.
+ */
+Frame::Frame(ClassFile& classFile, const ClassMember& method, Frame* previous, uint64_t* slots, uint16_t maxLocals, uint16_t maxStack) :
+	classFile(classFile),
+	method(method),
+	previous(previous),
+	lockedObject(NULL),
+	locals(slots),
+	operands(slots + maxLocals),
+	maxLocals(maxLocals),
+	maxStack(maxStack),
+	stackDepth(0),
+	pc(0) {
+
+}
+
+/**
+ * Destructor for Frame. The slots belong to the thread, so nothing is deleted.
+ */
+Frame::~Frame() {
+
+}
+
+/**
+ * Gets the class file whose method this frame is executing.
+ */
+ClassFile& Frame::getClassFile() {
+	return classFile;
+}
+
+/**
+ * Gets the method this frame is executing.
+ */
+const ClassMember& Frame::getMethod() const {
+	return method;
+}
+
+/**
+ * Gets the frame of the caller, or NULL if this is the bottom frame of the thread.
+ */
+Frame* Frame::getPrevious() {
+	return previous;
+}
+
+/**
+ * Gets the object whose monitor was entered when this frame was pushed, for synchronized methods. Returns
+ * NULL for methods that aren't synchronized.
+ */
+ObjectHeader* Frame::getLockedObject() {
+	return lockedObject;
+}
+
+/**
+ * Gets the number of local variable slots in this frame.
+ */
+uint16_t Frame::getMaxLocals() const {
+	return maxLocals;
+}
+
+/**
+ * Gets the maximum depth of the operand stack in this frame.
+ */
+uint16_t Frame::getMaxStack() const {
+	return maxStack;
+}
+
+/**
+ * Gets the current depth of the operand stack.
+ */
+uint16_t Frame::getStackDepth() const {
+	return stackDepth;
+}
+
+/**
+ * Gets the offset into the method's code of the instruction being executed.
+ */
+uint32_t Frame::getPc() const {
+	return pc;
+}
+
+/**
+ * Sets the offset into the method's code of the instruction being executed.
+ */
+void Frame::setPc(uint32_t pc) {
+	this->pc = pc;
+}
+
+/**
+ * Constructs a JavaThread with its own stack of the given number of slots. The OS thread isn't started
+ * until start() is called.
+ */
+JavaThread::JavaThread(VirtualMachine& vm, uint32_t id, uint32_t stackSlots) :
+	vm(vm),
+	id(id),
+	stack(new uint64_t[stackSlots]),
+	stackLimit(stack + stackSlots),
+	stackPointer(stack),
+	currentFrame(NULL),
+	depth(0),
+	profiler(Profiler::getMode() != Profiler::OFF ? new Profiler() : NULL) {
+
+}
+
+/**
+ * Destructor for JavaThread. Waits for the OS thread to finish, pops anything left on the stack, releasing the
+ * monitors its synchronized methods hold, and frees it.
+ */
+JavaThread::~JavaThread() {
+	if(osThread.joinable()) {
+		osThread.join();
+	}
+	// Popping releases the monitors of synchronized methods still on the stack. A frame is off the stack before
+	// its monitor is exited, so one that can't be exited doesn't stop the rest from being popped.
+	while(currentFrame != NULL) {
+		try {
+			popFrame();
+		} catch(const std::exception&) {
+		}
+	}
+	if(currentThread == this) {
+		currentThread = NULL;
+	}
+	delete profiler;
+	delete[] stack;
+}
+
+/**
+ * Gets the VirtualMachine this thread belongs to.
+ */
+VirtualMachine& JavaThread::getVirtualMachine() {
+	return vm;
+}
+
+/**
+ * Gets the id of this thread. Ids are never 0, since a lock word with an owner of 0 is unlocked.
+ */
+uint32_t JavaThread::getId() const {
+	return id;
+}
+
+/**
+ * Pushes a frame for the given method. If the method is synchronized, its monitor is entered first: the
+ * receiver's for instance methods, or the class's for static ones.
+ */
+Frame& JavaThread::pushFrame(ClassFile& cf, const ClassMember& method, uint16_t maxLocals, uint16_t maxStack, ObjectHeader* receiver) {
+	uint64_t* frameEnd = stackPointer + FRAME_SLOTS + maxLocals + maxStack;
+	if(frameEnd > stackLimit) {
+		throw runtime_error("StackOverflowError at depth " + toString(depth) + ".");
+	}
+	ObjectHeader* lockedObject = NULL;
+	if(method.getAccessFlags().isSynchronized()) {
+		lockedObject = method.getAccessFlags().isStatic() ? &cf.getHeader() : receiver;
+		if(lockedObject == NULL) {
+			throw runtime_error("NullPointerException: synchronized method invoked without a receiver.");
+		}
+		lockedObject->monitorEnter(id);
+	}
+	Frame* frame = new(stackPointer) Frame(cf, method, currentFrame, stackPointer + FRAME_SLOTS, maxLocals, maxStack);
+	frame->lockedObject = lockedObject;
+	stackPointer = frameEnd;
+	currentFrame = frame;
+	depth++;
+	if(profiler) {
+		profiler->enter(cf, method);
+	}
+	return *frame;
+}
+
+/**
+ * Pops the current frame, releasing its monitor if its method was synchronized.
+ */
+void JavaThread::popFrame() {
+	if(currentFrame == NULL) {
+		throw runtime_error("Popped a frame off of an empty stack.");
+	}
+	if(profiler) {
+		profiler->exit();
+	}
+	Frame* frame = currentFrame;
+	currentFrame = frame->previous;
+	stackPointer = reinterpret_cast<uint64_t*>(frame);
+	depth--;
+	ObjectHeader* lockedObject = frame->lockedObject;
+	frame->~Frame();
+	if(lockedObject != NULL) {
+		lockedObject->monitorExit(id);
+	}
+}
+
+/**
+ * Gets the frame currently being executed, or NULL if the stack is empty.
+ */
+Frame* JavaThread::getCurrentFrame() {
+	return currentFrame;
+}
+
+/**
+ * Gets the profiler counting this thread's execution, or NULL if profiling was off when it was created.
+ */
+Profiler* JavaThread::getProfiler() {
+	return profiler;
+}
+
+/**
+ * Gets the number of frames on the stack.
+ */
+uint32_t JavaThread::getDepth() const {
+	return depth;
+}
+
+/**
+ * Implements the monitorenter instruction for this thread.
+ */
+void JavaThread::monitorEnter(ObjectHeader& object) {
+	object.monitorEnter(id);
+}
+
+/**
+ * Implements the monitorexit instruction for this thread.
+ */
+void JavaThread::monitorExit(ObjectHeader& object) {
+	object.monitorExit(id);
+}
+
+/**
+ * Makes this the JavaThread for the calling OS thread. Used for the main thread, which the VM doesn't create.
+ */
+void JavaThread::attach() {
+	currentThread = this;
+}
+
+/**
+ * Starts a new OS thread for this JavaThread, which runs the given function.
+ */
+void JavaThread::start(function<void(JavaThread&)> body) {
+	if(osThread.joinable()) {
+		throw runtime_error("Thread " + toString(id) + " has already been started.");
+	}
+	osThread = thread([this, body]() {
+		currentThread = this;
+		body(*this);
+		currentThread = NULL;
+	});
+}
+
+/**
+ * Waits for this thread's OS thread to finish.
+ */
+void JavaThread::join() {
+	if(osThread.joinable()) {
+		osThread.join();
+	}
+}
+
+/**
+ * Returns the JavaThread for the calling OS thread, or NULL if it doesn't have one.
+ */
+JavaThread* JavaThread::current() {
+	return currentThread;
+}
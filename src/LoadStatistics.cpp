@@ -0,0 +1,359 @@
+#include "LoadStatistics.h"
+
+#include <cstdlib>
+#include <iomanip>
+#include <mutex>
+#include <new>
+#include <set>
+
+using std::ostream;
+using std::istream;
+using std::endl;
+using std::setw;
+using std::set;
+using std::mutex;
+using std::lock_guard;
+using std::atomic;
+using std::memory_order_relaxed;
+
+namespace {
+	/**
+	 * The number of allocations made by this thread, bumped by operator new. It's trivially initialized, so
+	 * it's safe to touch before anything else in the program is constructed.
+	 */
+	thread_local uint64_t allocations = 0;
+
+	/**
+	 * The innermost phase being timed on this thread.
+	 */
+	thread_local PhaseTimer* currentTimer = NULL;
+
+	/**
+	 * Gets how far a stream has been read, or -1 if its buffer can't tell. It asks the buffer rather than
+	 * calling tellg, which sets failbit on a stream that's already at its end and so would change the state the
+	 * code being timed sees.
+	 */
+	int64_t getPosition(istream* in) {
+		std::streambuf* buffer = in->rdbuf();
+		return buffer ? static_cast<int64_t>(buffer->pubseekoff(0, std::ios_base::cur, std::ios_base::in)) : -1;
+	}
+
+	const unsigned int CALLS = 0;
+	const unsigned int NANOSECONDS = 1;
+	const unsigned int BYTES = 2;
+	const unsigned int ALLOCATIONS = 3;
+	const unsigned int NUM_COUNTERS = 4;
+
+	/**
+	 * One thread's counters. Only the owning thread writes them, but others read them while they're
+	 * collected, so they're atomics that are only ever loaded and stored.
+	 */
+	struct ThreadCounters {
+		atomic<uint64_t> counters[NUM_LOAD_PHASES][NUM_COUNTERS];
+
+		ThreadCounters();
+		~ThreadCounters();
+
+		void add(unsigned int phase, unsigned int counter, uint64_t value) {
+			atomic<uint64_t>& total = counters[phase][counter];
+			total.store(total.load(memory_order_relaxed) + value, memory_order_relaxed);
+		}
+
+		void collect(PhaseTotals totals[NUM_LOAD_PHASES]) const;
+		void reset();
+	};
+
+	/**
+	 * Every live thread's counters, and the totals of the threads that have exited.
+	 */
+	struct Registry {
+		mutex lock;
+		set<ThreadCounters*> threads;
+		PhaseTotals retired[NUM_LOAD_PHASES];
+	};
+
+	Registry& getRegistry() {
+		static Registry registry;
+		return registry;
+	}
+
+	ThreadCounters::ThreadCounters() {
+		for(unsigned int phase = 0; phase < NUM_LOAD_PHASES; phase++) {
+			for(unsigned int counter = 0; counter < NUM_COUNTERS; counter++) {
+				counters[phase][counter].store(0, memory_order_relaxed);
+			}
+		}
+		Registry& registry = getRegistry();
+		lock_guard<mutex> guard(registry.lock);
+		registry.threads.insert(this);
+	}
+
+	ThreadCounters::~ThreadCounters() {
+		Registry& registry = getRegistry();
+		lock_guard<mutex> guard(registry.lock);
+		collect(registry.retired);
+		registry.threads.erase(this);
+	}
+
+	void ThreadCounters::collect(PhaseTotals totals[NUM_LOAD_PHASES]) const {
+		for(unsigned int phase = 0; phase < NUM_LOAD_PHASES; phase++) {
+			totals[phase].calls += counters[phase][CALLS].load(memory_order_relaxed);
+			totals[phase].nanoseconds += counters[phase][NANOSECONDS].load(memory_order_relaxed);
+			totals[phase].bytes += counters[phase][BYTES].load(memory_order_relaxed);
+			totals[phase].allocations += counters[phase][ALLOCATIONS].load(memory_order_relaxed);
+		}
+	}
+
+	void ThreadCounters::reset() {
+		for(unsigned int phase = 0; phase < NUM_LOAD_PHASES; phase++) {
+			for(unsigned int counter = 0; counter < NUM_COUNTERS; counter++) {
+				counters[phase][counter].store(0, memory_order_relaxed);
+			}
+		}
+	}
+
+	/**
+	 * Gets this thread's counters, registering them the first time.
+	 */
+	ThreadCounters& getThreadCounters() {
+		thread_local ThreadCounters counters;
+		return counters;
+	}
+}
+
+/**
+ * Counts every allocation on the calling thread, for the phase timers.
+ */
+void* operator new(size_t size) {
+	allocations++;
+	for(;;) {
+		void* memory = malloc(size ? size : 1);
+		if(memory) {
+			return memory;
+		}
+		std::new_handler handler = std::get_new_handler();
+		if(!handler) {
+			throw std::bad_alloc();
+		}
+		handler();
+	}
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	try {
+		return operator new(size);
+	} catch(const std::bad_alloc&) {
+		return NULL;
+	}
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void* memory) noexcept {
+	free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+	free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+	free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+	free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+	free(memory);
+}
+
+atomic<bool> LoadStatistics::enabled(false);
+
+/**
+ * Constructor for PhaseTotals. Everything starts at zero.
+ */
+PhaseTotals::PhaseTotals() : calls(0), nanoseconds(0), bytes(0), allocations(0) {
+
+}
+
+/**
+ * Adds another set of totals to this one.
+ */
+void PhaseTotals::add(const PhaseTotals& other) {
+	calls += other.calls;
+	nanoseconds += other.nanoseconds;
+	bytes += other.bytes;
+	allocations += other.allocations;
+}
+
+/**
+ * Turns phase timing on or off for every thread. Phases that are already running when it's turned on
+ * aren't counted.
+ */
+void LoadStatistics::setEnabled(bool enabled) {
+	LoadStatistics::enabled.store(enabled, memory_order_relaxed);
+}
+
+/**
+ * Adds a finished phase to the calling thread's counters.
+ */
+void LoadStatistics::record(LoadPhase phase, uint64_t nanoseconds, uint64_t bytes, uint64_t allocations) {
+	ThreadCounters& counters = getThreadCounters();
+	counters.add(phase, CALLS, 1);
+	counters.add(phase, NANOSECONDS, nanoseconds);
+	counters.add(phase, BYTES, bytes);
+	counters.add(phase, ALLOCATIONS, allocations);
+}
+
+/**
+ * Sums the counters of every thread, live or exited, into totals, which should start at zero. Phases still
+ * running aren't included.
+ */
+void LoadStatistics::collect(PhaseTotals totals[NUM_LOAD_PHASES]) {
+	Registry& registry = getRegistry();
+	lock_guard<mutex> guard(registry.lock);
+	for(unsigned int phase = 0; phase < NUM_LOAD_PHASES; phase++) {
+		totals[phase].add(registry.retired[phase]);
+	}
+	for(set<ThreadCounters*>::const_iterator it = registry.threads.begin(); it != registry.threads.end(); it++) {
+		(*it)->collect(totals);
+	}
+}
+
+/**
+ * Zeroes every thread's counters, and the totals of exited threads.
+ */
+void LoadStatistics::reset() {
+	Registry& registry = getRegistry();
+	lock_guard<mutex> guard(registry.lock);
+	for(unsigned int phase = 0; phase < NUM_LOAD_PHASES; phase++) {
+		registry.retired[phase] = PhaseTotals();
+	}
+	for(set<ThreadCounters*>::iterator it = registry.threads.begin(); it != registry.threads.end(); it++) {
+		(*it)->reset();
+	}
+}
+
+/**
+ * Gets the number of allocations the calling thread has made so far.
+ */
+uint64_t LoadStatistics::getAllocations() {
+	return allocations;
+}
+
+/**
+ * Gets the name a phase is reported under.
+ */
+const char* LoadStatistics::getPhaseName(LoadPhase phase) {
+	switch(phase) {
+		case PHASE_LOOKUP:
+			return "lookup";
+		case PHASE_INFLATE:
+			return "inflate";
+		case PHASE_CONSTANT_POOL:
+			return "constant pool";
+		case PHASE_MEMBERS:
+			return "members";
+		case PHASE_ATTRIBUTES:
+			return "attributes";
+		case PHASE_VALIDATE:
+			return "validate";
+		case PHASE_INITIALIZE:
+			return "initialize";
+		default:
+			return "unknown";
+	}
+}
+
+/**
+ * Writes a table of the totals for every phase, and for all of them together.
+ */
+void LoadStatistics::write(ostream& out) {
+	PhaseTotals totals[NUM_LOAD_PHASES];
+	collect(totals);
+	PhaseTotals sum;
+	out << std::left << setw(16) << "phase" << std::right << setw(12) << "calls" << setw(14) << "self ms";
+	out << setw(14) << "MB" << setw(14) << "allocations" << endl;
+	for(unsigned int phase = 0; phase <= NUM_LOAD_PHASES; phase++) {
+		const PhaseTotals& row = phase < NUM_LOAD_PHASES ? totals[phase] : sum;
+		const char* name = phase < NUM_LOAD_PHASES ? getPhaseName(static_cast<LoadPhase>(phase)) : "total";
+		out << std::left << setw(16) << name << std::right << setw(12) << row.calls;
+		out << std::fixed << std::setprecision(3) << setw(14) << (row.nanoseconds / 1e6) << setw(14) << (row.bytes / (1024.0 * 1024.0));
+		out << setw(14) << row.allocations << endl;
+		if(phase < NUM_LOAD_PHASES) {
+			sum.add(row);
+		}
+	}
+	out.unsetf(std::ios_base::floatfield);
+	out << std::setprecision(6);
+}
+
+/**
+ * Starts timing, pausing whichever phase this one is nested in.
+ */
+void PhaseTimer::start(istream* in) {
+	active = true;
+	counting = LoadStatistics::isEnabled();
+	tracing = Trace::isEnabled();
+	parent = currentTimer;
+	this->in = in;
+	startPosition = in ? getPosition(in) : -1;
+	nanoseconds = 0;
+	bytes = 0;
+	childBytes = 0;
+	startAllocations = allocations;
+	childAllocations = 0;
+	uint64_t time = Trace::now();
+	if(parent) {
+		parent->nanoseconds += time - parent->resumed;
+	}
+	started = time;
+	resumed = time;
+	currentTimer = this;
+}
+
+/**
+ * Stops timing, records the phase, and resumes the phase it was nested in.
+ */
+PhaseTimer::~PhaseTimer() {
+	if(!active) {
+		return;
+	}
+	uint64_t time = Trace::now();
+	nanoseconds += time - resumed;
+	uint64_t streamBytes = 0;
+	if(in && startPosition >= 0) {
+		int64_t endPosition = getPosition(in);
+		if(endPosition > startPosition) {
+			streamBytes = endPosition - startPosition;
+		}
+	}
+	uint64_t ownAllocations = allocations - startAllocations;
+	uint64_t ownStreamBytes = streamBytes > childBytes ? streamBytes - childBytes : 0;
+	if(counting) {
+		LoadStatistics::record(phase, nanoseconds, bytes + ownStreamBytes, ownAllocations - childAllocations);
+	}
+	if(tracing) {
+		Trace::record("phase", LoadStatistics::getPhaseName(phase), "", started, time);
+	}
+	if(parent) {
+		if(in && parent->in == in) {
+			parent->childBytes += streamBytes;
+		}
+		parent->childAllocations += ownAllocations;
+		parent->resumed = time;
+	}
+	currentTimer = parent;
+}
@@ -0,0 +1,48 @@
+#include "MemoryStreamBuf.h"
+
+using std::ios_base;
+
+/**
+ * Constructor for MemoryStreamBuf. The whole buffer is the get area from the start, so reads never need
+ * to call back into the buffer to refill it.
+ */
+MemoryStreamBuf::MemoryStreamBuf(const char* data, size_t size) {
+	char* start = const_cast<char*>(data);
+	setg(start, start, start + size);
+}
+
+/**
+ * Destructor for MemoryStreamBuf. The memory isn't ours, so nothing is freed.
+ */
+MemoryStreamBuf::~MemoryStreamBuf() {
+
+}
+
+/**
+ * Moves the read position relative to the start, the current position, or the end.
+ */
+MemoryStreamBuf::pos_type MemoryStreamBuf::seekoff(off_type offset, ios_base::seekdir direction, ios_base::openmode mode) {
+	if(!(mode & ios_base::in)) {
+		return pos_type(off_type(-1));
+	}
+	char* target;
+	if(direction == ios_base::beg) {
+		target = eback() + offset;
+	} else if(direction == ios_base::cur) {
+		target = gptr() + offset;
+	} else {
+		target = egptr() + offset;
+	}
+	if(target < eback() || target > egptr()) {
+		return pos_type(off_type(-1));
+	}
+	setg(eback(), target, egptr());
+	return pos_type(target - eback());
+}
+
+/**
+ * Moves the read position to an absolute offset.
+ */
+MemoryStreamBuf::pos_type MemoryStreamBuf::seekpos(pos_type position, ios_base::openmode mode) {
+	return seekoff(off_type(position), ios_base::beg, mode);
+}
@@ -0,0 +1,230 @@
+#include "ModifiedUtf8.h"
+
+#include <stdint.h>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_X86_VECTORS
+#endif
+
+using std::string;
+
+namespace {
+	typedef size_t (*CountAscii)(const char* data, size_t size);
+
+	/**
+	 * Counts ASCII bytes one at a time, for the tail a vector doesn't fit in.
+	 */
+	size_t countAsciiScalar(const char* data, size_t size) {
+		size_t i = 0;
+		while(i < size && static_cast<uint8_t>(data[i]) - 1U < 0x7FU) {
+			i++;
+		}
+		return i;
+	}
+
+#ifdef HAVE_X86_VECTORS
+	/**
+	 * Counts ASCII bytes sixteen at a time. A byte stops the count if its top bit is set, or if it's zero.
+	 */
+	__attribute__((target("sse2"))) size_t countAsciiSse2(const char* data, size_t size) {
+		const __m128i zero = _mm_setzero_si128();
+		size_t i = 0;
+		for(; i + 16 <= size; i += 16) {
+			__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+			int stops = _mm_movemask_epi8(bytes) | _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, zero));
+			if(stops) {
+				return i + __builtin_ctz(stops);
+			}
+		}
+		return i + countAsciiScalar(data + i, size - i);
+	}
+
+	/**
+	 * Counts ASCII bytes thirty-two at a time. The tail is done here with VEX encoded instructions, rather than by
+	 * calling the SSE2 version, since mixing the two encodings stalls some CPUs.
+	 */
+	__attribute__((target("avx2"))) size_t countAsciiAvx2(const char* data, size_t size) {
+		const __m256i zero = _mm256_setzero_si256();
+		size_t i = 0;
+		for(; i + 32 <= size; i += 32) {
+			__m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+			uint32_t stops = static_cast<uint32_t>(_mm256_movemask_epi8(bytes)) | static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, zero)));
+			if(stops) {
+				return i + __builtin_ctz(stops);
+			}
+		}
+		if(i + 16 <= size) {
+			__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+			int stops = _mm_movemask_epi8(bytes) | _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_setzero_si128()));
+			if(stops) {
+				return i + __builtin_ctz(stops);
+			}
+			i += 16;
+		}
+		return i + countAsciiScalar(data + i, size - i);
+	}
+#endif
+
+	/**
+	 * Picks the widest vectors the CPU has.
+	 */
+	CountAscii selectCountAscii() {
+#ifdef HAVE_X86_VECTORS
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx2")) {
+			return countAsciiAvx2;
+		}
+		if(__builtin_cpu_supports("sse2")) {
+			return countAsciiSse2;
+		}
+#endif
+		return countAsciiScalar;
+	}
+
+	/**
+	 * Checks a modified UTF-8 string, and converts it to standard UTF-8 if out isn't NULL: NUL becomes a single
+	 * zero byte, and surrogate pairs become four byte sequences. Unpaired surrogates are legal in Java strings, so
+	 * they're kept as they are. Overlong encodings, other than the one for NUL, aren't legal.
+	 */
+	bool decode(const char* data, size_t size, string* out) {
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+		size_t i = 0;
+		for(;;) {
+			size_t ascii = countAscii(data + i, size - i);
+			if(out) {
+				out->append(data + i, ascii);
+			}
+			i += ascii;
+			if(i == size) {
+				return true;
+			}
+			uint8_t lead = bytes[i];
+			if((lead & 0xE0) == 0xC0) {
+				if(i + 1 >= size || (bytes[i + 1] & 0xC0) != 0x80) {
+					return false;
+				}
+				uint32_t c = ((lead & 0x1F) << 6) | (bytes[i + 1] & 0x3F);
+				if(c != 0 && c < 0x80) {
+					return false;
+				}
+				if(out && c == 0) {
+					out->push_back('\0');
+				} else if(out) {
+					out->append(data + i, 2);
+				}
+				i += 2;
+			} else if((lead & 0xF0) == 0xE0) {
+				if(i + 2 >= size || (bytes[i + 1] & 0xC0) != 0x80 || (bytes[i + 2] & 0xC0) != 0x80) {
+					return false;
+				}
+				uint32_t c = ((lead & 0x0F) << 12) | ((bytes[i + 1] & 0x3F) << 6) | (bytes[i + 2] & 0x3F);
+				if(c < 0x800) {
+					return false;
+				}
+				// A high surrogate followed by a low one, which is always 0xED 0xB?, is one supplementary character.
+				if(c >= 0xD800 && c <= 0xDBFF && i + 5 < size && bytes[i + 3] == 0xED && (bytes[i + 4] & 0xF0) == 0xB0
+					&& (bytes[i + 5] & 0xC0) == 0x80) {
+					uint32_t low = 0xD000 | ((bytes[i + 4] & 0x3F) << 6) | (bytes[i + 5] & 0x3F);
+					uint32_t supplementary = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+					if(out) {
+						out->push_back(static_cast<char>(0xF0 | (supplementary >> 18)));
+						out->push_back(static_cast<char>(0x80 | ((supplementary >> 12) & 0x3F)));
+						out->push_back(static_cast<char>(0x80 | ((supplementary >> 6) & 0x3F)));
+						out->push_back(static_cast<char>(0x80 | (supplementary & 0x3F)));
+					}
+					i += 6;
+				} else {
+					if(out) {
+						out->append(data + i, 3);
+					}
+					i += 3;
+				}
+			} else {
+				// A zero byte, a stray continuation byte, or the lead of a four byte sequence.
+				return false;
+			}
+		}
+	}
+}
+
+/**
+ * Counts how many bytes at the start of a string are ASCII other than NUL, which are the same in modified UTF-8
+ * and standard UTF-8.
+ */
+size_t countAscii(const char* data, size_t size) {
+	static const CountAscii implementation = selectCountAscii();
+	return implementation(data, size);
+}
+
+/**
+ * Checks whether a string is legal modified UTF-8.
+ */
+bool isValidModifiedUtf8(const char* data, size_t size) {
+	return decode(data, size, NULL);
+}
+
+/**
+ * Converts a modified UTF-8 string to standard UTF-8, replacing what's in out. Returns false, leaving out
+ * holding whatever was decoded up to the problem, if the string isn't legal modified UTF-8.
+ */
+bool decodeModifiedUtf8(const char* data, size_t size, string& out) {
+	out.clear();
+	out.reserve(size);
+	return decode(data, size, &out);
+}
+
+/**
+ * Converts a standard UTF-8 string, as decodeModifiedUtf8 leaves it, back to modified UTF-8, writing it to out
+ * unless out is NULL. Returns the encoded length either way, so the space for it can be worked out first. NUL
+ * becomes 0xC0 0x80, and four byte sequences become surrogate pairs. Everything else is copied as it is, so
+ * decoding and encoding a legal string gives back the same bytes.
+ */
+size_t encodeModifiedUtf8(const char* data, size_t size, char* out) {
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+	size_t length = 0;
+	size_t i = 0;
+	for(;;) {
+		size_t ascii = countAscii(data + i, size - i);
+		if(out) {
+			std::memcpy(out + length, data + i, ascii);
+		}
+		i += ascii;
+		length += ascii;
+		if(i == size) {
+			return length;
+		}
+		uint8_t lead = bytes[i];
+		if(lead == 0) {
+			if(out) {
+				out[length] = static_cast<char>(0xC0);
+				out[length + 1] = static_cast<char>(0x80);
+			}
+			i++;
+			length += 2;
+		} else if((lead & 0xF8) == 0xF0 && i + 3 < size) {
+			uint32_t supplementary = ((lead & 0x07) << 18) | ((bytes[i + 1] & 0x3F) << 12) | ((bytes[i + 2] & 0x3F) << 6)
+				| (bytes[i + 3] & 0x3F);
+			uint32_t high = 0xD800 + ((supplementary - 0x10000) >> 10);
+			uint32_t low = 0xDC00 + ((supplementary - 0x10000) & 0x3FF);
+			if(out) {
+				char* pair = out + length;
+				pair[0] = static_cast<char>(0xE0 | (high >> 12));
+				pair[1] = static_cast<char>(0x80 | ((high >> 6) & 0x3F));
+				pair[2] = static_cast<char>(0x80 | (high & 0x3F));
+				pair[3] = static_cast<char>(0xE0 | (low >> 12));
+				pair[4] = static_cast<char>(0x80 | ((low >> 6) & 0x3F));
+				pair[5] = static_cast<char>(0x80 | (low & 0x3F));
+			}
+			i += 4;
+			length += 6;
+		} else {
+			if(out) {
+				out[length] = data[i];
+			}
+			i++;
+			length++;
+		}
+	}
+}
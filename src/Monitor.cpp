@@ -0,0 +1,298 @@
+#include "Monitor.h"
+#include "Util.h"
+
+#include <stdexcept>
+#include <thread>
+
+using std::mutex;
+using std::unique_lock;
+using std::runtime_error;
+
+namespace {
+	const uintptr_t INFLATED_BIT = 1;
+	const uintptr_t RECURSION_UNIT = 2;
+	const uintptr_t RECURSION_MASK = 0xFE;
+	const unsigned int OWNER_SHIFT = 8;
+
+	/**
+	 * How many times a contending thread retries the thin lock before giving up and inflating it.
+	 */
+	const unsigned int SPIN_LIMIT = 64;
+
+	uint32_t thinOwner(uintptr_t word) {
+		return word >> OWNER_SHIFT;
+	}
+
+	uint32_t thinRecursions(uintptr_t word) {
+		return (word & RECURSION_MASK) / RECURSION_UNIT;
+	}
+
+	Monitor* inflatedMonitor(uintptr_t word) {
+		return reinterpret_cast<Monitor*>(word & ~INFLATED_BIT);
+	}
+
+	runtime_error illegalMonitorState(uint32_t threadId) {
+		return runtime_error("IllegalMonitorStateException: thread " + toString(threadId) + " does not own the monitor.");
+	}
+}
+
+/**
+ * Constructs a Monitor that is already held by the given thread, the given number of times. A thread id
+ * of 0 means the monitor is unowned.
+ */
+Monitor::Monitor(uint32_t owner, uint32_t recursions) : owner(owner), recursions(recursions) {
+
+}
+
+/**
+ * Destructor for Monitor. Nothing is allocated, so nothing is deleted.
+ */
+Monitor::~Monitor() {
+
+}
+
+/**
+ * Acquires the monitor, blocking until it is free. Re-entering a monitor the thread already owns just
+ * bumps the recursion count.
+ */
+void Monitor::enter(uint32_t threadId) {
+	unique_lock<mutex> lock(monitorMutex);
+	if(owner == threadId) {
+		recursions++;
+		return;
+	}
+	while(owner != 0) {
+		entryCondition.wait(lock);
+	}
+	owner = threadId;
+	recursions = 1;
+}
+
+/**
+ * Releases one level of ownership of the monitor, waking up a blocked thread when it becomes free.
+ */
+void Monitor::exit(uint32_t threadId) {
+	unique_lock<mutex> lock(monitorMutex);
+	if(owner != threadId) {
+		throw illegalMonitorState(threadId);
+	}
+	if(--recursions == 0) {
+		owner = 0;
+		lock.unlock();
+		entryCondition.notify_one();
+	}
+}
+
+/**
+ * Implements Object.wait(): fully releases the monitor, waits for a notification, then re-acquires it
+ * with the same recursion count it had before. As in Java, spurious wakeups are possible.
+ */
+void Monitor::wait(uint32_t threadId) {
+	unique_lock<mutex> lock(monitorMutex);
+	if(owner != threadId) {
+		throw illegalMonitorState(threadId);
+	}
+	uint32_t savedRecursions = recursions;
+	owner = 0;
+	recursions = 0;
+	entryCondition.notify_one();
+	waitCondition.wait(lock);
+	while(owner != 0) {
+		entryCondition.wait(lock);
+	}
+	owner = threadId;
+	recursions = savedRecursions;
+}
+
+/**
+ * Implements Object.notify(), waking up a single waiting thread.
+ */
+void Monitor::notify(uint32_t threadId) {
+	unique_lock<mutex> lock(monitorMutex);
+	if(owner != threadId) {
+		throw illegalMonitorState(threadId);
+	}
+	waitCondition.notify_one();
+}
+
+/**
+ * Implements Object.notifyAll(), waking up every waiting thread.
+ */
+void Monitor::notifyAll(uint32_t threadId) {
+	unique_lock<mutex> lock(monitorMutex);
+	if(owner != threadId) {
+		throw illegalMonitorState(threadId);
+	}
+	waitCondition.notify_all();
+}
+
+/**
+ * Returns the id of the thread that currently owns this monitor, or 0 if nobody does.
+ */
+uint32_t Monitor::getOwner() {
+	unique_lock<mutex> lock(monitorMutex);
+	return owner;
+}
+
+/**
+ * Constructs an unlocked ObjectHeader.
+ */
+ObjectHeader::ObjectHeader() : lockWord(0) {
+
+}
+
+/**
+ * Destructor for ObjectHeader. Deletes the inflated monitor, if there is one.
+ */
+ObjectHeader::~ObjectHeader() {
+	uintptr_t word = lockWord.load(std::memory_order_relaxed);
+	if(word & INFLATED_BIT) {
+		delete inflatedMonitor(word);
+	}
+}
+
+/**
+ * Tries to replace the thin lock word "word" with an inflated monitor that has the same owner and recursion
+ * count. Returns the new monitor, or NULL if the lock word changed in the meantime and the caller should
+ * look at it again.
+ */
+Monitor* ObjectHeader::inflate(uintptr_t word) {
+	Monitor* monitor = NULL;
+	if(word == 0) {
+		monitor = new Monitor(0, 0);
+	} else {
+		monitor = new Monitor(thinOwner(word), thinRecursions(word) + 1);
+	}
+	if(lockWord.compare_exchange_strong(word, reinterpret_cast<uintptr_t>(monitor) | INFLATED_BIT, std::memory_order_acq_rel)) {
+		return monitor;
+	}
+	delete monitor;
+	return NULL;
+}
+
+/**
+ * Inflates a lock owned by the given thread (or returns the monitor it is already inflated to). Used when
+ * the owner needs a feature that the thin lock can't provide, like wait() or deep recursion.
+ */
+Monitor* ObjectHeader::inflateOwned(uint32_t threadId) {
+	for(;;) {
+		uintptr_t word = lockWord.load(std::memory_order_acquire);
+		if(word & INFLATED_BIT) {
+			return inflatedMonitor(word);
+		}
+		if(word == 0 || thinOwner(word) != threadId) {
+			throw illegalMonitorState(threadId);
+		}
+		Monitor* monitor = inflate(word);
+		if(monitor != NULL) {
+			return monitor;
+		}
+	}
+}
+
+/**
+ * Implements monitorenter. The uncontended case is a single compare-and-swap on the lock word; contending
+ * threads spin briefly, and then inflate the lock and block on the resulting Monitor.
+ */
+void ObjectHeader::monitorEnter(uint32_t threadId) {
+	uintptr_t expected = 0;
+	if(lockWord.compare_exchange_strong(expected, ((uintptr_t)threadId) << OWNER_SHIFT, std::memory_order_acquire)) {
+		return;
+	}
+	unsigned int spins = 0;
+	for(;;) {
+		uintptr_t word = lockWord.load(std::memory_order_acquire);
+		if(word & INFLATED_BIT) {
+			inflatedMonitor(word)->enter(threadId);
+			return;
+		} else if(word == 0) {
+			if(lockWord.compare_exchange_weak(word, ((uintptr_t)threadId) << OWNER_SHIFT, std::memory_order_acquire)) {
+				return;
+			}
+		} else if(thinOwner(word) == threadId) {
+			if((word & RECURSION_MASK) != RECURSION_MASK) {
+				if(lockWord.compare_exchange_weak(word, word + RECURSION_UNIT, std::memory_order_relaxed)) {
+					return;
+				}
+			} else {
+				inflate(word);
+			}
+		} else if(spins < SPIN_LIMIT) {
+			spins++;
+			std::this_thread::yield();
+		} else {
+			inflate(word);
+		}
+	}
+}
+
+/**
+ * Implements monitorexit. The thin lock is released with a compare-and-swap; if that fails, some other
+ * thread has inflated the lock while we held it, so the release goes through the Monitor instead.
+ */
+void ObjectHeader::monitorExit(uint32_t threadId) {
+	for(;;) {
+		uintptr_t word = lockWord.load(std::memory_order_relaxed);
+		if(word & INFLATED_BIT) {
+			inflatedMonitor(word)->exit(threadId);
+			return;
+		}
+		if(word == 0 || thinOwner(word) != threadId) {
+			throw illegalMonitorState(threadId);
+		}
+		uintptr_t released = (word & RECURSION_MASK) ? word - RECURSION_UNIT : 0;
+		if(lockWord.compare_exchange_weak(word, released, std::memory_order_release)) {
+			return;
+		}
+	}
+}
+
+/**
+ * Implements Object.wait() on this object. Waiting always needs a real Monitor, so the lock is inflated first.
+ */
+void ObjectHeader::wait(uint32_t threadId) {
+	inflateOwned(threadId)->wait(threadId);
+}
+
+/**
+ * Implements Object.notify() on this object. A thin lock has no waiters, so there is nothing to do unless
+ * the lock has been inflated.
+ */
+void ObjectHeader::notify(uint32_t threadId) {
+	uintptr_t word = lockWord.load(std::memory_order_acquire);
+	if(word & INFLATED_BIT) {
+		inflatedMonitor(word)->notify(threadId);
+	} else if(word == 0 || thinOwner(word) != threadId) {
+		throw illegalMonitorState(threadId);
+	}
+}
+
+/**
+ * Implements Object.notifyAll() on this object.
+ */
+void ObjectHeader::notifyAll(uint32_t threadId) {
+	uintptr_t word = lockWord.load(std::memory_order_acquire);
+	if(word & INFLATED_BIT) {
+		inflatedMonitor(word)->notifyAll(threadId);
+	} else if(word == 0 || thinOwner(word) != threadId) {
+		throw illegalMonitorState(threadId);
+	}
+}
+
+/**
+ * Returns whether this object's lock has been inflated into a full Monitor.
+ */
+bool ObjectHeader::isInflated() const {
+	return lockWord.load(std::memory_order_relaxed) & INFLATED_BIT;
+}
+
+/**
+ * Returns whether the given thread currently holds this object's lock.
+ */
+bool ObjectHeader::isLockedBy(uint32_t threadId) const {
+	uintptr_t word = lockWord.load(std::memory_order_acquire);
+	if(word & INFLATED_BIT) {
+		return inflatedMonitor(word)->getOwner() == threadId;
+	}
+	return word != 0 && thinOwner(word) == threadId;
+}
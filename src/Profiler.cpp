@@ -0,0 +1,350 @@
+#include "Profiler.h"
+#include "ClassFile.h"
+#include "Bytecode.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <signal.h>
+#include <sys/time.h>
+
+using std::string;
+using std::vector;
+using std::map;
+using std::pair;
+using std::ostream;
+using std::endl;
+using std::setw;
+using std::mutex;
+using std::lock_guard;
+using std::runtime_error;
+
+namespace {
+	/**
+	 * What a call path, or a method, adds up to over every thread.
+	 */
+	struct ProfileTotals {
+		uint64_t invocations;
+		uint64_t bytecodes;
+		uint64_t inclusiveNanoseconds;
+		uint64_t exclusiveNanoseconds;
+		uint64_t samples;
+
+		ProfileTotals() : invocations(0), bytecodes(0), inclusiveNanoseconds(0), exclusiveNanoseconds(0), samples(0) {}
+
+		void add(const ProfileNode& node) {
+			invocations += node.invocations;
+			bytecodes += node.bytecodes;
+			inclusiveNanoseconds += node.inclusiveNanoseconds;
+			exclusiveNanoseconds += node.exclusiveNanoseconds;
+			samples += node.samples;
+		}
+
+		void add(const ProfileTotals& other) {
+			invocations += other.invocations;
+			bytecodes += other.bytecodes;
+			inclusiveNanoseconds += other.inclusiveNanoseconds;
+			exclusiveNanoseconds += other.exclusiveNanoseconds;
+			samples += other.samples;
+		}
+	};
+
+	/**
+	 * The profiles of threads that have finished, keyed by their collapsed call paths. Paths are made into
+	 * strings when a thread's profile is handed over, since the classes its nodes point to may be gone by the
+	 * time the profile is written.
+	 */
+	struct Registry {
+		mutex lock;
+		map<string, ProfileTotals> paths;
+		uint64_t opcodes[256];
+		bool sampled;
+
+		Registry() : sampled(false) {
+			memset(opcodes, 0, sizeof(opcodes));
+		}
+	};
+
+	Registry& getRegistry() {
+		static Registry registry;
+		return registry;
+	}
+
+	/**
+	 * The samples taken on this thread that haven't been charged to a method yet. It's a lock-free atomic with
+	 * a constant initializer, so the signal handler can touch it before anything else on the thread has.
+	 */
+	thread_local std::atomic<uint32_t> pendingSamples(0);
+
+	/**
+	 * Counts a sample against the interrupted thread. It leaves charging it to whichever profiler runs on the
+	 * thread, since that profiler could be in the middle of being destroyed.
+	 */
+	void sample(int) {
+		if(Profiler::getMode() == Profiler::SAMPLE) {
+			pendingSamples.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	/**
+	 * Orders methods by where the time went: samples when sampling, exclusive time when counting.
+	 */
+	bool heavier(const pair<string, ProfileTotals>& a, const pair<string, ProfileTotals>& b) {
+		if(a.second.samples != b.second.samples) {
+			return a.second.samples > b.second.samples;
+		}
+		return a.second.exclusiveNanoseconds > b.second.exclusiveNanoseconds;
+	}
+
+	bool moreFrequent(const pair<uint8_t, uint64_t>& a, const pair<uint8_t, uint64_t>& b) {
+		return a.second > b.second;
+	}
+}
+
+std::atomic<int> Profiler::mode(Profiler::OFF);
+struct sigaction Profiler::previousAction;
+
+/**
+ * Constructor for ProfileNode.
+ */
+ProfileNode::ProfileNode(const string& className, const string& methodName, ProfileNode* parent) :
+	className(className),
+	methodName(methodName),
+	parent(parent),
+	invocations(0),
+	bytecodes(0),
+	inclusiveNanoseconds(0),
+	exclusiveNanoseconds(0),
+	samples(0) {
+
+}
+
+/**
+ * Destructor for ProfileNode. Deletes the subtree under it.
+ */
+ProfileNode::~ProfileNode() {
+	for(vector<ProfileNode*>::iterator it = children.begin(); it != children.end(); it++) {
+		delete *it;
+	}
+}
+
+/**
+ * Gets the node for a method called from this one, creating it the first time. Most methods call few
+ * others, so a linear search beats anything cleverer.
+ */
+ProfileNode* ProfileNode::getChild(const string& className, const string& methodName) {
+	for(vector<ProfileNode*>::iterator it = children.begin(); it != children.end(); it++) {
+		if((*it)->methodName == methodName && (*it)->className == className) {
+			return *it;
+		}
+	}
+	children.push_back(new ProfileNode(className, methodName, this));
+	return children.back();
+}
+
+/**
+ * Gets the name this node's method is shown under, like java/lang/Object.toString. Descriptors are left
+ * out, since collapsed stacks use semicolons as separators.
+ */
+string ProfileNode::getLabel() const {
+	if(className.empty()) {
+		return "";
+	}
+	return className + "." + methodName;
+}
+
+/**
+ * Sets the mode threads created from now on profile in. Sampling sets up a SIGPROF handler and a timer
+ * that fires every sampleMicroseconds of CPU time. Leaving it stops the timer and puts back the handler that
+ * was there before.
+ */
+void Profiler::setMode(Mode mode, unsigned int sampleMicroseconds) {
+	Mode previous = static_cast<Mode>(Profiler::mode.exchange(mode, std::memory_order_relaxed));
+	struct itimerval timer;
+	memset(&timer, 0, sizeof(timer));
+	if(mode == SAMPLE) {
+		if(previous != SAMPLE) {
+			struct sigaction action;
+			memset(&action, 0, sizeof(action));
+			action.sa_handler = ::sample;
+			action.sa_flags = SA_RESTART;
+			sigemptyset(&action.sa_mask);
+			if(sigaction(SIGPROF, &action, &previousAction) != 0) {
+				Profiler::mode.store(previous, std::memory_order_relaxed);
+				throw runtime_error("Could not install the SIGPROF handler");
+			}
+		}
+		timer.it_interval.tv_sec = sampleMicroseconds / 1000000;
+		timer.it_interval.tv_usec = sampleMicroseconds % 1000000;
+		timer.it_value = timer.it_interval;
+		setitimer(ITIMER_PROF, &timer, NULL);
+	} else if(previous == SAMPLE) {
+		setitimer(ITIMER_PROF, &timer, NULL);
+		// A signal the timer already raised can still be on its way, and by default SIGPROF ends the process.
+		struct sigaction restored = previousAction;
+		if(!(restored.sa_flags & SA_SIGINFO) && restored.sa_handler == SIG_DFL) {
+			restored.sa_handler = SIG_IGN;
+		}
+		sigaction(SIGPROF, &restored, NULL);
+	}
+}
+
+/**
+ * Gets the mode new threads profile in.
+ */
+Profiler::Mode Profiler::getMode() {
+	return static_cast<Mode>(mode.load(std::memory_order_relaxed));
+}
+
+/**
+ * Constructor for Profiler. Whether invocations are timed is fixed by the mode when it's created.
+ */
+Profiler::Profiler() : timed(getMode() == COUNT), root(new ProfileNode("", "", NULL)), current(root) {
+	memset(opcodes, 0, sizeof(opcodes));
+}
+
+/**
+ * Destructor for Profiler. Finishes any invocations still running, and hands the profile over to be written.
+ */
+Profiler::~Profiler() {
+	while(!activations.empty()) {
+		exit();
+	}
+	current = root;
+
+	map<string, ProfileTotals> paths;
+	vector<pair<ProfileNode*, string> > pending;
+	for(vector<ProfileNode*>::iterator it = root->children.begin(); it != root->children.end(); it++) {
+		pending.push_back(make_pair(*it, (*it)->getLabel()));
+	}
+	while(!pending.empty()) {
+		ProfileNode* node = pending.back().first;
+		string path = pending.back().second;
+		pending.pop_back();
+		paths[path].add(*node);
+		for(vector<ProfileNode*>::iterator it = node->children.begin(); it != node->children.end(); it++) {
+			pending.push_back(make_pair(*it, path + ";" + (*it)->getLabel()));
+		}
+	}
+
+	Registry& registry = getRegistry();
+	{
+		lock_guard<mutex> guard(registry.lock);
+		for(map<string, ProfileTotals>::iterator it = paths.begin(); it != paths.end(); it++) {
+			registry.paths[it->first].add(it->second);
+		}
+		for(unsigned int i = 0; i < 256; i++) {
+			registry.opcodes[i] += opcodes[i];
+		}
+		registry.sampled = registry.sampled || !timed;
+	}
+	delete root;
+}
+
+/**
+ * Starts an invocation of a method, called from whatever is running now.
+ */
+void Profiler::enter(const ClassFile& classFile, const ClassMember& method) {
+	chargeSamples();
+	ProfileNode* node = current->getChild(classFile.getName().raw(), method.getName().raw());
+	node->invocations++;
+	Activation activation;
+	activation.node = node;
+	activation.entered = timed ? Trace::now() : 0;
+	activation.calleeNanoseconds = 0;
+	activations.push_back(activation);
+	current = node;
+}
+
+/**
+ * Finishes the innermost invocation, and returns to its caller.
+ */
+void Profiler::exit() {
+	if(activations.empty()) {
+		return;
+	}
+	chargeSamples();
+	Activation& activation = activations.back();
+	ProfileNode* node = activation.node;
+	if(timed) {
+		uint64_t elapsed = Trace::now() - activation.entered;
+		node->inclusiveNanoseconds += elapsed;
+		node->exclusiveNanoseconds += elapsed - std::min(elapsed, activation.calleeNanoseconds);
+		if(activations.size() > 1) {
+			activations[activations.size() - 2].calleeNanoseconds += elapsed;
+		}
+	}
+	activations.pop_back();
+	current = node->parent;
+}
+
+/**
+ * Charges the samples the signal handler has counted on this thread since the last call to the method that
+ * was running all that time. Samples taken outside any method go to the root, which isn't written.
+ */
+void Profiler::chargeSamples() {
+	current->samples += pendingSamples.exchange(0, std::memory_order_relaxed);
+}
+
+/**
+ * Writes the profiles of every finished thread as collapsed stacks, one call path per line followed by its
+ * weight, which flamegraph.pl, speedscope and the like read. The weight is the number of samples if any thread
+ * was sampled rather than timed, and exclusive nanoseconds otherwise, whatever the mode is by now.
+ */
+void Profiler::writeCollapsed(ostream& out) {
+	Registry& registry = getRegistry();
+	lock_guard<mutex> guard(registry.lock);
+	bool sampled = registry.sampled;
+	for(map<string, ProfileTotals>::iterator it = registry.paths.begin(); it != registry.paths.end(); it++) {
+		uint64_t weight = sampled ? it->second.samples : it->second.exclusiveNanoseconds;
+		if(weight > 0) {
+			out << it->first << ' ' << weight << endl;
+		}
+	}
+}
+
+/**
+ * Writes a table of every method, heaviest first, and a histogram of the opcodes executed. A method's
+ * inclusive time is summed over its call paths, so it counts recursive calls more than once.
+ */
+void Profiler::writeSummary(ostream& out) {
+	Registry& registry = getRegistry();
+	lock_guard<mutex> guard(registry.lock);
+	map<string, ProfileTotals> methods;
+	for(map<string, ProfileTotals>::iterator it = registry.paths.begin(); it != registry.paths.end(); it++) {
+		string::size_type separator = it->first.rfind(';');
+		methods[separator == string::npos ? it->first : it->first.substr(separator + 1)].add(it->second);
+	}
+	vector<pair<string, ProfileTotals> > sorted(methods.begin(), methods.end());
+	std::stable_sort(sorted.begin(), sorted.end(), heavier);
+
+	out << setw(12) << "invocations" << setw(14) << "bytecodes" << setw(14) << "incl ms" << setw(14) << "excl ms";
+	out << setw(10) << "samples" << "  method" << endl;
+	out << std::fixed << std::setprecision(3);
+	for(vector<pair<string, ProfileTotals> >::iterator it = sorted.begin(); it != sorted.end(); it++) {
+		out << setw(12) << it->second.invocations << setw(14) << it->second.bytecodes;
+		out << setw(14) << (it->second.inclusiveNanoseconds / 1e6) << setw(14) << (it->second.exclusiveNanoseconds / 1e6);
+		out << setw(10) << it->second.samples << "  " << it->first << endl;
+	}
+
+	uint64_t total = 0;
+	vector<pair<uint8_t, uint64_t> > opcodes;
+	for(unsigned int i = 0; i < 256; i++) {
+		if(registry.opcodes[i] > 0) {
+			opcodes.push_back(pair<uint8_t, uint64_t>(i, registry.opcodes[i]));
+			total += registry.opcodes[i];
+		}
+	}
+	std::stable_sort(opcodes.begin(), opcodes.end(), moreFrequent);
+	out << endl << std::left << setw(18) << "opcode" << std::right << setw(14) << "count" << setw(10) << "%" << endl;
+	for(vector<pair<uint8_t, uint64_t> >::iterator it = opcodes.begin(); it != opcodes.end(); it++) {
+		out << std::left << setw(18) << getOpcodeInfo(it->first).name << std::right << setw(14) << it->second;
+		out << setw(10) << (100.0 * it->second / total) << endl;
+	}
+	out.unsetf(std::ios_base::floatfield);
+	out << std::setprecision(6);
+}
@@ -0,0 +1,948 @@
+#include "SegmentedSymbolIndex.h"
+#include "Inflater.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <zip.h>
+
+using std::string;
+using std::vector;
+using std::ifstream;
+using std::ofstream;
+using std::unordered_map;
+using std::unordered_set;
+using std::runtime_error;
+
+namespace {
+	const char MAGIC[8] = { 'D', 'J', 'A', 'V', 'A', 'S', 'E', 'G' };
+	const uint32_t NONE = SymbolIndex::NONE;
+
+	/*
+	 * Header {
+	 * 		u1 magic[8];
+	 * 		u4 version;
+	 * 		u4 next_segment;
+	 * 		u4 segment_count;
+	 * 		u4 next_list;
+	 * 		u8 jars_offset;
+	 * }
+	 * String {
+	 * 		u4 length;
+	 * 		u1 bytes[length];
+	 * }
+	 * Segment {
+	 * 		u4 id;
+	 * 		u4 tombstone_count;
+	 * 		String tombstones[tombstone_count];
+	 * }
+	 * Jar {
+	 * 		String path;
+	 * 		u8 size;
+	 * 		u8 time;
+	 * 		u4 list;
+	 * }
+	 * Location {
+	 * 		String jar;
+	 * 		String entry;
+	 * }
+	 * Duplicate {
+	 * 		String class_name;
+	 * 		u4 location_count;
+	 * 		Location locations[location_count];	// in classpath order
+	 * }
+	 * Manifest {
+	 * 		Header header;
+	 * 		Segment segments[segment_count];
+	 * 		u4 jar_count;
+	 * 		Jar jars[jar_count];
+	 * 		u4 duplicate_count;
+	 * 		Duplicate duplicates[duplicate_count];
+	 * }
+	 *
+	 * The segments come first, so opening an index for queries doesn't read the jars. The class entries of each jar
+	 * are in a list of their own, in the file named for the jar's list id, so an update only reads and writes the
+	 * lists of the jars that changed:
+	 *
+	 * Entry {
+	 * 		String name;
+	 * 		u4 crc;
+	 * 		u8 size;
+	 * 		u8 time;
+	 * 		String class_name;	// empty if the entry couldn't be scanned
+	 * }
+	 * List {
+	 * 		u4 entry_count;
+	 * 		Entry entries[entry_count];
+	 * }
+	 */
+	const size_t HEADER_SIZE = 32;
+
+	void writeString(string& out, const string& value) {
+		writeLittle32(out, value.size());
+		out += value;
+	}
+
+	/**
+	 * Reads a whole file.
+	 */
+	string readFile(const string& path) {
+		ifstream in(path.c_str(), std::ios::binary);
+		in.seekg(0, std::ios::end);
+		std::streamoff size = in.tellg();
+		if(!in || size < 0) {
+			throw runtime_error("Could not read " + path);
+		}
+		string data(size, '\0');
+		in.seekg(0);
+		if(size > 0 && !in.read(&data[0], size)) {
+			throw runtime_error("Could not read " + path);
+		}
+		return data;
+	}
+
+	/**
+	 * Writes a file next to its final path and renames it over it, so a reader sees either the old file or the new
+	 * one.
+	 */
+	void writeFile(const string& path, const string& data) {
+		string temporary = createTemporaryFile(path);
+		ofstream file(temporary.c_str(), std::ios::binary | std::ios::trunc);
+		file << data;
+		file.close();
+		if(!file) {
+			remove(temporary.c_str());
+			throw runtime_error("Could not write symbol index " + temporary);
+		}
+		if(rename(temporary.c_str(), path.c_str()) != 0) {
+			remove(temporary.c_str());
+			throw runtime_error("Could not move symbol index " + temporary + " to " + path);
+		}
+	}
+
+	/**
+	 * Reads and inflates an entry of a jar, opening the jar first if it isn't open yet.
+	 */
+	void readEntry(Inflater& inflater, struct zip*& zip, const string& jar, const string& entry, string& data) {
+		if(!zip) {
+			int error = 0;
+			zip = zip_open(jar.c_str(), 0, &error);
+			if(!zip) {
+				throw runtime_error("Could not open " + jar + ": libzip error " + toString(error));
+			}
+		}
+		zip_int64_t index = zip_name_locate(zip, entry.c_str(), 0);
+		if(index < 0) {
+			throw runtime_error(zip_strerror(zip));
+		}
+		inflater.readEntry(zip, index, data);
+	}
+
+	/**
+	 * Reads the fields of a manifest or a jar's list out of its bytes, throwing if they run out.
+	 */
+	class ManifestReader {
+	private:
+		const string& data;
+		const string& path;
+		size_t position;
+
+		const uint8_t* require(size_t count) {
+			if(data.size() - position < count) {
+				throw runtime_error(path + " is truncated");
+			}
+			const uint8_t* p = reinterpret_cast<const uint8_t*>(data.data()) + position;
+			position += count;
+			return p;
+		}
+	public:
+		ManifestReader(const string& data, const string& path, size_t position) : data(data), path(path), position(position) {}
+
+		uint32_t readInt() {
+			return readLittle32(require(4));
+		}
+
+		uint64_t readLong() {
+			return readLittle64(require(8));
+		}
+
+		string readString() {
+			uint32_t length = readInt();
+			return string(reinterpret_cast<const char*>(require(length)), length);
+		}
+	};
+
+	/**
+	 * Orders members like a SymbolIndex does, by class and then descriptor.
+	 */
+	bool compareMembers(const MemberSymbol& a, const MemberSymbol& b) {
+		if(a.className != b.className) {
+			return a.className < b.className;
+		}
+		return a.descriptor < b.descriptor;
+	}
+
+	/**
+	 * Orders references by what they refer to, and then where they're from.
+	 */
+	bool compareReferences(const ReferenceSymbol& a, const ReferenceSymbol& b) {
+		if(a.name != b.name) {
+			return a.name < b.name;
+		} else if(a.descriptor != b.descriptor) {
+			return a.descriptor < b.descriptor;
+		} else if(a.className != b.className) {
+			return a.className < b.className;
+		} else if(a.methodName != b.methodName) {
+			return a.methodName < b.methodName;
+		}
+		return a.methodDescriptor < b.methodDescriptor;
+	}
+}
+
+/**
+ * Orders candidates by where they are on the classpath.
+ */
+bool SegmentedSymbolIndex::Candidate::operator<(const Candidate& other) const {
+	if(jar != other.jar) {
+		return jar < other.jar;
+	}
+	return order < other.order;
+}
+
+/**
+ * Opens the index whose manifest is at a path, and every segment in it. If there's no manifest yet, the index is
+ * empty until the first update writes one.
+ */
+SegmentedSymbolIndex::SegmentedSymbolIndex(const string& path) : path(path), nextSegment(0), nextList(0), jarsOffset(0),
+	scanned(0), removed(0), merged(0) {
+
+	load();
+}
+
+/**
+ * Destructor for SegmentedSymbolIndex. Unmaps every segment.
+ */
+SegmentedSymbolIndex::~SegmentedSymbolIndex() {
+	close();
+}
+
+/**
+ * Returns whether the file at a path is the manifest of a SegmentedSymbolIndex, rather than a plain SymbolIndex.
+ */
+bool SegmentedSymbolIndex::isSegmented(const string& path) {
+	char magic[sizeof(MAGIC)];
+	ifstream in(path.c_str(), std::ios::binary);
+	return in.read(magic, sizeof(magic)) && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+/**
+ * Gets the path of a segment, which is the manifest's path followed by its id.
+ */
+string SegmentedSymbolIndex::getSegmentPath(uint32_t id) const {
+	return path + "." + toString(id);
+}
+
+/**
+ * Gets the path of a jar's list of entries, which is the manifest's path followed by "list" and the list's id.
+ */
+string SegmentedSymbolIndex::getListPath(uint32_t id) const {
+	return path + ".list." + toString(id);
+}
+
+/**
+ * Gets the number of classes in a segment that haven't been replaced.
+ */
+uint32_t SegmentedSymbolIndex::numLive(const Segment& segment) const {
+	return segment.index->numClasses() - segment.tombstones.size();
+}
+
+/**
+ * Reads the header and segments of the manifest, and opens the segments.
+ */
+void SegmentedSymbolIndex::load() {
+	close();
+	nextSegment = 0;
+	nextList = 0;
+	jarsOffset = 0;
+	ifstream in(path.c_str(), std::ios::binary);
+	if(!in) {
+		return;
+	}
+	string data(HEADER_SIZE, '\0');
+	if(!in.read(&data[0], HEADER_SIZE) || memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0) {
+		throw runtime_error(path + " is not a segmented symbol index");
+	}
+	const uint8_t* header = reinterpret_cast<const uint8_t*>(data.data());
+	if(readLittle32(header + 8) != VERSION) {
+		throw runtime_error(path + " was written by a different version");
+	}
+	nextSegment = readLittle32(header + 12);
+	uint32_t segmentCount = readLittle32(header + 16);
+	nextList = readLittle32(header + 20);
+	jarsOffset = readLittle64(header + 24);
+	in.seekg(0, std::ios::end);
+	if(jarsOffset < HEADER_SIZE || jarsOffset > static_cast<uint64_t>(in.tellg())) {
+		throw runtime_error(path + " has a corrupt header");
+	}
+	data.resize(jarsOffset);
+	in.seekg(HEADER_SIZE);
+	if(!in.read(&data[HEADER_SIZE], jarsOffset - HEADER_SIZE)) {
+		throw runtime_error("Could not read " + path);
+	}
+
+	try {
+		ManifestReader reader(data, path, HEADER_SIZE);
+		for(uint32_t i = 0; i < segmentCount; i++) {
+			Segment segment;
+			segment.id = reader.readInt();
+			segment.index = NULL;
+			uint32_t tombstones = reader.readInt();
+			for(uint32_t j = 0; j < tombstones; j++) {
+				segment.tombstones.insert(reader.readString());
+			}
+			if(segment.id >= nextSegment) {
+				throw runtime_error(path + " refers to a segment that doesn't exist yet");
+			}
+			segment.index = new SymbolIndex(getSegmentPath(segment.id));
+			segments.push_back(segment);
+			if(segment.tombstones.size() > segment.index->numClasses()) {
+				throw runtime_error(path + " has more dead classes than segment " + toString(segment.id) + " has classes");
+			}
+		}
+	} catch(...) {
+		close();
+		throw;
+	}
+}
+
+/**
+ * Unmaps every segment.
+ */
+void SegmentedSymbolIndex::close() {
+	for(vector<Segment>::iterator it = segments.begin(); it != segments.end(); it++) {
+		delete it->index;
+	}
+	segments.clear();
+}
+
+/**
+ * Reads the jars out of the manifest, and where every class name more than one entry has is, which only an update
+ * needs. The jars' entries stay in their lists until they're read.
+ */
+void SegmentedSymbolIndex::readJars(vector<Jar>& jars, Duplicates& duplicates) const {
+	jars.clear();
+	duplicates.clear();
+	if(jarsOffset == 0) {
+		return;
+	}
+	ifstream in(path.c_str(), std::ios::binary);
+	in.seekg(0, std::ios::end);
+	uint64_t size = in.tellg();
+	if(!in || size < jarsOffset) {
+		throw runtime_error("Could not read " + path);
+	}
+	string data(size - jarsOffset, '\0');
+	in.seekg(jarsOffset);
+	if(!in.read(&data[0], data.size())) {
+		throw runtime_error("Could not read " + path);
+	}
+
+	ManifestReader reader(data, path, 0);
+	uint32_t jarCount = reader.readInt();
+	for(uint32_t i = 0; i < jarCount; i++) {
+		jars.push_back(Jar());
+		Jar& jar = jars.back();
+		jar.path = reader.readString();
+		jar.size = reader.readLong();
+		jar.time = reader.readLong();
+		jar.list = reader.readInt();
+		jar.listed = false;
+		if(jar.list >= nextList) {
+			throw runtime_error(path + " refers to a list that doesn't exist yet");
+		}
+	}
+	uint32_t duplicateCount = reader.readInt();
+	for(uint32_t i = 0; i < duplicateCount; i++) {
+		vector<Location>& locations = duplicates[reader.readString()];
+		uint32_t locationCount = reader.readInt();
+		for(uint32_t j = 0; j < locationCount; j++) {
+			Location location;
+			location.jar = reader.readString();
+			location.entry = reader.readString();
+			locations.push_back(location);
+		}
+	}
+}
+
+/**
+ * Reads the entries of a jar out of its list.
+ */
+void SegmentedSymbolIndex::readEntries(Jar& jar) const {
+	string listPath = getListPath(jar.list);
+	string data = readFile(listPath);
+	ManifestReader reader(data, listPath, 0);
+	uint32_t entryCount = reader.readInt();
+	jar.entries.clear();
+	for(uint32_t i = 0; i < entryCount; i++) {
+		Entry entry;
+		entry.name = reader.readString();
+		entry.crc = reader.readInt();
+		entry.size = reader.readLong();
+		entry.time = reader.readLong();
+		entry.className = reader.readString();
+		entry.changed = false;
+		jar.entries.push_back(entry);
+	}
+	jar.listed = true;
+}
+
+/**
+ * Writes the entries of a jar to its list.
+ */
+void SegmentedSymbolIndex::writeEntries(const Jar& jar) const {
+	string out;
+	writeLittle32(out, jar.entries.size());
+	for(vector<Entry>::const_iterator entry = jar.entries.begin(); entry != jar.entries.end(); entry++) {
+		writeString(out, entry->name);
+		writeLittle32(out, entry->crc);
+		writeLittle64(out, entry->size);
+		writeLittle64(out, entry->time);
+		writeString(out, entry->className);
+	}
+	writeFile(getListPath(jar.list), out);
+}
+
+/**
+ * Writes the manifest for a list of segments and jars, and where every class name more than one entry has is.
+ * Like the segments and lists, it's written next to its final path and renamed over it, so a reader sees either
+ * the old index or the new one.
+ */
+void SegmentedSymbolIndex::writeManifest(const vector<Segment>& segments, const vector<Jar>& jars, const Duplicates& duplicates) const {
+	string out(MAGIC, sizeof(MAGIC));
+	writeLittle32(out, VERSION);
+	writeLittle32(out, nextSegment);
+	writeLittle32(out, segments.size());
+	writeLittle32(out, nextList);
+	writeLittle64(out, 0);
+	for(vector<Segment>::const_iterator it = segments.begin(); it != segments.end(); it++) {
+		writeLittle32(out, it->id);
+		writeLittle32(out, it->tombstones.size());
+		for(unordered_set<string>::const_iterator tombstone = it->tombstones.begin(); tombstone != it->tombstones.end(); tombstone++) {
+			writeString(out, *tombstone);
+		}
+	}
+	string offset;
+	writeLittle64(offset, out.size());
+	out.replace(24, 8, offset);
+
+	writeLittle32(out, jars.size());
+	for(vector<Jar>::const_iterator jar = jars.begin(); jar != jars.end(); jar++) {
+		writeString(out, jar->path);
+		writeLittle64(out, jar->size);
+		writeLittle64(out, jar->time);
+		writeLittle32(out, jar->list);
+	}
+	writeLittle32(out, duplicates.size());
+	for(Duplicates::const_iterator it = duplicates.begin(); it != duplicates.end(); it++) {
+		writeString(out, it->first);
+		writeLittle32(out, it->second.size());
+		for(vector<Location>::const_iterator location = it->second.begin(); location != it->second.end(); location++) {
+			writeString(out, location->jar);
+			writeString(out, location->entry);
+		}
+	}
+	writeFile(path, out);
+}
+
+/**
+ * Finds a segment by its id, or returns NULL if there isn't one.
+ */
+SegmentedSymbolIndex::Segment* SegmentedSymbolIndex::findSegment(vector<Segment>& segments, uint32_t id) const {
+	for(vector<Segment>::iterator it = segments.begin(); it != segments.end(); it++) {
+		if(it->id == id) {
+			return &*it;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Finds the one segment a class is alive in, and gets its symbol there. Returns NONE if it isn't alive in any.
+ */
+uint32_t SegmentedSymbolIndex::findLive(const string& name, ClassSymbol& symbol) const {
+	for(vector<Segment>::const_iterator it = segments.begin(); it != segments.end(); it++) {
+		if(!it->tombstones.count(name) && it->index->findClass(name, symbol)) {
+			return it->id;
+		}
+	}
+	return NONE;
+}
+
+/**
+ * Lists the class entries of a jar from its central directory, carrying over the class of each entry whose CRC,
+ * size and time are the same as they were last time, and marking the rest as changed. If the jar's own size and
+ * modification time are the same, neither the jar nor its list is opened, and the jar is left unlisted.
+ */
+void SegmentedSymbolIndex::listJar(const string& path, Jar* previous, Jar& jar) const {
+	struct stat info;
+	if(stat(path.c_str(), &info) != 0) {
+		throw runtime_error("Could not open " + path);
+	}
+	jar.path = path;
+	jar.size = info.st_size;
+	jar.time = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+	jar.list = NONE;
+	jar.listed = false;
+	if(previous && previous->size == jar.size && previous->time == jar.time) {
+		jar.list = previous->list;
+		return;
+	}
+
+	unordered_map<string, const Entry*> entries;
+	if(previous) {
+		readEntries(*previous);
+		for(vector<Entry>::const_iterator it = previous->entries.begin(); it != previous->entries.end(); it++) {
+			entries[it->name] = &*it;
+		}
+	}
+	int error = 0;
+	struct zip* zip = zip_open(path.c_str(), 0, &error);
+	if(!zip) {
+		throw runtime_error("Could not open " + path + ": libzip error " + toString(error));
+	}
+	zip_int64_t count = zip_get_num_entries(zip, 0);
+	for(zip_int64_t i = 0; i < count; i++) {
+		struct zip_stat stat;
+		zip_stat_init(&stat);
+		const zip_uint64_t needed = ZIP_STAT_NAME | ZIP_STAT_SIZE | ZIP_STAT_CRC;
+		if(zip_stat_index(zip, i, 0, &stat) != 0 || (stat.valid & needed) != needed || !isClassFile(stat.name)) {
+			continue;
+		}
+		Entry entry;
+		entry.name = stat.name;
+		entry.crc = stat.crc;
+		entry.size = stat.size;
+		entry.time = (stat.valid & ZIP_STAT_MTIME) ? stat.mtime : 0;
+		unordered_map<string, const Entry*>::iterator old = entries.find(entry.name);
+		entry.changed = old == entries.end() || old->second->crc != entry.crc || old->second->size != entry.size
+			|| old->second->time != entry.time;
+		entry.className = entry.changed ? string() : old->second->className;
+		jar.entries.push_back(entry);
+	}
+	zip_close(zip);
+	jar.listed = true;
+}
+
+/**
+ * Scans every changed entry of the listed jars into a writer, in classpath order, so that when two of them have
+ * the same name, the writer keeps the one that comes first. The name of every class scanned is added to the names.
+ */
+void SegmentedSymbolIndex::scanEntries(vector<Jar>& jars, SymbolIndexWriter& writer, unordered_set<string>& names) {
+	Inflater* inflater = Inflater::create();
+	string data;
+	try {
+		for(vector<Jar>::iterator jar = jars.begin(); jar != jars.end(); jar++) {
+			struct zip* zip = NULL;
+			for(vector<Entry>::iterator entry = jar->entries.begin(); entry != jar->entries.end(); entry++) {
+				if(!entry->changed) {
+					continue;
+				}
+				scanned++;
+				try {
+					readEntry(*inflater, zip, jar->path, entry->name, data);
+					writer.addClass(jar->path, entry->name, data.data(), data.size(), entry->className);
+					names.insert(entry->className);
+				} catch(const std::exception& e) {
+					errors.push_back(jar->path + "!" + entry->name + ": " + e.what());
+					entry->className.clear();
+				}
+			}
+			if(zip) {
+				zip_close(zip);
+			}
+		}
+	} catch(...) {
+		delete inflater;
+		throw;
+	}
+	delete inflater;
+}
+
+/**
+ * Scans entries that didn't change, but win for a class that isn't alive where they are, into a writer. The
+ * candidates are in classpath order, so each jar is opened once.
+ */
+void SegmentedSymbolIndex::rescanEntries(const vector<Candidate>& candidates, SymbolIndexWriter& writer) {
+	Inflater* inflater = Inflater::create();
+	struct zip* zip = NULL;
+	string data;
+	try {
+		for(vector<Candidate>::const_iterator it = candidates.begin(); it != candidates.end(); it++) {
+			if(zip && (it - 1)->jar != it->jar) {
+				zip_close(zip);
+				zip = NULL;
+			}
+			scanned++;
+			try {
+				readEntry(*inflater, zip, it->location.jar, it->location.entry, data);
+				writer.addClass(it->location.jar, it->location.entry, data.data(), data.size());
+			} catch(const std::exception& e) {
+				errors.push_back(it->location.jar + "!" + it->location.entry + ": " + e.what());
+			}
+		}
+	} catch(...) {
+		if(zip) {
+			zip_close(zip);
+		}
+		delete inflater;
+		throw;
+	}
+	if(zip) {
+		zip_close(zip);
+	}
+	delete inflater;
+}
+
+/**
+ * Brings the index up to date with a list of jars, in classpath order. Only the jars whose size or modification
+ * time changed, or that were added or removed, have their lists read and rewritten, and only the class entries in
+ * them that were added or changed are scanned. The names those jars had or have are the only ones whose winner can
+ * change, so only they're looked up, along with every name more than one jar has if the jars were reordered.
+ * Classes that were removed or replaced are marked dead in the segments they're in. The newest segments are
+ * merged while the one before them has no more live classes than they do together, and so is any segment that's
+ * mostly dead, so there are only a logarithmic number of them. Throws if a jar can't be opened, leaving the index
+ * as it was.
+ */
+void SegmentedSymbolIndex::update(const vector<string>& jarPaths) {
+	scanned = 0;
+	removed = 0;
+	merged = 0;
+	errors.clear();
+
+	vector<Jar> previous;
+	Duplicates duplicates;
+	readJars(previous, duplicates);
+	unordered_map<string, uint32_t> previousPositions;
+	for(uint32_t i = 0; i < previous.size(); i++) {
+		previousPositions[previous[i].path] = i;
+	}
+
+	// A jar that's given twice can't win anything the second time, so it's only kept the first.
+	vector<Jar> jars;
+	unordered_map<string, uint32_t> positions;
+	bool reordered = false;
+	uint32_t last = 0;
+	for(vector<string>::const_iterator it = jarPaths.begin(); it != jarPaths.end(); it++) {
+		if(positions.count(*it)) {
+			continue;
+		}
+		positions[*it] = jars.size();
+		jars.push_back(Jar());
+		unordered_map<string, uint32_t>::iterator old = previousPositions.find(*it);
+		Jar* previousJar = NULL;
+		if(old != previousPositions.end()) {
+			previousJar = &previous[old->second];
+			reordered = reordered || old->second < last;
+			last = old->second;
+		}
+		listJar(*it, previousJar, jars.back());
+	}
+
+	// The names that were in the jars that changed or went away are affected, and so are the names of the classes
+	// scanned from them now, which are added when they're scanned.
+	unordered_set<string> affected;
+	vector<uint32_t> obsoleteLists;
+	for(vector<Jar>::iterator jar = previous.begin(); jar != previous.end(); jar++) {
+		if(!positions.count(jar->path)) {
+			readEntries(*jar);
+		}
+		if(!jar->listed) {
+			continue;
+		}
+		obsoleteLists.push_back(jar->list);
+		for(vector<Entry>::const_iterator entry = jar->entries.begin(); entry != jar->entries.end(); entry++) {
+			if(!entry->className.empty()) {
+				affected.insert(entry->className);
+			}
+		}
+	}
+	if(reordered) {
+		for(Duplicates::const_iterator it = duplicates.begin(); it != duplicates.end(); it++) {
+			affected.insert(it->first);
+		}
+	}
+
+	vector<Segment> updated(segments);
+	vector<SymbolIndex*> opened;
+	vector<string> written;
+	vector<uint32_t> obsolete;
+	try {
+		// The changed entries go in one new segment, and the ones that win now without having changed, but whose
+		// class isn't alive where they are, go in another. Each only gets an id if anything was kept in it.
+		SymbolIndexWriter writer;
+		scanEntries(jars, writer, affected);
+		uint32_t changedId = NONE;
+		if(writer.numClasses() > 0) {
+			changedId = nextSegment++;
+			writer.write(getSegmentPath(changedId));
+			written.push_back(getSegmentPath(changedId));
+			Segment segment;
+			segment.id = changedId;
+			segment.index = NULL;
+			updated.push_back(segment);
+		}
+
+		// Every entry with an affected name, in classpath order. The listed jars have theirs in their entries, and
+		// the rest have theirs where the manifest says, or, for a name that only one entry had, where it's alive.
+		unordered_map<string, vector<Candidate> > candidates;
+		for(uint32_t i = 0; i < jars.size(); i++) {
+			for(uint32_t j = 0; j < jars[i].entries.size(); j++) {
+				const Entry& entry = jars[i].entries[j];
+				if(!entry.className.empty()) {
+					Candidate candidate;
+					candidate.jar = i;
+					candidate.order = j;
+					candidate.changed = entry.changed;
+					candidate.location.jar = jars[i].path;
+					candidate.location.entry = entry.name;
+					candidates[entry.className].push_back(candidate);
+				}
+			}
+		}
+		for(unordered_set<string>::const_iterator name = affected.begin(); name != affected.end(); name++) {
+			vector<Location> locations;
+			Duplicates::const_iterator duplicate = duplicates.find(*name);
+			ClassSymbol symbol;
+			if(duplicate != duplicates.end()) {
+				locations = duplicate->second;
+			} else if(findLive(*name, symbol) != NONE) {
+				locations.push_back(Location());
+				locations.back().jar = symbol.jar;
+				locations.back().entry = symbol.entry;
+			}
+			for(uint32_t i = 0; i < locations.size(); i++) {
+				unordered_map<string, uint32_t>::const_iterator position = positions.find(locations[i].jar);
+				if(position != positions.end() && !jars[position->second].listed) {
+					Candidate candidate;
+					candidate.jar = position->second;
+					candidate.order = i;
+					candidate.changed = false;
+					candidate.location = locations[i];
+					candidates[*name].push_back(candidate);
+				}
+			}
+		}
+
+		// The first candidate wins. If it changed, it's the one the new segment kept, and if its class is alive
+		// where it is, it stays there; otherwise it's scanned again. A class that's alive anywhere else is dead
+		// there now.
+		vector<Candidate> rescans;
+		for(unordered_set<string>::const_iterator name = affected.begin(); name != affected.end(); name++) {
+			vector<Candidate>& found = candidates[*name];
+			std::sort(found.begin(), found.end());
+			duplicates.erase(*name);
+			bool changed = false;
+			for(vector<Candidate>::const_iterator it = found.begin(); it != found.end(); it++) {
+				if(found.size() > 1) {
+					duplicates[*name].push_back(it->location);
+				}
+				changed = changed || it->changed;
+			}
+
+			ClassSymbol symbol;
+			uint32_t live = findLive(*name, symbol);
+			bool kept = live != NONE && !found.empty() && !found.front().changed && symbol.jar == found.front().location.jar
+				&& symbol.entry == found.front().location.entry;
+			if(live != NONE && !kept) {
+				findSegment(updated, live)->tombstones.insert(*name);
+			}
+			if(found.empty()) {
+				if(live != NONE) {
+					removed++;
+				}
+			} else if(!found.front().changed) {
+				if(changed) {
+					findSegment(updated, changedId)->tombstones.insert(*name);
+				}
+				if(!kept) {
+					rescans.push_back(found.front());
+				}
+			}
+		}
+		if(!rescans.empty()) {
+			std::sort(rescans.begin(), rescans.end());
+			SymbolIndexWriter rescanWriter;
+			rescanEntries(rescans, rescanWriter);
+			if(rescanWriter.numClasses() > 0) {
+				Segment segment;
+				segment.id = nextSegment++;
+				segment.index = NULL;
+				rescanWriter.write(getSegmentPath(segment.id));
+				written.push_back(getSegmentPath(segment.id));
+				updated.push_back(segment);
+			}
+		}
+		for(uint32_t i = segments.size(); i < updated.size(); i++) {
+			updated[i].index = new SymbolIndex(getSegmentPath(updated[i].id));
+			opened.push_back(updated[i].index);
+		}
+
+		// Drop the segments with nothing left in them, then merge the newest ones.
+		for(uint32_t i = 0; i < updated.size(); ) {
+			if(numLive(updated[i]) == 0) {
+				obsolete.push_back(updated[i].id);
+				updated.erase(updated.begin() + i);
+			} else {
+				i++;
+			}
+		}
+		size_t first = updated.size();
+		uint64_t live = 0;
+		while(first > 0) {
+			const Segment& segment = updated[first - 1];
+			bool sparse = 2 * numLive(segment) < segment.index->numClasses();
+			if(first < updated.size() && numLive(segment) > live && !sparse) {
+				break;
+			}
+			live += numLive(segment);
+			first--;
+		}
+		bool sparse = first < updated.size() && 2 * numLive(updated[first]) < updated[first].index->numClasses();
+		if(updated.size() - first > 1 || sparse) {
+			SymbolIndexWriter mergedWriter;
+			for(size_t i = first; i < updated.size(); i++) {
+				mergedWriter.addIndex(*updated[i].index, updated[i].tombstones);
+				obsolete.push_back(updated[i].id);
+				merged++;
+			}
+			Segment segment;
+			segment.id = nextSegment++;
+			segment.index = NULL;
+			mergedWriter.write(getSegmentPath(segment.id));
+			written.push_back(getSegmentPath(segment.id));
+			updated.erase(updated.begin() + first, updated.end());
+			updated.push_back(segment);
+		}
+
+		for(vector<Jar>::iterator jar = jars.begin(); jar != jars.end(); jar++) {
+			if(jar->listed) {
+				jar->list = nextList++;
+				writeEntries(*jar);
+				written.push_back(getListPath(jar->list));
+			}
+		}
+		writeManifest(updated, jars, duplicates);
+	} catch(...) {
+		for(vector<SymbolIndex*>::iterator it = opened.begin(); it != opened.end(); it++) {
+			delete *it;
+		}
+		for(vector<string>::iterator it = written.begin(); it != written.end(); it++) {
+			remove(it->c_str());
+		}
+		throw;
+	}
+	for(vector<SymbolIndex*>::iterator it = opened.begin(); it != opened.end(); it++) {
+		delete *it;
+	}
+
+	// Readers that already have them open keep their mappings, so the files can go as soon as the manifest does.
+	load();
+	for(vector<uint32_t>::iterator it = obsolete.begin(); it != obsolete.end(); it++) {
+		remove(getSegmentPath(*it).c_str());
+	}
+	for(vector<uint32_t>::iterator it = obsoleteLists.begin(); it != obsoleteLists.end(); it++) {
+		remove(getListPath(*it).c_str());
+	}
+}
+
+/**
+ * Gets the number of class entries the last update scanned.
+ */
+uint32_t SegmentedSymbolIndex::numScanned() const {
+	return scanned;
+}
+
+/**
+ * Gets the number of classes the last update removed, because no jar has them any more.
+ */
+uint32_t SegmentedSymbolIndex::numRemoved() const {
+	return removed;
+}
+
+/**
+ * Gets the number of segments the last update merged together.
+ */
+uint32_t SegmentedSymbolIndex::numMerged() const {
+	return merged;
+}
+
+/**
+ * Gets the classes the last update couldn't scan, and why.
+ */
+const vector<string>& SegmentedSymbolIndex::getErrors() const {
+	return errors;
+}
+
+/**
+ * Gets the number of segments.
+ */
+uint32_t SegmentedSymbolIndex::numSegments() const {
+	return segments.size();
+}
+
+/**
+ * Gets the number of live classes in every segment.
+ */
+uint32_t SegmentedSymbolIndex::numClasses() const {
+	uint32_t count = 0;
+	for(vector<Segment>::const_iterator it = segments.begin(); it != segments.end(); it++) {
+		count += numLive(*it);
+	}
+	return count;
+}
+
+/**
+ * Looks up a class by its internal name, in the one segment it's alive in. Returns false if it isn't in the index.
+ */
+bool SegmentedSymbolIndex::findClass(const string& name, ClassSymbol& symbol) const {
+	return findLive(name, symbol) != NONE;
+}
+
+/**
+ * Finds every field and method with a name, in order of the class that declares it.
+ */
+vector<MemberSymbol> SegmentedSymbolIndex::findMembers(const string& name) const {
+	vector<MemberSymbol> symbols;
+	for(vector<Segment>::const_iterator it = segments.begin(); it != segments.end(); it++) {
+		vector<MemberSymbol> found = it->index->findMembers(name);
+		for(vector<MemberSymbol>::iterator symbol = found.begin(); symbol != found.end(); symbol++) {
+			if(!it->tombstones.count(symbol->className)) {
+				symbols.push_back(*symbol);
+			}
+		}
+	}
+	std::sort(symbols.begin(), symbols.end(), compareMembers);
+	return symbols;
+}
+
+/**
+ * Finds what refers to a class, or to its fields and methods, like SymbolIndex::findReferences, leaving out the
+ * references made by dead classes.
+ */
+vector<ReferenceSymbol> SegmentedSymbolIndex::findReferences(const string& className, const string& name, const string& descriptor) const {
+	vector<ReferenceSymbol> symbols;
+	for(vector<Segment>::const_iterator it = segments.begin(); it != segments.end(); it++) {
+		vector<ReferenceSymbol> found = it->index->findReferences(className, name, descriptor);
+		for(vector<ReferenceSymbol>::iterator symbol = found.begin(); symbol != found.end(); symbol++) {
+			if(!it->tombstones.count(symbol->className)) {
+				symbols.push_back(*symbol);
+			}
+		}
+	}
+	std::sort(symbols.begin(), symbols.end(), compareReferences);
+	return symbols;
+}
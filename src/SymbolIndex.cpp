@@ -0,0 +1,1081 @@
+#include "SymbolIndex.h"
+#include "Bytecode.h"
+#include "Constants.h"
+#include "JarStream.h"
+#include "ModifiedUtf8.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using std::string;
+using std::vector;
+using std::ofstream;
+using std::runtime_error;
+
+namespace {
+	const char MAGIC[8] = { 'D', 'J', 'A', 'V', 'A', 'S', 'Y', 'M' };
+
+	/*
+	 * Header {
+	 * 		u1 magic[8];
+	 * 		u4 version;
+	 * 		u4 string_count;
+	 * 		u8 size;
+	 * 		u4 class_count;
+	 * 		u4 interface_count;
+	 * 		u4 member_count;
+	 * 		u4 reference_count;
+	 * 		u4 posting_count;
+	 * 		u4 reserved;
+	 * }
+	 * StringEntry {
+	 * 		u4 offset;
+	 * 		u4 length;
+	 * }
+	 * ClassEntry {
+	 * 		u4 name;
+	 * 		u4 jar;
+	 * 		u4 entry;
+	 * 		u4 super_name;
+	 * 		u4 interfaces_start;
+	 * 		u2 interface_count;
+	 * 		u2 access_flags;
+	 * }
+	 * MemberEntry {
+	 * 		u4 name;
+	 * 		u4 class_name;
+	 * 		u4 descriptor;
+	 * 		u2 access_flags;
+	 * 		u1 method;
+	 * 		u1 reserved;
+	 * }
+	 * ReferenceEntry {
+	 * 		u4 class_name;
+	 * 		u4 name;
+	 * 		u4 descriptor;
+	 * 		u4 postings_start;
+	 * 		u4 posting_count;
+	 * }
+	 * PostingEntry {
+	 * 		u4 class_name;
+	 * 		u4 method_name;
+	 * 		u4 method_descriptor;
+	 * }
+	 * Index {
+	 * 		Header header;
+	 * 		StringEntry strings[string_count];
+	 * 		ClassEntry classes[class_count];
+	 * 		u4 interfaces[interface_count];
+	 * 		MemberEntry members[member_count];
+	 * 		ReferenceEntry references[reference_count];
+	 * 		PostingEntry postings[posting_count];
+	 * 		u1 string_data[];
+	 * }
+	 *
+	 * Classes are sorted by name, members by name, class and descriptor, references by class, name and
+	 * descriptor, and the postings of each reference by class, method name and method descriptor. Every name is
+	 * a position in strings, or NONE where there's nothing.
+	 */
+	const uint32_t NONE = SymbolIndex::NONE;
+	const size_t HEADER_SIZE = 48;
+	const size_t STRING_SIZE = 8;
+	const size_t CLASS_SIZE = 24;
+	const size_t INTERFACE_SIZE = 4;
+	const size_t MEMBER_SIZE = 16;
+	const size_t REFERENCE_SIZE = 20;
+	const size_t POSTING_SIZE = 12;
+
+	uint16_t readBig16(const uint8_t* p) {
+		return (static_cast<uint16_t>(p[0]) << 8) | p[1];
+	}
+
+	/**
+	 * Finds the first record in a table sorted by the ids it starts with that's not less than a key of up to three
+	 * ids, or if after is true, the first one that's greater.
+	 */
+	uint32_t search(const uint8_t* table, uint32_t count, size_t recordSize, const uint32_t* key, unsigned int keyLength, bool after) {
+		uint32_t low = 0;
+		uint32_t high = count;
+		while(low < high) {
+			uint32_t middle = low + (high - low) / 2;
+			const uint8_t* record = table + static_cast<size_t>(middle) * recordSize;
+			int comparison = 0;
+			for(unsigned int i = 0; comparison == 0 && i < keyLength; i++) {
+				uint32_t id = readLittle32(record + 4 * i);
+				comparison = id < key[i] ? -1 : (id > key[i] ? 1 : 0);
+			}
+			if(comparison < 0 || (after && comparison == 0)) {
+				low = middle + 1;
+			} else {
+				high = middle;
+			}
+		}
+		return low;
+	}
+
+	/**
+	 * Orders string ids by the strings they stand for.
+	 */
+	struct ByString {
+		const vector<const string*>& strings;
+
+		ByString(const vector<const string*>& strings) : strings(strings) {}
+
+		bool operator()(uint32_t a, uint32_t b) const {
+			return *strings[a] < *strings[b];
+		}
+	};
+}
+
+/**
+ * Maps an index, and checks that every offset and id in it is in range, so that queries never read outside the
+ * mapping. Throws if the index can't be used.
+ */
+SymbolIndex::SymbolIndex(const string& path) : path(path), mapping(NULL), mappingSize(0), stringCount(0), classCount(0),
+	interfaceCount(0), memberCount(0), referenceCount(0), postingCount(0), strings(NULL), classes(NULL), interfaces(NULL),
+	members(NULL), references(NULL), postings(NULL) {
+
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0) {
+		throw runtime_error("Could not open symbol index " + path);
+	}
+	struct stat info;
+	if(fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(HEADER_SIZE)) {
+		close(fd);
+		throw runtime_error(path + " is not a symbol index");
+	}
+	mappingSize = info.st_size;
+	void* memory = mmap(NULL, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(memory == MAP_FAILED) {
+		throw runtime_error("Could not map symbol index " + path);
+	}
+	mapping = static_cast<const uint8_t*>(memory);
+
+	const char* problem = validate();
+	if(problem) {
+		munmap(const_cast<uint8_t*>(mapping), mappingSize);
+		throw runtime_error(path + problem);
+	}
+}
+
+/**
+ * Destructor for SymbolIndex. Unmaps the index; every symbol handed out has its own copies of its strings.
+ */
+SymbolIndex::~SymbolIndex() {
+	munmap(const_cast<uint8_t*>(mapping), mappingSize);
+}
+
+/**
+ * Reads the header and finds the tables, then checks every entry. Returns what's wrong with the index, or NULL if
+ * nothing is.
+ */
+const char* SymbolIndex::validate() {
+	if(memcmp(mapping, MAGIC, sizeof(MAGIC)) != 0) {
+		return " is not a symbol index";
+	} else if(readLittle32(mapping + 8) != VERSION) {
+		return " was written by a different version";
+	} else if(readLittle64(mapping + 16) != mappingSize) {
+		return " is truncated";
+	}
+	stringCount = readLittle32(mapping + 12);
+	classCount = readLittle32(mapping + 24);
+	interfaceCount = readLittle32(mapping + 28);
+	memberCount = readLittle32(mapping + 32);
+	referenceCount = readLittle32(mapping + 36);
+	postingCount = readLittle32(mapping + 40);
+	uint64_t tablesSize = static_cast<uint64_t>(stringCount) * STRING_SIZE + static_cast<uint64_t>(classCount) * CLASS_SIZE
+		+ static_cast<uint64_t>(interfaceCount) * INTERFACE_SIZE + static_cast<uint64_t>(memberCount) * MEMBER_SIZE
+		+ static_cast<uint64_t>(referenceCount) * REFERENCE_SIZE + static_cast<uint64_t>(postingCount) * POSTING_SIZE;
+	if(tablesSize > mappingSize - HEADER_SIZE) {
+		return " has a corrupt header";
+	}
+	strings = mapping + HEADER_SIZE;
+	classes = strings + static_cast<size_t>(stringCount) * STRING_SIZE;
+	interfaces = classes + static_cast<size_t>(classCount) * CLASS_SIZE;
+	members = interfaces + static_cast<size_t>(interfaceCount) * INTERFACE_SIZE;
+	references = members + static_cast<size_t>(memberCount) * MEMBER_SIZE;
+	postings = references + static_cast<size_t>(referenceCount) * REFERENCE_SIZE;
+
+	for(uint32_t i = 0; i < stringCount; i++) {
+		const uint8_t* p = strings + static_cast<size_t>(i) * STRING_SIZE;
+		if(static_cast<uint64_t>(readLittle32(p)) + readLittle32(p + 4) > mappingSize) {
+			return " has a corrupt string table";
+		}
+	}
+	for(uint32_t i = 0; i < classCount; i++) {
+		const uint8_t* p = classes + static_cast<size_t>(i) * CLASS_SIZE;
+		uint32_t superName = readLittle32(p + 12);
+		if(readLittle32(p) >= stringCount || readLittle32(p + 4) >= stringCount || readLittle32(p + 8) >= stringCount
+			|| (superName != NONE && superName >= stringCount)
+			|| static_cast<uint64_t>(readLittle32(p + 16)) + readLittle16(p + 20) > interfaceCount) {
+			return " has a corrupt class table";
+		}
+	}
+	for(uint32_t i = 0; i < interfaceCount; i++) {
+		if(readLittle32(interfaces + static_cast<size_t>(i) * INTERFACE_SIZE) >= stringCount) {
+			return " has a corrupt interface table";
+		}
+	}
+	for(uint32_t i = 0; i < memberCount; i++) {
+		const uint8_t* p = members + static_cast<size_t>(i) * MEMBER_SIZE;
+		if(readLittle32(p) >= stringCount || readLittle32(p + 4) >= stringCount || readLittle32(p + 8) >= stringCount) {
+			return " has a corrupt member table";
+		}
+	}
+	for(uint32_t i = 0; i < referenceCount; i++) {
+		const uint8_t* p = references + static_cast<size_t>(i) * REFERENCE_SIZE;
+		uint32_t name = readLittle32(p + 4);
+		uint32_t descriptor = readLittle32(p + 8);
+		if(readLittle32(p) >= stringCount || (name != NONE && name >= stringCount) || (descriptor != NONE && descriptor >= stringCount)
+			|| static_cast<uint64_t>(readLittle32(p + 12)) + readLittle32(p + 16) > postingCount) {
+			return " has a corrupt reference table";
+		}
+	}
+	for(uint32_t i = 0; i < postingCount; i++) {
+		const uint8_t* p = postings + static_cast<size_t>(i) * POSTING_SIZE;
+		uint32_t methodName = readLittle32(p + 4);
+		uint32_t methodDescriptor = readLittle32(p + 8);
+		if(readLittle32(p) >= stringCount || (methodName != NONE && methodName >= stringCount)
+			|| (methodDescriptor != NONE && methodDescriptor >= stringCount)) {
+			return " has a corrupt posting table";
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Gets a string by its id, or an empty string for NONE.
+ */
+string SymbolIndex::getString(uint32_t id) const {
+	if(id == NONE) {
+		return string();
+	}
+	const uint8_t* p = strings + static_cast<size_t>(id) * STRING_SIZE;
+	return string(reinterpret_cast<const char*>(mapping + readLittle32(p)), readLittle32(p + 4));
+}
+
+/**
+ * Compares a string in the index with another, like memcmp.
+ */
+int SymbolIndex::compareString(uint32_t id, const string& value) const {
+	const uint8_t* p = strings + static_cast<size_t>(id) * STRING_SIZE;
+	uint32_t length = readLittle32(p + 4);
+	size_t common = std::min<size_t>(length, value.size());
+	int comparison = memcmp(mapping + readLittle32(p), value.data(), common);
+	if(comparison == 0) {
+		comparison = length < value.size() ? -1 : (length > value.size() ? 1 : 0);
+	}
+	return comparison;
+}
+
+/**
+ * Finds the id of a string with a binary search over the string table. Returns false if it's not in the index,
+ * in which case nothing refers to it.
+ */
+bool SymbolIndex::findString(const string& value, uint32_t& id) const {
+	uint32_t low = 0;
+	uint32_t high = stringCount;
+	while(low < high) {
+		uint32_t middle = low + (high - low) / 2;
+		int comparison = compareString(middle, value);
+		if(comparison == 0) {
+			id = middle;
+			return true;
+		} else if(comparison < 0) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	return false;
+}
+
+/**
+ * Decodes the i'th class, in sorted order.
+ */
+void SymbolIndex::getClass(uint32_t i, ClassSymbol& symbol) const {
+	const uint8_t* p = classes + static_cast<size_t>(i) * CLASS_SIZE;
+	symbol.name = getString(readLittle32(p));
+	symbol.jar = getString(readLittle32(p + 4));
+	symbol.entry = getString(readLittle32(p + 8));
+	symbol.superName = getString(readLittle32(p + 12));
+	symbol.interfaces.clear();
+	uint32_t start = readLittle32(p + 16);
+	uint16_t count = readLittle16(p + 20);
+	for(uint32_t j = start; j < start + count; j++) {
+		symbol.interfaces.push_back(getString(readLittle32(interfaces + static_cast<size_t>(j) * INTERFACE_SIZE)));
+	}
+	symbol.accessFlags = readLittle16(p + 22);
+}
+
+/**
+ * Gets the number of classes in the index.
+ */
+uint32_t SymbolIndex::numClasses() const {
+	return classCount;
+}
+
+/**
+ * Gets the number of fields and methods in the index.
+ */
+uint32_t SymbolIndex::numMembers() const {
+	return memberCount;
+}
+
+/**
+ * Gets the number of distinct classes, fields and methods that something refers to.
+ */
+uint32_t SymbolIndex::numReferences() const {
+	return referenceCount;
+}
+
+/**
+ * Looks up a class by its internal name. Returns false if it isn't in the index.
+ */
+bool SymbolIndex::findClass(const string& name, ClassSymbol& symbol) const {
+	uint32_t key;
+	if(!findString(name, key)) {
+		return false;
+	}
+	uint32_t i = search(classes, classCount, CLASS_SIZE, &key, 1, false);
+	if(i == classCount || readLittle32(classes + static_cast<size_t>(i) * CLASS_SIZE) != key) {
+		return false;
+	}
+	getClass(i, symbol);
+	return true;
+}
+
+/**
+ * Finds every field and method with a name, in order of the class that declares it.
+ */
+vector<MemberSymbol> SymbolIndex::findMembers(const string& name) const {
+	vector<MemberSymbol> symbols;
+	uint32_t low[3] = { 0, 0, 0 };
+	if(!findString(name, low[0])) {
+		return symbols;
+	}
+	uint32_t high[3] = { low[0], NONE, NONE };
+	uint32_t end = search(members, memberCount, MEMBER_SIZE, high, 3, true);
+	for(uint32_t i = search(members, memberCount, MEMBER_SIZE, low, 3, false); i < end; i++) {
+		const uint8_t* p = members + static_cast<size_t>(i) * MEMBER_SIZE;
+		MemberSymbol symbol;
+		symbol.name = name;
+		symbol.className = getString(readLittle32(p + 4));
+		symbol.descriptor = getString(readLittle32(p + 8));
+		symbol.accessFlags = readLittle16(p + 12);
+		symbol.method = p[14] != 0;
+		symbols.push_back(symbol);
+	}
+	return symbols;
+}
+
+/**
+ * Finds what refers to a class, or to its fields and methods. With no name, that's everything referring to the
+ * class or anything in it; with a name but no descriptor, it's every field or method with that name.
+ */
+vector<ReferenceSymbol> SymbolIndex::findReferences(const string& className, const string& name, const string& descriptor) const {
+	vector<ReferenceSymbol> symbols;
+	uint32_t low[3] = { 0, 0, 0 };
+	uint32_t high[3] = { 0, NONE, NONE };
+	if(!findString(className, low[0])) {
+		return symbols;
+	}
+	high[0] = low[0];
+	if(!name.empty()) {
+		if(!findString(name, low[1])) {
+			return symbols;
+		}
+		high[1] = low[1];
+		if(!descriptor.empty()) {
+			if(!findString(descriptor, low[2])) {
+				return symbols;
+			}
+			high[2] = low[2];
+		}
+	}
+	uint32_t end = search(references, referenceCount, REFERENCE_SIZE, high, 3, true);
+	for(uint32_t i = search(references, referenceCount, REFERENCE_SIZE, low, 3, false); i < end; i++) {
+		const uint8_t* p = references + static_cast<size_t>(i) * REFERENCE_SIZE;
+		ReferenceSymbol symbol;
+		symbol.targetClass = className;
+		symbol.name = getString(readLittle32(p + 4));
+		symbol.descriptor = getString(readLittle32(p + 8));
+		uint32_t start = readLittle32(p + 12);
+		uint32_t count = readLittle32(p + 16);
+		for(uint32_t j = start; j < start + count; j++) {
+			const uint8_t* posting = postings + static_cast<size_t>(j) * POSTING_SIZE;
+			symbol.className = getString(readLittle32(posting));
+			symbol.methodName = getString(readLittle32(posting + 4));
+			symbol.methodDescriptor = getString(readLittle32(posting + 8));
+			symbols.push_back(symbol);
+		}
+	}
+	return symbols;
+}
+
+/**
+ * Gathers the symbols of one class as it's scanned, and hands them to the writer once the whole class has been,
+ * so a class that turns out to be malformed halfway through leaves nothing behind.
+ */
+class SymbolIndexWriter::Collector : public ClassVisitor {
+private:
+	SymbolIndexWriter& writer;
+	const ClassScanner* scanner;
+	uint32_t jar;
+	uint32_t entry;
+	bool duplicate;
+	ClassRecord record;
+	vector<uint32_t> interfaces;
+	vector<MemberRecord> members;
+	vector<Posting> postings;
+	vector<uint16_t> classConstants;
+	vector<uint16_t> methodHandles;
+	vector<uint32_t> resolved;
+	uint32_t methodName;
+	uint32_t methodDescriptor;
+
+	uint32_t intern(uint16_t index);
+	uint32_t resolve(uint16_t index);
+	void addPosting(uint32_t reference, uint32_t name, uint32_t descriptor);
+public:
+	Collector(SymbolIndexWriter& writer, uint32_t jar, uint32_t entry);
+
+	bool isDuplicate() const;
+	uint32_t getClassName() const;
+
+	void visitClassConstant(uint16_t index, uint16_t nameIndex);
+	void visitMethodHandle(uint16_t index, uint8_t referenceKind, uint16_t referenceIndex);
+	void visitClass(const ClassScanner& scanner, uint16_t accessFlags, uint16_t thisClass, uint16_t superClass);
+	void visitInterface(uint16_t classIndex);
+	void visitField(uint16_t accessFlags, uint16_t nameIndex, uint16_t descriptorIndex);
+	void visitMethod(uint16_t accessFlags, uint16_t nameIndex, uint16_t descriptorIndex);
+	bool visitCode(uint16_t maxStack, uint16_t maxLocals, const uint8_t* code, uint32_t codeLength);
+	void visitInstruction(const Instruction& instruction, const uint8_t* code);
+	void visitEnd();
+};
+
+/**
+ * Constructor for Collector, for a class at an entry of a jar.
+ */
+SymbolIndexWriter::Collector::Collector(SymbolIndexWriter& writer, uint32_t jar, uint32_t entry) :
+	writer(writer), scanner(NULL), jar(jar), entry(entry), duplicate(false), methodName(NONE), methodDescriptor(NONE) {
+	record.name = NONE;
+
+}
+
+/**
+ * Returns whether the class was left out because one with the same name had already been added.
+ */
+bool SymbolIndexWriter::Collector::isDuplicate() const {
+	return duplicate;
+}
+
+/**
+ * Gets the id of the name of the class, or NONE if the scan never got that far.
+ */
+uint32_t SymbolIndexWriter::Collector::getClassName() const {
+	return record.name;
+}
+
+/**
+ * Interns the string in a Utf8 constant.
+ */
+uint32_t SymbolIndexWriter::Collector::intern(uint16_t index) {
+	uint16_t length;
+	const char* data = scanner->getUtf8(index, length);
+	return writer.intern(data, length);
+}
+
+/**
+ * Gets the writer's reference for the field or method a Fieldref, Methodref or InterfaceMethodref refers to.
+ * Each constant is only resolved once per class, however many instructions use it.
+ */
+uint32_t SymbolIndexWriter::Collector::resolve(uint16_t index) {
+	if(resolved.size() < scanner->getNumConstants()) {
+		resolved.assign(scanner->getNumConstants(), NONE);
+	}
+	if(index >= resolved.size()) {
+		return NONE;
+	}
+	if(resolved[index] == NONE) {
+		uint8_t tag = scanner->getTag(index);
+		if(tag != CONSTANT_Fieldref && tag != CONSTANT_Methodref && tag != CONSTANT_InterfaceMethodref) {
+			return NONE;
+		}
+		const uint8_t* reference = scanner->getConstant(index);
+		uint16_t length;
+		const char* className = scanner->getClassName(readBig16(reference + 1), length);
+		uint32_t owner = writer.intern(className, length);
+		uint16_t nameAndTypeIndex = readBig16(reference + 3);
+		if(scanner->getTag(nameAndTypeIndex) != CONSTANT_NameAndType) {
+			throw runtime_error("Constant " + toString(nameAndTypeIndex) + " is not a NameAndType constant");
+		}
+		const uint8_t* nameAndType = scanner->getConstant(nameAndTypeIndex);
+		resolved[index] = writer.getReference(owner, intern(readBig16(nameAndType + 1)), intern(readBig16(nameAndType + 3)));
+	}
+	return resolved[index];
+}
+
+/**
+ * Notes that the class, or the method being visited, refers to something.
+ */
+void SymbolIndexWriter::Collector::addPosting(uint32_t reference, uint32_t name, uint32_t descriptor) {
+	Posting posting;
+	posting.reference = reference;
+	posting.className = record.name;
+	posting.methodName = name;
+	posting.methodDescriptor = descriptor;
+	postings.push_back(posting);
+}
+
+/**
+ * Notes a Class constant, to be resolved once the constant pool has been scanned.
+ */
+void SymbolIndexWriter::Collector::visitClassConstant(uint16_t index, uint16_t nameIndex) {
+	classConstants.push_back(index);
+}
+
+/**
+ * Notes a MethodHandle constant, to be resolved once the constant pool has been scanned.
+ */
+void SymbolIndexWriter::Collector::visitMethodHandle(uint16_t index, uint8_t referenceKind, uint16_t referenceIndex) {
+	methodHandles.push_back(referenceIndex);
+}
+
+/**
+ * Starts the class record, unless a class with the same name has already been added. Every class the constant
+ * pool names, other than this one, counts as a reference from the class as a whole, and so does every field and
+ * method a method handle refers to.
+ */
+void SymbolIndexWriter::Collector::visitClass(const ClassScanner& scanner, uint16_t accessFlags, uint16_t thisClass, uint16_t superClass) {
+	this->scanner = &scanner;
+	uint16_t length;
+	const char* name = scanner.getClassName(thisClass, length);
+	record.name = writer.intern(name, length);
+	if(writer.classNames.count(record.name)) {
+		duplicate = true;
+		return;
+	}
+	record.jar = jar;
+	record.entry = entry;
+	record.accessFlags = accessFlags;
+	record.superName = NONE;
+	if(superClass != 0) {
+		name = scanner.getClassName(superClass, length);
+		record.superName = writer.intern(name, length);
+	}
+	for(vector<uint16_t>::iterator it = classConstants.begin(); it != classConstants.end(); it++) {
+		name = scanner.getClassName(*it, length);
+		// Arrays refer to their element class; arrays of primitives don't refer to anything.
+		if(length > 0 && name[0] == '[') {
+			while(length > 0 && name[0] == '[') {
+				name++;
+				length--;
+			}
+			if(length < 2 || name[0] != 'L' || name[length - 1] != ';') {
+				continue;
+			}
+			name++;
+			length -= 2;
+		}
+		uint32_t target = writer.intern(name, length);
+		if(target != record.name) {
+			addPosting(writer.getReference(target, NONE, NONE), NONE, NONE);
+		}
+	}
+	for(vector<uint16_t>::iterator it = methodHandles.begin(); it != methodHandles.end(); it++) {
+		uint32_t reference = resolve(*it);
+		if(reference != NONE) {
+			addPosting(reference, NONE, NONE);
+		}
+	}
+}
+
+/**
+ * Adds an interface to the class record.
+ */
+void SymbolIndexWriter::Collector::visitInterface(uint16_t classIndex) {
+	if(!duplicate) {
+		uint16_t length;
+		const char* name = scanner->getClassName(classIndex, length);
+		interfaces.push_back(writer.intern(name, length));
+	}
+}
+
+/**
+ * Adds a field.
+ */
+void SymbolIndexWriter::Collector::visitField(uint16_t accessFlags, uint16_t nameIndex, uint16_t descriptorIndex) {
+	if(!duplicate) {
+		MemberRecord member;
+		member.className = record.name;
+		member.name = intern(nameIndex);
+		member.descriptor = intern(descriptorIndex);
+		member.accessFlags = accessFlags;
+		member.method = false;
+		members.push_back(member);
+	}
+}
+
+/**
+ * Adds a method, which the references in the code that follows are from.
+ */
+void SymbolIndexWriter::Collector::visitMethod(uint16_t accessFlags, uint16_t nameIndex, uint16_t descriptorIndex) {
+	if(!duplicate) {
+		MemberRecord member;
+		member.className = record.name;
+		member.name = intern(nameIndex);
+		member.descriptor = intern(descriptorIndex);
+		member.accessFlags = accessFlags;
+		member.method = true;
+		members.push_back(member);
+		methodName = member.name;
+		methodDescriptor = member.descriptor;
+	}
+}
+
+/**
+ * Asks for the instructions of a method, unless the class is being left out.
+ */
+bool SymbolIndexWriter::Collector::visitCode(uint16_t maxStack, uint16_t maxLocals, const uint8_t* code, uint32_t codeLength) {
+	return !duplicate;
+}
+
+/**
+ * Adds a reference from the method to the field or method a field access or invocation refers to.
+ */
+void SymbolIndexWriter::Collector::visitInstruction(const Instruction& instruction, const uint8_t* code) {
+	if(instruction.opcode >= BY_getstatic && instruction.opcode <= BY_invokeinterface) {
+		uint32_t reference = resolve(readBig16(code + instruction.pc + 1));
+		if(reference != NONE) {
+			addPosting(reference, methodName, methodDescriptor);
+		}
+	}
+}
+
+/**
+ * Hands everything gathered over to the writer.
+ */
+void SymbolIndexWriter::Collector::visitEnd() {
+	if(duplicate) {
+		return;
+	}
+	record.interfacesStart = writer.interfaces.size();
+	record.interfaceCount = interfaces.size();
+	writer.interfaces.insert(writer.interfaces.end(), interfaces.begin(), interfaces.end());
+	writer.classes.push_back(record);
+	writer.classNames.insert(record.name);
+	writer.members.insert(writer.members.end(), members.begin(), members.end());
+	writer.postings.insert(writer.postings.end(), postings.begin(), postings.end());
+}
+
+/**
+ * Orders members by name, class and descriptor ids, the order of the member table.
+ */
+bool SymbolIndexWriter::MemberKey::operator<(const MemberKey& other) const {
+	if(name != other.name) {
+		return name < other.name;
+	}
+	if(className != other.className) {
+		return className < other.className;
+	}
+	return descriptor < other.descriptor;
+}
+
+/**
+ * Orders references by class, name and descriptor ids.
+ */
+bool SymbolIndexWriter::ReferenceKey::operator<(const ReferenceKey& other) const {
+	if(className != other.className) {
+		return className < other.className;
+	}
+	if(name != other.name) {
+		return name < other.name;
+	}
+	return descriptor < other.descriptor;
+}
+
+/**
+ * Constructor for SymbolIndexWriter.
+ */
+SymbolIndexWriter::SymbolIndexWriter() : duplicates(0) {
+
+}
+
+/**
+ * Destructor for SymbolIndexWriter.
+ */
+SymbolIndexWriter::~SymbolIndexWriter() {
+
+}
+
+/**
+ * Gets the id of a string, adding it if it's new. Ids are in the order strings are first seen, until the index is
+ * written.
+ */
+uint32_t SymbolIndexWriter::intern(const string& value) {
+	std::pair<std::unordered_map<string, uint32_t>::iterator, bool> inserted = stringIds.insert(std::make_pair(value, strings.size()));
+	if(inserted.second) {
+		strings.push_back(&inserted.first->first);
+	}
+	return inserted.first->second;
+}
+
+/**
+ * Gets the id of a string in modified UTF-8, straight out of a class file, after decoding it to standard UTF-8
+ * like ConstantUtf8 does. Strings that aren't valid are kept as they are.
+ */
+uint32_t SymbolIndexWriter::intern(const char* data, size_t length) {
+	static thread_local string value;
+	if(countAscii(data, length) == length || !decodeModifiedUtf8(data, length, value)) {
+		value.assign(data, length);
+	}
+	return intern(value);
+}
+
+/**
+ * Gets the id of a reference to a class, field or method, adding it if it's new.
+ */
+uint32_t SymbolIndexWriter::getReference(uint32_t className, uint32_t name, uint32_t descriptor) {
+	ReferenceKey key;
+	key.className = className;
+	key.name = name;
+	key.descriptor = descriptor;
+	std::pair<std::map<ReferenceKey, uint32_t>::iterator, bool> inserted = referenceIds.insert(std::make_pair(key, references.size()));
+	if(inserted.second) {
+		references.push_back(key);
+	}
+	return inserted.first->second;
+}
+
+/**
+ * Scans every class in a jar into the index. Classes that can't be read or scanned are left out, and listed in
+ * the errors. Throws if the jar can't be opened.
+ */
+void SymbolIndexWriter::addJar(const string& path) {
+	JarStream stream(path);
+	string data;
+	while(true) {
+		// An entry that can't be skipped leaves nowhere to go on from, which loses the rest of the jar.
+		try {
+			if(!stream.nextEntry()) {
+				break;
+			}
+		} catch(const std::exception& e) {
+			errors.push_back(path + "!" + stream.getName() + ": " + e.what());
+			break;
+		}
+		if(!isClassFile(stream.getName())) {
+			continue;
+		}
+		// An entry that can't be read is an error like one that can't be scanned. If the stream can't find
+		// where it ends, the next nextEntry finishes the jar.
+		try {
+			stream.readEntry(data);
+			addClass(path, stream.getName(), data.data(), data.size());
+		} catch(const std::exception& e) {
+			errors.push_back(path + "!" + stream.getName() + ": " + e.what());
+		}
+	}
+}
+
+/**
+ * Scans a class into the index, given where it came from. Returns false if a class with the same name was
+ * already added. Throws if the class can't be scanned, leaving the index as it was, apart from some strings.
+ */
+bool SymbolIndexWriter::addClass(const string& jar, const string& entry, const char* data, size_t size) {
+	string name;
+	return addClass(jar, entry, data, size, name);
+}
+
+/**
+ * Scans a class into the index like the other addClass, and gets the name of the class, whether or not it was
+ * a duplicate.
+ */
+bool SymbolIndexWriter::addClass(const string& jar, const string& entry, const char* data, size_t size, string& name) {
+	Collector collector(*this, intern(jar), intern(entry));
+	scanner.scan(data, size, collector);
+	name = *strings[collector.getClassName()];
+	if(collector.isDuplicate()) {
+		duplicates++;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Gets the id in this index of a string in another, interning it the first time it's asked for. ids holds the
+ * ones interned so far, by their id in the other index. NONE stays NONE.
+ */
+uint32_t SymbolIndexWriter::intern(const SymbolIndex& index, uint32_t id, vector<uint32_t>& ids) {
+	if(id == NONE) {
+		return NONE;
+	}
+	if(ids[id] == NONE) {
+		ids[id] = intern(index.getString(id));
+	}
+	return ids[id];
+}
+
+/**
+ * Copies the classes in another index into this one, apart from the excluded ones, along with the fields and
+ * methods they declare and the references they make, without scanning anything. Classes with the same name as
+ * one already added are left out as duplicates, as they are by addClass.
+ */
+void SymbolIndexWriter::addIndex(const SymbolIndex& index, const std::unordered_set<string>& excluded) {
+	vector<uint32_t> ids(index.stringCount, NONE);
+	vector<bool> copied(index.stringCount, false);
+	for(uint32_t i = 0; i < index.classCount; i++) {
+		const uint8_t* p = index.classes + static_cast<size_t>(i) * CLASS_SIZE;
+		uint32_t name = readLittle32(p);
+		if(excluded.count(index.getString(name))) {
+			continue;
+		}
+		ClassRecord record;
+		record.name = intern(index, name, ids);
+		if(classNames.count(record.name)) {
+			duplicates++;
+			continue;
+		}
+		record.jar = intern(index, readLittle32(p + 4), ids);
+		record.entry = intern(index, readLittle32(p + 8), ids);
+		record.superName = intern(index, readLittle32(p + 12), ids);
+		record.interfacesStart = interfaces.size();
+		record.interfaceCount = readLittle16(p + 20);
+		record.accessFlags = readLittle16(p + 22);
+		uint32_t start = readLittle32(p + 16);
+		for(uint32_t j = start; j < start + record.interfaceCount; j++) {
+			interfaces.push_back(intern(index, readLittle32(index.interfaces + static_cast<size_t>(j) * INTERFACE_SIZE), ids));
+		}
+		classes.push_back(record);
+		classNames.insert(record.name);
+		copied[name] = true;
+	}
+
+	for(uint32_t i = 0; i < index.memberCount; i++) {
+		const uint8_t* p = index.members + static_cast<size_t>(i) * MEMBER_SIZE;
+		if(copied[readLittle32(p + 4)]) {
+			MemberRecord member;
+			member.name = intern(index, readLittle32(p), ids);
+			member.className = intern(index, readLittle32(p + 4), ids);
+			member.descriptor = intern(index, readLittle32(p + 8), ids);
+			member.accessFlags = readLittle16(p + 12);
+			member.method = p[14] != 0;
+			members.push_back(member);
+		}
+	}
+
+	for(uint32_t i = 0; i < index.referenceCount; i++) {
+		const uint8_t* p = index.references + static_cast<size_t>(i) * REFERENCE_SIZE;
+		uint32_t reference = NONE;
+		uint32_t start = readLittle32(p + 12);
+		for(uint32_t j = start; j < start + readLittle32(p + 16); j++) {
+			const uint8_t* posting = index.postings + static_cast<size_t>(j) * POSTING_SIZE;
+			if(!copied[readLittle32(posting)]) {
+				continue;
+			}
+			if(reference == NONE) {
+				reference = getReference(intern(index, readLittle32(p), ids), intern(index, readLittle32(p + 4), ids),
+					intern(index, readLittle32(p + 8), ids));
+			}
+			Posting copy;
+			copy.reference = reference;
+			copy.className = intern(index, readLittle32(posting), ids);
+			copy.methodName = intern(index, readLittle32(posting + 4), ids);
+			copy.methodDescriptor = intern(index, readLittle32(posting + 8), ids);
+			postings.push_back(copy);
+		}
+	}
+}
+
+/**
+ * Gets the number of classes added.
+ */
+uint32_t SymbolIndexWriter::numClasses() const {
+	return classes.size();
+}
+
+/**
+ * Gets the number of classes left out because a class with the same name had already been added.
+ */
+uint32_t SymbolIndexWriter::numDuplicates() const {
+	return duplicates;
+}
+
+/**
+ * Gets the classes that couldn't be scanned, and why.
+ */
+const vector<string>& SymbolIndexWriter::getErrors() const {
+	return errors;
+}
+
+/**
+ * Sorts the strings and renumbers everything by them, sorts every table, and writes the index. Like a
+ * ClassArchive, it's written next to its final path and renamed over it.
+ */
+void SymbolIndexWriter::write(const string& path) const {
+	vector<uint32_t> order(strings.size());
+	for(uint32_t i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), ByString(strings));
+	vector<uint32_t> ids(strings.size());
+	for(uint32_t i = 0; i < order.size(); i++) {
+		ids[order[i]] = i;
+	}
+	struct Renumber {
+		const vector<uint32_t>& ids;
+		uint32_t operator()(uint32_t id) const {
+			return id == SymbolIndex::NONE ? id : ids[id];
+		}
+	} renumber = { ids };
+
+	// Every table is sorted by tuples of ids, and since the ids are in string order now, so are the tables.
+	vector<std::pair<uint32_t, uint32_t> > classOrder;
+	for(uint32_t i = 0; i < classes.size(); i++) {
+		classOrder.push_back(std::make_pair(renumber(classes[i].name), i));
+	}
+	std::sort(classOrder.begin(), classOrder.end());
+
+	vector<std::pair<MemberKey, uint32_t> > memberOrder;
+	for(uint32_t i = 0; i < members.size(); i++) {
+		MemberKey key = { renumber(members[i].name), renumber(members[i].className), renumber(members[i].descriptor) };
+		memberOrder.push_back(std::make_pair(key, i));
+	}
+	std::sort(memberOrder.begin(), memberOrder.end());
+
+	vector<std::pair<ReferenceKey, uint32_t> > referenceOrder;
+	for(uint32_t i = 0; i < references.size(); i++) {
+		ReferenceKey key = { renumber(references[i].className), renumber(references[i].name), renumber(references[i].descriptor) };
+		referenceOrder.push_back(std::make_pair(key, i));
+	}
+	std::sort(referenceOrder.begin(), referenceOrder.end());
+	vector<uint32_t> referencePositions(references.size());
+	for(uint32_t i = 0; i < referenceOrder.size(); i++) {
+		referencePositions[referenceOrder[i].second] = i;
+	}
+
+	// Postings are sorted by the position of their reference first, so each reference's are together.
+	vector<Posting> sortedPostings;
+	sortedPostings.reserve(postings.size());
+	for(vector<Posting>::const_iterator it = postings.begin(); it != postings.end(); it++) {
+		Posting posting = { referencePositions[it->reference], renumber(it->className), renumber(it->methodName), renumber(it->methodDescriptor) };
+		sortedPostings.push_back(posting);
+	}
+	struct PostingOrder {
+		static bool less(const Posting& a, const Posting& b) {
+			if(a.reference != b.reference) {
+				return a.reference < b.reference;
+			}
+			if(a.className != b.className) {
+				return a.className < b.className;
+			}
+			if(a.methodName != b.methodName) {
+				return a.methodName < b.methodName;
+			}
+			return a.methodDescriptor < b.methodDescriptor;
+		}
+
+		static bool equal(const Posting& a, const Posting& b) {
+			return !less(a, b) && !less(b, a);
+		}
+	};
+	std::sort(sortedPostings.begin(), sortedPostings.end(), PostingOrder::less);
+	sortedPostings.erase(std::unique(sortedPostings.begin(), sortedPostings.end(), PostingOrder::equal), sortedPostings.end());
+
+	size_t tablesSize = HEADER_SIZE + strings.size() * STRING_SIZE + classes.size() * CLASS_SIZE + interfaces.size() * INTERFACE_SIZE
+		+ members.size() * MEMBER_SIZE + references.size() * REFERENCE_SIZE + sortedPostings.size() * POSTING_SIZE;
+	string tables;
+	tables.reserve(tablesSize);
+	string data;
+	for(vector<uint32_t>::iterator it = order.begin(); it != order.end(); it++) {
+		const string& value = *strings[*it];
+		if(tablesSize + data.size() + value.size() > 0xffffffffULL) {
+			throw runtime_error("Too many symbols to index");
+		}
+		writeLittle32(tables, tablesSize + data.size());
+		writeLittle32(tables, value.size());
+		data += value;
+	}
+
+	uint32_t interfacesWritten = 0;
+	string interfaceTable;
+	for(vector<std::pair<uint32_t, uint32_t> >::iterator it = classOrder.begin(); it != classOrder.end(); it++) {
+		const ClassRecord& record = classes[it->second];
+		writeLittle32(tables, renumber(record.name));
+		writeLittle32(tables, renumber(record.jar));
+		writeLittle32(tables, renumber(record.entry));
+		writeLittle32(tables, renumber(record.superName));
+		writeLittle32(tables, interfacesWritten);
+		writeLittle16(tables, record.interfaceCount);
+		writeLittle16(tables, record.accessFlags);
+		for(uint32_t i = record.interfacesStart; i < record.interfacesStart + record.interfaceCount; i++) {
+			writeLittle32(interfaceTable, renumber(interfaces[i]));
+		}
+		interfacesWritten += record.interfaceCount;
+	}
+	tables += interfaceTable;
+
+	for(vector<std::pair<MemberKey, uint32_t> >::iterator it = memberOrder.begin(); it != memberOrder.end(); it++) {
+		const MemberRecord& member = members[it->second];
+		writeLittle32(tables, it->first.name);
+		writeLittle32(tables, it->first.className);
+		writeLittle32(tables, it->first.descriptor);
+		writeLittle16(tables, member.accessFlags);
+		tables += static_cast<char>(member.method ? 1 : 0);
+		tables += '\0';
+	}
+
+	vector<Posting>::const_iterator posting = sortedPostings.begin();
+	for(uint32_t i = 0; i < referenceOrder.size(); i++) {
+		uint32_t start = posting - sortedPostings.begin();
+		while(posting != sortedPostings.end() && posting->reference == i) {
+			posting++;
+		}
+		writeLittle32(tables, referenceOrder[i].first.className);
+		writeLittle32(tables, referenceOrder[i].first.name);
+		writeLittle32(tables, referenceOrder[i].first.descriptor);
+		writeLittle32(tables, start);
+		writeLittle32(tables, (posting - sortedPostings.begin()) - start);
+	}
+	for(posting = sortedPostings.begin(); posting != sortedPostings.end(); posting++) {
+		writeLittle32(tables, posting->className);
+		writeLittle32(tables, posting->methodName);
+		writeLittle32(tables, posting->methodDescriptor);
+	}
+
+	string header(MAGIC, sizeof(MAGIC));
+	writeLittle32(header, SymbolIndex::VERSION);
+	writeLittle32(header, strings.size());
+	writeLittle64(header, tablesSize + data.size());
+	writeLittle32(header, classes.size());
+	writeLittle32(header, interfaces.size());
+	writeLittle32(header, members.size());
+	writeLittle32(header, references.size());
+	writeLittle32(header, sortedPostings.size());
+	writeLittle32(header, 0);
+
+	string temporary = createTemporaryFile(path);
+	{
+		ofstream out(temporary.c_str(), std::ios::binary | std::ios::trunc);
+		out << header << tables << data;
+		out.close();
+		if(!out) {
+			remove(temporary.c_str());
+			throw runtime_error("Could not write symbol index " + temporary);
+		}
+	}
+	if(rename(temporary.c_str(), path.c_str()) != 0) {
+		remove(temporary.c_str());
+		throw runtime_error("Could not move symbol index " + temporary + " to " + path);
+	}
+}
@@ -0,0 +1,168 @@
+#include "Trace.h"
+#include "Util.h"
+
+#include <chrono>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+
+using std::string;
+using std::vector;
+using std::ostream;
+using std::endl;
+using std::mutex;
+using std::lock_guard;
+using std::atomic;
+
+namespace {
+	struct TraceEvent {
+		const char* category;
+		const char* name;
+		string detail;
+		uint64_t start;
+		uint64_t end;
+	};
+
+	/**
+	 * One thread's events. Only the owning thread adds to them, but the lock keeps writing the trace
+	 * safe while threads are still running.
+	 */
+	struct ThreadTrace {
+		uint32_t id;
+		mutex lock;
+		vector<TraceEvent> events;
+	};
+
+	/**
+	 * Every thread that has recorded anything, in the order they started. Buffers are kept after their
+	 * threads exit, until the trace is written.
+	 */
+	struct Registry {
+		mutex lock;
+		vector<ThreadTrace*> threads;
+		uint64_t origin;
+
+		Registry() : origin(0) {}
+
+		~Registry() {
+			for(vector<ThreadTrace*>::iterator it = threads.begin(); it != threads.end(); it++) {
+				delete *it;
+			}
+		}
+	};
+
+	Registry& getRegistry() {
+		static Registry registry;
+		return registry;
+	}
+
+	thread_local ThreadTrace* currentThread = NULL;
+
+	/**
+	 * Gets the calling thread's buffer, registering it the first time.
+	 */
+	ThreadTrace& getThreadTrace() {
+		if(!currentThread) {
+			Registry& registry = getRegistry();
+			lock_guard<mutex> guard(registry.lock);
+			currentThread = new ThreadTrace();
+			currentThread->id = registry.threads.size() + 1;
+			registry.threads.push_back(currentThread);
+		}
+		return *currentThread;
+	}
+
+	/**
+	 * Writes a time in nanoseconds since the trace started as the microseconds the format wants.
+	 */
+	void writeMicroseconds(ostream& out, uint64_t nanoseconds) {
+		out << (nanoseconds / 1000) << '.' << std::setw(3) << std::setfill('0') << (nanoseconds % 1000) << std::setfill(' ');
+	}
+}
+
+atomic<bool> Trace::enabled(false);
+
+/**
+ * Starts recording spans. Times in the trace are relative to when it was started.
+ */
+void Trace::start() {
+	Registry& registry = getRegistry();
+	{
+		lock_guard<mutex> guard(registry.lock);
+		registry.origin = now();
+	}
+	enabled.store(true, std::memory_order_relaxed);
+}
+
+/**
+ * Stops recording spans. Spans that are already open are still recorded when they end.
+ */
+void Trace::stop() {
+	enabled.store(false, std::memory_order_relaxed);
+}
+
+/**
+ * Gets the current time in nanoseconds, from the clock spans are timed with.
+ */
+uint64_t Trace::now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Adds a finished span to the calling thread's buffer.
+ */
+void Trace::record(const char* category, const char* name, const string& detail, uint64_t start, uint64_t end) {
+	ThreadTrace& thread = getThreadTrace();
+	TraceEvent event;
+	event.category = category;
+	event.name = name;
+	event.detail = detail;
+	event.start = start;
+	event.end = end;
+	lock_guard<mutex> guard(thread.lock);
+	thread.events.push_back(event);
+}
+
+/**
+ * Writes every span recorded so far as a Chrome trace, with a name for each thread's track. Spans with a
+ * detail are named after it, so a class's span reads as the class, and keep the detail as an argument too.
+ */
+void Trace::write(ostream& out) {
+	Registry& registry = getRegistry();
+	lock_guard<mutex> guard(registry.lock);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << endl;
+	bool first = true;
+	for(vector<ThreadTrace*>::iterator thread = registry.threads.begin(); thread != registry.threads.end(); thread++) {
+		lock_guard<mutex> threadGuard((*thread)->lock);
+		out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << (*thread)->id;
+		out << ",\"args\":{\"name\":\"thread " << (*thread)->id << "\"}}";
+		first = false;
+		for(vector<TraceEvent>::const_iterator event = (*thread)->events.begin(); event != (*thread)->events.end(); event++) {
+			uint64_t start = event->start > registry.origin ? event->start - registry.origin : 0;
+			out << ",\n{\"name\":";
+			writeJsonString(out, event->detail.empty() ? string(event->name) : event->detail);
+			out << ",\"cat\":";
+			writeJsonString(out, event->category);
+			out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << (*thread)->id << ",\"ts\":";
+			writeMicroseconds(out, start);
+			out << ",\"dur\":";
+			writeMicroseconds(out, event->end - event->start);
+			if(!event->detail.empty()) {
+				out << ",\"args\":{\"" << event->name << "\":";
+				writeJsonString(out, event->detail);
+				out << "}";
+			}
+			out << "}";
+		}
+	}
+	out << "\n]}" << endl;
+}
+
+/**
+ * Ends the span, and records it.
+ */
+TraceSpan::~TraceSpan() {
+	if(active) {
+		Trace::record(category, name, detail, start, Trace::now());
+	}
+}
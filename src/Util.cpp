@@ -1,5 +1,9 @@
 #include "Util.h"
+#include <atomic>
 #include <stdexcept>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 union readConvert {
 	uint8_t bytes[8];
@@ -42,14 +46,14 @@ readConvert readBytes(std::istream& in, unsigned int numBytes) {
 		case 8:
 			in.read((char*)ret.bytes, 8);
 			ret.ulongVal = 
-				(((uint64_t)ret.bytes[1])<<56) + 
-				(((uint64_t)ret.bytes[0])<<48) + 
-				(((uint64_t)ret.bytes[1])<<40) + 
-				(((uint64_t)ret.bytes[2])<<32) + 
-				(((uint64_t)ret.bytes[0])<<24) + 
-				(((uint64_t)ret.bytes[1])<<16) + 
-				(((uint64_t)ret.bytes[2])<<8) + 
-				((uint64_t)ret.bytes[3]);
+				(((uint64_t)ret.bytes[0])<<56) + 
+				(((uint64_t)ret.bytes[1])<<48) + 
+				(((uint64_t)ret.bytes[2])<<40) + 
+				(((uint64_t)ret.bytes[3])<<32) + 
+				(((uint64_t)ret.bytes[4])<<24) + 
+				(((uint64_t)ret.bytes[5])<<16) + 
+				(((uint64_t)ret.bytes[6])<<8) + 
+				((uint64_t)ret.bytes[7]);
 			return ret;
 			break;
 		default:
@@ -99,3 +103,105 @@ double readDouble(std::istream& in) {
 
 
 
+
+void writeByteUnsigned(std::ostream& out, uint8_t value) {
+	out.put(static_cast<char>(value));
+}
+
+void writeShortUnsigned(std::ostream& out, uint16_t value) {
+	char bytes[2] = { static_cast<char>(value >> 8), static_cast<char>(value) };
+	out.write(bytes, 2);
+}
+
+void writeIntUnsigned(std::ostream& out, uint32_t value) {
+	char bytes[4] = { static_cast<char>(value >> 24), static_cast<char>(value >> 16), static_cast<char>(value >> 8), static_cast<char>(value) };
+	out.write(bytes, 4);
+}
+
+void writeLongUnsigned(std::ostream& out, uint64_t value) {
+	writeIntUnsigned(out, value >> 32);
+	writeIntUnsigned(out, value);
+}
+
+/**
+ * Reads little-endian integers out of memory, for the formats of our own and zip's that use them.
+ */
+uint16_t readLittle16(const uint8_t* p) {
+	return p[0] | (p[1] << 8);
+}
+
+uint32_t readLittle32(const uint8_t* p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t readLittle64(const uint8_t* p) {
+	return readLittle32(p) | (static_cast<uint64_t>(readLittle32(p + 4)) << 32);
+}
+
+/**
+ * Appends little-endian integers to a buffer.
+ */
+void writeLittle16(std::string& out, uint16_t value) {
+	out += static_cast<char>(value);
+	out += static_cast<char>(value >> 8);
+}
+
+void writeLittle32(std::string& out, uint32_t value) {
+	writeLittle16(out, value);
+	writeLittle16(out, value >> 16);
+}
+
+void writeLittle64(std::string& out, uint64_t value) {
+	writeLittle32(out, value);
+	writeLittle32(out, value >> 32);
+}
+
+/**
+ * Returns whether a jar entry is a class file.
+ */
+bool isClassFile(const std::string& name) {
+	return name.size() > 6 && name.compare(name.size() - 6, 6, ".class") == 0;
+}
+
+/**
+ * Writes a string as a JSON string literal.
+ */
+void writeJsonString(std::ostream& out, const std::string& s) {
+	out << '"';
+	for(std::string::const_iterator it = s.begin(); it != s.end(); it++) {
+		switch(*it) {
+			case '"': out << "\\\""; break;
+			case '\\': out << "\\\\"; break;
+			case '\n': out << "\\n"; break;
+			case '\r': out << "\\r"; break;
+			case '\t': out << "\\t"; break;
+			default:
+				if((unsigned char)*it < 0x20) {
+					out << "\\u00" << "0123456789abcdef"[(*it >> 4) & 0xF] << "0123456789abcdef"[*it & 0xF];
+				} else {
+					out << *it;
+				}
+		}
+	}
+	out << '"';
+}
+
+/**
+ * Creates a new, empty file next to path, for writing what will be renamed over path once it's complete. It's
+ * named after the process and a counter and created exclusively, so writers racing to replace the same file
+ * never share one. It gets the permissions a file created normally would.
+ */
+std::string createTemporaryFile(const std::string& path) {
+	static std::atomic<uint32_t> counter(0);
+	for(int attempt = 0; attempt < 100; attempt++) {
+		std::string temporary = path + "." + toString(getpid()) + "." + toString(counter++) + ".tmp";
+		int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+		if(fd >= 0) {
+			close(fd);
+			return temporary;
+		} else if(errno != EEXIST) {
+			break;
+		}
+	}
+	throw std::runtime_error("Could not create a temporary file next to " + path);
+}
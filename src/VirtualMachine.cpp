@@ -1,42 +1,91 @@
 #include "VirtualMachine.h"
+#include "JavaThread.h"
+#include "Inflater.h"
+#include "ClassArchive.h"
+#include "ArrayClass.h"
+#include "LoadStatistics.h"
+#include "Trace.h"
+#include "MemoryStreamBuf.h"
+#include "Util.h"
 #include <fstream>
+#include <set>
 #include <iostream>
 
 #include "zip.h"
 #include <cstdlib>
+#include <stdexcept>
 #include <stdio.h>
 
 using namespace std;
 
 /**
- * Constructor for VirtualMachine. Nothing is specially allocated for this, so nothing is deleted here.
+ * Constructor for VirtualMachine. Opens the JRE's jars, and attaches the calling thread as the main thread.
  */
-VirtualMachine::VirtualMachine() : rtZip(NULL), jceZip(NULL), jsseZip(NULL) {
-	string rt = string(getenv("JAVA_HOME"))+"/jre/lib/rt.jar";
-	int error = 0;
-	rtZip = zip_open(rt.c_str(), 0, &error);
-	if(!rtZip) {
-		throw error;
+VirtualMachine::VirtualMachine() : inflater(NULL), archive(NULL), main(NULL) {
+	const char* javaHome = getenv("JAVA_HOME");
+	if(!javaHome) {
+		throw runtime_error("JAVA_HOME is not set");
 	}
-	
-	string jce = string(getenv("JAVA_HOME"))+"/jre/lib/jce.jar";
-	jceZip = zip_open(jce.c_str(), 0, &error);
-	if(!jceZip) {
-		throw error;
+	vector<string> jars;
+	jars.push_back(string(javaHome) + "/jre/lib/rt.jar");
+	jars.push_back(string(javaHome) + "/jre/lib/jce.jar");
+	jars.push_back(string(javaHome) + "/jre/lib/jsse.jar");
+	openClasspath(jars);
+}
+
+/**
+ * Constructor for VirtualMachine that loads classes from the given jars, searched in order, instead of
+ * from the JRE.
+ */
+VirtualMachine::VirtualMachine(const vector<string>& classpath) : inflater(NULL), archive(NULL), main(NULL) {
+	openClasspath(classpath);
+}
+
+/**
+ * Opens every jar on the classpath, sets up the fastest inflater available, and attaches the calling thread
+ * as the main thread.
+ */
+void VirtualMachine::openClasspath(const vector<string>& jars) {
+	inflater = Inflater::create();
+	this->jars = jars;
+	for(vector<string>::const_iterator it = jars.begin(); it != jars.end(); it++) {
+		int error = 0;
+		struct zip* jar = zip_open(it->c_str(), 0, &error);
+		if(!jar) {
+			closeClasspath();
+			delete inflater;
+			throw runtime_error("Could not open " + *it + ": libzip error " + toString(error));
+		}
+		classpath.push_back(jar);
 	}
 	
-	string jsse = string(getenv("JAVA_HOME"))+"/jre/lib/jsse.jar";
-	jsseZip = zip_open(jsse.c_str(), 0, &error);
-	if(!jsseZip) {
-		throw error;
+	threads.push_back(new JavaThread(*this, 1));
+	threads[0]->attach();
+}
+
+/**
+ * Closes every jar on the classpath.
+ */
+void VirtualMachine::closeClasspath() {
+	for(vector<struct zip*>::iterator it = classpath.begin(); it != classpath.end(); it++) {
+		zip_close(*it); // Get rid of zip file
 	}
+	classpath.clear();
 }
 
 /**
- * Destructor for a VirtualMachine. Deletes all of the class objects that have been loaded.
+ * Destructor for a VirtualMachine. Waits for its threads to finish, and deletes all of the class objects that have been loaded.
  */
 VirtualMachine::~VirtualMachine() {
-	zip_close(rtZip); // Get rid of zip file
+	for(vector<JavaThread*>::iterator it = threads.begin(); it != threads.end(); it++) {
+		delete *it;
+	}
+	closeClasspath();
+	delete inflater;
+	delete archive;
+	for(map<const FieldType*,ArrayClass*>::iterator it = arrayClasses.begin(); it != arrayClasses.end(); it++) {
+		delete it->second;
+	}
 	for(map<string,ClassFile*>::iterator it = classes.begin(); it != classes.end(); it++) {
 		delete it->second;
 	}
@@ -44,37 +93,26 @@ VirtualMachine::~VirtualMachine() {
 
 /**
  * Gets the representation of a class file. If it has not yet been loaded, loads it and initializes it.
+ * Loading is serialized by a recursive lock, since initializing a class loads the classes it refers to.
  */
 ClassFile& VirtualMachine::getClass(string name) {
+	lock_guard<recursive_mutex> lock(classMutex);
 	if(classes.count(name)) {
 		return *(classes[name]);
 	} else {
-		std::string className = name + ".class";
-		struct zip_file* classZipFile = zip_fopen(rtZip, className.c_str(), 0);
-		//I could definitely do this better.
-		if(!classZipFile) {
-			classZipFile = zip_fopen(jceZip, className.c_str(), 0);
-			if(!classZipFile) {
-				classZipFile = zip_fopen(jsseZip, className.c_str(), 0);
-				if(!classZipFile) {
-					cout << name << endl;
-					throw zip_strerror(rtZip);
-				}
-			}
+		TraceSpan span("load", "class", name);
+		const char* data = NULL;
+		size_t size = 0;
+		if(!findClass(name, data, size)) {
+			throw runtime_error("Class not found on the classpath: " + name);
 		}
-#define BUFFER_SIZE (1 << 10)
-		char buffer[BUFFER_SIZE];
-		std::string fileStr = "";
-		int bytes = 0;
-		while((bytes = zip_fread(classZipFile, buffer, BUFFER_SIZE)) > 0) {
-			fileStr = fileStr + std::string(buffer, bytes);
-		}
-		zip_fclose(classZipFile); //Get rid of file memory
-		std::stringstream filestream(fileStr);
-		//f.exceptions(fstream::eofbit | fstream::failbit | fstream::badbit);
+		MemoryStreamBuf buffer(data, size);
+		std::istream filestream(&buffer);
 		ClassFile* cf = new ClassFile(*this,filestream);
 		//cout << "Constructed class file object for " + name << endl;
 		classes[name] = cf;
+		loadOrder.push_back(name);
+		graph.addClass(name, cf->getReferencedClasses());
 		cf->initialize();
 		return *cf;
 	
@@ -82,6 +120,281 @@ ClassFile& VirtualMachine::getClass(string name) {
 	throw "help";
 }
 
+/**
+ * Gets the class of an array type, making it the first time it's asked for. Arrays of classes load the class
+ * of their elements. Array classes are cached by their interned type, so asking again costs a map lookup, and
+ * the name is never parsed again.
+ */
+ArrayClass& VirtualMachine::getArrayClass(const FieldType& type) {
+	lock_guard<recursive_mutex> lock(classMutex);
+	map<const FieldType*,ArrayClass*>::iterator it = arrayClasses.find(&type);
+	if(it != arrayClasses.end()) {
+		return *(it->second);
+	}
+	ClassFile* elementClass = NULL;
+	if(type.getElementKind() == FieldType::REFERENCE) {
+		elementClass = &(getClass(type.getClassName()));
+	}
+	ArrayClass* arrayClass = new ArrayClass(type, elementClass);
+	arrayClasses[&type] = arrayClass;
+	return *arrayClass;
+}
+
+/**
+ * Finds the bytes of a class, in the archive if there is one and the class is in it, and otherwise by
+ * inflating it from the first jar on the classpath that has it. Bytes from the archive point into its mapping;
+ * bytes from a jar are only good until the next class is read, since initializing a class loads others
+ * recursively. Returns false if the class isn't anywhere.
+ */
+bool VirtualMachine::findClass(const string& name, const char*& data, size_t& size) {
+	std::string className = name + ".class";
+	struct zip* jar = NULL;
+	zip_int64_t index = -1;
+	{
+		PhaseTimer timer(PHASE_LOOKUP);
+		if(archive && archive->find(name, data, size)) {
+			return true;
+		}
+		for(vector<struct zip*>::iterator it = classpath.begin(); index < 0 && it != classpath.end(); it++) {
+			jar = *it;
+			index = zip_name_locate(jar, className.c_str(), 0);
+		}
+	}
+	if(index < 0) {
+		return false;
+	}
+	inflater->readEntry(jar, index, classData);
+	data = classData.data();
+	size = classData.size();
+	return true;
+}
+
+/**
+ * Reads the bytes of a class, from wherever getClass would load it, without loading it.
+ */
+string VirtualMachine::readClass(const string& name) {
+	lock_guard<recursive_mutex> lock(classMutex);
+	const char* data = NULL;
+	size_t size = 0;
+	if(!findClass(name, data, size)) {
+		throw runtime_error("Class not found on the classpath: " + name);
+	}
+	return string(data, size);
+}
+
+/**
+ * Gets the names of every class that has been loaded so far, in the order they were loaded.
+ */
+vector<string> VirtualMachine::getLoadedClasses() {
+	lock_guard<recursive_mutex> lock(classMutex);
+	return loadOrder;
+}
+
+/**
+ * Maps a class data sharing archive, which classes are loaded from before the classpath is searched. Classes
+ * that are already loaded stay as they are.
+ */
+void VirtualMachine::setArchive(const string& path) {
+	lock_guard<recursive_mutex> lock(classMutex);
+	ClassArchive* replacement = new ClassArchive(path);
+	delete archive;
+	archive = replacement;
+}
+
+/**
+ * Writes a snapshot of every class that has been loaded, in the order they were loaded, and the main class, as a
+ * class archive that restoreSnapshot can rebuild this state from.
+ */
+void VirtualMachine::saveSnapshot(const string& path) {
+	lock_guard<recursive_mutex> lock(classMutex);
+	vector<pair<string, string> > snapshot;
+	snapshot.reserve(loadOrder.size());
+	for(vector<string>::iterator it = loadOrder.begin(); it != loadOrder.end(); it++) {
+		snapshot.push_back(make_pair(*it, readClass(*it)));
+	}
+	ClassArchive::write(path, snapshot, main ? string(main->getName()) : "");
+}
+
+/**
+ * Restores the classes of a snapshot into a virtual machine that hasn't loaded any yet. The snapshot is mapped as
+ * its archive, and every class is parsed out of the mapping in the order it was originally loaded, before any of
+ * them are initialized, so that initializing them only links them to each other and never searches the classpath
+ * or inflates anything. It's a replay of the original loads, not a restore of parsed state: every class is parsed
+ * and initialized again, so it's no faster than loading the same classes from an archive. Throws if the snapshot
+ * is missing a class it lists.
+ */
+void VirtualMachine::restoreSnapshot(const string& path) {
+	lock_guard<recursive_mutex> lock(classMutex);
+	if(!classes.empty()) {
+		throw runtime_error("A snapshot can only be restored before any classes are loaded");
+	}
+	setArchive(path);
+	vector<string> order = archive->getLoadOrder();
+	for(vector<string>::iterator it = order.begin(); it != order.end(); it++) {
+		TraceSpan span("load", "class", *it);
+		const char* data = NULL;
+		size_t size = 0;
+		{
+			PhaseTimer timer(PHASE_LOOKUP);
+			if(!archive->find(*it, data, size)) {
+				throw runtime_error("Snapshot " + path + " is missing class " + *it);
+			}
+		}
+		MemoryStreamBuf buffer(data, size);
+		std::istream filestream(&buffer);
+		ClassFile* cf = new ClassFile(*this, filestream);
+		classes[*it] = cf;
+		loadOrder.push_back(*it);
+		graph.addClass(*it, cf->getReferencedClasses());
+	}
+	for(vector<string>::iterator it = order.begin(); it != order.end(); it++) {
+		classes[*it]->initialize();
+	}
+	if(!archive->getMainClass().empty()) {
+		setMainClass(archive->getMainClass());
+	}
+}
+
+/**
+ * Gets the graph of which loaded classes refer to which.
+ */
+const DependencyGraph& VirtualMachine::getDependencyGraph() const {
+	return graph;
+}
+
+/**
+ * Reloads classes whose class files have changed, along with every loaded class that refers to them, directly
+ * or not, and leaves every other class as it is. The jars are reopened first, to pick up what changed in them;
+ * if any of them can't be, the old ones are kept and nothing is reloaded. Classes in the archive come from the
+ * archive again. If any class can't be loaded again, the old classes are put back and the exception is thrown,
+ * though the jars stay reopened. Nothing may be running code in the affected classes, since they're deleted.
+ * Returns the names of the classes that were reloaded, in the order they had been loaded.
+ */
+vector<string> VirtualMachine::reloadClasses(const vector<string>& changed) {
+	lock_guard<recursive_mutex> lock(classMutex);
+	set<string> affected = graph.getAffected(changed);
+	vector<string> reloaded;
+	vector<string> kept;
+	for(vector<string>::iterator it = loadOrder.begin(); it != loadOrder.end(); it++) {
+		(affected.count(*it) ? reloaded : kept).push_back(*it);
+	}
+	
+	vector<struct zip*> reopened;
+	for(vector<string>::iterator it = jars.begin(); it != jars.end(); it++) {
+		int error = 0;
+		struct zip* jar = zip_open(it->c_str(), 0, &error);
+		if(!jar) {
+			for(vector<struct zip*>::iterator opened = reopened.begin(); opened != reopened.end(); opened++) {
+				zip_close(*opened);
+			}
+			throw runtime_error("Could not reopen " + *it + ": libzip error " + toString(error));
+		}
+		reopened.push_back(jar);
+	}
+	closeClasspath();
+	classpath.swap(reopened);
+	
+	// The old classes are set aside rather than deleted, so that if any of them can't be loaded again, because
+	// it's gone from the jars or no longer parses, they can be put back as they were.
+	ClassFile* oldMain = main;
+	string mainName = main ? string(main->getName()) : "";
+	vector<string> oldLoadOrder = loadOrder;
+	map<string, ClassFile*> old;
+	for(vector<string>::iterator it = reloaded.begin(); it != reloaded.end(); it++) {
+		if(classes[*it] == main) {
+			main = NULL;
+		}
+		old[*it] = classes[*it];
+		classes.erase(*it);
+		graph.removeClass(*it);
+	}
+	// Array classes of reloaded classes would point at the old ones, so they're set aside too, and made again on
+	// demand.
+	map<const FieldType*,ArrayClass*> oldArrays;
+	for(map<const FieldType*,ArrayClass*>::iterator it = arrayClasses.begin(); it != arrayClasses.end();) {
+		if(affected.count(it->second->getType().getClassName())) {
+			oldArrays.insert(*it);
+			arrayClasses.erase(it++);
+		} else {
+			it++;
+		}
+	}
+	loadOrder = kept;
+	try {
+		for(vector<string>::iterator it = reloaded.begin(); it != reloaded.end(); it++) {
+			getClass(*it);
+		}
+		if(!main && !mainName.empty()) {
+			main = &(getClass(mainName));
+		}
+	} catch(...) {
+		for(vector<string>::iterator it = loadOrder.begin() + kept.size(); it != loadOrder.end(); it++) {
+			delete classes[*it];
+			classes.erase(*it);
+			graph.removeClass(*it);
+		}
+		// Arrays made while reloading, of classes that are gone again, go with them.
+		for(map<const FieldType*,ArrayClass*>::iterator it = arrayClasses.begin(); it != arrayClasses.end();) {
+			const FieldType& type = it->second->getType();
+			if(type.getElementKind() == FieldType::REFERENCE && !classes.count(type.getClassName())) {
+				delete it->second;
+				arrayClasses.erase(it++);
+			} else {
+				it++;
+			}
+		}
+		arrayClasses.insert(oldArrays.begin(), oldArrays.end());
+		for(map<string, ClassFile*>::iterator it = old.begin(); it != old.end(); it++) {
+			classes[it->first] = it->second;
+			graph.addClass(it->first, it->second->getReferencedClasses());
+		}
+		loadOrder = oldLoadOrder;
+		main = oldMain;
+		throw;
+	}
+	for(map<const FieldType*,ArrayClass*>::iterator it = oldArrays.begin(); it != oldArrays.end(); it++) {
+		delete it->second;
+	}
+	for(map<string, ClassFile*>::iterator it = old.begin(); it != old.end(); it++) {
+		delete it->second;
+	}
+	return reloaded;
+}
+
+/**
+ * Switches the backend used to inflate classes as they're loaded.
+ */
+void VirtualMachine::setInflater(const string& backend) {
+	lock_guard<recursive_mutex> lock(classMutex);
+	Inflater* replacement = Inflater::create(backend);
+	delete inflater;
+	inflater = replacement;
+}
+
+/**
+ * Gets the inflater classes are loaded with, for its statistics.
+ */
+const Inflater& VirtualMachine::getInflater() const {
+	return *inflater;
+}
+
+/**
+ * Creates a new JavaThread. It doesn't start running until JavaThread::start is called on it.
+ */
+JavaThread& VirtualMachine::createThread() {
+	lock_guard<mutex> lock(threadMutex);
+	JavaThread* thread = new JavaThread(*this, threads.size() + 1);
+	threads.push_back(thread);
+	return *thread;
+}
+
+/**
+ * Gets the thread that constructed the VirtualMachine.
+ */
+JavaThread& VirtualMachine::getMainThread() {
+	return *(threads[0]);
+}
+
 /**
  * Tells the virtual machine what its main class should be.
  */
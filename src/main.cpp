@@ -1,24 +1,797 @@
 #include "ClassFile.h"
+#include "BatchAnalyzer.h"
+#include "Inflater.h"
+#include "CorpusGenerator.h"
+#include "LoadStatistics.h"
+#include "Trace.h"
+#include "ClassArchive.h"
+#include "ClassPass.h"
+#include "JarTransformer.h"
+#include "SymbolIndex.h"
+#include "SegmentedSymbolIndex.h"
+#include "EscapeAnalysis.h"
+#include "ClassHierarchy.h"
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <set>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <stdexcept>
 #include <stdio.h>
 
 using namespace std;
 
+/**
+ * Prints how to use the program.
+ */
+void usage(const char* program) {
+	cerr << "Usage: " << program << " [--stats] [--trace=FILE] [--inflater=BACKEND]" << endl;
+	cerr << "           [--classpath=JAR:JAR...] [--archive=FILE]" << endl;
+	cerr << "           [--save-snapshot=FILE] [--restore-snapshot=FILE] [--graph=FILE] [--graph-format=dot|binary]" << endl;
+	cerr << "           [--reload=CLASS,CLASS...] [--subtypes=CLASS,CLASS...] [--overriders=CLASS.NAME:DESCRIPTOR]" << endl;
+	cerr << "           [--escape=CLASS,CLASS...] [class]" << endl;
+	cerr << "       " << program << " --batch [--stats] [--trace=FILE] [--stream] [--inflater=BACKEND] [--format=json|csv] [--threads=N]" << endl;
+	cerr << "           [--output=FILE] jar..." << endl;
+	cerr << "       " << program << " --generate [--classes=N] [--package=NAME] [--seed=N] [--constants=N] [--fields=N] [--methods=N]" << endl;
+	cerr << "           [--code-length=N] [--graph=tree|chain|random] [--fanout=N] [--attributes=LIST] [--no-runtime] jar" << endl;
+	cerr << "       " << program << " --dump-archive=FILE [--classpath=JAR:JAR...] [--classlist=FILE] [--closure] [class...]" << endl;
+	cerr << "       " << program << " --verify-archive=FILE" << endl;
+	cerr << "       " << program << " --transform=JAR [--passes=PASS,PASS...] [--shrink] [--threads=N] [--level=N]" << endl;
+	cerr << "           [--inflater=BACKEND] [--trace=FILE] jar" << endl;
+	cerr << "       " << program << " --build-index=FILE jar..." << endl;
+	cerr << "       " << program << " --update-index=FILE jar..." << endl;
+	cerr << "       " << program << " --query-index=FILE [--class=NAME] [--members=NAME] [--references=CLASS[.NAME[:DESCRIPTOR]]]" << endl;
+	cerr << endl;
+	cerr << "With a class name (java/lang/Object by default), loads it and every class it refers to from the JRE, or" << endl;
+	cerr << "from the given jars." << endl;
+	cerr << "With --batch, parses every class in the given jars and prints statistics for each one. --stream reads" << endl;
+	cerr << "each jar in one sequential pass instead of seeking to every entry." << endl;
+	cerr << "With --generate, writes a jar of synthetic classes, the same for the same options on any machine. LIST is" << endl;
+	cerr << "a comma separated list of lines, source, constants, exceptions, custom=SIZE, or none. Class 0 refers to" << endl;
+	cerr << "every other class, directly or not, unless the graph is random." << endl;
+	cerr << "With --dump-archive, writes a class data sharing archive of the given classes, and those listed one per" << endl;
+	cerr << "line in the class list, which --archive maps and loads classes from before searching the classpath." << endl;
+	cerr << "--closure archives every class the given ones load, too. --verify-archive checks an archive's CRCs. An" << endl;
+	cerr << "archive holds inflated class files, so it saves finding and inflating classes, but they're still parsed." << endl;
+	cerr << "With --transform, rewrites every class in a jar through the given passes into a new jar, in parallel, and" << endl;
+	cerr << "deflates it at the given zlib level. Other entries are copied. The passes are:";
+	vector<string> passes = ClassPass::getPasses();
+	for(vector<string>::iterator it = passes.begin(); it != passes.end(); it++) {
+		cerr << " " << *it;
+	}
+	cerr << endl;
+	cerr << "--shrink strips debugging attributes and leaves the constants nothing refers to any more out of each class." << endl;
+	cerr << "With --build-index, scans every class in the given jars into a symbol index, which --query-index maps and" << endl;
+	cerr << "searches for a class, the fields and methods with a name, or what refers to a class, field or method." << endl;
+	cerr << "--update-index keeps a segmented index up to date with the jars, scanning only the classes that changed," << endl;
+	cerr << "and --query-index searches either kind." << endl;
+	cerr << "--save-snapshot writes every class loaded, in load order, and the main class to FILE, and --restore-snapshot" << endl;
+	cerr << "loads them from it again in that order instead of loading the main class, without the JRE or the jars." << endl;
+	cerr << "--graph writes which loaded classes refer to which, for Graphviz or as binary adjacency lists. --reload" << endl;
+	cerr << "reloads the given classes and every class that depends on them, printing their names." << endl;
+	cerr << "--subtypes prints every loaded subclass of the given classes, or implementor of the given interfaces, and" << endl;
+	cerr << "--overriders every loaded class that overrides the given method." << endl;
+	cerr << "--escape prints every allocation site in the methods of the given classes, how far its objects escape, and" << endl;
+	cerr << "whether their fields could be replaced with locals." << endl;
+	cerr << "--stats prints the time, bytes and allocations of each phase of loading, summed over every thread." << endl;
+	cerr << "--trace writes a timeline of every class loaded and its phases, for chrome://tracing or Perfetto." << endl;
+	cerr << endl;
+	cerr << "Inflater backends, fastest first:";
+	vector<string> backends = Inflater::getBackends();
+	for(vector<string>::iterator it = backends.begin(); it != backends.end(); it++) {
+		cerr << " " << *it;
+	}
+	cerr << endl;
+}
+
+/**
+ * Starts tracing if a trace file was asked for, by an argument like --trace=FILE.
+ */
+bool parseTrace(const string& arg, string& traceFile) {
+	if(arg.compare(0, 8, "--trace=") != 0) {
+		return false;
+	}
+	traceFile = arg.substr(8);
+	Trace::start();
+	return true;
+}
+
+/**
+ * Writes the trace, if one was asked for.
+ */
+void writeTrace(const string& traceFile) {
+	if(traceFile.empty()) {
+		return;
+	}
+	Trace::stop();
+	ofstream out(traceFile.c_str());
+	if(!out) {
+		throw runtime_error("Could not open " + traceFile + " for writing");
+	}
+	Trace::write(out);
+}
+
+/**
+ * Adds the jars in a colon separated list to the classpath, for an argument like --classpath=a.jar:b.jar.
+ */
+bool parseClasspath(const string& arg, vector<string>& classpath) {
+	if(arg.compare(0, 12, "--classpath=") != 0) {
+		return false;
+	}
+	stringstream jars(arg.substr(12));
+	string jar;
+	while(getline(jars, jar, ':')) {
+		classpath.push_back(jar);
+	}
+	return true;
+}
+
+/**
+ * Runs batch mode: parses every class in the jars given on the command line, and writes their statistics
+ * to the output, and the throughput to stderr.
+ */
+int runBatch(int argc, const char** argv) {
+	BatchAnalyzer::OutputFormat format = BatchAnalyzer::JSON;
+	unsigned int threads = 0;
+	bool stream = false;
+	string inflater;
+	string output;
+	string traceFile;
+	vector<string> jars;
+	for(int i = 2; i < argc; i++) {
+		string arg = argv[i];
+		if(arg == "--format=json") {
+			format = BatchAnalyzer::JSON;
+		} else if(arg == "--format=csv") {
+			format = BatchAnalyzer::CSV;
+		} else if(arg == "--stream") {
+			stream = true;
+		} else if(arg == "--stats") {
+			LoadStatistics::setEnabled(true);
+		} else if(parseTrace(arg, traceFile)) {
+			continue;
+		} else if(arg.compare(0, 11, "--inflater=") == 0) {
+			inflater = arg.substr(11);
+		} else if(arg.compare(0, 10, "--threads=") == 0) {
+			threads = atoi(arg.c_str() + 10);
+		} else if(arg.compare(0, 9, "--output=") == 0) {
+			output = arg.substr(9);
+		} else if(arg.compare(0, 2, "--") == 0) {
+			usage(argv[0]);
+			return 1;
+		} else {
+			jars.push_back(arg);
+		}
+	}
+	if(jars.empty()) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	// Batch mode never loads classes through the VirtualMachine, so it doesn't need a classpath.
+	VirtualMachine vm((vector<string>()));
+	BatchAnalyzer analyzer(vm, threads);
+	if(!inflater.empty()) {
+		analyzer.setInflater(inflater);
+	}
+	for(vector<string>::iterator it = jars.begin(); it != jars.end(); it++) {
+		analyzer.addJar(*it);
+	}
+	if(stream) {
+		analyzer.runStreaming();
+	} else {
+		analyzer.run();
+	}
+	if(output.empty()) {
+		analyzer.write(cout, format);
+	} else {
+		ofstream out(output.c_str());
+		if(!out) {
+			throw runtime_error("Could not open " + output + " for writing");
+		}
+		analyzer.write(out, format);
+	}
+	analyzer.writeThroughput(cerr);
+	if(LoadStatistics::isEnabled()) {
+		LoadStatistics::write(cerr);
+	}
+	writeTrace(traceFile);
+	return analyzer.numErrors() == 0 ? 0 : 2;
+}
+
+/**
+ * Sets the attributes a generated corpus has from a comma separated list.
+ */
+bool parseAttributes(const string& list, CorpusOptions& options) {
+	options.lineNumbers = false;
+	options.sourceFile = false;
+	options.constantValues = false;
+	options.exceptions = false;
+	options.customAttributeSize = 0;
+	stringstream in(list);
+	string attribute;
+	while(getline(in, attribute, ',')) {
+		if(attribute == "lines") {
+			options.lineNumbers = true;
+		} else if(attribute == "source") {
+			options.sourceFile = true;
+		} else if(attribute == "constants") {
+			options.constantValues = true;
+		} else if(attribute == "exceptions") {
+			options.exceptions = true;
+		} else if(attribute.compare(0, 7, "custom=") == 0) {
+			options.customAttributeSize = atoi(attribute.c_str() + 7);
+		} else if(attribute != "none") {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Runs generate mode: writes a jar of synthetic classes shaped by the command line.
+ */
+int runGenerate(int argc, const char** argv) {
+	CorpusOptions options;
+	string jar;
+	for(int i = 2; i < argc; i++) {
+		string arg = argv[i];
+		if(arg.compare(0, 10, "--classes=") == 0) {
+			options.numClasses = atoi(arg.c_str() + 10);
+		} else if(arg.compare(0, 10, "--package=") == 0) {
+			options.packageName = arg.substr(10);
+		} else if(arg.compare(0, 7, "--seed=") == 0) {
+			options.seed = strtoull(arg.c_str() + 7, NULL, 10);
+		} else if(arg.compare(0, 12, "--constants=") == 0) {
+			options.constantPoolSize = atoi(arg.c_str() + 12);
+		} else if(arg.compare(0, 9, "--fields=") == 0) {
+			options.fields = atoi(arg.c_str() + 9);
+		} else if(arg.compare(0, 10, "--methods=") == 0) {
+			options.methods = atoi(arg.c_str() + 10);
+		} else if(arg.compare(0, 14, "--code-length=") == 0) {
+			options.codeLength = atoi(arg.c_str() + 14);
+		} else if(arg == "--graph=tree") {
+			options.graph = CorpusOptions::TREE;
+		} else if(arg == "--graph=chain") {
+			options.graph = CorpusOptions::CHAIN;
+		} else if(arg == "--graph=random") {
+			options.graph = CorpusOptions::RANDOM;
+		} else if(arg.compare(0, 9, "--fanout=") == 0) {
+			options.fanout = atoi(arg.c_str() + 9);
+		} else if(arg.compare(0, 13, "--attributes=") == 0 && parseAttributes(arg.substr(13), options)) {
+			continue;
+		} else if(arg == "--no-runtime") {
+			options.includeRuntime = false;
+		} else if(arg.compare(0, 2, "--") == 0 || !jar.empty()) {
+			usage(argv[0]);
+			return 1;
+		} else {
+			jar = arg;
+		}
+	}
+	if(jar.empty()) {
+		usage(argv[0]);
+		return 1;
+	}
+	CorpusGenerator generator(options);
+	generator.writeJar(jar);
+	return 0;
+}
+
+/**
+ * Reads a class list: one class name per line, ignoring blank lines and comments starting with #.
+ */
+void readClassList(const string& path, vector<string>& names) {
+	ifstream in(path.c_str());
+	if(!in) {
+		throw runtime_error("Could not open " + path);
+	}
+	string line;
+	while(getline(in, line)) {
+		string::size_type comment = line.find('#');
+		if(comment != string::npos) {
+			line.erase(comment);
+		}
+		string::size_type start = line.find_first_not_of(" \t\r");
+		if(start != string::npos) {
+			names.push_back(line.substr(start, line.find_last_not_of(" \t\r") + 1 - start));
+		}
+	}
+}
+
+/**
+ * Runs dump mode: writes a class data sharing archive of the classes named on the command line and in the
+ * class list, and with --closure, of every class they load.
+ */
+int runDumpArchive(int argc, const char** argv) {
+	string archive = string(argv[1]).substr(15);
+	bool closure = false;
+	vector<string> classpath;
+	vector<string> names;
+	for(int i = 2; i < argc; i++) {
+		string arg = argv[i];
+		if(parseClasspath(arg, classpath)) {
+			continue;
+		} else if(arg.compare(0, 12, "--classlist=") == 0) {
+			readClassList(arg.substr(12), names);
+		} else if(arg == "--closure") {
+			closure = true;
+		} else if(arg.compare(0, 1, "-") == 0) {
+			usage(argv[0]);
+			return 1;
+		} else {
+			names.push_back(arg);
+		}
+	}
+	if(archive.empty() || names.empty()) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	VirtualMachine* vm = classpath.empty() ? new VirtualMachine() : new VirtualMachine(classpath);
+	if(closure) {
+		for(vector<string>::iterator it = names.begin(); it != names.end(); it++) {
+			vm->getClass(*it);
+		}
+		names = vm->getLoadedClasses();
+	}
+	set<string> unique;
+	vector<pair<string, string> > classes;
+	for(vector<string>::iterator it = names.begin(); it != names.end(); it++) {
+		if(unique.insert(*it).second) {
+			classes.push_back(make_pair(*it, vm->readClass(*it)));
+		}
+	}
+	delete vm;
+	ClassArchive::write(archive, classes);
+	cerr << "Archived " << classes.size() << " classes to " << archive << endl;
+	return 0;
+}
+
+/**
+ * Runs verify mode: checks every class in an archive against its CRC.
+ */
+int runVerifyArchive(int argc, const char** argv) {
+	if(argc != 2) {
+		usage(argv[0]);
+		return 1;
+	}
+	ClassArchive archive(string(argv[1]).substr(17));
+	string error;
+	if(!archive.verify(error)) {
+		cerr << error << endl;
+		return 2;
+	}
+	cerr << archive.size() << " classes are intact" << endl;
+	return 0;
+}
+
+/**
+ * Runs transform mode: rewrites the classes in a jar through the passes on the command line, into a new jar.
+ */
+int runTransform(int argc, const char** argv) {
+	string output = string(argv[1]).substr(12);
+	unsigned int threads = 0;
+	int level = -1;
+	string inflater;
+	string traceFile;
+	vector<string> passes;
+	bool shrink = false;
+	string input;
+	for(int i = 2; i < argc; i++) {
+		string arg = argv[i];
+		if(arg.compare(0, 9, "--passes=") == 0) {
+			stringstream names(arg.substr(9));
+			string name;
+			while(getline(names, name, ',')) {
+				passes.push_back(name);
+			}
+		} else if(arg == "--shrink") {
+			shrink = true;
+		} else if(arg.compare(0, 10, "--threads=") == 0) {
+			threads = atoi(arg.c_str() + 10);
+		} else if(arg.compare(0, 8, "--level=") == 0) {
+			level = atoi(arg.c_str() + 8);
+		} else if(arg.compare(0, 11, "--inflater=") == 0) {
+			inflater = arg.substr(11);
+		} else if(parseTrace(arg, traceFile)) {
+			continue;
+		} else if(arg.compare(0, 2, "--") == 0 || !input.empty()) {
+			usage(argv[0]);
+			return 1;
+		} else {
+			input = arg;
+		}
+	}
+	if(output.empty() || input.empty()) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	// Like batch mode, transforming only parses classes, so there's no classpath.
+	VirtualMachine vm((vector<string>()));
+	JarTransformer transformer(vm, threads);
+	for(vector<string>::iterator it = passes.begin(); it != passes.end(); it++) {
+		transformer.addPass(*it);
+	}
+	if(shrink) {
+		if(std::find(passes.begin(), passes.end(), "strip-debug") == passes.end()) {
+			transformer.addPass("strip-debug");
+		}
+		transformer.setCompactConstantPool(true);
+	}
+	if(level >= 0) {
+		transformer.setLevel(level);
+	}
+	if(!inflater.empty()) {
+		transformer.setInflater(inflater);
+	}
+	transformer.run(input, output);
+	const vector<string>& errors = transformer.getErrors();
+	for(vector<string>::const_iterator it = errors.begin(); it != errors.end(); it++) {
+		cerr << *it << endl;
+	}
+	transformer.writeThroughput(cerr);
+	writeTrace(traceFile);
+	return errors.empty() ? 0 : 2;
+}
+
+/**
+ * Runs index mode: scans every class in the jars on the command line into a symbol index.
+ */
+int runBuildIndex(int argc, const char** argv) {
+	string output = string(argv[1]).substr(14);
+	vector<string> jars;
+	for(int i = 2; i < argc; i++) {
+		string arg = argv[i];
+		if(arg.compare(0, 2, "--") == 0) {
+			usage(argv[0]);
+			return 1;
+		}
+		jars.push_back(arg);
+	}
+	if(output.empty() || jars.empty()) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	SymbolIndexWriter writer;
+	for(vector<string>::iterator it = jars.begin(); it != jars.end(); it++) {
+		writer.addJar(*it);
+	}
+	writer.write(output);
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	const vector<string>& errors = writer.getErrors();
+	for(vector<string>::const_iterator it = errors.begin(); it != errors.end(); it++) {
+		cerr << *it << endl;
+	}
+	cerr << "Indexed " << writer.numClasses() << " classes (" << writer.numDuplicates() << " duplicates, " << errors.size()
+		<< " errors) in " << seconds << " s to " << output << endl;
+	return errors.empty() ? 0 : 2;
+}
+
+/**
+ * Runs update mode: brings a segmented symbol index up to date with the jars on the command line.
+ */
+int runUpdateIndex(int argc, const char** argv) {
+	string output = string(argv[1]).substr(15);
+	vector<string> jars;
+	for(int i = 2; i < argc; i++) {
+		string arg = argv[i];
+		if(arg.compare(0, 2, "--") == 0) {
+			usage(argv[0]);
+			return 1;
+		}
+		jars.push_back(arg);
+	}
+	if(output.empty() || jars.empty()) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	SegmentedSymbolIndex index(output);
+	index.update(jars);
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	const vector<string>& errors = index.getErrors();
+	for(vector<string>::const_iterator it = errors.begin(); it != errors.end(); it++) {
+		cerr << *it << endl;
+	}
+	cerr << "Updated " << output << " in " << seconds << " s: scanned " << index.numScanned() << " classes, removed "
+		<< index.numRemoved() << ", merged " << index.numMerged() << " segments, " << index.numClasses() << " classes in "
+		<< index.numSegments() << " segments" << endl;
+	return errors.empty() ? 0 : 2;
+}
+
+/**
+ * Looks up the classes, members and references asked for on the command line in a symbol index of either kind,
+ * printing one result per line, and how long each lookup took to stderr.
+ */
+template<class Index>
+int queryIndex(const Index& index, int argc, const char** argv) {
+	for(int i = 2; i < argc; i++) {
+		string arg = argv[i];
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		size_t results = 0;
+		if(arg.compare(0, 8, "--class=") == 0) {
+			ClassSymbol symbol;
+			if(index.findClass(arg.substr(8), symbol)) {
+				cout << symbol.name << " " << symbol.jar << "!" << symbol.entry << " extends "
+					<< (symbol.superName.empty() ? "-" : symbol.superName);
+				for(vector<string>::iterator it = symbol.interfaces.begin(); it != symbol.interfaces.end(); it++) {
+					cout << (it == symbol.interfaces.begin() ? " implements " : ",") << *it;
+				}
+				cout << endl;
+				results = 1;
+			}
+		} else if(arg.compare(0, 10, "--members=") == 0) {
+			vector<MemberSymbol> members = index.findMembers(arg.substr(10));
+			for(vector<MemberSymbol>::iterator it = members.begin(); it != members.end(); it++) {
+				cout << it->className << "." << it->name << ":" << it->descriptor << (it->method ? " method" : " field") << endl;
+			}
+			results = members.size();
+		} else if(arg.compare(0, 13, "--references=") == 0) {
+			string target = arg.substr(13);
+			string name;
+			string descriptor;
+			size_t dot = target.find('.');
+			if(dot != string::npos) {
+				name = target.substr(dot + 1);
+				target.erase(dot);
+				size_t colon = name.find(':');
+				if(colon != string::npos) {
+					descriptor = name.substr(colon + 1);
+					name.erase(colon);
+				}
+			}
+			vector<ReferenceSymbol> references = index.findReferences(target, name, descriptor);
+			for(vector<ReferenceSymbol>::iterator it = references.begin(); it != references.end(); it++) {
+				cout << it->targetClass;
+				if(!it->name.empty()) {
+					cout << "." << it->name << ":" << it->descriptor;
+				}
+				cout << " <- " << it->className;
+				if(!it->methodName.empty()) {
+					cout << "." << it->methodName << ":" << it->methodDescriptor;
+				}
+				cout << endl;
+			}
+			results = references.size();
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+		cerr << arg << ": " << results << " results in " << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count()
+			<< " ms" << endl;
+	}
+	return 0;
+}
+
+/**
+ * Runs query mode: opens a symbol index, or the manifest of a segmented one, and queries it.
+ */
+int runQueryIndex(int argc, const char** argv) {
+	string path = string(argv[1]).substr(14);
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	if(SegmentedSymbolIndex::isSegmented(path)) {
+		SegmentedSymbolIndex index(path);
+		cerr << "Opened index of " << index.numClasses() << " classes in " << index.numSegments() << " segments in "
+			<< chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms" << endl;
+		return queryIndex(index, argc, argv);
+	}
+	SymbolIndex index(path);
+	cerr << "Opened index of " << index.numClasses() << " classes in "
+		<< chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms" << endl;
+	return queryIndex(index, argc, argv);
+}
+
+/**
+ * Prints the subtypes of each of the given classes, then the overriders of each of the given methods, one per
+ * line, from the hierarchy of every class loaded so far.
+ */
+void writeHierarchy(VirtualMachine& vm, const vector<string>& subtypes, const vector<string>& overriders) {
+	ClassHierarchy hierarchy(vm);
+	for(vector<string>::const_iterator it = subtypes.begin(); it != subtypes.end(); it++) {
+		uint32_t id = hierarchy.getId(*it);
+		vector<string> names;
+		if(id != ClassHierarchy::NONE) {
+			names = hierarchy.isInterface(id) ? hierarchy.getImplementors(*it) : hierarchy.getSubclasses(*it);
+		}
+		for(vector<string>::iterator name = names.begin(); name != names.end(); name++) {
+			cout << *it << " > " << *name << endl;
+		}
+	}
+	for(vector<string>::const_iterator it = overriders.begin(); it != overriders.end(); it++) {
+		size_t dot = it->find('.');
+		size_t colon = it->find(':', dot);
+		if(dot == string::npos || colon == string::npos) {
+			throw runtime_error("Expected CLASS.NAME:DESCRIPTOR instead of " + *it);
+		}
+		vector<string> names = hierarchy.getOverriders(it->substr(0, dot), it->substr(dot + 1, colon - dot - 1), it->substr(colon + 1));
+		for(vector<string>::iterator name = names.begin(); name != names.end(); name++) {
+			cout << *it << " > " << *name << endl;
+		}
+	}
+}
+
+/**
+ * Runs escape analysis on every method with code in each of the given classes, and prints each allocation site in
+ * it, one per line: the method, the pc, the class allocated, how far its objects escape, and, if they could be
+ * scalar replaced, how many fields they'd need as locals. Statically bound callees are loaded and analyzed too.
+ */
+void writeEscapes(VirtualMachine& vm, const vector<string>& classes) {
+	const char* const STATES[] = { "no-escape", "arg-escape", "global-escape" };
+	for(vector<string>::const_iterator it = classes.begin(); it != classes.end(); it++) {
+		ClassFile& cf = vm.getClass(*it);
+		ClassMemberPool& methods = cf.getMethods();
+		for(uint16_t i = 0; i < methods.numMembers(); i++) {
+			const ClassMember& method = methods[i];
+			if(!method.getAttributes().containsAttribute<CodeAttribute>()) {
+				continue;
+			}
+			string methodName = *it + "." + string(method.getName()) + ":" + string(method.getDescriptor());
+			try {
+				EscapeAnalysis analysis(cf, method, &vm);
+				const vector<EscapeAnalysis::AllocationSite>& sites = analysis.getAllocationSites();
+				for(vector<EscapeAnalysis::AllocationSite>::const_iterator site = sites.begin(); site != sites.end(); site++) {
+					cout << methodName << " " << site->pc << " "
+						<< cf.getConstantPool().get<ConstantClassInfo>(site->classIndex).getClassName() << " " << STATES[site->state];
+					if(site->scalarReplaceable) {
+						cout << " scalar-replaceable " << site->fields.size();
+					}
+					cout << endl;
+				}
+			} catch(const std::exception& e) {
+				cerr << methodName << ": " << e.what() << endl;
+			}
+		}
+	}
+}
+
 int main(int argc, const char** argv) {
-	VirtualMachine vm;
-	//vm->getClass("java/lang/StringBuilder");
-	
 	try {
-		//VirtualMachine* vm = new VirtualMachine();
-		if(argc>1) {
-			vm.setMainClass(argv[1]);
+		if(argc > 1 && string(argv[1]) == "--batch") {
+			return runBatch(argc, argv);
+		} else if(argc > 1 && string(argv[1]) == "--generate") {
+			return runGenerate(argc, argv);
+		} else if(argc > 1 && string(argv[1]).compare(0, 15, "--dump-archive=") == 0) {
+			return runDumpArchive(argc, argv);
+		} else if(argc > 1 && string(argv[1]).compare(0, 17, "--verify-archive=") == 0) {
+			return runVerifyArchive(argc, argv);
+		} else if(argc > 1 && string(argv[1]).compare(0, 12, "--transform=") == 0) {
+			return runTransform(argc, argv);
+		} else if(argc > 1 && string(argv[1]).compare(0, 14, "--build-index=") == 0) {
+			return runBuildIndex(argc, argv);
+		} else if(argc > 1 && string(argv[1]).compare(0, 15, "--update-index=") == 0) {
+			return runUpdateIndex(argc, argv);
+		} else if(argc > 1 && string(argv[1]).compare(0, 14, "--query-index=") == 0) {
+			return runQueryIndex(argc, argv);
+		}
+		string inflater;
+		string mainClass = "java/lang/Object";
+		string traceFile;
+		string archive;
+		string saveSnapshot;
+		string restoreSnapshot;
+		string graphFile;
+		bool binaryGraph = false;
+		vector<string> reload;
+		vector<string> subtypes;
+		vector<string> overriders;
+		vector<string> escapes;
+		vector<string> classpath;
+		for(int i = 1; i < argc; i++) {
+			string arg = argv[i];
+			if(arg.compare(0, 11, "--inflater=") == 0) {
+				inflater = arg.substr(11);
+			} else if(arg == "--stats") {
+				LoadStatistics::setEnabled(true);
+			} else if(parseTrace(arg, traceFile)) {
+				continue;
+			} else if(parseClasspath(arg, classpath)) {
+				continue;
+			} else if(arg.compare(0, 10, "--archive=") == 0) {
+				archive = arg.substr(10);
+			} else if(arg.compare(0, 16, "--save-snapshot=") == 0) {
+				saveSnapshot = arg.substr(16);
+			} else if(arg.compare(0, 19, "--restore-snapshot=") == 0) {
+				restoreSnapshot = arg.substr(19);
+			} else if(arg.compare(0, 8, "--graph=") == 0) {
+				graphFile = arg.substr(8);
+			} else if(arg == "--graph-format=dot") {
+				binaryGraph = false;
+			} else if(arg == "--graph-format=binary") {
+				binaryGraph = true;
+			} else if(arg.compare(0, 9, "--reload=") == 0) {
+				stringstream names(arg.substr(9));
+				string name;
+				while(getline(names, name, ',')) {
+					reload.push_back(name);
+				}
+			} else if(arg.compare(0, 11, "--subtypes=") == 0) {
+				stringstream names(arg.substr(11));
+				string name;
+				while(getline(names, name, ',')) {
+					subtypes.push_back(name);
+				}
+			} else if(arg.compare(0, 13, "--overriders=") == 0) {
+				overriders.push_back(arg.substr(13));
+			} else if(arg.compare(0, 9, "--escape=") == 0) {
+				stringstream names(arg.substr(9));
+				string name;
+				while(getline(names, name, ',')) {
+					escapes.push_back(name);
+				}
+			} else if(arg.compare(0, 1, "-") == 0) {
+				usage(argv[0]);
+				return 1;
+			} else {
+				mainClass = arg;
+			}
+		}
+
+		if(!archive.empty() && !restoreSnapshot.empty()) {
+			usage(argv[0]);
+			return 1;
+		}
+
+		// A snapshot has every class it needs, so restoring one doesn't need the JRE.
+		bool jre = classpath.empty() && restoreSnapshot.empty();
+		VirtualMachine* vm = jre ? new VirtualMachine() : new VirtualMachine(classpath);
+		if(!inflater.empty()) {
+			vm->setInflater(inflater);
+		}
+		if(!archive.empty()) {
+			vm->setArchive(archive);
+		}
+		if(restoreSnapshot.empty()) {
+			vm->setMainClass(mainClass);
 		} else {
-			vm.setMainClass("java/lang/Object");
+			vm->restoreSnapshot(restoreSnapshot);
+		}
+		if(!reload.empty()) {
+			vector<string> reloaded = vm->reloadClasses(reload);
+			for(vector<string>::iterator it = reloaded.begin(); it != reloaded.end(); it++) {
+				cout << *it << endl;
+			}
+		}
+		if(!subtypes.empty() || !overriders.empty()) {
+			writeHierarchy(*vm, subtypes, overriders);
+		}
+		if(!escapes.empty()) {
+			writeEscapes(*vm, escapes);
+		}
+		if(!graphFile.empty()) {
+			ofstream out(graphFile.c_str(), binaryGraph ? ios::binary : ios::out);
+			if(!out) {
+				throw runtime_error("Could not open " + graphFile + " for writing");
+			}
+			if(binaryGraph) {
+				vm->getDependencyGraph().writeBinary(out);
+			} else {
+				vm->getDependencyGraph().writeDot(out);
+			}
+		}
+		if(!saveSnapshot.empty()) {
+			vm->saveSnapshot(saveSnapshot);
+		}
+		vm->runMain();
+		Inflater::writeStatistics(cerr, vm->getInflater().getName(), vm->getInflater().getStatistics());
+		if(LoadStatistics::isEnabled()) {
+			LoadStatistics::write(cerr);
 		}
-		vm.runMain();
+		writeTrace(traceFile);
+		delete vm;
 	} catch(const char* str) {
 		cout << str << endl;
 	} catch(string s) {
 		cout << s << endl;
+	} catch(const exception& e) {
+		cout << e.what() << endl;
+		return 1;
 	}
-}
\ No newline at end of file
+	return 0;
+}